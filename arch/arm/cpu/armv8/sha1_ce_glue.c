@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 using the ARMv8 Crypto Extensions, if the CPU has them
+ */
+
+#include <common.h>
+#include <asm/system.h>
+#include <u-boot/sha1.h>
+
+void sha1_ce_transform(u32 state[5], const u8 *src, int blocks);
+
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks)
+{
+	u32 state[5];
+	int i;
+
+	if (!blocks)
+		return;
+	if (!(get_id_aa64isar0() & ID_AA64ISAR0_EL1_SHA1)) {
+		sha1_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	/* The context holds the state in unsigned longs */
+	for (i = 0; i < 5; i++)
+		state[i] = ctx->state[i];
+	sha1_ce_transform(state, data, blocks);
+	for (i = 0; i < 5; i++)
+		ctx->state[i] = state[i];
+}
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-384/SHA-512 using the ARMv8.2 SHA-512 instructions, if the CPU has them
+ */
+
+#include <common.h>
+#include <asm/system.h>
+#include <linux/bitfield.h>
+#include <u-boot/sha512.h>
+
+/* ID_AA64ISAR0_EL1.SHA2 value when the SHA-512 instructions are present */
+#define ID_AA64ISAR0_EL1_SHA2_SHA512	2
+
+void sha512_ce_transform(u64 state[8], const u8 *src, int blocks);
+
+void sha512_process(sha512_context *ctx, const uint8_t *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+	if (FIELD_GET(ID_AA64ISAR0_EL1_SHA2, get_id_aa64isar0()) <
+	    ID_AA64ISAR0_EL1_SHA2_SHA512) {
+		sha512_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	sha512_ce_transform(ctx->state, data, blocks);
+}
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Worker pool for ARMv8, with secondary CPUs switched on and off by PSCI
+ * firmware (e.g. TF-A)
+ */
+
+#include <common.h>
+#include <cpu_func.h>
+#include <errno.h>
+#include <malloc.h>
+#include <time.h>
+#include <worker.h>
+#include <asm/global_data.h>
+#include <asm/io.h>
+#include <asm/psci.h>
+#include <asm/ptrace.h>
+#include <asm/system.h>
+#include <asm/armv8/worker.h>
+#include <dm/ofnode.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Affinity fields of MPIDR_EL1, which identify a CPU to PSCI */
+#define MPIDR_HWID_MASK		0xff00ffffffUL
+
+/* Time allowed for a CPU to switch off */
+#define WORKER_OFF_TIMEOUT_MS	100
+
+static struct worker_boot worker_boot[CONFIG_WORKER_NR_CPUS - 1];
+
+static long worker_psci(ulong fn, ulong arg0, ulong arg1, ulong arg2)
+{
+	struct pt_regs regs;
+
+	regs.regs[0] = fn;
+	regs.regs[1] = arg0;
+	regs.regs[2] = arg1;
+	regs.regs[3] = arg2;
+	smc_call(&regs);
+
+	return regs.regs[0];
+}
+
+static int worker_psci_err(long ret)
+{
+	switch (ret) {
+	case ARM_PSCI_RET_SUCCESS:
+		return 0;
+	case ARM_PSCI_RET_NI:
+		return -ENOSYS;
+	case ARM_PSCI_RET_INVAL:
+	case ARM_PSCI_RET_INVALID_ADDRESS:
+		return -EINVAL;
+	case ARM_PSCI_RET_DENIED:
+		return -EPERM;
+	case ARM_PSCI_RET_ALREADY_ON:
+	case ARM_PSCI_RET_ON_PENDING:
+		return -EBUSY;
+	default:
+		return -EIO;
+	}
+}
+
+/* Check that firmware provides PSCI 0.2 or later through SMC calls */
+static bool worker_have_psci(void)
+{
+	const char *method;
+	ofnode node;
+	long ver;
+
+	if (current_el() == 3)
+		return false;
+	node = ofnode_path("/psci");
+	method = ofnode_read_string(node, "method");
+	if (!method || strcmp(method, "smc"))
+		return false;
+	ver = worker_psci(ARM_PSCI_0_2_FN_PSCI_VERSION, 0, 0, 0);
+
+	return ver >= 2;
+}
+
+int arch_worker_cpus(ulong *ids, int max)
+{
+	const fdt32_t *reg;
+	ofnode cpus, node;
+	ulong self, id;
+	int count = 0;
+	int i, len;
+
+	if (!worker_have_psci())
+		return 0;
+	asm volatile("mrs %0, mpidr_el1" : "=r" (self));
+	self &= MPIDR_HWID_MASK;
+
+	cpus = ofnode_path("/cpus");
+	if (ofnode_valid(cpus)) {
+		ofnode_for_each_subnode(node, cpus) {
+			if (strcmp(ofnode_read_string(node, "device_type") ?: "",
+				   "cpu"))
+				continue;
+			reg = ofnode_get_property(node, "reg", &len);
+			if (!reg || len < sizeof(*reg))
+				continue;
+			id = fdt32_to_cpu(reg[0]);
+			if (len >= 2 * sizeof(*reg))
+				id = (u64)id << 32 | fdt32_to_cpu(reg[1]);
+			if (id != self && count < max)
+				ids[count++] = id;
+		}
+	}
+	if (count)
+		return count;
+
+	/* Without CPU nodes, assume the CPUs in our cluster count from 0 */
+	for (i = 0; i < CONFIG_WORKER_NR_CPUS && count < max; i++) {
+		id = (self & ~0xffUL) | i;
+		if (id != self)
+			ids[count++] = id;
+	}
+
+	return count;
+}
+
+static void __noreturn worker_secondary_main(struct worker_cpu *wc)
+{
+	worker_main(wc);
+
+	/* Firmware cleans this CPU's caches as it powers down */
+	worker_psci(ARM_PSCI_0_2_FN_CPU_OFF, 0, 0, 0);
+	while (1)
+		wfi();
+}
+
+int arch_worker_start(struct worker_cpu *wc)
+{
+	struct worker_boot *wb = &worker_boot[wc->index];
+	void *stack = wc->priv;
+	phys_addr_t entry;
+
+	if (!stack) {
+		stack = memalign(16, CONFIG_WORKER_STACK_SIZE);
+		if (!stack)
+			return -ENOMEM;
+		wc->priv = stack;
+	}
+
+	wb->sp = (ulong)stack + CONFIG_WORKER_STACK_SIZE;
+	wb->gd = (ulong)gd;
+	switch (current_el()) {
+	case 2:
+		asm volatile("mrs %0, ttbr0_el2" : "=r" (wb->ttbr));
+		asm volatile("mrs %0, tcr_el2" : "=r" (wb->tcr));
+		asm volatile("mrs %0, mair_el2" : "=r" (wb->mair));
+		asm volatile("mrs %0, sctlr_el2" : "=r" (wb->sctlr));
+		asm volatile("mrs %0, vbar_el2" : "=r" (wb->vbar));
+		asm volatile("mrs %0, cptr_el2" : "=r" (wb->cptr));
+		break;
+	default:
+		asm volatile("mrs %0, ttbr0_el1" : "=r" (wb->ttbr));
+		asm volatile("mrs %0, tcr_el1" : "=r" (wb->tcr));
+		asm volatile("mrs %0, mair_el1" : "=r" (wb->mair));
+		asm volatile("mrs %0, sctlr_el1" : "=r" (wb->sctlr));
+		asm volatile("mrs %0, vbar_el1" : "=r" (wb->vbar));
+		asm volatile("mrs %0, cpacr_el1" : "=r" (wb->cptr));
+		break;
+	}
+	wb->func = (ulong)worker_secondary_main;
+	wb->arg = (ulong)wc;
+	flush_dcache_range((ulong)wb, (ulong)(wb + 1));
+
+	entry = virt_to_phys((void *)worker_secondary_entry);
+
+	return worker_psci_err(worker_psci(ARM_PSCI_0_2_FN64_CPU_ON, wc->id,
+					   entry, virt_to_phys(wb)));
+}
+
+int arch_worker_stop(struct worker_cpu *wc)
+{
+	ulong start = get_timer(0);
+
+	while (worker_psci(ARM_PSCI_0_2_FN64_AFFINITY_INFO, wc->id, 0, 0) !=
+	       PSCI_AFFINITY_LEVEL_OFF) {
+		if (get_timer(start) > WORKER_OFF_TIMEOUT_MS)
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+void arch_worker_idle(void)
+{
+	int i;
+
+	/*
+	 * Poll rather than using WFE, since nothing generates an event when
+	 * a timeout expires
+	 */
+	for (i = 0; i < 16; i++)
+		asm volatile("yield");
+}
@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Start-up information for secondary CPUs in the worker pool
+ */
+
+#ifndef _ASM_ARMV8_WORKER_H_
+#define _ASM_ARMV8_WORKER_H_
+
+/* Offsets into struct worker_boot, for use by worker_secondary_entry */
+#define WB_SP		0
+#define WB_GD		8
+#define WB_TTBR		16
+#define WB_TCR		24
+#define WB_MAIR		32
+#define WB_SCTLR	40
+#define WB_VBAR		48
+#define WB_CPTR		56
+#define WB_FUNC		64
+#define WB_ARG		72
+
+#ifndef __ASSEMBLY__
+#include <asm/cache.h>
+#include <linux/types.h>
+
+/**
+ * struct worker_boot - state handed to a secondary CPU as it starts
+ *
+ * The CPU reads this with its MMU and caches off, so it must be flushed to
+ * memory before the CPU is switched on. System registers are those for the
+ * exception level U-Boot is running at.
+ *
+ * @sp:		Initial stack pointer
+ * @gd:		Global data pointer, for x18
+ * @ttbr:	Translation table base (TTBR0)
+ * @tcr:	Translation control register
+ * @mair:	Memory attribute indirection register
+ * @sctlr:	System control register, enabling the MMU and caches
+ * @vbar:	Exception vector base
+ * @cptr:	FP/SIMD trap control (CPTR_ELx, or CPACR_EL1 at EL1)
+ * @func:	Function to call once set up
+ * @arg:	Argument for @func
+ */
+struct worker_boot {
+	u64 sp;
+	u64 gd;
+	u64 ttbr;
+	u64 tcr;
+	u64 mair;
+	u64 sctlr;
+	u64 vbar;
+	u64 cptr;
+	u64 func;
+	u64 arg;
+} __aligned(ARCH_DMA_MINALIGN);
+
+/* Entry point passed to PSCI CPU_ON, with x0 pointing to a worker_boot */
+void worker_secondary_entry(void);
+#endif
+
+#endif /* _ASM_ARMV8_WORKER_H_ */
@@ -83,6 +83,13 @@
 #define HCR_EL2_RW_AARCH32	(0 << 31) /* Lower levels are AArch32         */
 #define HCR_EL2_HCD_DIS		(1 << 29) /* Hypervisor Call disabled         */
 
+/*
+ * ID_AA64ISAR0_EL1 bits definitions
+ */
+#define ID_AA64ISAR0_EL1_CRC32	(0xF << 16) /* CRC32 instructions             */
+#define ID_AA64ISAR0_EL1_SHA2	(0xF << 12) /* SHA256 (1), SHA512 (2) insns   */
+#define ID_AA64ISAR0_EL1_SHA1	(0xF << 8)  /* SHA1 instructions              */
+
 /*
  * ID_AA64ISAR1_EL1 bits definitions
  */
@@ -160,6 +167,14 @@ static inline unsigned int current_el(void)
 	return 3 & (el >> 2);
 }
 
+static inline unsigned long get_id_aa64isar0(void)
+{
+	unsigned long val;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (val));
+	return val;
+}
+
 static inline unsigned int get_sctlr(void)
 {
 	unsigned int el;
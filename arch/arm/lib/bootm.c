@@ -31,6 +31,7 @@
 #include <linux/compiler.h>
 #include <bootm.h>
 #include <vxworks.h>
+#include <worker.h>
 #include <asm/cache.h>
 
 #ifdef CONFIG_ARMV7_NONSEC
@@ -67,6 +68,9 @@ static void announce_and_cleanup(int fake)
 
 	board_quiesce_devices();
 
+	/* The OS expects to start the secondary CPUs itself */
+	worker_park();
+
 	printf("\nStarting kernel ...%s\n\n", fake ?
 		"(fake run for tracing)" : "");
 	/*
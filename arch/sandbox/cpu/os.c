@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
@@ -985,3 +986,43 @@ void os_relaunch(char *argv[])
 	execv(argv[0], argv);
 	os_exit(1);
 }
+
+struct os_thread {
+	pthread_t thread;
+	void (*func)(void *arg);
+	void *arg;
+};
+
+static void *os_thread_start(void *data)
+{
+	struct os_thread *thr = data;
+
+	thr->func(thr->arg);
+
+	return NULL;
+}
+
+void *os_thread_create(void (*func)(void *arg), void *arg)
+{
+	struct os_thread *thr;
+
+	thr = os_malloc(sizeof(*thr));
+	if (!thr)
+		return NULL;
+	thr->func = func;
+	thr->arg = arg;
+	if (pthread_create(&thr->thread, NULL, os_thread_start, thr)) {
+		os_free(thr);
+		return NULL;
+	}
+
+	return thr;
+}
+
+void os_thread_join(void *thread)
+{
+	struct os_thread *thr = thread;
+
+	pthread_join(thr->thread, NULL);
+	os_free(thr);
+}
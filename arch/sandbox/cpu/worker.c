@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Worker pool for sandbox, using a host thread for each 'CPU'
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <os.h>
+#include <worker.h>
+
+int arch_worker_cpus(ulong *ids, int max)
+{
+	int i;
+
+	for (i = 0; i < max; i++)
+		ids[i] = i + 1;
+
+	return max;
+}
+
+static void sandbox_worker_thread(void *arg)
+{
+	worker_main(arg);
+}
+
+int arch_worker_start(struct worker_cpu *wc)
+{
+	wc->priv = os_thread_create(sandbox_worker_thread, wc);
+
+	return wc->priv ? 0 : -EAGAIN;
+}
+
+int arch_worker_stop(struct worker_cpu *wc)
+{
+	os_thread_join(wc->priv);
+	wc->priv = NULL;
+
+	return 0;
+}
+
+void arch_worker_idle(void)
+{
+	/* Sleep rather than spin, so idle threads do not slow down the host */
+	os_usleep(10);
+}
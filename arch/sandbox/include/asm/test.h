@@ -285,4 +285,33 @@ void sandbox_cros_ec_set_test_flags(struct udevice *dev, uint flags);
  */
 int sandbox_cros_ec_get_pwm_duty(struct udevice *dev, uint index, uint *duty);
 
+/**
+ * sandbox_mmc_set_emmc() - Select whether an MMC device emulates an eMMC
+ *
+ * The card is an SD card by default. The new type is seen the next time
+ * the card is initialised, e.g. after clearing mmc->has_init.
+ *
+ * @dev: MMC device to update
+ * @emmc: true to emulate an eMMC, false for an SD card
+ */
+void sandbox_mmc_set_emmc(struct udevice *dev, bool emmc);
+
+/**
+ * sandbox_mmc_get_cqe_tasks() - Count the tasks queued on an MMC device
+ *
+ * @dev: MMC device to check
+ * @return number of read and write tasks carried out by its command queue
+ *	engine
+ */
+int sandbox_mmc_get_cqe_tasks(struct udevice *dev);
+
+/**
+ * sandbox_mmc_set_cqe_stall() - Stop an MMC device finishing queued tasks
+ *
+ * @dev: MMC device to update
+ * @stall: true to never report queued tasks as finished, false to report
+ *	them as normal
+ */
+void sandbox_mmc_set_cqe_stall(struct udevice *dev, bool stall);
+
 #endif
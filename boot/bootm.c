@@ -389,9 +389,26 @@ static int bootm_load_os(bootm_headers_t *images, int boot_progress)
 
 	load_buf = map_sysmem(load, 0);
 	image_buf = map_sysmem(os.image_start, image_len);
-	err = image_decomp(os.comp, load, os.image_start, os.type,
-			   load_buf, image_buf, image_len,
-			   CONFIG_SYS_BOOTM_LEN, &load_end);
+	if (CONFIG_IS_ENABLED(FIT_STREAM) && images->fit_stream_os) {
+		ulong len = 0;
+
+		printf("   Uncompressing %s\n", genimg_get_type_name(os.type));
+		err = fit_image_stream_load(images->fit_hdr_os,
+					    images->fit_noffset_os, os.comp,
+					    image_buf, image_len, load_buf,
+					    CONFIG_SYS_BOOTM_LEN, &len);
+		if (err == -EACCES) {
+			puts("Bad Data Hash\n");
+			bootstage_error(BOOTSTAGE_ID_FIT_KERNEL_START +
+					BOOTSTAGE_SUB_HASH);
+			return BOOTM_ERR_RESET;
+		}
+		load_end = load + len;
+	} else {
+		err = image_decomp(os.comp, load, os.image_start, os.type,
+				   load_buf, image_buf, image_len,
+				   CONFIG_SYS_BOOTM_LEN, &load_end);
+	}
 	if (err) {
 		err = handle_decomp_error(os.comp, load_end - load, err);
 		bootstage_error(BOOTSTAGE_ID_DECOMP_IMAGE);
@@ -918,6 +935,8 @@ static const void *boot_get_kernel(struct cmd_tbl *cmdtp, int flag, int argc,
 #endif
 #if CONFIG_IS_ENABLED(FIT)
 	case IMAGE_FORMAT_FIT:
+		/* Check the hashes while decompressing, if possible */
+		images->fit_stream_req = true;
 		os_noffset = fit_image_load(images, img_addr,
 				&fit_uname_kernel, &fit_uname_config,
 				IH_ARCH_DEFAULT, IH_TYPE_KERNEL,
@@ -19,6 +19,7 @@
 #include <malloc.h>
 #include <mapmem.h>
 #include <vxworks.h>
+#include <worker.h>
 #include <tee/optee.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -593,6 +594,8 @@ __weak void board_preboot_os(void)
 int boot_selected_os(int argc, char *const argv[], int state,
 		     bootm_headers_t *images, boot_os_fn *boot_fn)
 {
+	/* Nothing may run on the secondary CPUs once the OS has control */
+	worker_park();
 	arch_preboot_os();
 	board_preboot_os();
 	boot_fn(state, argc, argv, images);
@@ -0,0 +1,442 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Single-pass verification and loading of FIT sub-images
+ *
+ * Rather than hashing a whole sub-image and then copying or decompressing
+ * it, the data is processed in chunks: each chunk is hashed and then
+ * immediately handed to the decompressor while it is still in the cache.
+ * With CONFIG_WORKER, a secondary CPU hashes each chunk while the boot CPU
+ * decompresses it.
+ */
+
+#define LOG_CATEGORY LOGC_BOOT
+
+#include <common.h>
+#include <gzip.h>
+#include <hash.h>
+#include <image.h>
+#include <log.h>
+#include <malloc.h>
+#include <watchdog.h>
+#include <worker.h>
+#include <asm/global_data.h>
+#include <linux/sizes.h>
+#include <linux/zstd.h>
+#include <u-boot/zlib.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Amount of image data hashed and then passed on in one go */
+#define FIT_STREAM_CHUNK	SZ_64K
+
+/* Maximum number of hash nodes we can check in one pass */
+#define FIT_STREAM_MAX_HASHES	4
+
+/**
+ * struct fit_stream_hash - a hash being calculated over the image data
+ *
+ * @noffset:	Offset of the hash node in the FIT
+ * @algo:	Hash algorithm to use
+ * @ctx:	Progressive hashing context
+ */
+struct fit_stream_hash {
+	int noffset;
+	struct hash_algo *algo;
+	void *ctx;
+};
+
+/* Check whether the control FDT holds keys which must sign each image */
+static bool fit_stream_image_sigs_required(void)
+{
+	const void *blob = gd_fdt_blob();
+	const char *required;
+	int sig_node, noffset;
+
+	if (!FIT_IMAGE_ENABLE_VERIFY || !blob)
+		return false;
+
+	sig_node = fdt_subnode_offset(blob, 0, FIT_SIG_NODENAME);
+	if (sig_node < 0)
+		return false;
+
+	fdt_for_each_subnode(noffset, blob, sig_node) {
+		required = fdt_getprop(blob, noffset, FIT_KEY_REQUIRED, NULL);
+		if (required && !strcmp(required, "image"))
+			return true;
+	}
+
+	return false;
+}
+
+bool fit_image_can_stream(const void *fit, int noffset, int comp)
+{
+	struct hash_algo *algo;
+	int count = 0;
+	char *algo_name;
+	const char *name;
+	int node;
+
+	if (comp != IH_COMP_NONE &&
+	    !(comp == IH_COMP_GZIP && CONFIG_IS_ENABLED(GZIP)) &&
+	    !(comp == IH_COMP_ZSTD && CONFIG_IS_ENABLED(ZSTD)))
+		return false;
+
+	/* Signatures and ciphers need the whole image to be present */
+	if (fit_stream_image_sigs_required())
+		return false;
+
+	fdt_for_each_subnode(node, fit, noffset) {
+		name = fit_get_name(fit, node, NULL);
+		if (!strncmp(name, FIT_SIG_NODENAME,
+			     strlen(FIT_SIG_NODENAME)) ||
+		    !strncmp(name, FIT_CIPHER_NODENAME,
+			     strlen(FIT_CIPHER_NODENAME)))
+			return false;
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, node, &algo_name) ||
+		    hash_lookup_algo(algo_name, &algo) || !algo->hash_init)
+			return false;
+		if (++count > FIT_STREAM_MAX_HASHES)
+			return false;
+	}
+
+	return true;
+}
+
+static int fit_stream_hash_init(const void *fit, int noffset,
+				struct fit_stream_hash *hash)
+{
+	int ignore, count = 0;
+	struct hash_algo *algo;
+	char *algo_name;
+	const char *name;
+	int node;
+
+	fdt_for_each_subnode(node, fit, noffset) {
+		name = fit_get_name(fit, node, NULL);
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		fit_image_hash_get_ignore(fit, node, &ignore);
+		if (ignore)
+			continue;
+		if (fit_image_hash_get_algo(fit, node, &algo_name) ||
+		    hash_lookup_algo(algo_name, &algo))
+			return -EINVAL;
+		if (count == FIT_STREAM_MAX_HASHES)
+			return -E2BIG;
+		hash[count].noffset = node;
+		hash[count].algo = algo;
+		if (algo->hash_init(algo, &hash[count].ctx))
+			return -ENOMEM;
+		count++;
+	}
+
+	return count;
+}
+
+static int fit_stream_hash_update(struct fit_stream_hash *hash, int count,
+				  const void *buf, ulong size, bool last)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (hash[i].algo->hash_update(hash[i].algo, hash[i].ctx, buf,
+					      size, last)) {
+			/* hash_update() frees the context on error */
+			hash[i].ctx = NULL;
+			return -EIO;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * struct fit_stream_hash_job - hashing of one chunk, which may run on another
+ * CPU
+ *
+ * @hash:	Hashes to update
+ * @count:	Number of hashes
+ * @buf:	Data to hash
+ * @size:	Number of bytes in @buf
+ * @last:	true if this is the last chunk
+ */
+struct fit_stream_hash_job {
+	struct fit_stream_hash *hash;
+	int count;
+	const void *buf;
+	ulong size;
+	bool last;
+};
+
+static int fit_stream_hash_job(void *arg)
+{
+	struct fit_stream_hash_job *hj = arg;
+
+	return fit_stream_hash_update(hj->hash, hj->count, hj->buf, hj->size,
+				      hj->last);
+}
+
+static int fit_stream_hash_check(const void *fit, int image_noffset,
+				 struct fit_stream_hash *hash, int count)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	uint8_t *fit_value;
+	int fit_value_len;
+	int i, ret = 0;
+
+	for (i = 0; i < count; i++) {
+		struct hash_algo *algo = hash[i].algo;
+		const char *err_msg = NULL;
+
+		printf("%s", algo->name);
+		if (hash[i].algo->hash_finish(algo, hash[i].ctx, value,
+					      sizeof(value)))
+			err_msg = "Can't calculate hash value";
+		else if (fit_image_hash_get_value(fit, hash[i].noffset,
+						  &fit_value, &fit_value_len))
+			err_msg = "Can't get hash value property";
+		else if (fit_value_len != algo->digest_size)
+			err_msg = "Bad hash value len";
+		else if (memcmp(value, fit_value, fit_value_len))
+			err_msg = "Bad hash value";
+		hash[i].ctx = NULL;
+
+		if (err_msg) {
+			printf(" error!\n%s for '%s' hash node in '%s' image node\n",
+			       err_msg, fit_get_name(fit, hash[i].noffset, NULL),
+			       fit_get_name(fit, image_noffset, NULL));
+			ret = -EACCES;
+			break;
+		}
+		puts("+ ");
+	}
+
+	return ret;
+}
+
+static void fit_stream_hash_abort(struct fit_stream_hash *hash, int count)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (hash[i].ctx)
+			hash[i].algo->hash_finish(hash[i].algo, hash[i].ctx,
+						  value, sizeof(value));
+	}
+}
+
+/**
+ * fit_stream_inflate() - pass the next chunk of data to the decompressor
+ *
+ * @s:		zlib stream, with next_out and avail_out set up
+ * @buf:	Compressed data
+ * @size:	Number of bytes in @buf
+ * @return 0 if more input is needed, 1 at the end of the compressed
+ * stream, -ENOSPC if the output buffer is full, -EIO on corrupt data
+ */
+static int fit_stream_inflate(z_stream *s, const void *buf, ulong size)
+{
+	int r;
+
+	s->next_in = (unsigned char *)buf;
+	s->avail_in = size;
+	do {
+		r = inflate(s, Z_NO_FLUSH);
+		if (r == Z_STREAM_END)
+			return 1;
+		if (r == Z_BUF_ERROR && !s->avail_out)
+			return -ENOSPC;
+		if (r != Z_OK && r != Z_BUF_ERROR) {
+			printf("Error: inflate() returned %d\n", r);
+			return -EIO;
+		}
+	} while (s->avail_in);
+
+	return 0;
+}
+
+/**
+ * fit_stream_unzstd() - pass the next chunk of data to the zstd decompressor
+ *
+ * @zs:		zstd stream
+ * @zin:	Compressed data; the caller sets the size to the amount which
+ *		has been hashed so far
+ * @zout:	Output buffer
+ * @return 0 if more input is needed, 1 at the end of the compressed
+ * stream, -ENOSPC if the output buffer is full, -EIO on corrupt data
+ */
+static int fit_stream_unzstd(struct zstd_stream *zs, ZSTD_inBuffer *zin,
+			     ZSTD_outBuffer *zout)
+{
+	int r;
+
+	r = zstd_stream_decompress(zs, zin, zout);
+	if (r < 0 && r != -ENOSPC) {
+		printf("Error: zstd decompression failed (%d)\n", r);
+		return -EIO;
+	}
+
+	return r;
+}
+
+int fit_image_stream_load(const void *fit, int noffset, int comp,
+			  const void *src, ulong srclen, void *dst,
+			  ulong dstlen, ulong *lenp)
+{
+	struct fit_stream_hash hash[FIT_STREAM_MAX_HASHES];
+	struct fit_stream_hash_job hj;
+	struct worker_job job;
+	const char *in = src;
+	bool copy, inflating = false, unzstd = false, hash_first;
+	ZSTD_inBuffer zin = { .src = src };
+	ZSTD_outBuffer zout = { .dst = dst, .size = dstlen };
+	struct zstd_stream zs;
+	ulong pos, size, skip = 0;
+	int count, ret, hret, zret = 0;
+	z_stream s;
+
+	copy = comp == IH_COMP_NONE && dst != src;
+	if (copy && srclen > dstlen)
+		return -ENOSPC;
+
+	/*
+	 * Copying forwards in chunks would overwrite data which is not hashed
+	 * yet if the destination overlaps the end of the source
+	 */
+	if (copy && dst > src && dst < src + srclen) {
+		if (!fit_image_verify_with_data(fit, noffset, src, srclen))
+			return -EACCES;
+		memmove(dst, src, srclen);
+		if (lenp)
+			*lenp = srclen;
+		return 0;
+	}
+
+	puts("   Verifying Hash Integrity ... ");
+	count = fit_stream_hash_init(fit, noffset, hash);
+	if (count < 0) {
+		printf("error!\nCan't set up hashes for '%s' image node\n",
+		       fit_get_name(fit, noffset, NULL));
+		return -EACCES;
+	}
+	hj.hash = hash;
+	hj.count = count;
+
+	/*
+	 * Each chunk is normally hashed on another CPU while it is used here.
+	 * Hash it first if the output might overwrite it, or if hashing uses
+	 * hardware which only the boot CPU may touch.
+	 */
+	hash_first = CONFIG_IS_ENABLED(SHA_PROG_HW_ACCEL) ||
+		(dst < src + srclen && dst + dstlen > (void *)src);
+
+	if (comp == IH_COMP_GZIP) {
+		ret = gzip_parse_header(src, srclen);
+		if (ret < 0)
+			goto abort;
+		skip = ret;
+		memset(&s, '\0', sizeof(s));
+		s.zalloc = gzalloc;
+		s.zfree = gzfree;
+		if (inflateInit2(&s, -MAX_WBITS) != Z_OK) {
+			ret = -ENOMEM;
+			goto abort;
+		}
+		inflating = true;
+		s.next_out = dst;
+		s.avail_out = dstlen;
+	} else if (CONFIG_IS_ENABLED(ZSTD) && comp == IH_COMP_ZSTD) {
+		/* The output stays in @dst, so no window buffer is needed */
+		ret = zstd_stream_init(&zs);
+		if (ret)
+			goto abort;
+		unzstd = true;
+	}
+
+	for (pos = 0; pos < srclen; pos += size) {
+		size = min_t(ulong, srclen - pos, FIT_STREAM_CHUNK);
+		hj.buf = in + pos;
+		hj.size = size;
+		hj.last = pos + size == srclen;
+		worker_submit(&job, fit_stream_hash_job, &hj);
+		if (hash_first) {
+			ret = worker_wait(&job);
+			if (ret)
+				goto abort;
+		}
+
+		ret = 0;
+		if (copy) {
+			memmove(dst + pos, in + pos, size);
+		} else if (inflating && !zret && pos + size > skip) {
+			ulong start = max(pos, skip);
+
+			zret = fit_stream_inflate(&s, in + start,
+						  pos + size - start);
+			if (zret < 0)
+				ret = zret;
+		} else if (unzstd && !zret) {
+			zin.size = pos + size;
+			zret = fit_stream_unzstd(&zs, &zin, &zout);
+			if (zret < 0)
+				ret = zret;
+		}
+
+		hret = worker_wait(&job);
+		if (ret || hret) {
+			ret = ret ?: hret;
+			goto abort;
+		}
+		WATCHDOG_RESET();
+	}
+
+	if (inflating) {
+		if (zret != 1) {
+			if (s.avail_out) {
+				printf("Error: compressed data is truncated\n");
+				ret = -EIO;
+			} else {
+				ret = -ENOSPC;
+			}
+			goto abort;
+		}
+		if (lenp)
+			*lenp = s.total_out;
+		inflateEnd(&s);
+		inflating = false;
+	} else if (unzstd) {
+		if (zret != 1) {
+			printf("Error: compressed data is truncated\n");
+			ret = -EIO;
+			goto abort;
+		}
+		if (lenp)
+			*lenp = zout.pos;
+		zstd_stream_end(&zs);
+		unzstd = false;
+	} else if (lenp) {
+		*lenp = srclen;
+	}
+
+	ret = fit_stream_hash_check(fit, noffset, hash, count);
+	if (ret)
+		goto abort;
+	puts("OK\n");
+
+	return 0;
+
+abort:
+	if (inflating)
+		inflateEnd(&s);
+	if (unzstd)
+		zstd_stream_end(&zs);
+	fit_stream_hash_abort(hash, count);
+	if (ret != -EACCES)
+		printf("Error loading '%s' image data: %d\n",
+		       fit_get_name(fit, noffset, NULL), ret);
+
+	return ret;
+}
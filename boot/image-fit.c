@@ -1121,7 +1121,7 @@ int fit_image_hash_get_value(const void *fit, int noffset, uint8_t **value,
  *     0, on ignore not found
  *     value, on ignore found
  */
-static int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore)
+int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore)
 {
 	int len;
 	int *value;
@@ -1915,6 +1915,21 @@ int fit_conf_get_prop_node(const void *fit, int noffset,
 	return fit_conf_get_prop_node_index(fit, noffset, prop_name, 0);
 }
 
+/*
+ * Check whether the image hashes can be checked while the image is loaded,
+ * rather than in a separate pass beforehand
+ */
+static bool fit_image_stream_ok(bootm_headers_t *images, const void *fit,
+				int noffset, int comp)
+{
+	if (tools_build() || !CONFIG_IS_ENABLED(FIT_STREAM) || !images->verify)
+		return false;
+	if (IS_ENABLED(CONFIG_FIT_IMAGE_POST_PROCESS))
+		return false;
+
+	return fit_image_can_stream(fit, noffset, comp);
+}
+
 static int fit_image_select(const void *fit, int rd_noffset, int verify)
 {
 	fit_image_print(fit, rd_noffset, "   ");
@@ -2007,11 +2022,18 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 	void *loadbuf;
 	size_t size;
 	int type_ok, os_ok;
+	bool decomp, stream, stream_req;
 	ulong load, load_end, data, len;
 	uint8_t os, comp;
 	const char *prop_name;
 	int ret;
 
+	/* The caller's request only covers this load */
+	stream_req = images->fit_stream_req;
+	images->fit_stream_req = false;
+	if (image_type == IH_TYPE_KERNEL)
+		images->fit_stream_os = false;
+
 	fit = map_sysmem(addr, 0);
 	fit_uname = fit_unamep ? *fit_unamep : NULL;
 	fit_uname_config = fit_uname_configp ? *fit_uname_configp : NULL;
@@ -2084,7 +2106,28 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	/* Kernel images get decompressed later in bootm_load_os(). */
+	if (fit_image_get_comp(fit, noffset, &comp))
+		comp = IH_COMP_NONE;
+	decomp = comp != IH_COMP_NONE &&
+		 !(image_type == IH_TYPE_KERNEL ||
+		   image_type == IH_TYPE_KERNEL_NOLOAD ||
+		   image_type == IH_TYPE_RAMDISK);
+
+	/*
+	 * Unless it is decompressed here, the image is only copied, so the
+	 * hashes can be checked on the way. A compressed kernel is checked
+	 * by bootm_load_os() while decompressing, if the caller allows it.
+	 */
+	stream = fit_image_stream_ok(images, fit, noffset,
+				     decomp ? comp : IH_COMP_NONE);
+	if (image_type == IH_TYPE_KERNEL) {
+		images->fit_stream_os = stream_req && stream &&
+			comp != IH_COMP_NONE &&
+			fit_image_can_stream(fit, noffset, comp);
+	}
+
+	ret = fit_image_select(fit, noffset, images->verify && !stream);
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
@@ -2201,14 +2244,8 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		load = data;	/* No load address specified */
 	}
 
-	comp = IH_COMP_NONE;
 	loadbuf = buf;
-	/* Kernel images get decompressed later in bootm_load_os(). */
-	if (!fit_image_get_comp(fit, noffset, &comp) &&
-	    comp != IH_COMP_NONE &&
-	    !(image_type == IH_TYPE_KERNEL ||
-	      image_type == IH_TYPE_KERNEL_NOLOAD ||
-	      image_type == IH_TYPE_RAMDISK)) {
+	if (decomp) {
 		ulong max_decomp_len = len * 20;
 		if (load == data) {
 			loadbuf = malloc(max_decomp_len);
@@ -2216,13 +2253,39 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		} else {
 			loadbuf = map_sysmem(load, max_decomp_len);
 		}
-		if (image_decomp(comp, load, data, image_type,
-				loadbuf, buf, len, max_decomp_len, &load_end)) {
-			printf("Error decompressing %s\n", prop_name);
+		if (stream) {
+			printf("   Uncompressing %s\n",
+			       genimg_get_type_name(image_type));
+			ret = fit_image_stream_load(fit, noffset, comp, buf, len,
+						    loadbuf, max_decomp_len,
+						    &len);
+			if (ret == -EACCES) {
+				bootstage_error(bootstage_id +
+						BOOTSTAGE_SUB_HASH);
+				return ret;
+			} else if (ret) {
+				printf("Error decompressing %s\n", prop_name);
+				return -ENOEXEC;
+			}
+		} else {
+			if (image_decomp(comp, load, data, image_type, loadbuf,
+					 buf, len, max_decomp_len, &load_end)) {
+				printf("Error decompressing %s\n", prop_name);
 
-			return -ENOEXEC;
+				return -ENOEXEC;
+			}
+			len = load_end - load;
+		}
+	} else if (stream && !(image_type == IH_TYPE_KERNEL &&
+			       images->fit_stream_os)) {
+		if (load != data)
+			loadbuf = map_sysmem(load, len);
+		ret = fit_image_stream_load(fit, noffset, IH_COMP_NONE, buf,
+					    len, loadbuf, len, NULL);
+		if (ret) {
+			bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
+			return ret;
 		}
-		len = load_end - load;
 	} else if (load != data) {
 		loadbuf = map_sysmem(load, len);
 		memcpy(loadbuf, buf, len);
@@ -14,15 +14,27 @@ static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 		     int argc, char *const argv[])
 {
 	struct block_cache_stats stats;
+	unsigned lookups;
+
 	blkcache_stats(&stats);
+	lookups = stats.hits + stats.misses;
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
+	       "hit ratio: %u%%\n"
+	       "bytes served: %llu\n"
 	       "entries: %u\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "max cache entries: %u\n"
+	       "size: %lu KiB of %lu KiB\n"
+	       "read-ahead: %u blocks max, %u issued, %u used (%u%%)\n",
+	       stats.hits, stats.misses,
+	       lookups ? stats.hits * 100 / lookups : 0,
+	       stats.bytes_served, stats.entries,
+	       stats.max_blocks_per_entry, stats.max_entries,
+	       stats.size >> 10, stats.max_size >> 10,
+	       stats.max_readahead, stats.ra_issued, stats.ra_used,
+	       stats.ra_issued ? stats.ra_used * 100 / stats.ra_issued : 0);
 	return 0;
 }
 
@@ -41,9 +53,27 @@ static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 	return 0;
 }
 
+static int blkc_size(struct cmd_tbl *cmdtp, int flag,
+		     int argc, char *const argv[])
+{
+	unsigned long size;
+	unsigned readahead;
+
+	if (argc != 3)
+		return CMD_RET_USAGE;
+
+	size = simple_strtoul(argv[1], 0, 0) << 20;
+	readahead = simple_strtoul(argv[2], 0, 0);
+	blkcache_configure_size(size, readahead);
+	printf("changed to max of %lu MiB, read-ahead of %u blocks\n",
+	       size >> 20, readahead);
+	return 0;
+}
+
 static struct cmd_tbl cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
 	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(size, 3, 0, blkc_size, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -85,4 +115,6 @@ U_BOOT_CMD(
 	"show - show and reset statistics\n"
 	"blkcache configure <blocks> <entries> "
 	"- set max blocks per entry and max cache entries\n"
+	"blkcache size <MiB> <readahead> "
+	"- set cache capacity and max read-ahead blocks\n"
 );
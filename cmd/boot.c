@@ -10,6 +10,7 @@
 #include <common.h>
 #include <command.h>
 #include <net.h>
+#include <worker.h>
 
 #ifdef CONFIG_CMD_GO
 
@@ -33,6 +34,9 @@ static int do_go(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 
 	printf ("## Starting application at 0x%08lX ...\n", addr);
 
+	/* The application may overwrite the code the secondary CPUs run */
+	worker_park();
+
 	/*
 	 * pass address parameter as argv[0] (aka command name),
 	 * and all remaining args
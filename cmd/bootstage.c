@@ -6,6 +6,9 @@
 #include <common.h>
 #include <bootstage.h>
 #include <command.h>
+#include <env.h>
+#include <mapmem.h>
+#include <linux/sizes.h>
 
 static int do_bootstage_report(struct cmd_tbl *cmdtp, int flag, int argc,
 			       char *const argv[])
@@ -59,10 +62,60 @@ static int do_bootstage_stash(struct cmd_tbl *cmdtp, int flag, int argc,
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(BOOTSTAGE_SCOPES)
+static int do_bootstage_scopes(struct cmd_tbl *cmdtp, int flag, int argc,
+			       char *const argv[])
+{
+	uint min_us = 0;
+
+	if (argc > 1)
+		min_us = dectoul(argv[1], NULL);
+	bootstage_scope_report(min_us);
+
+	return 0;
+}
+
+static int do_bootstage_export(struct cmd_tbl *cmdtp, int flag, int argc,
+			       char *const argv[])
+{
+	enum bootstage_trace_fmt fmt;
+	ulong addr, size = SZ_1M;
+	char *buf;
+	int len;
+
+	if (argc < 3)
+		return CMD_RET_USAGE;
+	if (!strcmp(argv[1], "folded"))
+		fmt = BOOTSTAGE_TRACE_FOLDED;
+	else if (!strcmp(argv[1], "chrome"))
+		fmt = BOOTSTAGE_TRACE_CHROME;
+	else
+		return CMD_RET_USAGE;
+	addr = hextoul(argv[2], NULL);
+	if (argc > 3)
+		size = hextoul(argv[3], NULL);
+
+	buf = map_sysmem(addr, size);
+	len = bootstage_scope_export(fmt, buf, size);
+	unmap_sysmem(buf);
+	if (len >= size) {
+		printf("Trace needs %#x bytes\n", len + 1);
+		return CMD_RET_FAILURE;
+	}
+	env_set_hex("filesize", len);
+
+	return 0;
+}
+#endif
+
 static struct cmd_tbl cmd_bootstage_sub[] = {
 	U_BOOT_CMD_MKENT(report, 2, 1, do_bootstage_report, "", ""),
 	U_BOOT_CMD_MKENT(stash, 4, 0, do_bootstage_stash, "", ""),
 	U_BOOT_CMD_MKENT(unstash, 4, 0, do_bootstage_stash, "", ""),
+#if CONFIG_IS_ENABLED(BOOTSTAGE_SCOPES)
+	U_BOOT_CMD_MKENT(scopes, 2, 1, do_bootstage_scopes, "", ""),
+	U_BOOT_CMD_MKENT(export, 4, 0, do_bootstage_export, "", ""),
+#endif
 };
 
 /*
@@ -87,10 +140,15 @@ static int do_boostage(struct cmd_tbl *cmdtp, int flag, int argc,
 }
 
 
-U_BOOT_CMD(bootstage, 4, 1, do_boostage,
+U_BOOT_CMD(bootstage, 5, 1, do_boostage,
 	"Boot stage command",
 	" - check boot progress and timing\n"
 	"report                      - Print a report\n"
 	"stash [<start> [<size>]]    - Stash data into memory\n"
 	"unstash [<start> [<size>]]  - Unstash data from memory"
+#if CONFIG_IS_ENABLED(BOOTSTAGE_SCOPES)
+	"\nscopes [<min_us>]           - Print timed scopes as a tree\n"
+	"export folded|chrome <addr> [<size>]\n"
+	"                            - Write scopes as a trace, setting filesize"
+#endif
 );
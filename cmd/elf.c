@@ -13,6 +13,7 @@
 #include <log.h>
 #include <net.h>
 #include <vxworks.h>
+#include <worker.h>
 #ifdef CONFIG_X86
 #include <vbe.h>
 #include <asm/cache.h>
@@ -26,6 +27,9 @@ static unsigned long do_bootelf_exec(ulong (*entry)(int, char * const[]),
 {
 	unsigned long ret;
 
+	/* The image may overwrite the code the secondary CPUs are running */
+	worker_park();
+
 	/*
 	 * pass address parameter as argv[0] (aka command name),
 	 * and all remaining args
@@ -276,6 +280,7 @@ int do_bootvx(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 
 	printf("## Starting vxWorks at 0x%08lx ...\n", addr);
 
+	worker_park();
 	dcache_disable();
 #if defined(CONFIG_ARM64) && defined(CONFIG_ARMV8_PSCI)
 	armv8_setup_psci();
@@ -21,13 +21,18 @@
 #include <log.h>
 #include <mapmem.h>
 #include <rand.h>
+#include <time.h>
 #include <watchdog.h>
+#include <worker.h>
+#include <asm/cache.h>
 #include <asm/global_data.h>
 #include <asm/io.h>
 #include <linux/bitops.h>
 #include <linux/compiler.h>
 #include <linux/ctype.h>
 #include <linux/delay.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -998,9 +1003,73 @@ static ulong mem_test_bitflip(vu_long *buf, ulong start, ulong end)
 	return test_bitflip_comparison(buf, buf + half_size, half_size);
 }
 
+/* Number of words handled by all CPUs between watchdog resets */
+#define MTEST_QUICK_SLICE	(SZ_16M / sizeof(ulong))
+
+/**
+ * struct mtest_quick - the pattern written by mem_test_quick()
+ *
+ * Word i of @buf holds @pattern + i * @incr
+ */
+struct mtest_quick {
+	vu_long *buf;
+	ulong pattern;
+	ulong incr;
+};
+
+static long mem_test_quick_fill(void *arg, ulong start, ulong end)
+{
+	struct mtest_quick *mq = arg;
+	ulong val = mq->pattern + start * mq->incr;
+	vu_long *addr;
+
+	for (addr = mq->buf + start; addr < mq->buf + end; addr++) {
+		*addr = val;
+		val += mq->incr;
+	}
+
+	return 0;
+}
+
+static long mem_test_quick_check(void *arg, ulong start, ulong end)
+{
+	struct mtest_quick *mq = arg;
+	ulong val = mq->pattern + start * mq->incr;
+	vu_long *addr;
+	long errs = 0;
+
+	for (addr = mq->buf + start; addr < mq->buf + end; addr++) {
+		if (*addr != val)
+			errs++;
+		val += mq->incr;
+	}
+
+	return errs;
+}
+
+/*
+ * Write and check the pattern using all CPUs (see worker.h), a slice at a
+ * time. Returns the number of errors found.
+ */
+static ulong mem_test_quick_run(struct mtest_quick *mq, ulong length,
+				worker_range_func_t func)
+{
+	const ulong align = ARCH_DMA_MINALIGN / sizeof(ulong);
+	ulong pos, errs = 0;
+
+	for (pos = 0; pos < length; pos += MTEST_QUICK_SLICE) {
+		WATCHDOG_RESET();
+		errs += worker_run_range(pos, min(pos + MTEST_QUICK_SLICE,
+						  length), align, func, mq);
+	}
+
+	return errs;
+}
+
 static ulong mem_test_quick(vu_long *buf, ulong start_addr, ulong end_addr,
 			    vu_long pattern, int iteration)
 {
+	struct mtest_quick mq;
 	vu_long *end;
 	vu_long *addr;
 	ulong errs = 0;
@@ -1029,14 +1098,16 @@ static ulong mem_test_quick(vu_long *buf, ulong start_addr, ulong end_addr,
 		"\b\b\b\b\b\b\b\b\b\b",
 		pattern, "");
 
-	for (addr = buf, val = pattern; addr < end; addr++) {
-		WATCHDOG_RESET();
-		*addr = val;
-		val += incr;
-	}
+	mq.buf = buf;
+	mq.pattern = pattern;
+	mq.incr = incr;
+	mem_test_quick_run(&mq, length, mem_test_quick_fill);
 
 	puts("Reading...");
+	if (!mem_test_quick_run(&mq, length, mem_test_quick_check))
+		return 0;
 
+	/* Go through again on this CPU to report the errors */
 	for (addr = buf, val = pattern; addr < end; addr++) {
 		WATCHDOG_RESET();
 		readback = *addr;
@@ -1312,6 +1383,98 @@ static int do_random(struct cmd_tbl *cmdtp, int flag, int argc,
 }
 #endif
 
+#ifdef CONFIG_CMD_MEMBENCH
+/* Bytes handled for each measurement, so small sizes run long enough */
+#define MEMBENCH_BYTES		SZ_64M
+
+/* Gap used for overlapping memmove() */
+#define MEMBENCH_GAP		64
+
+enum membench_op {
+	MEMBENCH_MEMCPY,
+	MEMBENCH_MEMMOVE,
+	MEMBENCH_MEMSET,
+
+	MEMBENCH_COUNT,
+};
+
+/*
+ * Time one operation on @size bytes, returning the rate in MB/s. memcpy()
+ * copies from the first half of @buf to the second, while memmove() moves
+ * data up and down by MEMBENCH_GAP bytes within the second half, so that it
+ * copies both forwards and backwards.
+ */
+static ulong mem_bench_one(enum membench_op op, u8 *buf, ulong half,
+			   ulong size)
+{
+	ulong loops = max(MEMBENCH_BYTES / size, 1UL);
+	u8 *dst = buf + half;
+	ulong start, i;
+	ulong us;
+
+	start = timer_get_us();
+	for (i = 0; i < loops; i++) {
+		switch (op) {
+		case MEMBENCH_MEMCPY:
+			memcpy(dst, buf, size);
+			break;
+		case MEMBENCH_MEMMOVE:
+			if (i & 1)
+				memmove(dst, dst + MEMBENCH_GAP, size);
+			else
+				memmove(dst + MEMBENCH_GAP, dst, size);
+			break;
+		case MEMBENCH_MEMSET:
+			memset(dst, i, size);
+			break;
+		default:
+			break;
+		}
+	}
+	us = max(timer_get_us() - start, 1UL);
+
+	return div_u64((u64)loops * size, us);
+}
+
+static int do_mem_bench(struct cmd_tbl *cmdtp, int flag, int argc,
+			char *const argv[])
+{
+	ulong addr, len, half, max_size, size;
+	u8 *buf;
+	int op;
+
+	if (argc != 3)
+		return CMD_RET_USAGE;
+
+	addr = hextoul(argv[1], NULL);
+	len = hextoul(argv[2], NULL);
+	half = len / 2;
+	if (half < 2 * MEMBENCH_GAP) {
+		printf("Length must be at least %#x\n", 4 * MEMBENCH_GAP);
+		return CMD_RET_FAILURE;
+	}
+	max_size = half - MEMBENCH_GAP;
+
+	buf = map_sysmem(addr, len);
+	memset(buf, 0xa5, len);
+	printf("    size    memcpy   memmove    memset (GB/s)\n");
+	for (size = MEMBENCH_GAP; ; size = min(size * 16, max_size)) {
+		printf("%8lx", size);
+		for (op = 0; op < MEMBENCH_COUNT; op++) {
+			ulong rate = mem_bench_one(op, buf, half, size);
+
+			printf("  %4lu.%03lu", rate / 1000, rate % 1000);
+		}
+		printf("\n");
+		if (size == max_size || ctrlc())
+			break;
+	}
+	unmap_sysmem(buf);
+
+	return CMD_RET_SUCCESS;
+}
+#endif
+
 /**************************************************/
 U_BOOT_CMD(
 	md,	3,	1,	do_mem_md,
@@ -1446,6 +1609,16 @@ U_BOOT_CMD(
 );
 #endif
 
+#ifdef CONFIG_CMD_MEMBENCH
+U_BOOT_CMD(
+	membench,	3,	0,	do_mem_bench,
+	"measure memcpy, memmove and memset speed",
+	"<addr> <len>\n"
+	"   - Time each function at sizes up to half of 'len', using the\n"
+	"     memory at 'addr'"
+);
+#endif
+
 #ifdef CONFIG_CMD_RANDOM
 U_BOOT_CMD(
 	random,	4,	0,	do_random,
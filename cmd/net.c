@@ -11,6 +11,7 @@
 #include <bootstage.h>
 #include <command.h>
 #include <dm.h>
+#include <dm/device-internal.h>
 #include <env.h>
 #include <image.h>
 #include <net.h>
@@ -124,6 +125,20 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_WGET)
+static int do_wget(struct cmd_tbl *cmdtp, int flag, int argc,
+		   char *const argv[])
+{
+	return netboot_common(WGET, cmdtp, argc, argv);
+}
+
+U_BOOT_CMD(
+	wget,	3,	1,	do_wget,
+	"boot image via network using HTTP protocol",
+	"[loadAddress] [[hostIPaddr:]path]"
+);
+#endif
+
 static void netboot_update_env(void)
 {
 	char tmp[22];
@@ -498,8 +513,40 @@ static int do_net_list(struct cmd_tbl *cmdtp, int flag, int argc, char *const ar
 	return CMD_RET_SUCCESS;
 }
 
+static int do_net_stats(struct cmd_tbl *cmdtp, int flag, int argc,
+			char *const argv[])
+{
+	struct eth_stats stats;
+	struct udevice *dev;
+	int ret;
+
+	if (argc > 1)
+		dev = eth_get_dev_by_name(argv[1]);
+	else
+		dev = eth_get_dev();
+	if (!dev || device_probe(dev)) {
+		printf("No such device\n");
+		return CMD_RET_FAILURE;
+	}
+
+	ret = eth_get_stats(dev, &stats);
+	if (ret) {
+		printf("%s: no statistics (err=%d)\n", dev->name, ret);
+		return CMD_RET_FAILURE;
+	}
+	printf("%s:\n", dev->name);
+	printf("  rx: %llu packets, %llu bytes, %llu errors\n",
+	       stats.rx_packets, stats.rx_bytes, stats.rx_errors);
+	printf("  tx: %llu packets, %llu bytes, %llu errors, %llu busy\n",
+	       stats.tx_packets, stats.tx_bytes, stats.tx_errors,
+	       stats.tx_busy);
+
+	return CMD_RET_SUCCESS;
+}
+
 static struct cmd_tbl cmd_net[] = {
 	U_BOOT_CMD_MKENT(list, 1, 0, do_net_list, "", ""),
+	U_BOOT_CMD_MKENT(stats, 2, 0, do_net_stats, "", ""),
 };
 
 static int do_net(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
@@ -521,8 +568,9 @@ static int do_net(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 }
 
 U_BOOT_CMD(
-	net, 2, 1, do_net,
+	net, 3, 1, do_net,
 	"NET sub-system",
 	"list - list available devices\n"
+	"net stats [<dev>] - show traffic counters of a device\n"
 );
 #endif // CONFIG_DM_ETH
@@ -18,6 +18,7 @@
 #include <asm/cache.h>
 #include <jffs2/jffs2.h>
 #include <linux/mtd/mtd.h>
+#include <linux/sizes.h>
 
 #include <asm/io.h>
 #include <dm/device-internal.h>
@@ -154,48 +155,91 @@ static int do_spi_flash_probe(int argc, char *const argv[])
 	return 0;
 }
 
+/* Bytes of flash compared at a time by sf update: the usual largest erase */
+#define SF_UPDATE_BLOCK		SZ_64K
+
+/* How a sector of flash compares with the data it is to be updated to */
+enum sf_sect_state {
+	SF_SECT_SAME,		/* it already holds the data */
+	SF_SECT_BLANK,		/* it is erased, so only needs writing */
+	SF_SECT_DIRTY,		/* it needs erasing and writing */
+};
+
+static enum sf_sect_state sf_sect_state(const char *old, const char *new,
+					size_t len)
+{
+	size_t i;
+
+	if (!memcmp(old, new, len))
+		return SF_SECT_SAME;
+	for (i = 0; i < len; i++) {
+		if ((u8)old[i] != 0xff)
+			return SF_SECT_DIRTY;
+	}
+
+	return SF_SECT_BLANK;
+}
+
 /**
- * Write a block of data to SPI flash, first checking if it is different from
- * what is already there.
+ * Write a block of data to SPI flash, first checking which of its sectors
+ * differ from what is already there.
  *
- * If the data being written is the same, then *skipped is incremented by len.
+ * Sectors which already hold the data are left alone and *skipped is
+ * incremented by the bytes they hold. Sectors which are blank are written
+ * without erasing. Runs of other sectors are erased with one call, so that
+ * the flash can use its larger erase commands.
  *
  * @param flash		flash context pointer
- * @param offset	flash offset to write
+ * @param offset	flash offset to write, a multiple of the sector size
  * @param len		number of bytes to write
  * @param buf		buffer to write from
- * @param cmp_buf	read buffer to use to compare data
+ * @param cmp_buf	read buffer to use to compare data, holding at least
+ *			len bytes rounded up to a whole sector
  * @param skipped	Count of skipped data (incremented by this function)
  * @return NULL if OK, else a string containing the stage which failed
  */
 static const char *spi_flash_update_block(struct spi_flash *flash, u32 offset,
 		size_t len, const char *buf, char *cmp_buf, size_t *skipped)
 {
-	char *ptr = (char *)buf;
-
-	debug("offset=%#x, sector_size=%#x, len=%#zx\n",
-	      offset, flash->sector_size, len);
-	/* Read the entire sector so to allow for rewriting */
-	if (spi_flash_read(flash, offset, flash->sector_size, cmp_buf))
+	u32 sect = flash->sector_size;
+	size_t span = roundup(len, sect);
+	enum sf_sect_state state;
+	size_t pos, end, n;
+
+	debug("offset=%#x, sector_size=%#x, len=%#zx\n", offset, sect, len);
+	/* Read entire sectors so to allow for rewriting */
+	if (spi_flash_read(flash, offset, span, cmp_buf))
 		return "read";
-	/* Compare only what is meaningful (len) */
-	if (memcmp(cmp_buf, buf, len) == 0) {
-		debug("Skip region %x size %zx: no change\n",
-		      offset, len);
-		*skipped += len;
-		return NULL;
-	}
-	/* Erase the entire sector */
-	if (spi_flash_erase(flash, offset, flash->sector_size))
-		return "erase";
-	/* If it's a partial sector, copy the data into the temp-buffer */
-	if (len != flash->sector_size) {
-		memcpy(cmp_buf, buf, len);
-		ptr = cmp_buf;
+
+	for (pos = 0; pos < span; pos = end) {
+		/* Find the run of sectors in the same state as this one */
+		state = sf_sect_state(cmp_buf + pos, buf + pos,
+				      min_t(size_t, sect, len - pos));
+		for (end = pos + sect; end < span; end += sect) {
+			if (sf_sect_state(cmp_buf + end, buf + end,
+					  min_t(size_t, sect, len - end)) != state)
+				break;
+		}
+		/* Only the part up to len is meaningful */
+		n = min(end, len) - pos;
+
+		if (state == SF_SECT_SAME) {
+			debug("Skip region %zx size %zx: no change\n",
+			      offset + pos, n);
+			*skipped += n;
+			continue;
+		}
+		if (state == SF_SECT_DIRTY &&
+		    spi_flash_erase(flash, offset + pos, end - pos))
+			return "erase";
+		if (spi_flash_write(flash, offset + pos, n, buf + pos))
+			return "write";
+		/* Put back the rest of an erased partial sector */
+		if (state == SF_SECT_DIRTY && end > len &&
+		    spi_flash_write(flash, offset + len, end - len,
+				    cmp_buf + len))
+			return "write";
 	}
-	/* Write one complete sector */
-	if (spi_flash_write(flash, offset, flash->sector_size, ptr))
-		return "write";
 
 	return NULL;
 }
@@ -217,6 +261,7 @@ static int spi_flash_update(struct spi_flash *flash, u32 offset,
 	char *cmp_buf;
 	const char *end = buf + len;
 	size_t todo;		/* number of bytes to do in this pass */
+	size_t block;		/* most bytes to do in one pass */
 	size_t skipped = 0;	/* statistics */
 	const ulong start_time = get_timer(0);
 	size_t scale = 1;
@@ -225,12 +270,15 @@ static int spi_flash_update(struct spi_flash *flash, u32 offset,
 
 	if (end - buf >= 200)
 		scale = (end - buf) / 100;
-	cmp_buf = memalign(ARCH_DMA_MINALIGN, flash->sector_size);
+	/* Work in whole sectors, at least SF_UPDATE_BLOCK at a time */
+	block = roundup(SF_UPDATE_BLOCK, flash->sector_size);
+	cmp_buf = memalign(ARCH_DMA_MINALIGN, block);
 	if (cmp_buf) {
 		ulong last_update = get_timer(0);
 
 		for (; buf < end && !err_oper; buf += todo, offset += todo) {
-			todo = min_t(size_t, end - buf, flash->sector_size);
+			/* Keep blocks aligned, so that erases can be large */
+			todo = min_t(size_t, end - buf, block - offset % block);
 			if (get_timer(last_update) > 100) {
 				printf("   \rUpdating, %zu%% %lu B/s",
 				       100 - (end - buf) / scale,
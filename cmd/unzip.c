@@ -8,6 +8,7 @@
 #include <command.h>
 #include <env.h>
 #include <gzip.h>
+#include <mmc.h>
 #include <part.h>
 
 static int do_unzip(struct cmd_tbl *cmdtp, int flag, int argc,
@@ -63,6 +64,21 @@ static int do_gzwrite(struct cmd_tbl *cmdtp, int flag,
 	addr = (unsigned char *)hextoul(argv[3], NULL);
 	length = hextoul(argv[4], NULL);
 
+	/*
+	 * Write whole erase groups unless told otherwise, as long as the
+	 * buffers take no more than a quarter of the malloc() pool
+	 */
+	if (CONFIG_IS_ENABLED(MMC) && bdev->if_type == IF_TYPE_MMC) {
+		struct mmc *mmc = find_mmc_device(bdev->devnum);
+		unsigned long grp;
+
+		if (mmc && mmc->erase_grp_size) {
+			grp = roundup(writebuf, mmc->erase_grp_size * 512);
+			if (grp * 3 <= CONFIG_SYS_MALLOC_LEN / 4)
+				writebuf = grp;
+		}
+	}
+
 	if (5 < argc) {
 		writebuf = hextoul(argv[5], NULL);
 		if (6 < argc) {
@@ -83,7 +99,8 @@ U_BOOT_CMD(
 	"unzip and write memory to block device",
 	"<interface> <dev> <addr> length [wbuf=1M [offs=0 [outsize=0]]]\n"
 	"\twbuf is the size in bytes (hex) of write buffer\n"
-	"\t\tand should be padded to erase size for SSDs\n"
+	"\t\tand should be padded to erase size for SSDs;\n"
+	"\t\tfor eMMC it defaults to a whole number of erase groups\n"
 	"\toffs is the output start offset in bytes (hex)\n"
 	"\toutsize is the size of the expected output (hex bytes)\n"
 	"\t\tand is required for files with uncompressed lengths\n"
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Decompress a zstd frame held in memory
+ */
+
+#include <common.h>
+#include <abuf.h>
+#include <command.h>
+#include <env.h>
+#include <mapmem.h>
+#include <linux/sizes.h>
+#include <linux/zstd.h>
+
+/* Output size used when the frame does not record it */
+#ifdef CONFIG_SYS_BOOTM_LEN
+#define UNZSTD_DEFAULT_LEN	CONFIG_SYS_BOOTM_LEN
+#else
+#define UNZSTD_DEFAULT_LEN	SZ_8M
+#endif
+
+static int do_unzstd(struct cmd_tbl *cmdtp, int flag, int argc,
+		     char *const argv[])
+{
+	unsigned long src, dst, dst_len = UNZSTD_DEFAULT_LEN;
+	unsigned long long content;
+	struct abuf in, out;
+	size_t src_len;
+	void *ptr;
+	int ret;
+
+	if (argc < 3 || argc > 4)
+		return CMD_RET_USAGE;
+	src = hextoul(argv[1], NULL);
+	dst = hextoul(argv[2], NULL);
+
+	/* The frame records where it ends and usually how large it is */
+	ptr = map_sysmem(src, 0);
+	src_len = ZSTD_findFrameCompressedSize(ptr, SZ_1G);
+	if (ZSTD_isError(src_len)) {
+		printf("No zstd frame at %lx\n", src);
+		unmap_sysmem(ptr);
+		return CMD_RET_FAILURE;
+	}
+	content = ZSTD_getFrameContentSize(ptr, src_len);
+	if (argc == 4)
+		dst_len = hextoul(argv[3], NULL);
+	else if (content != ZSTD_CONTENTSIZE_UNKNOWN &&
+		 content != ZSTD_CONTENTSIZE_ERROR)
+		dst_len = content;
+
+	abuf_init_set(&in, ptr, src_len);
+	abuf_init_set(&out, map_sysmem(dst, dst_len), dst_len);
+	ret = zstd_decompress(&in, &out);
+	unmap_sysmem(abuf_data(&out));
+	unmap_sysmem(ptr);
+	if (ret < 0) {
+		printf("Uncompress error: %d\n", ret);
+		return CMD_RET_FAILURE;
+	}
+
+	printf("Uncompressed size: %d = 0x%X\n", ret, ret);
+	env_set_hex("filesize", ret);
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	unzstd,	4,	1,	do_unzstd,
+	"decompress a zstd-compressed memory region",
+	"srcaddr dstaddr [dstsize]\n"
+	"    - dstsize defaults to the size recorded in the frame, if any"
+);
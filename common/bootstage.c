@@ -36,10 +36,47 @@ struct bootstage_record {
 	enum bootstage_id id;
 };
 
+#if CONFIG_IS_ENABLED(BOOTSTAGE_SCOPES)
+enum {
+	SCOPE_COUNT	= CONFIG_BOOTSTAGE_SCOPE_COUNT,
+	SCOPE_NAME_LEN	= 24,
+	SCOPE_MAX_DEPTH	= 32,
+};
+
+/**
+ * struct bootstage_scope - a timed, possibly nested, region of code
+ *
+ * @name:	Name of the scope (truncated if necessary)
+ * @start_us:	Time when the scope was first entered
+ * @time_us:	Total time spent in the scope, over all the times it was
+ *		entered
+ * @enter_us:	Time when the scope was last entered
+ * @count:	Number of times the scope was entered (see merging in
+ *		bootstage_scope_start())
+ * @depth:	Nesting depth, 0 for a scope with no parent
+ * @type:	Kind of scope (enum bootstage_scope_type)
+ */
+struct bootstage_scope {
+	char name[SCOPE_NAME_LEN];
+	u32 start_us;
+	u32 time_us;
+	u32 enter_us;
+	u32 count;
+	u8 depth;
+	u8 type;
+};
+#endif
+
 struct bootstage_data {
 	uint rec_count;
 	uint next_id;
 	struct bootstage_record record[RECORD_COUNT];
+#if CONFIG_IS_ENABLED(BOOTSTAGE_SCOPES)
+	struct bootstage_scope *scope;	/* Allocated on first use */
+	uint scope_count;		/* Number of scopes recorded */
+	uint scope_depth;		/* Number of scopes currently open */
+	uint scope_dropped;		/* Scopes not recorded for lack of space */
+#endif
 };
 
 enum {
@@ -224,6 +261,111 @@ uint32_t bootstage_accum(enum bootstage_id id)
 	return duration;
 }
 
+#if CONFIG_IS_ENABLED(BOOTSTAGE_SCOPES)
+static const char *const scope_type_name[BOOTSTAGE_SCOPE_TYPE_COUNT] = {
+	[BOOTSTAGE_SCOPE_USER]	= "scope",
+	[BOOTSTAGE_SCOPE_PROBE]	= "probe",
+	[BOOTSTAGE_SCOPE_READ]	= "read",
+};
+
+int bootstage_scope_start(enum bootstage_scope_type type, const char *name)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct bootstage_scope *sc;
+	u32 now;
+	uint depth;
+
+	/* Pre-relocation memory is too small to hold a useful trace */
+	if (!data || !(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return -ENOENT;
+	if (!data->scope) {
+		data->scope = calloc(SCOPE_COUNT, sizeof(*data->scope));
+		if (!data->scope)
+			return -ENOENT;
+	}
+	if (!name)
+		name = "";
+	now = timer_get_boot_us();
+	depth = data->scope_depth++;
+
+	/*
+	 * Filesystems read many small pieces one after the other. Merge
+	 * consecutive reads from the same device, keeping the total time.
+	 * Once scopes are being dropped, the last one recorded may not be
+	 * the last one started, so stop merging.
+	 */
+	if (type == BOOTSTAGE_SCOPE_READ && data->scope_count &&
+	    data->scope_count < SCOPE_COUNT) {
+		sc = &data->scope[data->scope_count - 1];
+		if (sc->type == type && sc->depth == depth &&
+		    !strncmp(sc->name, name, sizeof(sc->name) - 1)) {
+			sc->enter_us = now;
+			sc->count++;
+			return data->scope_count - 1;
+		}
+	}
+
+	if (data->scope_count == SCOPE_COUNT || depth >= SCOPE_MAX_DEPTH) {
+		data->scope_dropped++;
+		return -ENOSPC;
+	}
+	sc = &data->scope[data->scope_count];
+	strlcpy(sc->name, name, sizeof(sc->name));
+	sc->start_us = now;
+	sc->time_us = 0;
+	sc->enter_us = now;
+	sc->count = 1;
+	sc->depth = depth;
+	sc->type = type;
+
+	return data->scope_count++;
+}
+
+void bootstage_scope_end(int scope)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct bootstage_scope *sc;
+
+	if (scope == -ENOENT)
+		return;
+	data->scope_depth--;
+	if (scope < 0)
+		return;
+	sc = &data->scope[scope];
+	sc->time_us += (u32)timer_get_boot_us() - sc->enter_us;
+}
+
+/* Get the time spent in a scope, less that spent in its children */
+static u32 scope_self_us(const struct bootstage_data *data, uint i)
+{
+	const struct bootstage_scope *sc = &data->scope[i];
+	u32 child_us = 0;
+	uint j;
+
+	for (j = i + 1; j < data->scope_count; j++) {
+		const struct bootstage_scope *child = &data->scope[j];
+
+		if (child->depth <= sc->depth)
+			break;
+		if (child->depth == sc->depth + 1)
+			child_us += child->time_us;
+	}
+
+	return sc->time_us - min(child_us, sc->time_us);
+}
+
+/* Get a scope name with its type, e.g. "probe:serial" */
+static const char *get_scope_label(char *buf, int len,
+				   const struct bootstage_scope *sc)
+{
+	if (sc->type == BOOTSTAGE_SCOPE_USER)
+		return sc->name;
+	snprintf(buf, len, "%s:%s", scope_type_name[sc->type], sc->name);
+
+	return buf;
+}
+#endif
+
 /**
  * Get a record name as a printable string
  *
@@ -321,6 +463,33 @@ static int add_bootstages_devicetree(struct fdt_header *blob)
 			return -EINVAL;
 	}
 
+#if CONFIG_IS_ENABLED(BOOTSTAGE_SCOPES)
+	/*
+	 * Add the scopes as a 'scopes' node holding one array per field, with
+	 * an entry for each scope, to keep the tree small
+	 */
+	if (data->scope_count) {
+		int node;
+
+		node = fdt_add_subnode(blob, bootstage, "scopes");
+		if (node < 0)
+			return -EINVAL;
+		for (i = 0; i < data->scope_count; i++) {
+			const struct bootstage_scope *sc = &data->scope[i];
+			char label[SCOPE_NAME_LEN + 8];
+
+			if (fdt_appendprop_string(blob, node, "name",
+					get_scope_label(label, sizeof(label),
+							sc)) ||
+			    fdt_appendprop_u32(blob, node, "start", sc->start_us) ||
+			    fdt_appendprop_u32(blob, node, "time", sc->time_us) ||
+			    fdt_appendprop_u32(blob, node, "depth", sc->depth) ||
+			    fdt_appendprop_u32(blob, node, "count", sc->count))
+				return -EINVAL;
+		}
+	}
+#endif
+
 	return 0;
 }
 
@@ -365,6 +534,134 @@ void bootstage_report(void)
 	}
 }
 
+#if CONFIG_IS_ENABLED(BOOTSTAGE_SCOPES)
+void bootstage_scope_report(uint min_us)
+{
+	struct bootstage_data *data = gd->bootstage;
+	char label[SCOPE_NAME_LEN + 8];
+	uint i;
+
+	printf("Scopes in microseconds (%u recorded, %u dropped):\n",
+	       data->scope_count, data->scope_dropped);
+	printf("%11s%11s%11s  %s\n", "Start", "Elapsed", "Self", "Scope");
+	for (i = 0; i < data->scope_count; i++) {
+		const struct bootstage_scope *sc = &data->scope[i];
+
+		if (sc->time_us < min_us)
+			continue;
+		print_grouped_ull(sc->start_us, BOOTSTAGE_DIGITS);
+		print_grouped_ull(sc->time_us, BOOTSTAGE_DIGITS);
+		print_grouped_ull(scope_self_us(data, i), BOOTSTAGE_DIGITS);
+		printf("  %*s%s", sc->depth * 2, "",
+		       get_scope_label(label, sizeof(label), sc));
+		if (sc->count > 1)
+			printf(" (x%u)", sc->count);
+		printf("\n");
+	}
+}
+
+/* Output buffer for bootstage_scope_export() */
+struct scope_out {
+	char *buf;
+	int size;
+	int len;
+};
+
+static void scope_printf(struct scope_out *out, const char *fmt, ...)
+{
+	int pos = min(out->len, out->size);
+	va_list args;
+
+	va_start(args, fmt);
+	out->len += vsnprintf(out->buf + pos, out->size - pos, fmt, args);
+	va_end(args);
+}
+
+/* Write a string as the contents of a JSON string */
+static void scope_put_json(struct scope_out *out, const char *str)
+{
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			scope_printf(out, "\\%c", *str);
+		else if (*str >= ' ')
+			scope_printf(out, "%c", *str);
+	}
+}
+
+static void scope_export_folded(struct bootstage_data *data,
+				struct scope_out *out)
+{
+	uint stack[SCOPE_MAX_DEPTH];
+	char label[SCOPE_NAME_LEN + 8];
+	uint i, d;
+
+	for (i = 0; i < data->scope_count; i++) {
+		const struct bootstage_scope *sc = &data->scope[i];
+
+		stack[sc->depth] = i;
+		for (d = 0; d <= sc->depth; d++)
+			scope_printf(out, "%s%s", d ? ";" : "",
+				     get_scope_label(label, sizeof(label),
+						     &data->scope[stack[d]]));
+		scope_printf(out, " %u\n", scope_self_us(data, i));
+	}
+}
+
+static void scope_export_chrome(struct bootstage_data *data,
+				struct scope_out *out)
+{
+	const char *sep = "";
+	char buf[20];
+	uint i;
+
+	scope_printf(out, "{\"traceEvents\":[\n");
+
+	/* Show the marks as instant events across the whole trace */
+	for (i = 0; i < data->rec_count; i++) {
+		const struct bootstage_record *rec = &data->record[i];
+
+		if (rec->start_us ||
+		    (rec->id != BOOTSTAGE_ID_AWAKE && !rec->time_us))
+			continue;
+		scope_printf(out, "%s{\"name\":\"", sep);
+		scope_put_json(out, get_record_name(buf, sizeof(buf), rec));
+		scope_printf(out, "\",\"cat\":\"mark\",\"ph\":\"i\",\"s\":\"g\","
+			     "\"ts\":%lu,\"pid\":1,\"tid\":1}", rec->time_us);
+		sep = ",\n";
+	}
+
+	for (i = 0; i < data->scope_count; i++) {
+		const struct bootstage_scope *sc = &data->scope[i];
+
+		scope_printf(out, "%s{\"name\":\"", sep);
+		scope_put_json(out, sc->name);
+		scope_printf(out, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%u,"
+			     "\"dur\":%u,\"pid\":1,\"tid\":1,"
+			     "\"args\":{\"count\":%u}}",
+			     scope_type_name[sc->type], sc->start_us,
+			     sc->time_us, sc->count);
+		sep = ",\n";
+	}
+	scope_printf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+int bootstage_scope_export(enum bootstage_trace_fmt fmt, char *buf, int size)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct scope_out out = {
+		.buf	= buf,
+		.size	= size,
+	};
+
+	if (fmt == BOOTSTAGE_TRACE_CHROME)
+		scope_export_chrome(data, &out);
+	else
+		scope_export_folded(data, &out);
+
+	return out.len;
+}
+#endif
+
 /**
  * Append data to a memory buffer
  *
@@ -7,6 +7,7 @@
 #include <common.h>
 #include <errno.h>
 #include <fpga.h>
+#include <abuf.h>
 #include <gzip.h>
 #include <image.h>
 #include <log.h>
@@ -17,6 +18,7 @@
 #include <asm/cache.h>
 #include <asm/global_data.h>
 #include <linux/libfdt.h>
+#include <linux/zstd.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -258,7 +260,7 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 			debug("%s ", genimg_get_type_name(type));
 	}
 
-	if (IS_ENABLED(CONFIG_SPL_GZIP)) {
+	if (IS_ENABLED(CONFIG_SPL_GZIP) || CONFIG_IS_ENABLED(ZSTD)) {
 		fit_image_get_comp(fit, node, &image_comp);
 		debug("%s ", genimg_get_comp_name(image_comp));
 	}
@@ -286,7 +288,16 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 		if (fit_image_get_data_size(fit, node, &len))
 			return -ENOENT;
 
-		src_ptr = map_sysmem(ALIGN(load_addr, ARCH_DMA_MINALIGN), len);
+		/*
+		 * zstd cannot decompress in place, so read the frame somewhere
+		 * out of the way
+		 */
+		if (CONFIG_IS_ENABLED(ZSTD) && image_comp == IH_COMP_ZSTD)
+			src_ptr = map_sysmem(ALIGN(CONFIG_SYS_LOAD_ADDR,
+						   ARCH_DMA_MINALIGN), len);
+		else
+			src_ptr = map_sysmem(ALIGN(load_addr, ARCH_DMA_MINALIGN),
+					     len);
 		length = len;
 
 		overhead = get_aligned_image_overhead(info, offset);
@@ -330,6 +341,18 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 			return -EIO;
 		}
 		length = size;
+	} else if (CONFIG_IS_ENABLED(ZSTD) && image_comp == IH_COMP_ZSTD) {
+		struct abuf in, out;
+		int ret;
+
+		abuf_init_set(&in, src, length);
+		abuf_init_set(&out, load_ptr, CONFIG_SYS_BOOTM_LEN);
+		ret = zstd_decompress(&in, &out);
+		if (ret < 0) {
+			puts("Uncompressing error\n");
+			return -EIO;
+		}
+		length = ret;
 	} else {
 		memcpy(load_ptr, src, length);
 	}
@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Pool of secondary CPUs which run jobs queued by the boot CPU
+ *
+ * Jobs are held in a ring of pointers. Only the boot CPU adds jobs, so the
+ * head needs no locking; CPUs take jobs by advancing the tail with a
+ * compare-and-swap. A job is finished when its 'done' flag is set.
+ */
+
+#define LOG_CATEGORY	LOGC_BOOT
+
+#include <common.h>
+#include <log.h>
+#include <time.h>
+#include <worker.h>
+#include <asm/cache.h>
+#include <asm/global_data.h>
+#include <linux/kernel.h>
+#include <linux/sizes.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Number of jobs which can be waiting in the queue */
+#define WORKER_QUEUE_LEN	32
+
+/* Ranges smaller than this are not worth splitting between CPUs */
+#define WORKER_MIN_SPLIT	SZ_64K
+
+/* Time allowed for a CPU to start or stop */
+#define WORKER_TIMEOUT_MS	100
+
+/**
+ * struct worker_pool - the pool of secondary CPUs
+ *
+ * @head:	Number of jobs ever added to the queue
+ * @tail:	Number of jobs ever taken from the queue
+ * @slot:	Jobs in the queue, indexed by position modulo the queue length
+ * @stop:	Set to tell the CPUs to park
+ * @started:	true if we have tried to start the CPUs
+ * @count:	Number of CPUs in @cpu
+ * @running:	Number of CPUs which started successfully
+ * @cpu:	Information about each CPU
+ */
+struct worker_pool {
+	ulong head;
+	ulong tail;
+	struct worker_job *slot[WORKER_QUEUE_LEN];
+	int stop;
+	bool started;
+	int count;
+	int running;
+	struct worker_cpu cpu[CONFIG_WORKER_NR_CPUS - 1];
+};
+
+static struct worker_pool pool;
+
+static void worker_run(struct worker_job *job)
+{
+	job->ret = job->func(job->arg);
+	__atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+}
+
+/* Take the next job from the queue, returning NULL if it is empty */
+static struct worker_job *worker_take(void)
+{
+	struct worker_job *job;
+	ulong tail;
+
+	tail = __atomic_load_n(&pool.tail, __ATOMIC_ACQUIRE);
+	do {
+		if (tail == __atomic_load_n(&pool.head, __ATOMIC_ACQUIRE))
+			return NULL;
+		job = pool.slot[tail % WORKER_QUEUE_LEN];
+	} while (!__atomic_compare_exchange_n(&pool.tail, &tail, tail + 1,
+					      false, __ATOMIC_ACQ_REL,
+					      __ATOMIC_ACQUIRE));
+
+	return job;
+}
+
+void worker_main(struct worker_cpu *wc)
+{
+	struct worker_job *job;
+
+	__atomic_store_n(&wc->state, WORKER_RUNNING, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(&pool.stop, __ATOMIC_ACQUIRE)) {
+		job = worker_take();
+		if (job)
+			worker_run(job);
+		else
+			arch_worker_idle();
+	}
+	__atomic_store_n(&wc->state, WORKER_PARKED, __ATOMIC_RELEASE);
+}
+
+/* Wait for a CPU to leave the given state */
+static int worker_wait_state(struct worker_cpu *wc, int state)
+{
+	ulong start = get_timer(0);
+
+	while (__atomic_load_n(&wc->state, __ATOMIC_ACQUIRE) == state) {
+		if (get_timer(start) > WORKER_TIMEOUT_MS)
+			return -ETIMEDOUT;
+		arch_worker_idle();
+	}
+
+	return 0;
+}
+
+static void worker_start(void)
+{
+	ulong ids[ARRAY_SIZE(pool.cpu)];
+	struct worker_cpu *wc;
+	int count, i, ret;
+
+	pool.started = true;
+	pool.stop = 0;
+	count = arch_worker_cpus(ids, ARRAY_SIZE(ids));
+	for (i = 0; i < count; i++) {
+		wc = &pool.cpu[i];
+		wc->index = i;
+		wc->id = ids[i];
+		wc->state = WORKER_OFF;
+		ret = arch_worker_start(wc);
+		if (!ret)
+			ret = worker_wait_state(wc, WORKER_OFF);
+		if (ret) {
+			log_debug("Cannot start CPU %lx (err=%d)\n", ids[i],
+				  ret);
+			continue;
+		}
+		pool.running++;
+	}
+	pool.count = count;
+	log_debug("%d secondary CPUs running\n", pool.running);
+}
+
+int worker_count(void)
+{
+	if (!pool.started && gd->flags & GD_FLG_RELOC)
+		worker_start();
+
+	return pool.running;
+}
+
+void worker_submit(struct worker_job *job, worker_func_t func, void *arg)
+{
+	ulong queued;
+
+	job->func = func;
+	job->arg = arg;
+	job->done = 0;
+	queued = pool.head - __atomic_load_n(&pool.tail, __ATOMIC_ACQUIRE);
+	if (!worker_count() || queued == WORKER_QUEUE_LEN) {
+		worker_run(job);
+		return;
+	}
+	pool.slot[pool.head % WORKER_QUEUE_LEN] = job;
+	__atomic_store_n(&pool.head, pool.head + 1, __ATOMIC_RELEASE);
+}
+
+int worker_wait(struct worker_job *job)
+{
+	struct worker_job *other;
+
+	while (!__atomic_load_n(&job->done, __ATOMIC_ACQUIRE)) {
+		other = worker_take();
+		if (other)
+			worker_run(other);
+		else
+			arch_worker_idle();
+	}
+
+	return job->ret;
+}
+
+struct worker_range {
+	struct worker_job job;
+	worker_range_func_t func;
+	void *arg;
+	ulong start;
+	ulong end;
+};
+
+static int worker_range_job(void *arg)
+{
+	struct worker_range *range = arg;
+	long ret;
+
+	ret = range->func(range->arg, range->start, range->end);
+
+	return ret < 0 ? ret : min_t(long, ret, INT_MAX);
+}
+
+long worker_run_range(ulong start, ulong end, ulong align,
+		      worker_range_func_t func, void *arg)
+{
+	struct worker_range range[CONFIG_WORKER_NR_CPUS];
+	ulong piece, pos;
+	long ret, total;
+	int count, i;
+
+	if (start >= end)
+		return 0;
+	count = 1;
+	if (end - start >= WORKER_MIN_SPLIT * 2)
+		count += worker_count();
+	piece = ALIGN((end - start) / count, align);
+
+	/* The last piece is done here, after queueing the others */
+	for (i = 0, pos = start; i < count; i++, pos += piece) {
+		range[i].func = func;
+		range[i].arg = arg;
+		range[i].start = min(pos, end);
+		range[i].end = i == count - 1 ? end : min(pos + piece, end);
+		if (i < count - 1)
+			worker_submit(&range[i].job, worker_range_job,
+				      &range[i]);
+	}
+	total = func(arg, range[count - 1].start, range[count - 1].end);
+
+	for (i = 0; i < count - 1; i++) {
+		ret = worker_wait(&range[i].job);
+		if (ret < 0 && total >= 0)
+			total = ret;
+		else if (total >= 0)
+			total += ret;
+	}
+
+	return total;
+}
+
+static long worker_memset_range(void *arg, ulong start, ulong end)
+{
+	memset((void *)start, (uintptr_t)arg, end - start);
+
+	return 0;
+}
+
+void *worker_memset(void *s, int c, size_t count)
+{
+	worker_run_range((ulong)s, (ulong)s + count, ARCH_DMA_MINALIGN,
+			 worker_memset_range, (void *)(uintptr_t)(u8)c);
+
+	return s;
+}
+
+int worker_park(void)
+{
+	struct worker_cpu *wc;
+	int i, ret = 0;
+
+	if (!pool.started)
+		return 0;
+	__atomic_store_n(&pool.stop, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < pool.count; i++) {
+		wc = &pool.cpu[i];
+		if (wc->state == WORKER_OFF)
+			continue;
+		if (worker_wait_state(wc, WORKER_RUNNING) ||
+		    arch_worker_stop(wc)) {
+			log_err("CPU %lx did not stop\n", wc->id);
+			ret = -ETIMEDOUT;
+		}
+		wc->state = WORKER_OFF;
+	}
+	pool.count = 0;
+	pool.running = 0;
+	pool.started = false;
+
+	return ret;
+}
@@ -8,6 +8,7 @@
 
 #include <common.h>
 #include <blk.h>
+#include <bootstage.h>
 #include <dm.h>
 #include <log.h>
 #include <malloc.h>
@@ -16,6 +17,7 @@
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
 #include <linux/err.h>
+#include <linux/sizes.h>
 
 static const char *if_typename_str[IF_TYPE_COUNT] = {
 	[IF_TYPE_IDE]		= "ide",
@@ -436,25 +438,81 @@ int blk_get_device(int if_type, int devnum, struct udevice **devp)
 	return device_probe(*devp);
 }
 
+/* Amount of data transferred by each call to blk_queue_poll() */
+#define BLK_QUEUE_CHUNK		SZ_64K
+
+/**
+ * struct blk_uclass_priv - per-device uclass information
+ *
+ * @queue:	Requests waiting to be carried out by blk_queue_poll()
+ * @pending:	Number of submitted requests which have not yet completed
+ * @writes:	Number of those requests which are writes
+ * @write_start: First block covered by the outstanding writes
+ * @write_end:	Block after the last one covered by the outstanding writes
+ */
+struct blk_uclass_priv {
+	struct list_head queue;
+	int pending;
+	int writes;
+	lbaint_t write_start;
+	lbaint_t write_end;
+};
+
+/*
+ * Complete any outstanding write which overlaps the given blocks, so that a
+ * synchronous access is ordered after it
+ */
+static int blk_drain_writes(struct udevice *dev, lbaint_t start,
+			    lbaint_t blkcnt)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
+
+	while (priv && priv->writes && start < priv->write_end &&
+	       priv->write_start < start + blkcnt) {
+		ret = ops->poll(dev);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static unsigned long blk_read_dev(struct blk_desc *block_dev, lbaint_t start,
+				  lbaint_t blkcnt, void *buffer)
+{
+	struct udevice *dev = block_dev->bdev;
+
+	return blk_get_ops(dev)->read(dev, start, blkcnt, buffer);
+}
+
 unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			lbaint_t blkcnt, void *buffer)
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
-	ulong blks_read;
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+	ulong ret;
+	int scope;
 
 	if (!ops->read)
 		return -ENOSYS;
 
-	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
-		return blkcnt;
-	blks_read = ops->read(dev, start, blkcnt, buffer);
-	if (blks_read == blkcnt)
-		blkcache_fill(block_dev->if_type, block_dev->devnum,
-			      start, blkcnt, block_dev->blksz, buffer);
+	ret = blk_drain_writes(dev, start, blkcnt);
+	if (ret)
+		return ret;
+
+	scope = bootstage_scope_start(BOOTSTAGE_SCOPE_READ, dev->name);
+	/* Read-ahead could pick up blocks which an outstanding write changes */
+	if (priv && priv->writes)
+		ret = blk_read_dev(block_dev, start, blkcnt, buffer);
+	else
+		ret = blkcache_read_through(block_dev, start, blkcnt, buffer,
+					    blk_read_dev);
+	bootstage_scope_end(scope);
 
-	return blks_read;
+	return ret;
 }
 
 unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
@@ -463,9 +521,15 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
 
+	int ret;
+
 	if (!ops->write)
 		return -ENOSYS;
 
+	ret = blk_drain_writes(dev, start, blkcnt);
+	if (ret)
+		return ret;
+
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
 	return ops->write(dev, start, blkcnt, buffer);
 }
@@ -476,13 +540,184 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
 
+	int ret;
+
 	if (!ops->erase)
 		return -ENOSYS;
 
+	ret = blk_drain_writes(dev, start, blkcnt);
+	if (ret)
+		return ret;
+
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
 	return ops->erase(dev, start, blkcnt);
 }
 
+void blk_request_done(struct blk_request *req, int status)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(req->dev);
+	struct blk_desc *desc = dev_get_uclass_plat(req->dev);
+
+	if (!status && req->xfer != req->blkcnt)
+		status = -EIO;
+	if (req->op == BLK_REQ_WRITE) {
+		blkcache_invalidate(desc->if_type, desc->devnum);
+		priv->writes--;
+	} else if (!status && !priv->writes) {
+		/* Data read before a write was submitted may be stale now */
+		blkcache_fill(desc->if_type, desc->devnum, req->start,
+			      req->blkcnt, desc->blksz, req->buffer);
+	}
+
+	req->status = status;
+	req->done = true;
+	priv->pending--;
+	if (req->end_io)
+		req->end_io(req);
+}
+
+int blk_submit(struct blk_desc *desc, struct blk_request *req)
+{
+	struct udevice *dev = desc->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+	bool read = req->op == BLK_REQ_READ;
+	ulong n;
+	int ret;
+
+	if (read ? !ops->read : !ops->write)
+		return -ENOSYS;
+
+	req->dev = dev;
+	req->xfer = 0;
+	req->status = 0;
+	req->done = false;
+	priv->pending++;
+
+	if (read && blkcache_read(desc->if_type, desc->devnum, req->start,
+				  req->blkcnt, desc->blksz, req->buffer)) {
+		req->xfer = req->blkcnt;
+		blk_request_done(req, 0);
+		return 0;
+	}
+	if (!read) {
+		/* Invalidate now, so that no later read sees the old data */
+		blkcache_invalidate(desc->if_type, desc->devnum);
+		if (!priv->writes++) {
+			priv->write_start = req->start;
+			priv->write_end = req->start + req->blkcnt;
+		} else {
+			priv->write_start = min(priv->write_start, req->start);
+			priv->write_end = max(priv->write_end,
+					      req->start + req->blkcnt);
+		}
+	}
+
+	/* The cache was checked above and is filled on completion */
+	if (!ops->submit) {
+		if (read)
+			n = ops->read(dev, req->start, req->blkcnt,
+				      req->buffer);
+		else
+			n = ops->write(dev, req->start, req->blkcnt,
+				       req->buffer);
+		if (!IS_ERR_VALUE(n))
+			req->xfer = n;
+		blk_request_done(req, IS_ERR_VALUE(n) ? (int)n : 0);
+		return 0;
+	}
+
+	ret = ops->submit(dev, req);
+	/* wait for an earlier request to complete if the driver is full */
+	while (ret == -EBUSY && priv->pending > 1) {
+		ret = ops->poll(dev);
+		if (!ret)
+			ret = ops->submit(dev, req);
+	}
+	if (ret) {
+		log_debug("%s: submit failed: %d\n", dev->name, ret);
+		priv->pending--;
+		if (!read)
+			priv->writes--;
+		return ret;
+	}
+
+	return 0;
+}
+
+int blk_poll(struct blk_desc *desc)
+{
+	struct udevice *dev = desc->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+	int ret;
+
+	if (priv->pending && ops->poll) {
+		ret = ops->poll(dev);
+		if (ret)
+			return ret;
+	}
+
+	return priv->pending;
+}
+
+int blk_wait(struct blk_desc *desc, struct blk_request *req)
+{
+	int ret;
+
+	while (!req->done) {
+		ret = blk_poll(desc);
+		if (ret < 0)
+			return ret;
+		/* nothing outstanding, so this request was never submitted */
+		if (!ret && !req->done)
+			return -ENOENT;
+	}
+
+	return req->status;
+}
+
+int blk_queue_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+
+	list_add_tail(&req->list, &priv->queue);
+
+	return 0;
+}
+
+int blk_queue_poll(struct udevice *dev)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_request *req;
+	lbaint_t blkcnt;
+	void *buf;
+	ulong n;
+
+	if (list_empty(&priv->queue))
+		return 0;
+
+	req = list_first_entry(&priv->queue, struct blk_request, list);
+	blkcnt = min_t(lbaint_t, req->blkcnt - req->xfer,
+		       max(BLK_QUEUE_CHUNK / desc->blksz, 1UL));
+	buf = req->buffer + req->xfer * desc->blksz;
+	if (req->op == BLK_REQ_READ)
+		n = ops->read(dev, req->start + req->xfer, blkcnt, buf);
+	else
+		n = ops->write(dev, req->start + req->xfer, blkcnt, buf);
+	if (!IS_ERR_VALUE(n))
+		req->xfer += n;
+
+	if (IS_ERR_VALUE(n) || n != blkcnt || req->xfer == req->blkcnt) {
+		list_del(&req->list);
+		blk_request_done(req, IS_ERR_VALUE(n) ? (int)n : 0);
+	}
+
+	return 0;
+}
+
 int blk_get_from_parent(struct udevice *parent, struct udevice **devp)
 {
 	struct udevice *dev;
@@ -710,6 +945,15 @@ int blk_unbind_all(int if_type)
 	return 0;
 }
 
+static int blk_pre_probe(struct udevice *dev)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+
+	INIT_LIST_HEAD(&priv->queue);
+
+	return 0;
+}
+
 static int blk_post_probe(struct udevice *dev)
 {
 	if (IS_ENABLED(CONFIG_PARTITIONS) &&
@@ -722,9 +966,29 @@ static int blk_post_probe(struct udevice *dev)
 	return 0;
 }
 
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	struct blk_request *req, *next;
+
+	blkcache_remove(desc->if_type, desc->devnum);
+	if (!priv)
+		return 0;
+	list_for_each_entry_safe(req, next, &priv->queue, list) {
+		list_del(&req->list);
+		blk_request_done(req, -ENODEV);
+	}
+
+	return 0;
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
+	.pre_probe	= blk_pre_probe,
 	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
+	.per_device_auto	= sizeof(struct blk_uclass_priv),
 	.per_device_plat_auto	= sizeof(struct blk_desc),
 };
@@ -12,26 +12,58 @@
 #include <asm/global_data.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
+#include <linux/sizes.h>
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 DECLARE_GLOBAL_DATA_PTR;
 #endif
 
-struct block_cache_node {
+/*
+ * The cache is made of fixed-size entries of max_blocks_per_entry blocks,
+ * each aligned to its own size on the device. Entries are found through a
+ * hash table keyed by device and entry start, kept in a global LRU list for
+ * eviction and in a per-device list so that invalidation only has to visit
+ * the entries of one device.
+ */
+#define BLKCACHE_HASH_BITS	7
+#define BLKCACHE_HASH_SIZE	(1 << BLKCACHE_HASH_BITS)
+
+/* Number of back-to-back sequential reads before read-ahead kicks in */
+#define BLKCACHE_SEQ_THRESHOLD	2
+
+struct block_cache_dev {
 	struct list_head lh;
+	struct list_head entries;
 	int iftype;
 	int devnum;
+	lbaint_t next_start;	/* block following the previous read */
+	unsigned seq_reads;	/* length of the current sequential run */
+};
+
+struct block_cache_node {
+	struct list_head lh;
+	struct list_head dev_lh;
+	struct hlist_node hash;
+	struct block_cache_dev *bdev;
 	lbaint_t start;
-	lbaint_t blkcnt;
 	unsigned long blksz;
+	bool readahead;		/* filled by read-ahead, not yet used */
 	char *cache;
 };
 
 static LIST_HEAD(block_cache);
+static LIST_HEAD(block_cache_devs);
+static struct hlist_head block_cache_hash[BLKCACHE_HASH_SIZE];
+
+/* Bounce buffer used for reads widened to whole entries plus read-ahead */
+static char *fetch_buf;
+static size_t fetch_buf_size;
 
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_entries = (CONFIG_BLOCK_CACHE_SIZE * SZ_1M) / (8 * 512),
+	.max_size = CONFIG_BLOCK_CACHE_SIZE * SZ_1M,
+	.max_readahead = CONFIG_BLOCK_CACHE_READAHEAD,
 };
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
@@ -42,149 +74,394 @@ int blkcache_init(void)
 	head->next = (uintptr_t)head->next + gd->reloc_off;
 	head->prev = (uintptr_t)head->prev + gd->reloc_off;
 
+	head = &block_cache_devs;
+	head->next = (uintptr_t)head->next + gd->reloc_off;
+	head->prev = (uintptr_t)head->prev + gd->reloc_off;
+
 	return 0;
 }
 #endif
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+static inline unsigned cache_hash(struct block_cache_dev *bdev,
+				  lbaint_t start)
 {
+	u32 key = (u32)(start / _stats.max_blocks_per_entry) ^
+		  (u32)((uintptr_t)bdev >> 4);
+
+	/* multiplicative hash, see Knuth TAOCP vol 3, section 6.4 */
+	return (key * 0x61c88647) >> (32 - BLKCACHE_HASH_BITS);
+}
+
+static struct block_cache_dev *cache_dev(int iftype, int devnum, bool create)
+{
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry(bdev, &block_cache_devs, lh)
+		if (bdev->iftype == iftype && bdev->devnum == devnum)
+			return bdev;
+
+	if (!create)
+		return NULL;
+
+	bdev = calloc(1, sizeof(*bdev));
+	if (!bdev)
+		return NULL;
+	bdev->iftype = iftype;
+	bdev->devnum = devnum;
+	INIT_LIST_HEAD(&bdev->entries);
+	list_add(&bdev->lh, &block_cache_devs);
+
+	return bdev;
+}
+
+static struct block_cache_node *cache_find(struct block_cache_dev *bdev,
+					   lbaint_t start, unsigned long blksz)
+{
+	struct hlist_head *head = &block_cache_hash[cache_hash(bdev, start)];
 	struct block_cache_node *node;
+	struct hlist_node *pos;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
-			}
+	hlist_for_each_entry(node, pos, head, hash)
+		if (node->bdev == bdev && node->start == start &&
+		    node->blksz == blksz)
 			return node;
-		}
-	return 0;
+
+	return NULL;
+}
+
+static void cache_unlink(struct block_cache_node *node)
+{
+	list_del(&node->lh);
+	list_del(&node->dev_lh);
+	hlist_del(&node->hash);
+	_stats.entries--;
+	_stats.size -= _stats.max_blocks_per_entry * node->blksz;
+}
+
+static void cache_free(struct block_cache_node *node)
+{
+	free(node->cache);
+	free(node);
+}
+
+/* Track sequential access so that read-ahead is only used when it pays */
+static void cache_track(struct block_cache_dev *bdev, lbaint_t start,
+			lbaint_t blkcnt)
+{
+	if (start == bdev->next_start)
+		bdev->seq_reads++;
+	else
+		bdev->seq_reads = 0;
+	bdev->next_start = start + blkcnt;
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+	const lbaint_t per_entry = _stats.max_blocks_per_entry;
+	struct block_cache_dev *bdev;
+	struct block_cache_node *node;
+	lbaint_t blk, first, last;
+	char *dst = buffer;
+
+	bdev = cache_dev(iftype, devnum, true);
+	if (!bdev || !blkcnt || !per_entry)
+		goto miss;
+	cache_track(bdev, start, blkcnt);
+
+	/* Check that every entry is present before copying anything out */
+	first = start - (start % per_entry);
+	last = start + blkcnt;
+	for (blk = first; blk < last; blk += per_entry)
+		if (!cache_find(bdev, blk, blksz))
+			goto miss;
+
+	for (blk = first; blk < last; blk += per_entry) {
+		lbaint_t from = max(blk, start);
+		lbaint_t to = min(blk + per_entry, last);
+
+		node = cache_find(bdev, blk, blksz);
+		memcpy(dst, node->cache + (from - blk) * blksz,
+		       (to - from) * blksz);
+		dst += (to - from) * blksz;
+
+		if (node->readahead) {
+			node->readahead = false;
+			_stats.ra_used += per_entry;
+		}
+		if (block_cache.next != &node->lh) {
+			/* maintain MRU ordering */
+			list_del(&node->lh);
+			list_add(&node->lh, &block_cache);
+		}
 	}
 
+	debug("hit: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+	++_stats.hits;
+	_stats.bytes_served += blkcnt * blksz;
+	return 1;
+
+miss:
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 	++_stats.misses;
 	return 0;
 }
 
-void blkcache_fill(int iftype, int devnum,
-		   lbaint_t start, lbaint_t blkcnt,
-		   unsigned long blksz, void const *buffer)
+static void cache_fill(int iftype, int devnum,
+		       lbaint_t start, lbaint_t blkcnt,
+		       unsigned long blksz, void const *buffer,
+		       lbaint_t ra_start)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
+	const lbaint_t per_entry = _stats.max_blocks_per_entry;
+	const unsigned long bytes = per_entry * blksz;
+	struct block_cache_dev *bdev;
+	struct block_cache_node *node, *victim;
+	lbaint_t blk;
+
+	if (_stats.max_entries == 0 || !per_entry)
+		return;
 
-	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	/* don't let one big read flush everything else out of the cache */
+	if (blkcnt * blksz > _stats.max_size / 4)
 		return;
 
-	if (_stats.max_entries == 0)
+	bdev = cache_dev(iftype, devnum, true);
+	if (!bdev)
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
+	/* only entries wholly covered by the buffer can be cached */
+	blk = roundup(start, per_entry);
+	for (; blk + per_entry <= start + blkcnt; blk += per_entry) {
+		if (cache_find(bdev, blk, blksz))
+			continue;
+
+		node = NULL;
+		while (_stats.entries &&
+		       (_stats.entries >= _stats.max_entries ||
+			_stats.size + bytes > _stats.max_size)) {
+			/* pop LRU, recycling it if it has the right size */
+			victim = list_last_entry(&block_cache,
+						 struct block_cache_node, lh);
+			cache_unlink(victim);
+			debug("drop: start " LBAF ", count " LBAFU "\n",
+			      victim->start, per_entry);
+			if (!node && victim->blksz == blksz)
+				node = victim;
+			else
+				cache_free(victim);
 		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
+		if (_stats.size + bytes > _stats.max_size) {
+			if (node)
+				cache_free(node);
 			return;
-		node->cache = 0;
-	}
+		}
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
+		if (!node) {
+			node = malloc(sizeof(*node));
+			if (!node)
+				return;
+			node->cache = malloc(bytes);
+			if (!node->cache) {
+				free(node);
+				return;
+			}
 		}
+
+		debug("fill: start " LBAF ", count " LBAFU "\n",
+		      blk, per_entry);
+
+		node->bdev = bdev;
+		node->start = blk;
+		node->blksz = blksz;
+		node->readahead = blk >= ra_start;
+		memcpy(node->cache, (const char *)buffer + (blk - start) * blksz,
+		       bytes);
+		list_add(&node->lh, &block_cache);
+		list_add(&node->dev_lh, &bdev->entries);
+		hlist_add_head(&node->hash,
+			       &block_cache_hash[cache_hash(bdev, blk)]);
+		_stats.entries++;
+		_stats.size += bytes;
 	}
+}
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+void blkcache_fill(int iftype, int devnum,
+		   lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, void const *buffer)
+{
+	cache_fill(iftype, devnum, start, blkcnt, blksz, buffer,
+		   start + blkcnt);
+}
+
+ulong blkcache_read_through(struct blk_desc *desc, lbaint_t start,
+			    lbaint_t blkcnt, void *buffer,
+			    blkcache_read_fn read)
+{
+	const lbaint_t per_entry = _stats.max_blocks_per_entry;
+	const unsigned long blksz = desc->blksz;
+	struct block_cache_dev *bdev;
+	lbaint_t fetch_start, fetch_end, limit, ra = 0;
+	size_t fetch_bytes;
+	ulong blks_read;
+
+	if (blkcache_read(desc->if_type, desc->devnum, start, blkcnt, blksz,
+			  buffer))
+		return blkcnt;
+
+	if (!per_entry || !_stats.max_entries || !desc->lba ||
+	    blkcnt * blksz > _stats.max_size / 4)
+		goto direct;
+
+	/*
+	 * Widen the request to whole cache entries, and beyond that when
+	 * the device is being read sequentially, so that the next few
+	 * reads are served from the cache.
+	 */
+	bdev = cache_dev(desc->if_type, desc->devnum, false);
+	if (bdev && bdev->seq_reads >= BLKCACHE_SEQ_THRESHOLD)
+		ra = roundup(_stats.max_readahead, per_entry);
+	fetch_start = start - (start % per_entry);
+	fetch_end = roundup(start + blkcnt, per_entry) + ra;
+	if (fetch_end > desc->lba)
+		fetch_end = desc->lba;
+	/* cache_fill() only takes fetches up to a quarter of the cache */
+	limit = rounddown(_stats.max_size / 4 / blksz, per_entry);
+	if (fetch_end - fetch_start > limit)
+		fetch_end = fetch_start + limit;
+	if (fetch_end < start + blkcnt)
+		goto direct;
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	fetch_bytes = (fetch_end - fetch_start) * blksz;
+	if (fetch_bytes > fetch_buf_size) {
+		free(fetch_buf);
+		fetch_buf = malloc(fetch_bytes);
+		fetch_buf_size = fetch_buf ? fetch_bytes : 0;
+		if (!fetch_buf)
+			goto direct;
+	}
+
+	blks_read = read(desc, fetch_start, fetch_end - fetch_start,
+			 fetch_buf);
+	if (blks_read != fetch_end - fetch_start)
+		goto direct;
+
+	if (fetch_end > roundup(start + blkcnt, per_entry))
+		_stats.ra_issued += fetch_end - roundup(start + blkcnt,
+							per_entry);
+	cache_fill(desc->if_type, desc->devnum, fetch_start,
+		   fetch_end - fetch_start, blksz, fetch_buf,
+		   roundup(start + blkcnt, per_entry));
+	memcpy(buffer, fetch_buf + (start - fetch_start) * blksz,
+	       blkcnt * blksz);
+
+	return blkcnt;
+
+direct:
+	blks_read = read(desc, start, blkcnt, buffer);
+	if (blks_read == blkcnt)
+		blkcache_fill(desc->if_type, desc->devnum, start, blkcnt,
+			      blksz, buffer);
+
+	return blks_read;
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
+	struct block_cache_node *node, *n;
+	struct block_cache_dev *bdev;
+
+	bdev = cache_dev(iftype, devnum, false);
+	if (!bdev)
+		return;
+
+	list_for_each_entry_safe(node, n, &bdev->entries, dev_lh) {
+		cache_unlink(node);
+		cache_free(node);
+	}
+	bdev->next_start = 0;
+	bdev->seq_reads = 0;
+}
+
+static void cache_free_fetch_buf(void)
+{
+	free(fetch_buf);
+	fetch_buf = NULL;
+	fetch_buf_size = 0;
+}
+
+void blkcache_remove(int iftype, int devnum)
+{
+	struct block_cache_dev *bdev;
+
+	blkcache_invalidate(iftype, devnum);
+	bdev = cache_dev(iftype, devnum, false);
+	if (!bdev)
+		return;
+
+	list_del(&bdev->lh);
+	free(bdev);
+	if (list_empty(&block_cache_devs))
+		cache_free_fetch_buf();
+}
+
+static void blkcache_flush(void)
+{
 	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
-		}
+	while (!list_empty(&block_cache)) {
+		node = list_first_entry(&block_cache, struct block_cache_node,
+					lh);
+		cache_unlink(node);
+		cache_free(node);
+	}
+	_stats.entries = 0;
+	_stats.size = 0;
+
+	while (!list_empty(&block_cache_devs)) {
+		bdev = list_first_entry(&block_cache_devs,
+					struct block_cache_dev, lh);
+		list_del(&bdev->lh);
+		free(bdev);
 	}
+	cache_free_fetch_buf();
+}
+
+static void blkcache_reset_stats(void)
+{
+	_stats.hits = 0;
+	_stats.misses = 0;
+	_stats.bytes_served = 0;
+	_stats.ra_issued = 0;
+	_stats.ra_used = 0;
 }
 
 void blkcache_configure(unsigned blocks, unsigned entries)
 {
-	struct block_cache_node *node;
 	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries)) {
-		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
-		}
-		_stats.entries = 0;
-	}
+	    (entries != _stats.max_entries))
+		blkcache_flush();
 
 	_stats.max_blocks_per_entry = blocks;
 	_stats.max_entries = entries;
 
-	_stats.hits = 0;
-	_stats.misses = 0;
+	blkcache_reset_stats();
+}
+
+void blkcache_configure_size(unsigned long size, unsigned readahead)
+{
+	if (size < _stats.size)
+		blkcache_flush();
+
+	_stats.max_size = size;
+	_stats.max_readahead = readahead;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
 	memcpy(stats, &_stats, sizeof(*stats));
-	_stats.hits = 0;
-	_stats.misses = 0;
+	blkcache_reset_stats();
 }
@@ -246,6 +246,8 @@ int sandbox_host_unbind(struct udevice *dev)
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+	.submit	= blk_queue_submit,
+	.poll	= blk_queue_poll,
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
@@ -9,6 +9,7 @@
  */
 
 #include <common.h>
+#include <bootstage.h>
 #include <cpu_func.h>
 #include <log.h>
 #include <asm/global_data.h>
@@ -482,17 +483,11 @@ static int device_get_dma_constraints(struct udevice *dev)
 	return 0;
 }
 
-int device_probe(struct udevice *dev)
+static int device_do_probe(struct udevice *dev)
 {
 	const struct driver *drv;
 	int ret;
 
-	if (!dev)
-		return -EINVAL;
-
-	if (dev_get_flags(dev) & DM_FLAG_ACTIVATED)
-		return 0;
-
 	drv = dev->driver;
 	assert(drv);
 
@@ -603,6 +598,23 @@ fail:
 	return ret;
 }
 
+int device_probe(struct udevice *dev)
+{
+	int scope, ret;
+
+	if (!dev)
+		return -EINVAL;
+
+	if (dev_get_flags(dev) & DM_FLAG_ACTIVATED)
+		return 0;
+
+	scope = bootstage_scope_start(BOOTSTAGE_SCOPE_PROBE, dev->name);
+	ret = device_do_probe(dev);
+	bootstage_scope_end(scope);
+
+	return ret;
+}
+
 void *dev_get_plat(const struct udevice *dev)
 {
 	if (!dev) {
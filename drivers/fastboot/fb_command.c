@@ -29,6 +29,41 @@ static u32 fastboot_bytes_received;
  */
 static u32 fastboot_bytes_expected;
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * stream_part - partition downloads are written to as they arrive, if any
+ */
+static char stream_part[FASTBOOT_COMMAND_LEN];
+
+/**
+ * streamed - the current or last download went to stream_part
+ */
+static bool streamed;
+
+/**
+ * stream_fill - bytes of a streamed download in the buffer, not yet written
+ */
+static u32 stream_fill;
+
+/**
+ * stream_response - result of writing the streamed download, for "flash"
+ */
+static char stream_response[FASTBOOT_RESPONSE_LEN];
+
+/**
+ * stream_abort() - Forget a streamed download which did not complete
+ */
+static void stream_abort(void)
+{
+	streamed = false;
+	stream_fill = 0;
+}
+#else
+static inline void stream_abort(void)
+{
+}
+#endif
+
 static void okay(char *, char *);
 static void getvar(char *, char *);
 static void download(char *, char *);
@@ -48,6 +83,9 @@ static void oem_partconf(char *, char *);
 #if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_BOOTBUS)
 static void oem_bootbus(char *, char *);
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+static void oem_stream(char *, char *);
+#endif
 
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 static void run_ucmd(char *, char *);
@@ -122,6 +160,12 @@ static const struct {
 		.dispatch = oem_bootbus,
 	},
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	[FASTBOOT_COMMAND_OEM_STREAM] = {
+		.command = "oem stream",
+		.dispatch = oem_stream,
+	},
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 	[FASTBOOT_COMMAND_UCMD] = {
 		.command = "UCmd",
@@ -201,6 +245,7 @@ static void getvar(char *cmd_parameter, char *response)
  */
 static void download(char *cmd_parameter, char *response)
 {
+	u64 max_size = fastboot_buf_size;
 	char *tmp;
 
 	if (!cmd_parameter) {
@@ -213,13 +258,26 @@ static void download(char *cmd_parameter, char *response)
 		fastboot_fail("Expected nonzero image size", response);
 		return;
 	}
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* Only the partition bounds the size of a streamed image */
+	streamed = false;
+	if (stream_part[0]) {
+		if (fastboot_mmc_stream_start(stream_part, &max_size,
+					      response))
+			return;
+		streamed = true;
+		stream_fill = 0;
+		stream_response[0] = '\0';
+	}
+#endif
 	/*
 	 * Nothing to download yet. Response is of the form:
 	 * [DATA|FAIL]$cmd_parameter
 	 *
 	 * where cmd_parameter is an 8 digit hexadecimal number
 	 */
-	if (fastboot_bytes_expected > fastboot_buf_size) {
+	if (fastboot_bytes_expected > max_size) {
+		stream_abort();
 		fastboot_fail(cmd_parameter, response);
 	} else {
 		printf("Starting download of %d bytes\n",
@@ -238,6 +296,52 @@ u32 fastboot_data_remaining(void)
 	return fastboot_bytes_expected - fastboot_bytes_received;
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * stream_write() - Write out the streamed data held in the buffer
+ *
+ * @last: true at the end of the download
+ *
+ * Whatever cannot be written yet (part of a block or of a sparse header) is
+ * moved to the start of the buffer. After an error the rest of the download
+ * is dropped and the error kept for "flash".
+ */
+static void stream_write(bool last)
+{
+	int used;
+
+	if (stream_response[0]) {
+		stream_fill = 0;
+		return;
+	}
+
+	used = fastboot_mmc_stream_write(fastboot_buf_addr, stream_fill, last,
+					 stream_response);
+	if (used < 0) {
+		stream_fill = 0;
+		return;
+	}
+	stream_fill -= used;
+	memmove(fastboot_buf_addr, fastboot_buf_addr + used, stream_fill);
+}
+#endif
+
+/**
+ * fastboot_data_flush() - Write out streamed data once enough has arrived
+ *
+ * Transports call this once they are ready for more data, so that the next
+ * packet is on its way while the storage is written. Streamed data is
+ * written half a buffer at a time, the other half taking in what arrives
+ * meanwhile.
+ */
+void fastboot_data_flush(void)
+{
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	if (streamed && stream_fill >= fastboot_buf_size / 2)
+		stream_write(false);
+#endif
+}
+
 /**
  * fastboot_data_download() - Copy image data to fastboot_buf_addr.
  *
@@ -262,13 +366,33 @@ void fastboot_data_download(const void *fastboot_data,
 	if (fastboot_data_len == 0 ||
 	    (fastboot_bytes_received + fastboot_data_len) >
 	    fastboot_bytes_expected) {
+		stream_abort();
 		fastboot_fail("Received invalid data length",
 			      response);
 		return;
 	}
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	if (streamed) {
+		/* In case the transport did not give us a chance to write */
+		if (stream_fill + fastboot_data_len > fastboot_buf_size)
+			stream_write(false);
+		if (stream_fill + fastboot_data_len > fastboot_buf_size) {
+			stream_abort();
+			fastboot_fail("Stream buffer overflow", response);
+			return;
+		}
+		memcpy(fastboot_buf_addr + stream_fill, fastboot_data,
+		       fastboot_data_len);
+		stream_fill += fastboot_data_len;
+	} else {
+		memcpy(fastboot_buf_addr + fastboot_bytes_received,
+		       fastboot_data, fastboot_data_len);
+	}
+#else
 	/* Download data to fastboot_buf_addr */
 	memcpy(fastboot_buf_addr + fastboot_bytes_received,
 	       fastboot_data, fastboot_data_len);
+#endif
 
 	pre_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
 	fastboot_bytes_received += fastboot_data_len;
@@ -291,6 +415,11 @@ void fastboot_data_download(const void *fastboot_data,
  */
 void fastboot_data_complete(char *response)
 {
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* The result of writing is given by "flash" */
+	if (streamed)
+		stream_write(true);
+#endif
 	/* Download complete. Respond with "OKAY" */
 	fastboot_okay(NULL, response);
 	printf("\ndownloading of %d bytes finished\n", fastboot_bytes_received);
@@ -312,6 +441,19 @@ void fastboot_data_complete(char *response)
  */
 static void flash(char *cmd_parameter, char *response)
 {
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* The image is already written, or failed to be */
+	if (streamed) {
+		streamed = false;
+		if (!cmd_parameter || strcmp(cmd_parameter, stream_part))
+			fastboot_fail("image was streamed to another partition",
+				      response);
+		else
+			strlcpy(response, stream_response,
+				FASTBOOT_RESPONSE_LEN);
+		return;
+	}
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH_MMC)
 	fastboot_mmc_flash_write(cmd_parameter, fastboot_buf_addr, image_size,
 				 response);
@@ -514,3 +656,36 @@ static void oem_bootbus(char *cmd_parameter, char *response)
 		fastboot_okay(NULL, response);
 }
 #endif
+
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * oem_stream() - Write later downloads to a partition as they arrive
+ *
+ * @cmd_parameter: Partition to write to, or empty to stop streaming
+ * @response: Pointer to fastboot response buffer
+ *
+ * Each download then goes straight to the partition, so it is not bounded
+ * by the download buffer, and the following "flash" of that partition only
+ * reports how writing went.
+ */
+static void oem_stream(char *cmd_parameter, char *response)
+{
+	u64 max_size;
+
+	stream_part[0] = '\0';
+	if (!cmd_parameter || !*cmd_parameter) {
+		fastboot_okay(NULL, response);
+		return;
+	}
+
+	if (strlen(cmd_parameter) >= sizeof(stream_part)) {
+		fastboot_fail("partition name too long", response);
+		return;
+	}
+	if (fastboot_mmc_stream_start(cmd_parameter, &max_size, response))
+		return;
+
+	strcpy(stream_part, cmd_parameter);
+	fastboot_okay(NULL, response);
+}
+#endif
@@ -14,11 +14,13 @@
 #include <image-sparse.h>
 #include <image.h>
 #include <log.h>
+#include <malloc.h>
 #include <part.h>
 #include <mmc.h>
 #include <div64.h>
 #include <linux/compat.h>
 #include <android_image.h>
+#include <asm/cache.h>
 
 #define FASTBOOT_MAX_BLK_WRITE 16384
 
@@ -638,6 +640,184 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 	}
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/* An image written to a partition while it is being downloaded */
+struct fb_mmc_stream {
+	struct blk_desc *dev_desc;
+	struct disk_partition info;
+	char name[FASTBOOT_COMMAND_LEN];
+	bool started;		/* we know whether the image is sparse */
+	bool sparse;
+	lbaint_t blk;		/* next block of a raw image */
+	struct fb_mmc_sparse sparse_priv;
+	struct sparse_storage sparse_info;
+	struct sparse_stream ss;
+};
+
+static struct fb_mmc_stream fb_mmc_stream;
+
+/* Targets which need the whole image at once */
+static bool fb_mmc_stream_unsupported(const char *cmd)
+{
+#ifdef CONFIG_FASTBOOT_MMC_BOOT_SUPPORT
+	if (!strcmp(cmd, CONFIG_FASTBOOT_MMC_BOOT1_NAME) ||
+	    !strcmp(cmd, CONFIG_FASTBOOT_MMC_BOOT2_NAME))
+		return true;
+#endif
+#if CONFIG_IS_ENABLED(EFI_PARTITION)
+	if (!strcmp(cmd, CONFIG_FASTBOOT_GPT_NAME))
+		return true;
+#endif
+#if CONFIG_IS_ENABLED(DOS_PARTITION)
+	if (!strcmp(cmd, CONFIG_FASTBOOT_MBR_NAME))
+		return true;
+#endif
+#ifdef CONFIG_ANDROID_BOOT_IMAGE
+	if (!strncasecmp(cmd, "zimage", 6))
+		return true;
+#endif
+	return false;
+}
+
+/**
+ * fastboot_mmc_stream_start() - Get ready to write an image as it arrives
+ *
+ * @cmd: Named partition to write image to
+ * @max_size: Returns the size of the partition, in bytes
+ * @response: Pointer to fastboot response buffer
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_start(const char *cmd, u64 *max_size, char *response)
+{
+	struct fb_mmc_stream *st = &fb_mmc_stream;
+	int ret;
+
+	memset(st, '\0', sizeof(*st));
+	if (!cmd || fb_mmc_stream_unsupported(cmd)) {
+		fastboot_fail("cannot stream to this partition", response);
+		return -EINVAL;
+	}
+	strlcpy(st->name, cmd, sizeof(st->name));
+
+#if CONFIG_IS_ENABLED(FASTBOOT_MMC_USER_SUPPORT)
+	if (strcmp(cmd, CONFIG_FASTBOOT_MMC_USER_NAME) == 0) {
+		st->dev_desc = fastboot_mmc_get_dev(response);
+		if (!st->dev_desc)
+			return -ENODEV;
+
+		strlcpy((char *)&st->info.name, cmd, sizeof(st->info.name));
+		st->info.size	= st->dev_desc->lba;
+		st->info.blksz	= st->dev_desc->blksz;
+	}
+#endif
+
+	if (!st->info.name[0]) {
+		ret = fastboot_mmc_get_part_info(cmd, &st->dev_desc, &st->info,
+						 response);
+		if (ret < 0)
+			return ret;
+	}
+	*max_size = (u64)st->info.size * st->info.blksz;
+
+	return 0;
+}
+
+/**
+ * fastboot_mmc_stream_write() - Write the next part of a streamed image
+ *
+ * @data: Next bytes of the image
+ * @len: Number of bytes
+ * @last: true if this is the end of the image
+ * @response: Pointer to fastboot response buffer, set on error or at the end
+ * Return: number of bytes used (the rest must be passed again with more
+ *	data), or -ve on error
+ */
+int fastboot_mmc_stream_write(const void *data, u32 len, bool last,
+			      char *response)
+{
+	struct fb_mmc_stream *st = &fb_mmc_stream;
+	struct disk_partition *info = &st->info;
+	lbaint_t blkcnt, blks;
+	void *tail = NULL;
+	u32 tail_len;
+	int used;
+
+	if (!st->started) {
+		/* Wait until a sparse image can be told from a raw one */
+		if (len < sizeof(sparse_header_t) && !last)
+			return 0;
+		st->started = true;
+		st->sparse = len >= sizeof(sparse_header_t) &&
+			     is_sparse_image((void *)data);
+		st->blk = info->start;
+		if (st->sparse) {
+			st->sparse_priv.dev_desc = st->dev_desc;
+			st->sparse_info.blksz = info->blksz;
+			st->sparse_info.start = info->start;
+			st->sparse_info.size = info->size;
+			st->sparse_info.write = fb_mmc_sparse_write;
+			st->sparse_info.reserve = fb_mmc_sparse_reserve;
+			st->sparse_info.mssg = fastboot_fail;
+			st->sparse_info.priv = &st->sparse_priv;
+
+			printf("Flashing sparse image at offset " LBAFU "\n",
+			       info->start);
+			sparse_stream_init(&st->ss, &st->sparse_info,
+					   st->name);
+		} else {
+			puts("Flashing Raw Image\n");
+		}
+	}
+
+	if (st->sparse) {
+		used = sparse_stream_write(&st->ss, data, len, response);
+		if (used < 0 || !last)
+			return used;
+		if (sparse_stream_finish(&st->ss, response))
+			return -EIO;
+		fastboot_okay(NULL, response);
+		return len;
+	}
+
+	blkcnt = len / info->blksz;
+	tail_len = last ? len % info->blksz : 0;
+	if (st->blk + blkcnt + !!tail_len > info->start + info->size) {
+		pr_err("too large for partition: '%s'\n", st->name);
+		fastboot_fail("too large for partition", response);
+		return -EFBIG;
+	}
+
+	blks = fb_mmc_blk_write(st->dev_desc, st->blk, blkcnt, data);
+	if (blks == blkcnt && tail_len) {
+		/* Pad the end of the image to a whole block */
+		tail = memalign(ARCH_DMA_MINALIGN, info->blksz);
+		if (tail) {
+			memset(tail, '\0', info->blksz);
+			memcpy(tail, data + blkcnt * info->blksz, tail_len);
+			blks += fb_mmc_blk_write(st->dev_desc,
+						 st->blk + blkcnt, 1, tail);
+			free(tail);
+		}
+		blkcnt++;
+	}
+	if (blks != blkcnt) {
+		pr_err("failed writing to device %d\n", st->dev_desc->devnum);
+		fastboot_fail("failed writing to device", response);
+		return -EIO;
+	}
+	st->blk += blkcnt;
+
+	if (!last)
+		return blkcnt * info->blksz;
+
+	printf("........ wrote " LBAFU " bytes to '%s'\n",
+	       (st->blk - info->start) * info->blksz, st->name);
+	fastboot_okay(NULL, response);
+
+	return len;
+}
+#endif
+
 /**
  * fastboot_mmc_flash_erase() - Erase eMMC for fastboot
  *
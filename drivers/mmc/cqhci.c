@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * eMMC Command Queue Host Controller Interface (CQHCI)
+ *
+ * Only read and write tasks are queued; direct commands are not used, since
+ * the card is taken out of command queue mode for anything else. Completion
+ * is polled rather than signalled by interrupt.
+ */
+
+#include <common.h>
+#include <cpu_func.h>
+#include <cqhci.h>
+#include <log.h>
+#include <malloc.h>
+#include <mmc.h>
+#include <wait_bit.h>
+#include <asm/byteorder.h>
+#include <asm/cache.h>
+#include <asm/io.h>
+#include <linux/dma-mapping.h>
+#include <linux/kernel.h>
+
+/* How long to wait for the engine to halt or drop its tasks */
+#define CQHCI_TIMEOUT_MS	100
+
+static void cqhci_flush(void *start, size_t len)
+{
+	ulong addr = (ulong)start;
+
+	flush_dcache_range(rounddown(addr, ARCH_DMA_MINALIGN),
+			   roundup(addr + len, ARCH_DMA_MINALIGN));
+}
+
+/* Transfer and link descriptors share a layout: attributes, then address */
+static void cqhci_set_desc(struct cqhci_host *cq, void *desc, u32 attr,
+			   dma_addr_t addr)
+{
+	__le32 *word = desc;
+
+	word[0] = cpu_to_le32(attr);
+	word[1] = cpu_to_le32(lower_32_bits(addr));
+	if (cq->dma64)
+		word[2] = cpu_to_le32(upper_32_bits(addr));
+}
+
+static void *cqhci_trans(struct cqhci_host *cq, int tag)
+{
+	return cq->trans + tag * CQHCI_MAX_SEGS * cq->trans_len;
+}
+
+void cqhci_free(struct cqhci_host *cq)
+{
+	free(cq->desc);
+	free(cq->trans);
+	cq->desc = NULL;
+	cq->trans = NULL;
+}
+
+int cqhci_init(struct cqhci_host *cq, void *mmio, bool dma64)
+{
+	int task_len = dma64 ? 16 : 8;
+	size_t desc_size, trans_size;
+	int tag;
+
+	cq->mmio = mmio;
+	cq->dma64 = dma64;
+	cq->trans_len = dma64 ? 16 : 8;
+	cq->slot_len = task_len + cq->trans_len;
+
+	desc_size = CQHCI_NUM_SLOTS * cq->slot_len;
+	trans_size = CQHCI_NUM_SLOTS * CQHCI_MAX_SEGS * cq->trans_len;
+	cq->desc = memalign(ARCH_DMA_MINALIGN, desc_size);
+	cq->trans = memalign(ARCH_DMA_MINALIGN, trans_size);
+	if (!cq->desc || !cq->trans) {
+		cqhci_free(cq);
+		return -ENOMEM;
+	}
+	memset(cq->desc, '\0', desc_size);
+	memset(cq->trans, '\0', trans_size);
+
+	/* Each slot links to its own transfer descriptor list */
+	for (tag = 0; tag < CQHCI_NUM_SLOTS; tag++)
+		cqhci_set_desc(cq, cq->desc + tag * cq->slot_len + task_len,
+			       CQHCI_VALID(1) | CQHCI_ACT(CQHCI_ACT_LINK),
+			       virt_to_phys(cqhci_trans(cq, tag)));
+	cqhci_flush(cq->desc, desc_size);
+
+	return 0;
+}
+
+int cqhci_enable(struct cqhci_host *cq, struct mmc *mmc)
+{
+	dma_addr_t desc = virt_to_phys(cq->desc);
+	u32 cfg;
+
+	cfg = readl(cq->mmio + CQHCI_CFG);
+	if (cfg & CQHCI_CFG_ENABLE)
+		writel(cfg & ~CQHCI_CFG_ENABLE, cq->mmio + CQHCI_CFG);
+
+	cfg &= ~(CQHCI_CFG_ENABLE | CQHCI_CFG_DCMD | CQHCI_CFG_TASK_DESC_SZ);
+	if (cq->dma64)
+		cfg |= CQHCI_CFG_TASK_DESC_SZ;
+	writel(cfg, cq->mmio + CQHCI_CFG);
+
+	writel(lower_32_bits(desc), cq->mmio + CQHCI_TDLBA);
+	writel(upper_32_bits(desc), cq->mmio + CQHCI_TDLBAU);
+	writel(mmc->rca, cq->mmio + CQHCI_SSC2);
+
+	/* Record completions and errors, but do not interrupt */
+	writel(CQHCI_IS_MASK, cq->mmio + CQHCI_ISTE);
+	writel(0, cq->mmio + CQHCI_ISGE);
+	writel(readl(cq->mmio + CQHCI_IS), cq->mmio + CQHCI_IS);
+	writel(readl(cq->mmio + CQHCI_TCN), cq->mmio + CQHCI_TCN);
+
+	writel(cfg | CQHCI_CFG_ENABLE, cq->mmio + CQHCI_CFG);
+	writel(readl(cq->mmio + CQHCI_CTL) & ~CQHCI_CTL_HALT,
+	       cq->mmio + CQHCI_CTL);
+
+	cq->mmc = mmc;
+	cq->busy = 0;
+
+	return CQHCI_NUM_SLOTS;
+}
+
+static int cqhci_halt(struct cqhci_host *cq)
+{
+	writel(readl(cq->mmio + CQHCI_CTL) | CQHCI_CTL_HALT,
+	       cq->mmio + CQHCI_CTL);
+
+	return wait_for_bit_le32(cq->mmio + CQHCI_CTL, CQHCI_CTL_HALT, true,
+				 CQHCI_TIMEOUT_MS, false);
+}
+
+static void cqhci_unmap(struct cqhci_host *cq, u32 mask)
+{
+	int tag;
+
+	for (tag = 0; tag < CQHCI_NUM_SLOTS; tag++) {
+		if (!(mask & BIT(tag)))
+			continue;
+		dma_unmap_single(cq->buf[tag], cq->len[tag],
+				 cq->write & BIT(tag) ? DMA_TO_DEVICE :
+				 DMA_FROM_DEVICE);
+	}
+	cq->busy &= ~mask;
+}
+
+int cqhci_disable(struct cqhci_host *cq)
+{
+	int ret;
+
+	ret = cqhci_halt(cq);
+	writel(readl(cq->mmio + CQHCI_CFG) & ~CQHCI_CFG_ENABLE,
+	       cq->mmio + CQHCI_CFG);
+	cqhci_unmap(cq, cq->busy);
+	cq->mmc = NULL;
+
+	return ret;
+}
+
+int cqhci_request(struct cqhci_host *cq, int tag, bool write, lbaint_t start,
+		  lbaint_t blkcnt, void *buf)
+{
+	size_t len = blkcnt * MMC_MAX_BLOCK_LEN;
+	int segs = DIV_ROUND_UP(len, CQHCI_SEG_SIZE);
+	void *trans = cqhci_trans(cq, tag);
+	__le64 *task = cq->desc + tag * cq->slot_len;
+	dma_addr_t addr;
+	size_t seg;
+	int i;
+
+	if (!blkcnt || segs > CQHCI_MAX_SEGS)
+		return -EINVAL;
+
+	addr = dma_map_single(buf, len, write ? DMA_TO_DEVICE :
+			      DMA_FROM_DEVICE);
+	for (i = 0; i < segs; i++) {
+		seg = min_t(size_t, len - i * CQHCI_SEG_SIZE, CQHCI_SEG_SIZE);
+		cqhci_set_desc(cq, trans + i * cq->trans_len,
+			       CQHCI_VALID(1) | CQHCI_END(i == segs - 1) |
+			       CQHCI_ACT(CQHCI_ACT_TRAN) |
+			       CQHCI_DAT_LENGTH(seg),
+			       addr + i * CQHCI_SEG_SIZE);
+	}
+	cqhci_flush(trans, segs * cq->trans_len);
+
+	if (!cq->mmc->high_capacity)
+		start *= cq->mmc->read_bl_len;
+	*task = cpu_to_le64(CQHCI_VALID(1) | CQHCI_END(1) | CQHCI_INT(1) |
+			    CQHCI_ACT(CQHCI_ACT_TASK) | CQHCI_DATA_DIR(!write) |
+			    CQHCI_BLK_COUNT(blkcnt) | CQHCI_BLK_ADDR(start));
+	cqhci_flush(task, sizeof(*task));
+
+	cq->buf[tag] = addr;
+	cq->len[tag] = len;
+	if (write)
+		cq->write |= BIT(tag);
+	else
+		cq->write &= ~BIT(tag);
+	cq->busy |= BIT(tag);
+	writel(BIT(tag), cq->mmio + CQHCI_TDBR);
+
+	return 0;
+}
+
+int cqhci_poll(struct cqhci_host *cq, u32 *donep, u32 *failedp)
+{
+	u32 status, terri, done;
+	int ret;
+
+	status = readl(cq->mmio + CQHCI_IS);
+	writel(status, cq->mmio + CQHCI_IS);
+
+	if (status & CQHCI_IS_ERROR) {
+		terri = readl(cq->mmio + CQHCI_TERRI);
+		log_debug("error %#x, task error info %#x\n", status, terri);
+
+		/* Drop everything; the caller will discard the card's queue */
+		ret = cqhci_halt(cq);
+		if (!ret) {
+			writel(readl(cq->mmio + CQHCI_CTL) |
+			       CQHCI_CTL_CLEAR_ALL_TASKS, cq->mmio + CQHCI_CTL);
+			ret = wait_for_bit_le32(cq->mmio + CQHCI_CTL,
+						CQHCI_CTL_CLEAR_ALL_TASKS,
+						false, CQHCI_TIMEOUT_MS, false);
+		}
+		writel(readl(cq->mmio + CQHCI_TCN), cq->mmio + CQHCI_TCN);
+		done = cq->busy;
+		cqhci_unmap(cq, done);
+		if (ret)
+			return ret;
+		*donep = done;
+		*failedp = done;
+
+		return 0;
+	}
+
+	done = readl(cq->mmio + CQHCI_TCN);
+	writel(done, cq->mmio + CQHCI_TCN);
+	done &= cq->busy;
+	cqhci_unmap(cq, done);
+	*donep = done;
+	*failedp = 0;
+
+	return 0;
+}
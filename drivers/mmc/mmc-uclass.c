@@ -125,6 +125,34 @@ int mmc_execute_tuning(struct mmc *mmc, uint opcode)
 {
 	return dm_mmc_execute_tuning(mmc->dev, opcode);
 }
+
+static int dm_mmc_get_tuning(struct udevice *dev, u32 *val)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->get_tuning)
+		return -ENOSYS;
+	return ops->get_tuning(dev, val);
+}
+
+int mmc_get_tuning(struct mmc *mmc, u32 *val)
+{
+	return dm_mmc_get_tuning(mmc->dev, val);
+}
+
+static int dm_mmc_set_tuning(struct udevice *dev, u32 val)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->set_tuning)
+		return -ENOSYS;
+	return ops->set_tuning(dev, val);
+}
+
+int mmc_set_tuning(struct mmc *mmc, u32 val)
+{
+	return dm_mmc_set_tuning(mmc->dev, val);
+}
 #endif
 
 #if CONFIG_IS_ENABLED(MMC_HS400_ES_SUPPORT)
@@ -159,6 +187,45 @@ int mmc_hs400_prepare_ddr(struct mmc *mmc)
 	return dm_mmc_hs400_prepare_ddr(mmc->dev);
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+int mmc_cqe_enable(struct mmc *mmc)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!ops->cqe_enable)
+		return -ENOSYS;
+	return ops->cqe_enable(mmc->dev);
+}
+
+int mmc_cqe_disable(struct mmc *mmc)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!ops->cqe_disable)
+		return -ENOSYS;
+	return ops->cqe_disable(mmc->dev);
+}
+
+int mmc_cqe_request(struct mmc *mmc, int tag, bool write, lbaint_t start,
+		    lbaint_t blkcnt, void *buf)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!ops->cqe_request)
+		return -ENOSYS;
+	return ops->cqe_request(mmc->dev, tag, write, start, blkcnt, buf);
+}
+
+int mmc_cqe_poll(struct mmc *mmc, u32 *donep, u32 *failedp)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!ops->cqe_poll)
+		return -ENOSYS;
+	return ops->cqe_poll(mmc->dev, donep, failedp);
+}
+#endif
+
 static int dm_mmc_host_power_cycle(struct udevice *dev)
 {
 	struct dm_mmc_ops *ops = mmc_get_ops(dev);
@@ -447,6 +514,10 @@ static int mmc_select_hwpart(struct udevice *bdev, int hwpart)
 	if (mmc->part_config == MMCPART_NOAVAILABLE)
 		return -EMEDIUMTYPE;
 
+	ret = mmc_cmdq_off(mmc);
+	if (ret)
+		return ret;
+
 	ret = mmc_switch_part(mmc, hwpart);
 	if (!ret)
 		blkcache_invalidate(desc->if_type, desc->devnum);
@@ -472,14 +543,52 @@ static int mmc_blk_probe(struct udevice *dev)
 
 #if CONFIG_IS_ENABLED(MMC_UHS_SUPPORT) || \
     CONFIG_IS_ENABLED(MMC_HS200_SUPPORT) || \
-    CONFIG_IS_ENABLED(MMC_HS400_SUPPORT)
+    CONFIG_IS_ENABLED(MMC_HS400_SUPPORT) || \
+    CONFIG_IS_ENABLED(MMC_CQE)
 static int mmc_blk_remove(struct udevice *dev)
 {
 	struct udevice *mmc_dev = dev_get_parent(dev);
 	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(mmc_dev);
 	struct mmc *mmc = upriv->mmc;
+	int ret;
 
-	return mmc_deinit(mmc);
+#if CONFIG_IS_ENABLED(MMC_UHS_SUPPORT) || \
+    CONFIG_IS_ENABLED(MMC_HS200_SUPPORT) || \
+    CONFIG_IS_ENABLED(MMC_HS400_SUPPORT)
+	ret = mmc_deinit(mmc);
+#else
+	ret = mmc_cmdq_off(mmc);
+#endif
+	mmc_cmdq_free(mmc);
+
+	return ret;
+}
+#endif
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/* Use the card's command queue if it has one, else queue in the uclass */
+static int mmc_blk_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev_get_parent(dev));
+	int ret;
+
+	ret = mmc_cmdq_submit(mmc, req);
+	if (ret == -ENOSYS)
+		return blk_queue_submit(dev, req);
+
+	return ret;
+}
+
+static int mmc_blk_poll(struct udevice *dev)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev_get_parent(dev));
+	int ret;
+
+	ret = mmc_cmdq_poll(mmc);
+	if (ret)
+		return ret;
+
+	return blk_queue_poll(dev);
 }
 #endif
 
@@ -490,6 +599,13 @@ static const struct blk_ops mmc_blk_ops = {
 	.erase	= mmc_berase,
 #endif
 	.select_hwpart	= mmc_select_hwpart,
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	.submit		= mmc_blk_submit,
+	.poll		= mmc_blk_poll,
+#else
+	.submit		= blk_queue_submit,
+	.poll		= blk_queue_poll,
+#endif
 };
 
 U_BOOT_DRIVER(mmc_blk) = {
@@ -499,7 +615,8 @@ U_BOOT_DRIVER(mmc_blk) = {
 	.probe		= mmc_blk_probe,
 #if CONFIG_IS_ENABLED(MMC_UHS_SUPPORT) || \
     CONFIG_IS_ENABLED(MMC_HS200_SUPPORT) || \
-    CONFIG_IS_ENABLED(MMC_HS400_SUPPORT)
+    CONFIG_IS_ENABLED(MMC_HS400_SUPPORT) || \
+    CONFIG_IS_ENABLED(MMC_CQE)
 	.remove		= mmc_blk_remove,
 	.flags		= DM_FLAG_OS_PREPARE,
 #endif
@@ -10,6 +10,7 @@
 #include <config.h>
 #include <common.h>
 #include <blk.h>
+#include <bloblist.h>
 #include <command.h>
 #include <dm.h>
 #include <log.h>
@@ -468,6 +469,9 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	if (!mmc)
 		return 0;
 
+	if (mmc_cmdq_off(mmc))
+		return 0;
+
 	if (CONFIG_IS_ENABLED(MMC_TINY))
 		err = mmc_switch_part(mmc, block_dev->hwpart);
 	else
@@ -1961,6 +1965,19 @@ static const struct ext_csd_bus_width {
 	{MMC_MODE_1BIT, false, EXT_CSD_BUS_WIDTH_1},
 };
 
+#ifdef MMC_SUPPORTS_TUNING
+/* Tune the host, or apply the result of an earlier tuning if there is one */
+static int mmc_tune(struct mmc *mmc, uint opcode)
+{
+#if CONFIG_IS_ENABLED(MMC_BUS_CACHE)
+	if (mmc->use_cached_tuning &&
+	    !mmc_set_tuning(mmc, mmc->cached_tuning))
+		return 0;
+#endif
+	return mmc_execute_tuning(mmc, opcode);
+}
+#endif
+
 #if CONFIG_IS_ENABLED(MMC_HS400_SUPPORT)
 static int mmc_select_hs400(struct mmc *mmc)
 {
@@ -1977,7 +1994,7 @@ static int mmc_select_hs400(struct mmc *mmc)
 
 	/* execute tuning if needed */
 	mmc->hs400_tuning = 1;
-	err = mmc_execute_tuning(mmc, MMC_CMD_SEND_TUNING_BLOCK_HS200);
+	err = mmc_tune(mmc, MMC_CMD_SEND_TUNING_BLOCK_HS200);
 	mmc->hs400_tuning = 0;
 	if (err) {
 		debug("tuning failed\n");
@@ -2061,6 +2078,94 @@ static int mmc_select_hs400es(struct mmc *mmc)
 	    ecbv++) \
 		if ((ddr == ecbv->is_ddr) && (caps & ecbv->cap))
 
+/*
+ * Switch the card and the host to a mode and bus width, then do a transfer to
+ * check them. If that fails, both are put back to legacy mode with a 1-bit
+ * bus.
+ */
+static int mmc_try_mode_and_width(struct mmc *mmc,
+				  const struct mode_width_tuning *mwt,
+				  const struct ext_csd_bus_width *ecbw)
+{
+	enum mmc_voltage old_voltage;
+	int err;
+
+	pr_debug("trying mode %s width %d (at %d MHz)\n",
+		 mmc_mode_name(mwt->mode), bus_width(ecbw->cap),
+		 mmc_mode2freq(mmc, mwt->mode) / 1000000);
+	old_voltage = mmc->signal_voltage;
+	err = mmc_set_lowest_voltage(mmc, mwt->mode, MMC_ALL_SIGNAL_VOLTAGE);
+	if (err)
+		return err;
+
+	/* configure the bus width (card + host) */
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BUS_WIDTH,
+			 ecbw->ext_csd_bits & ~EXT_CSD_DDR_FLAG);
+	if (err)
+		goto error;
+	mmc_set_bus_width(mmc, bus_width(ecbw->cap));
+
+	if (mwt->mode == MMC_HS_400) {
+		err = mmc_select_hs400(mmc);
+		if (err) {
+			printf("Select HS400 failed %d\n", err);
+			goto error;
+		}
+	} else if (mwt->mode == MMC_HS_400_ES) {
+		err = mmc_select_hs400es(mmc);
+		if (err) {
+			printf("Select HS400ES failed %d\n", err);
+			goto error;
+		}
+	} else {
+		/* configure the bus speed (card) */
+		err = mmc_set_card_speed(mmc, mwt->mode, false);
+		if (err)
+			goto error;
+
+		/*
+		 * configure the bus width AND the ddr mode (card). The host
+		 * side will be taken care of in the next step
+		 */
+		if (ecbw->ext_csd_bits & EXT_CSD_DDR_FLAG) {
+			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+					 EXT_CSD_BUS_WIDTH,
+					 ecbw->ext_csd_bits);
+			if (err)
+				goto error;
+		}
+
+		/* configure the bus mode (host) */
+		mmc_select_mode(mmc, mwt->mode);
+		mmc_set_clock(mmc, mmc->tran_speed, MMC_CLK_ENABLE);
+#ifdef MMC_SUPPORTS_TUNING
+
+		/* execute tuning if needed */
+		if (mwt->tuning) {
+			err = mmc_tune(mmc, mwt->tuning);
+			if (err) {
+				pr_debug("tuning failed : %d\n", err);
+				goto error;
+			}
+		}
+#endif
+	}
+
+	/* do a transfer to check the configuration */
+	err = mmc_read_and_compare_ext_csd(mmc);
+	if (!err)
+		return 0;
+error:
+	mmc_set_signal_voltage(mmc, old_voltage);
+	/* if an error occurred, revert to a safer bus mode */
+	mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BUS_WIDTH,
+		   EXT_CSD_BUS_WIDTH_1);
+	mmc_select_mode(mmc, MMC_LEGACY);
+	mmc_set_bus_width(mmc, 1);
+
+	return err;
+}
+
 static int mmc_select_mode_and_width(struct mmc *mmc, uint card_caps)
 {
 	int err = 0;
@@ -2110,94 +2215,115 @@ static int mmc_select_mode_and_width(struct mmc *mmc, uint card_caps)
 	for_each_mmc_mode_by_pref(card_caps, mwt) {
 		for_each_supported_width(card_caps & mwt->widths,
 					 mmc_is_mode_ddr(mwt->mode), ecbw) {
-			enum mmc_voltage old_voltage;
-			pr_debug("trying mode %s width %d (at %d MHz)\n",
-				 mmc_mode_name(mwt->mode),
-				 bus_width(ecbw->cap),
-				 mmc_mode2freq(mmc, mwt->mode) / 1000000);
-			old_voltage = mmc->signal_voltage;
-			err = mmc_set_lowest_voltage(mmc, mwt->mode,
-						     MMC_ALL_SIGNAL_VOLTAGE);
-			if (err)
-				continue;
+			err = mmc_try_mode_and_width(mmc, mwt, ecbw);
+			if (!err)
+				return 0;
+		}
+	}
 
-			/* configure the bus width (card + host) */
-			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
-				    EXT_CSD_BUS_WIDTH,
-				    ecbw->ext_csd_bits & ~EXT_CSD_DDR_FLAG);
-			if (err)
-				goto error;
-			mmc_set_bus_width(mmc, bus_width(ecbw->cap));
+	pr_err("unable to select a mode : %d\n", err);
 
-			if (mwt->mode == MMC_HS_400) {
-				err = mmc_select_hs400(mmc);
-				if (err) {
-					printf("Select HS400 failed %d\n", err);
-					goto error;
-				}
-			} else if (mwt->mode == MMC_HS_400_ES) {
-				err = mmc_select_hs400es(mmc);
-				if (err) {
-					printf("Select HS400ES failed %d\n",
-					       err);
-					goto error;
-				}
-			} else {
-				/* configure the bus speed (card) */
-				err = mmc_set_card_speed(mmc, mwt->mode, false);
-				if (err)
-					goto error;
+	return -ENOTSUPP;
+}
 
-				/*
-				 * configure the bus width AND the ddr mode
-				 * (card). The host side will be taken care
-				 * of in the next step
-				 */
-				if (ecbw->ext_csd_bits & EXT_CSD_DDR_FLAG) {
-					err = mmc_switch(mmc,
-							 EXT_CSD_CMD_SET_NORMAL,
-							 EXT_CSD_BUS_WIDTH,
-							 ecbw->ext_csd_bits);
-					if (err)
-						goto error;
-				}
+#if CONFIG_IS_ENABLED(MMC_BUS_CACHE)
+static struct mmc_bus_cache_entry *mmc_bus_cache_find(struct mmc *mmc,
+						      bool add)
+{
+	struct mmc_bus_cache *cache;
+	int i;
 
-				/* configure the bus mode (host) */
-				mmc_select_mode(mmc, mwt->mode);
-				mmc_set_clock(mmc, mmc->tran_speed,
-					      MMC_CLK_ENABLE);
-#ifdef MMC_SUPPORTS_TUNING
+	if (add)
+		cache = bloblist_ensure(BLOBLISTT_MMC_BUS, sizeof(*cache));
+	else
+		cache = bloblist_find(BLOBLISTT_MMC_BUS, sizeof(*cache));
+	if (!cache)
+		return NULL;
 
-				/* execute tuning if needed */
-				if (mwt->tuning) {
-					err = mmc_execute_tuning(mmc,
-								 mwt->tuning);
-					if (err) {
-						pr_debug("tuning failed : %d\n", err);
-						goto error;
-					}
-				}
-#endif
-			}
+	for (i = 0; i < MMC_BUS_CACHE_ENTRIES; i++) {
+		if (!memcmp(cache->ent[i].cid, mmc->cid, sizeof(mmc->cid)))
+			return &cache->ent[i];
+	}
+	if (!add)
+		return NULL;
+	for (i = 0; i < MMC_BUS_CACHE_ENTRIES; i++) {
+		if (!cache->ent[i].cid[0] && !cache->ent[i].cid[3])
+			return &cache->ent[i];
+	}
 
-			/* do a transfer to check the configuration */
-			err = mmc_read_and_compare_ext_csd(mmc);
-			if (!err)
-				return 0;
-error:
-			mmc_set_signal_voltage(mmc, old_voltage);
-			/* if an error occurred, revert to a safer bus mode */
-			mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
-				   EXT_CSD_BUS_WIDTH, EXT_CSD_BUS_WIDTH_1);
-			mmc_select_mode(mmc, MMC_LEGACY);
-			mmc_set_bus_width(mmc, 1);
+	/* Full, so reuse the first entry */
+	return &cache->ent[0];
+}
+
+/*
+ * Select the mode and bus width recorded by an earlier phase for this card,
+ * applying its tuning result rather than tuning again. The usual check
+ * transfer makes sure the settings still work.
+ */
+static int mmc_bus_cache_restore(struct mmc *mmc)
+{
+	const struct mmc_bus_cache_entry *ent;
+	const struct mode_width_tuning *mwt;
+	const struct ext_csd_bus_width *ecbw;
+	uint caps = mmc->card_caps & mmc->host_caps;
+	int err = -ENOENT;
+
+	if (mmc_host_is_spi(mmc) || mmc->version < MMC_VERSION_4 ||
+	    !mmc->ext_csd)
+		return -ENOTSUPP;
+
+	ent = mmc_bus_cache_find(mmc, false);
+	if (!ent || !(caps & MMC_CAP(ent->mode)) ||
+	    mmc_mode2freq(mmc, ent->mode) != ent->clock)
+		return -ENOENT;
+
+	mmc_set_clock(mmc, mmc->legacy_speed, MMC_CLK_ENABLE);
+	for_each_mmc_mode_by_pref(MMC_CAP(ent->mode), mwt) {
+		for_each_supported_width(caps & mwt->widths & ent->width,
+					 mmc_is_mode_ddr(mwt->mode), ecbw) {
+			mmc->use_cached_tuning = ent->has_tuning;
+			mmc->cached_tuning = ent->tuning;
+			err = mmc_try_mode_and_width(mmc, mwt, ecbw);
+			mmc->use_cached_tuning = false;
+			if (err)
+				log_debug("cached mode %s failed: %d\n",
+					  mmc_mode_name(mwt->mode), err);
+			return err;
 		}
 	}
 
-	pr_err("unable to select a mode : %d\n", err);
+	return err;
+}
 
-	return -ENOTSUPP;
+static void mmc_bus_cache_save(struct mmc *mmc)
+{
+	struct mmc_bus_cache_entry *ent;
+
+	ent = mmc_bus_cache_find(mmc, true);
+	if (!ent)
+		return;
+
+	memcpy(ent->cid, mmc->cid, sizeof(mmc->cid));
+	ent->mode = mmc->selected_mode;
+	ent->width = mmc->bus_width == 8 ? MMC_MODE_8BIT :
+		     mmc->bus_width == 4 ? MMC_MODE_4BIT : MMC_MODE_1BIT;
+	ent->clock = mmc->tran_speed;
+#ifdef MMC_SUPPORTS_TUNING
+	ent->has_tuning = !mmc_get_tuning(mmc, &ent->tuning);
+#else
+	ent->has_tuning = false;
+#endif
+}
+#else
+static int mmc_bus_cache_restore(struct mmc *mmc)
+{
+	return -ENOSYS;
 }
+
+static void mmc_bus_cache_save(struct mmc *mmc)
+{
+}
+#endif
 #endif
 
 #if CONFIG_IS_ENABLED(MMC_TINY)
@@ -2261,6 +2387,15 @@ static int mmc_startup_v4(struct mmc *mmc)
 
 	mmc->version = mmc_versions[ext_csd[EXT_CSD_REV]];
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	if (mmc->version >= MMC_VERSION_5_1 &&
+	    (ext_csd[EXT_CSD_CMDQ_SUPPORT] & EXT_CSD_CMDQ_SUPPORTED))
+		mmc->cmdq_depth = (ext_csd[EXT_CSD_CMDQ_DEPTH] &
+				   EXT_CSD_CMDQ_DEPTH_MASK) + 1;
+	else
+		mmc->cmdq_depth = 0;
+#endif
+
 	if (mmc->version >= MMC_VERSION_4_2) {
 		/*
 		 * According to the JEDEC Standard, the value of
@@ -2591,7 +2726,12 @@ static int mmc_startup(struct mmc *mmc)
 		err = mmc_get_capabilities(mmc);
 		if (err)
 			return err;
-		err = mmc_select_mode_and_width(mmc, mmc->card_caps);
+		/* Reuse what an earlier phase found, if it still works */
+		err = mmc_bus_cache_restore(mmc);
+		if (err)
+			err = mmc_select_mode_and_width(mmc, mmc->card_caps);
+		if (!err)
+			mmc_bus_cache_save(mmc);
 	}
 #endif
 	if (err)
@@ -2959,10 +3099,15 @@ int mmc_init(struct mmc *mmc)
 int mmc_deinit(struct mmc *mmc)
 {
 	u32 caps_filtered;
+	int ret;
 
 	if (!mmc->has_init)
 		return 0;
 
+	ret = mmc_cmdq_off(mmc);
+	if (ret)
+		return ret;
+
 	if (IS_SD(mmc)) {
 		caps_filtered = mmc->card_caps &
 			~(MMC_CAP(UHS_SDR12) | MMC_CAP(UHS_SDR25) |
@@ -0,0 +1,336 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * eMMC command queueing
+ *
+ * Carries out blk_submit() requests as tasks queued on the card through the
+ * host's command queue engine, so that the card can work on several of them
+ * at once. The card is only in command queue mode while tasks are queued,
+ * since other commands cannot be sent then.
+ */
+
+#define LOG_CATEGORY UCLASS_MMC
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <log.h>
+#include <malloc.h>
+#include <mmc.h>
+#include <time.h>
+#include <linux/bitops.h>
+#include "mmc_private.h"
+
+/* Most tasks the command queue specification allows for */
+#define MMC_CMDQ_MAX_TASKS	32
+/* How long to wait for queued tasks before giving up on them */
+#define MMC_CMDQ_TIMEOUT_MS	10000
+
+/**
+ * struct mmc_cmdq_task - A task queued on the card
+ *
+ * @req: Request the task is part of
+ * @start: First block of the task
+ * @blkcnt: Number of blocks in the task
+ */
+struct mmc_cmdq_task {
+	struct blk_request *req;
+	lbaint_t start;
+	lbaint_t blkcnt;
+};
+
+/**
+ * struct mmc_cmdq - Command queue state of an MMC device
+ *
+ * @queue: Requests with blocks which are not yet queued on the card
+ * @issued: Number of blocks of the first request in @queue which are queued
+ * @task: Queued tasks, indexed by tag
+ * @busy: Mask of tags in use
+ * @depth: Number of tags which may be used
+ * @start: Time at which a task was last queued, in milliseconds
+ * @on: true if the card and host are in command queue mode
+ * @broken: true if the host failed to enter command queue mode, so that it
+ *	is not tried again
+ */
+struct mmc_cmdq {
+	struct list_head queue;
+	lbaint_t issued;
+	struct mmc_cmdq_task task[MMC_CMDQ_MAX_TASKS];
+	u32 busy;
+	int depth;
+	ulong start;
+	bool on;
+	bool broken;
+};
+
+static struct mmc_cmdq *mmc_cmdq_get(struct mmc *mmc)
+{
+	struct mmc_cmdq *cmdq = mmc->cmdq;
+
+	if (!mmc->cmdq_depth || !mmc_get_ops(mmc->dev)->cqe_enable)
+		return NULL;
+	if (!cmdq) {
+		cmdq = calloc(1, sizeof(*cmdq));
+		if (!cmdq)
+			return NULL;
+		INIT_LIST_HEAD(&cmdq->queue);
+		mmc->cmdq = cmdq;
+	}
+
+	return cmdq->broken ? NULL : cmdq;
+}
+
+/*
+ * The card is switched first, while the host still takes the response to
+ * CMD6; once the host's engine is on, it no longer handles other commands
+ */
+static int mmc_cmdq_enter(struct mmc *mmc, struct mmc_cmdq *cmdq)
+{
+	int ret, slots;
+
+	ret = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 1);
+	if (ret)
+		return ret;
+
+	slots = mmc_cqe_enable(mmc);
+	if (slots < 0) {
+		mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 0);
+		return slots;
+	}
+	cmdq->depth = min3(slots, (int)mmc->cmdq_depth, MMC_CMDQ_MAX_TASKS);
+	cmdq->on = true;
+	log_debug("%s: command queue on, %d tasks\n", mmc->dev->name,
+		  cmdq->depth);
+
+	return 0;
+}
+
+/*
+ * Leave command queue mode, dropping any tasks the card still has. The host's
+ * engine is stopped first, so that it can send the other commands.
+ */
+static int mmc_cmdq_leave(struct mmc *mmc, struct mmc_cmdq *cmdq,
+			  bool discard)
+{
+	struct mmc_cmd cmd;
+	int ret, err;
+
+	cmdq->on = false;
+	ret = mmc_cqe_disable(mmc);
+	if (discard) {
+		cmd.cmdidx = MMC_CMD_CMDQ_TASK_MGMT;
+		cmd.cmdarg = MMC_CMDQ_DISCARD_QUEUE;
+		cmd.resp_type = MMC_RSP_R1b;
+		err = mmc_send_cmd(mmc, &cmd, NULL);
+		if (err)
+			log_debug("%s: discard failed: %d\n", mmc->dev->name,
+				  err);
+	}
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 0);
+	log_debug("%s: command queue off\n", mmc->dev->name);
+
+	return ret ? ret : err;
+}
+
+/* Complete @req if none of it is queued or waiting to be queued */
+static void mmc_cmdq_end(struct mmc_cmdq *cmdq, struct blk_request *req)
+{
+	int tag;
+
+	for (tag = 0; tag < MMC_CMDQ_MAX_TASKS; tag++) {
+		if ((cmdq->busy & BIT(tag)) && cmdq->task[tag].req == req)
+			return;
+	}
+	if (!list_empty(&cmdq->queue) &&
+	    list_first_entry(&cmdq->queue, struct blk_request, list) == req)
+		return;
+
+	blk_request_done(req, req->status);
+}
+
+/*
+ * The card may carry out queued tasks in any order, so a task must not be
+ * queued alongside another for the same blocks unless both are reads
+ */
+static bool mmc_cmdq_conflict(struct mmc_cmdq *cmdq, struct blk_request *req,
+			      lbaint_t start, lbaint_t blkcnt)
+{
+	struct mmc_cmdq_task *task;
+	int tag;
+
+	for (tag = 0; tag < MMC_CMDQ_MAX_TASKS; tag++) {
+		task = &cmdq->task[tag];
+		if (!(cmdq->busy & BIT(tag)))
+			continue;
+		if (req->op == BLK_REQ_READ && task->req->op == BLK_REQ_READ)
+			continue;
+		if (start < task->start + task->blkcnt &&
+		    task->start < start + blkcnt)
+			return true;
+	}
+
+	return false;
+}
+
+/* Queue as many tasks as the card will take */
+static void mmc_cmdq_issue(struct mmc *mmc, struct mmc_cmdq *cmdq)
+{
+	struct blk_desc *desc = mmc_get_blk_desc(mmc);
+	lbaint_t max = min_t(lbaint_t, mmc->cfg->b_max, MMC_CQE_MAX_BLKCNT);
+	struct mmc_cmdq_task *task;
+	struct blk_request *req;
+	lbaint_t start, blkcnt;
+	int tag, ret;
+
+	while (!list_empty(&cmdq->queue)) {
+		tag = ffs(~cmdq->busy) - 1;
+		if (tag < 0 || tag >= cmdq->depth)
+			break;
+
+		req = list_first_entry(&cmdq->queue, struct blk_request, list);
+		start = req->start + cmdq->issued;
+		blkcnt = min(req->blkcnt - cmdq->issued, max);
+		if (mmc_cmdq_conflict(cmdq, req, start, blkcnt))
+			break;
+
+		ret = mmc_cqe_request(mmc, tag, req->op == BLK_REQ_WRITE, start,
+				      blkcnt,
+				      req->buffer + cmdq->issued * desc->blksz);
+		if (ret) {
+			/* Give up on the rest of the request */
+			req->status = ret;
+			blkcnt = req->blkcnt - cmdq->issued;
+		} else {
+			task = &cmdq->task[tag];
+			task->req = req;
+			task->start = start;
+			task->blkcnt = blkcnt;
+			cmdq->busy |= BIT(tag);
+			cmdq->start = get_timer(0);
+		}
+
+		cmdq->issued += blkcnt;
+		if (cmdq->issued == req->blkcnt) {
+			list_del(&req->list);
+			cmdq->issued = 0;
+			if (ret)
+				mmc_cmdq_end(cmdq, req);
+		}
+	}
+}
+
+int mmc_cmdq_submit(struct mmc *mmc, struct blk_request *req)
+{
+	struct mmc_cmdq *cmdq = mmc_cmdq_get(mmc);
+	int ret;
+
+	if (!cmdq)
+		return -ENOSYS;
+
+	/* Only queue tasks for the user partition */
+	if (mmc_get_blk_desc(mmc)->hwpart)
+		return -ENOSYS;
+
+	if (!cmdq->on) {
+		ret = mmc_cmdq_enter(mmc, cmdq);
+		if (ret) {
+			if (ret != -ENOSYS)
+				log_warning("%s: cannot use the command queue: %d\n",
+					    mmc->dev->name, ret);
+			cmdq->broken = true;
+			return -ENOSYS;
+		}
+	}
+
+	list_add_tail(&req->list, &cmdq->queue);
+	mmc_cmdq_issue(mmc, cmdq);
+
+	return 0;
+}
+
+/* Hand back finished tasks, then queue more or leave command queue mode */
+static int mmc_cmdq_complete(struct mmc *mmc, struct mmc_cmdq *cmdq, u32 done,
+			     u32 failed)
+{
+	struct mmc_cmdq_task *task;
+	struct blk_request *req;
+	int tag;
+
+	for (tag = 0; tag < MMC_CMDQ_MAX_TASKS; tag++) {
+		if (!(done & cmdq->busy & BIT(tag)))
+			continue;
+		task = &cmdq->task[tag];
+		req = task->req;
+		cmdq->busy &= ~BIT(tag);
+		if (failed & BIT(tag))
+			req->status = -EIO;
+		else
+			req->xfer += task->blkcnt;
+		mmc_cmdq_end(cmdq, req);
+	}
+
+	if (failed) {
+		/* Stop, so that the rest of the queue fails cleanly */
+		while (!list_empty(&cmdq->queue)) {
+			req = list_first_entry(&cmdq->queue,
+					       struct blk_request, list);
+			list_del(&req->list);
+			cmdq->issued = 0;
+			req->status = -EIO;
+			mmc_cmdq_end(cmdq, req);
+		}
+		if (!cmdq->busy)
+			return mmc_cmdq_leave(mmc, cmdq, true);
+		return 0;
+	}
+
+	mmc_cmdq_issue(mmc, cmdq);
+	if (!cmdq->busy && list_empty(&cmdq->queue))
+		return mmc_cmdq_leave(mmc, cmdq, false);
+
+	return 0;
+}
+
+int mmc_cmdq_poll(struct mmc *mmc)
+{
+	struct mmc_cmdq *cmdq = mmc->cmdq;
+	u32 done = 0, failed = 0;
+	int ret;
+
+	if (!cmdq || !cmdq->on)
+		return 0;
+
+	ret = mmc_cqe_poll(mmc, &done, &failed);
+	if (ret) {
+		log_err("%s: command queue failed: %d\n", mmc->dev->name, ret);
+		done = cmdq->busy;
+		failed = cmdq->busy;
+	} else if (cmdq->busy & ~done &&
+		   get_timer(cmdq->start) > MMC_CMDQ_TIMEOUT_MS) {
+		log_err("%s: command queue timed out\n", mmc->dev->name);
+		done = cmdq->busy;
+		failed = cmdq->busy;
+	}
+
+	return mmc_cmdq_complete(mmc, cmdq, done, failed);
+}
+
+int mmc_cmdq_off(struct mmc *mmc)
+{
+	struct mmc_cmdq *cmdq = mmc->cmdq;
+	int ret;
+
+	/* mmc_cmdq_poll() gives up on tasks which take too long */
+	while (cmdq && cmdq->on) {
+		ret = mmc_cmdq_poll(mmc);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+void mmc_cmdq_free(struct mmc *mmc)
+{
+	free(mmc->cmdq);
+	mmc->cmdq = NULL;
+}
@@ -132,4 +132,55 @@ int mmc_switch_part(struct mmc *mmc, unsigned int part_num);
  */
 int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value);
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/**
+ * mmc_cmdq_submit() - Start a block request as command queue tasks
+ *
+ * @mmc:	MMC device
+ * @req:	Request to start
+ * @return 0 if OK, -ENOSYS if the card or host cannot queue commands (the
+ *	caller must then carry out the request another way), other -ve on
+ *	error
+ */
+int mmc_cmdq_submit(struct mmc *mmc, struct blk_request *req);
+
+/**
+ * mmc_cmdq_poll() - Complete finished tasks and queue more
+ *
+ * @mmc:	MMC device
+ * @return 0 if OK, -ve on error
+ */
+int mmc_cmdq_poll(struct mmc *mmc);
+
+/**
+ * mmc_cmdq_off() - Leave command queue mode
+ *
+ * Waits for all queued requests, then switches the card and host back so that
+ * other commands can be sent. This is a no-op if they are not in command
+ * queue mode.
+ *
+ * @mmc:	MMC device
+ * @return 0 if OK, -ve on error
+ */
+int mmc_cmdq_off(struct mmc *mmc);
+
+/**
+ * mmc_cmdq_free() - Free the command queue state
+ *
+ * The card and host must not be in command queue mode; see mmc_cmdq_off().
+ *
+ * @mmc:	MMC device
+ */
+void mmc_cmdq_free(struct mmc *mmc);
+#else
+static inline int mmc_cmdq_off(struct mmc *mmc)
+{
+	return 0;
+}
+
+static inline void mmc_cmdq_free(struct mmc *mmc)
+{
+}
+#endif
+
 #endif /* _MMC_PRIVATE_H_ */
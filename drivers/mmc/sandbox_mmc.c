@@ -11,6 +11,7 @@
 #include <log.h>
 #include <mmc.h>
 #include <asm/test.h>
+#include <asm/unaligned.h>
 
 struct sandbox_mmc_plat {
 	struct mmc_config cfg;
@@ -24,14 +25,92 @@ struct sandbox_mmc_plat {
 #define MMC_CAPACITY (((MMC_CSIZE + 1) << (MMC_CMULT + 2)) \
 		      * MMC_BL_LEN) /* 1 MiB */
 
+/* Revision of the emulated eMMC: 5.1 */
+#define MMC_EXT_CSD_REV 8
+/* Tasks the eMMC can queue, and tasks the host's engine can hold */
+#define MMC_CMDQ_DEPTH 8
+#define MMC_CQE_SLOTS 4
+
+/**
+ * struct sandbox_mmc_priv - Private data for the sandbox MMC device
+ *
+ * @buf: Contents of the card
+ * @emmc: true to emulate an eMMC rather than an SD card
+ * @ext_csd: EXT_CSD register of the eMMC
+ * @cqe_on: true if the command queue engine is enabled
+ * @cqe_done: Mask of tasks which are finished but not yet polled
+ * @cqe_tasks: Number of tasks carried out by the command queue engine
+ * @cqe_stall: true to never report tasks as finished
+ */
 struct sandbox_mmc_priv {
 	u8 buf[MMC_CAPACITY];
+	bool emmc;
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	bool cqe_on;
+	u32 cqe_done;
+	int cqe_tasks;
+	bool cqe_stall;
 };
 
+/*
+ * Commands which an eMMC handles differently from an SD card. Returns
+ * -ENOENT for the others.
+ */
+static int sandbox_mmc_emmc_cmd(struct sandbox_mmc_priv *priv,
+				struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	/* In command queue mode, reads and writes must be queued as tasks */
+	if (priv->ext_csd[EXT_CSD_CMDQ_MODE_EN] &&
+	    cmd->cmdidx != MMC_CMD_SWITCH &&
+	    cmd->cmdidx != MMC_CMD_SEND_STATUS &&
+	    cmd->cmdidx != MMC_CMD_CMDQ_TASK_MGMT)
+		return -EIO;
+
+	switch (cmd->cmdidx) {
+	case MMC_CMD_ALL_SEND_CID:
+		memset(cmd->response, '\0', sizeof(cmd->response));
+		cmd->response[0] = 0x15 << 24; /* manufacturer ID */
+		break;
+	case MMC_CMD_SEND_OP_COND:
+		cmd->response[0] = OCR_BUSY | OCR_HCS;
+		break;
+	case MMC_CMD_SEND_CSD:
+		cmd->response[0] = 4 << 26; /* spec version 4 */
+		cmd->response[1] = (MMC_BL_LEN_SHIFT << 16) |
+				   ((MMC_CSIZE >> 16) & 0x3f);
+		cmd->response[2] = (MMC_CSIZE & 0xffff) << 16;
+		cmd->response[3] = 9 << 22; /* 512-byte write blocks */
+		break;
+	case MMC_CMD_SEND_EXT_CSD:
+		/* Without data this is SEND_IF_COND, which an eMMC ignores */
+		if (!data)
+			return -ETIMEDOUT;
+		memcpy(data->dest, priv->ext_csd, sizeof(priv->ext_csd));
+		break;
+	case MMC_CMD_SEND_STATUS:
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA | MMC_STATE_TRANS;
+		break;
+	case MMC_CMD_SWITCH:
+		if (cmd->cmdarg >> 24 == MMC_SWITCH_MODE_WRITE_BYTE)
+			priv->ext_csd[(cmd->cmdarg >> 16) & 0xff] =
+				(cmd->cmdarg >> 8) & 0xff;
+		break;
+	case MMC_CMD_CMDQ_TASK_MGMT:
+		break;
+	case MMC_CMD_APP_CMD:
+		return -ETIMEDOUT;
+	default:
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
 /**
  * sandbox_mmc_send_cmd() - Emulate SD commands
  *
- * This emulate an SD card version 2. Single-block reads result in zero data.
+ * This emulate an SD card version 2, or an eMMC 5.1 if requested with
+ * sandbox_mmc_set_emmc(). Single-block reads result in zero data.
  * Multiple-block reads return a test string.
  */
 static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
@@ -40,6 +119,17 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
 	struct mmc *mmc = mmc_get_mmc_dev(dev);
 	static ulong erase_start, erase_end;
+	int ret;
+
+	/* The host cannot send commands while its queue engine is on */
+	if (priv->cqe_on)
+		return -EBUSY;
+
+	if (priv->emmc) {
+		ret = sandbox_mmc_emmc_cmd(priv, cmd, data);
+		if (ret != -ENOENT)
+			return ret;
+	}
 
 	switch (cmd->cmdidx) {
 	case MMC_CMD_ALL_SEND_CID:
@@ -120,6 +210,35 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	return 0;
 }
 
+void sandbox_mmc_set_emmc(struct udevice *dev, bool emmc)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	u32 sectors = MMC_CAPACITY / MMC_MAX_BLOCK_LEN;
+
+	priv->emmc = emmc;
+	memset(priv->ext_csd, '\0', sizeof(priv->ext_csd));
+	priv->ext_csd[EXT_CSD_REV] = MMC_EXT_CSD_REV;
+	priv->ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 |
+					   EXT_CSD_CARD_TYPE_52;
+	put_unaligned_le32(sectors, &priv->ext_csd[EXT_CSD_SEC_CNT]);
+	priv->ext_csd[EXT_CSD_CMDQ_SUPPORT] = EXT_CSD_CMDQ_SUPPORTED;
+	priv->ext_csd[EXT_CSD_CMDQ_DEPTH] = MMC_CMDQ_DEPTH - 1;
+}
+
+int sandbox_mmc_get_cqe_tasks(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	return priv->cqe_tasks;
+}
+
+void sandbox_mmc_set_cqe_stall(struct udevice *dev, bool stall)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	priv->cqe_stall = stall;
+}
+
 static int sandbox_mmc_set_ios(struct udevice *dev)
 {
 	return 0;
@@ -130,10 +249,86 @@ static int sandbox_mmc_get_cd(struct udevice *dev)
 	return 1;
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/*
+ * A command queue engine which carries out each task as soon as it is
+ * queued, for an eMMC only
+ */
+static int sandbox_mmc_cqe_enable(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (!priv->emmc)
+		return -ENOSYS;
+
+	/* The card must be switched to command queue mode first */
+	if (!priv->ext_csd[EXT_CSD_CMDQ_MODE_EN])
+		return -EIO;
+	priv->cqe_on = true;
+	priv->cqe_done = 0;
+
+	return MMC_CQE_SLOTS;
+}
+
+static int sandbox_mmc_cqe_disable(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	priv->cqe_on = false;
+	priv->cqe_done = 0;
+
+	return 0;
+}
+
+static int sandbox_mmc_cqe_request(struct udevice *dev, int tag, bool write,
+				   lbaint_t start, lbaint_t blkcnt, void *buf)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	ulong offset = start * MMC_MAX_BLOCK_LEN;
+	ulong len = blkcnt * MMC_MAX_BLOCK_LEN;
+
+	if (!priv->cqe_on || tag >= MMC_CQE_SLOTS ||
+	    (priv->cqe_done & BIT(tag)))
+		return -EINVAL;
+	if (offset + len > MMC_CAPACITY)
+		return -EIO;
+
+	if (write)
+		memcpy(&priv->buf[offset], buf, len);
+	else
+		memcpy(buf, &priv->buf[offset], len);
+	priv->cqe_done |= BIT(tag);
+	priv->cqe_tasks++;
+
+	return 0;
+}
+
+static int sandbox_mmc_cqe_poll(struct udevice *dev, u32 *donep,
+				u32 *failedp)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	*donep = 0;
+	*failedp = 0;
+	if (!priv->cqe_stall) {
+		*donep = priv->cqe_done;
+		priv->cqe_done = 0;
+	}
+
+	return 0;
+}
+#endif
+
 static const struct dm_mmc_ops sandbox_mmc_ops = {
 	.send_cmd = sandbox_mmc_send_cmd,
 	.set_ios = sandbox_mmc_set_ios,
 	.get_cd = sandbox_mmc_get_cd,
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	.cqe_enable = sandbox_mmc_cqe_enable,
+	.cqe_disable = sandbox_mmc_cqe_disable,
+	.cqe_request = sandbox_mmc_cqe_request,
+	.cqe_poll = sandbox_mmc_cqe_poll,
+#endif
 };
 
 static int sandbox_mmc_of_to_plat(struct udevice *dev)
@@ -9,6 +9,7 @@
 
 #include <common.h>
 #include <cpu_func.h>
+#include <cqhci.h>
 #include <dm.h>
 #include <errno.h>
 #include <log.h>
@@ -364,6 +365,26 @@ static int sdhci_execute_tuning(struct udevice *dev, uint opcode)
 	}
 	return 0;
 }
+
+static int sdhci_get_tuning(struct udevice *dev, u32 *val)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+
+	if (host->ops && host->ops->platform_get_tuning)
+		return host->ops->platform_get_tuning(mmc, val);
+	return -ENOSYS;
+}
+
+static int sdhci_set_tuning(struct udevice *dev, u32 val)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+
+	if (host->ops && host->ops->platform_set_tuning)
+		return host->ops->platform_set_tuning(mmc, val);
+	return -ENOSYS;
+}
 #endif
 int sdhci_set_clock(struct mmc *mmc, unsigned int clock)
 {
@@ -807,6 +828,65 @@ static int sdhci_wait_dat0(struct udevice *dev, int state,
 	return -ETIMEDOUT;
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+static int sdhci_cqe_enable(struct udevice *dev)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+	u8 ctrl;
+
+	if (!host->cqhci)
+		return -ENOSYS;
+
+	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
+	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	if (host->flags & USE_ADMA64)
+		ctrl |= SDHCI_CTRL_ADMA64;
+	else
+		ctrl |= SDHCI_CTRL_ADMA32;
+	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+	sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
+					    MMC_MAX_BLOCK_LEN),
+		     SDHCI_BLOCK_SIZE);
+
+	/* Only the command queue engine's events, which are polled */
+	host->cqe_int_enable = sdhci_readl(host, SDHCI_INT_ENABLE);
+	sdhci_writel(host, SDHCI_INT_CQE | SDHCI_INT_ERROR_MASK,
+		     SDHCI_INT_ENABLE);
+
+	return cqhci_enable(host->cqhci, mmc);
+}
+
+static int sdhci_cqe_disable(struct udevice *dev)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+	int ret;
+
+	ret = cqhci_disable(host->cqhci);
+	sdhci_writel(host, host->cqe_int_enable, SDHCI_INT_ENABLE);
+
+	return ret;
+}
+
+static int sdhci_cqe_request(struct udevice *dev, int tag, bool write,
+			     lbaint_t start, lbaint_t blkcnt, void *buf)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+
+	return cqhci_request(host->cqhci, tag, write, start, blkcnt, buf);
+}
+
+static int sdhci_cqe_poll(struct udevice *dev, u32 *donep, u32 *failedp)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+
+	return cqhci_poll(host->cqhci, donep, failedp);
+}
+#endif
+
 const struct dm_mmc_ops sdhci_ops = {
 	.send_cmd	= sdhci_send_command,
 	.set_ios	= sdhci_set_ios,
@@ -814,8 +894,16 @@ const struct dm_mmc_ops sdhci_ops = {
 	.deferred_probe	= sdhci_deferred_probe,
 #ifdef MMC_SUPPORTS_TUNING
 	.execute_tuning	= sdhci_execute_tuning,
+	.get_tuning	= sdhci_get_tuning,
+	.set_tuning	= sdhci_set_tuning,
 #endif
 	.wait_dat0	= sdhci_wait_dat0,
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	.cqe_enable	= sdhci_cqe_enable,
+	.cqe_disable	= sdhci_cqe_disable,
+	.cqe_request	= sdhci_cqe_request,
+	.cqe_poll	= sdhci_cqe_poll,
+#endif
 };
 #else
 static const struct mmc_ops sdhci_ops = {
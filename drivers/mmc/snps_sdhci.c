@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0+
 #include <common.h>
+#include <cqhci.h>
 #include <dm.h>
 #include <dm/device_compat.h>
 #include <malloc.h>
@@ -55,6 +56,18 @@
 #define DWCMSHC_SDCLKDL_DC			0x0000031E
 #define DWCMSHC_SDCLKDL_DC__CCKDL_DC GENMASK(6,0)
 
+#define DWCMSHC_AT_CTRL_R			0x00000540
+#define DWCMSHC_AT_CTRL_R__SW_TUNE_EN BIT(4)
+
+#define DWCMSHC_AT_STAT_R			0x00000544
+#define DWCMSHC_AT_STAT_R__CENTER_PH_CODE GENMASK(7,0)
+
+#define DWCMSHC_TUNING_LOOP_COUNT		40
+
+/* Offset of the command queue engine's registers */
+#define DWCMSHC_P_VENDOR_AREA2			0x000000EA
+#define DWCMSHC_P_VENDOR_AREA2__PTR GENMASK(11,0)
+
 enum pad_config {
 	TXSLEW_CTRL_N = 0,
 	TXSLEW_CTRL_P = 1,
@@ -91,7 +104,11 @@ struct snps_sdhci_plat {
 	struct clk card_clk;
 	struct clk div_clk_bypass;
 	bool is_clk_divider_bypass;
+	bool has_auto_tuning;	/* AT_CTRL_R and AT_STAT_R are present */
 	hailo15_phy_config sdio_phy_config;
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	struct cqhci_host cqhci;
+#endif
 };
 
 static void sdhci_hailo15_phy_config(struct sdhci_host *host, struct udevice *dev, hailo15_phy_config* sdio_phy_config)
@@ -278,6 +295,11 @@ static int snps_sdhci_remove(struct udevice *dev) {
 	clk_disable(&plat->card_clk);
 	clk_free(&plat->card_clk);
 
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	/* Allocated again on the next probe */
+	cqhci_free(&plat->cqhci);
+#endif
+
 	return ret;
 }
 
@@ -335,9 +357,116 @@ void snps_sdhci_adma_desc(struct sdhci_adma_desc **desc,
 	sdhci_adma_desc(desc, addr, len, end);
 }
 
+#ifdef MMC_SUPPORTS_TUNING
+static int snps_sdhci_execute_tuning(struct mmc *mmc, u8 opcode)
+{
+	struct sdhci_host *host = dev_get_priv(mmc->dev);
+	int loops = DWCMSHC_TUNING_LOOP_COUNT;
+	struct mmc_cmd cmd;
+	u32 blk_size;
+	u16 ctrl;
+
+	/* Let the controller's auto-tuning find the sampling phase */
+	ctrl = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+	ctrl &= ~SDHCI_CTRL_TUNED_CLK;
+	ctrl |= SDHCI_CTRL_EXEC_TUNING;
+	sdhci_writew(host, ctrl, SDHCI_HOST_CONTROL2);
+
+	sdhci_writel(host, SDHCI_INT_DATA_AVAIL, SDHCI_INT_ENABLE);
+	sdhci_writel(host, SDHCI_INT_DATA_AVAIL, SDHCI_SIGNAL_ENABLE);
+
+	blk_size = SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG, 64);
+	if (opcode == MMC_CMD_SEND_TUNING_BLOCK_HS200 && mmc->bus_width == 8)
+		blk_size = SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG, 128);
+	sdhci_writew(host, blk_size, SDHCI_BLOCK_SIZE);
+	sdhci_writew(host, SDHCI_TRNS_READ, SDHCI_TRANSFER_MODE);
+
+	cmd.cmdidx = opcode;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
+
+	do {
+		mmc_send_cmd(mmc, &cmd, NULL);
+		ctrl = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+	} while ((ctrl & SDHCI_CTRL_EXEC_TUNING) && --loops);
+
+	sdhci_writel(host, SDHCI_INT_DATA_MASK | SDHCI_INT_CMD_MASK,
+		     SDHCI_INT_ENABLE);
+	sdhci_writel(host, 0x0, SDHCI_SIGNAL_ENABLE);
+
+	if ((ctrl & SDHCI_CTRL_EXEC_TUNING) || !(ctrl & SDHCI_CTRL_TUNED_CLK)) {
+		dev_err(mmc->dev, "tuning failed\n");
+		ctrl &= ~(SDHCI_CTRL_EXEC_TUNING | SDHCI_CTRL_TUNED_CLK);
+		sdhci_writew(host, ctrl, SDHCI_HOST_CONTROL2);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/* The tuning result is the centre of the passing sampling phases */
+static int snps_sdhci_get_tuning(struct mmc *mmc, u32 *val)
+{
+	struct snps_sdhci_plat *plat = dev_get_plat(mmc->dev);
+	struct sdhci_host *host = dev_get_priv(mmc->dev);
+
+	if (!plat->has_auto_tuning)
+		return -ENOSYS;
+	if (!(sdhci_readw(host, SDHCI_HOST_CONTROL2) & SDHCI_CTRL_TUNED_CLK))
+		return -EINVAL;
+	*val = FIELD_GET(DWCMSHC_AT_STAT_R__CENTER_PH_CODE,
+			 sdhci_readl(host, DWCMSHC_AT_STAT_R));
+
+	return 0;
+}
+
+static int snps_sdhci_set_tuning(struct mmc *mmc, u32 val)
+{
+	struct snps_sdhci_plat *plat = dev_get_plat(mmc->dev);
+	struct sdhci_host *host = dev_get_priv(mmc->dev);
+	u32 reg32;
+	u16 clk, ctrl;
+
+	if (!plat->has_auto_tuning)
+		return -ENOSYS;
+	if (!FIELD_FIT(DWCMSHC_AT_STAT_R__CENTER_PH_CODE, val))
+		return -EINVAL;
+
+	/* The phase may only be changed with the card clock stopped */
+	clk = sdhci_readw(host, SDHCI_CLOCK_CONTROL);
+	sdhci_writew(host, clk & ~SDHCI_CLOCK_CARD_EN, SDHCI_CLOCK_CONTROL);
+
+	reg32 = sdhci_readl(host, DWCMSHC_AT_CTRL_R);
+	reg32 |= DWCMSHC_AT_CTRL_R__SW_TUNE_EN;
+	sdhci_writel(host, reg32, DWCMSHC_AT_CTRL_R);
+
+	reg32 = sdhci_readl(host, DWCMSHC_AT_STAT_R);
+	reg32 &= ~DWCMSHC_AT_STAT_R__CENTER_PH_CODE;
+	reg32 |= FIELD_PREP(DWCMSHC_AT_STAT_R__CENTER_PH_CODE, val);
+	sdhci_writel(host, reg32, DWCMSHC_AT_STAT_R);
+
+	reg32 = sdhci_readl(host, DWCMSHC_AT_CTRL_R);
+	reg32 &= ~DWCMSHC_AT_CTRL_R__SW_TUNE_EN;
+	sdhci_writel(host, reg32, DWCMSHC_AT_CTRL_R);
+
+	/* Sample with the tuned clock, as after a successful tuning */
+	ctrl = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+	sdhci_writew(host, ctrl | SDHCI_CTRL_TUNED_CLK, SDHCI_HOST_CONTROL2);
+
+	sdhci_writew(host, clk, SDHCI_CLOCK_CONTROL);
+
+	return 0;
+}
+#endif
+
 static struct sdhci_ops hailo15_sdhci_ops = {
 	.set_clock_dividier = hailo_set_clock_dividier,
 	.sdhci_adma_desc = snps_sdhci_adma_desc,
+#ifdef MMC_SUPPORTS_TUNING
+	.platform_execute_tuning = snps_sdhci_execute_tuning,
+	.platform_get_tuning = snps_sdhci_get_tuning,
+	.platform_set_tuning = snps_sdhci_set_tuning,
+#endif
 };
 
 static int snps_sdhci_probe(struct udevice *dev)
@@ -404,10 +533,26 @@ static int snps_sdhci_probe(struct udevice *dev)
 		return ret;
 	}
 
+	/* Only the full DWC MSHC register map has the auto-tuning registers */
+	plat->has_auto_tuning = device_is_compatible(dev, "snps,dwcmshc-sdhci");
+
 	if (device_is_compatible(dev, "hailo,dwcmshc-sdhci-0")) {
 		// Set PIO and max block count to 1, will be removed as part of MSW-1429
 		host->flags &= ~(USE_DMA);
 	}
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	if ((host->flags & (USE_ADMA | USE_ADMA64)) &&
+	    dev_read_bool(dev, "supports-cqe")) {
+		u16 area = FIELD_GET(DWCMSHC_P_VENDOR_AREA2__PTR,
+				     sdhci_readw(host, DWCMSHC_P_VENDOR_AREA2));
+
+		ret = cqhci_init(&plat->cqhci, host->ioaddr + area,
+				 host->flags & USE_ADMA64);
+		if (ret)
+			return ret;
+		host->cqhci = &plat->cqhci;
+	}
+#endif
 	upriv->mmc = &plat->mmc;
 	host->mmc->priv = host;
 
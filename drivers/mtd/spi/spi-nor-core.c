@@ -607,12 +607,15 @@ static u8 spi_nor_convert_3to4_erase(u8 opcode)
 static void spi_nor_set_4byte_opcodes(struct spi_nor *nor,
 				      const struct flash_info *info)
 {
+	int i;
+
 	/* Do some manufacturer fixups first */
 	switch (JEDEC_MFR(info)) {
 	case SNOR_MFR_SPANSION:
 		/* No small sector erase for 4-byte command set */
 		nor->erase_opcode = SPINOR_OP_SE;
 		nor->mtd.erasesize = info->sector_size;
+		memset(nor->erase_types, '\0', sizeof(nor->erase_types));
 		break;
 
 	default:
@@ -622,6 +625,16 @@ static void spi_nor_set_4byte_opcodes(struct spi_nor *nor,
 	nor->read_opcode = spi_nor_convert_3to4_read(nor->read_opcode);
 	nor->program_opcode = spi_nor_convert_3to4_program(nor->program_opcode);
 	nor->erase_opcode = spi_nor_convert_3to4_erase(nor->erase_opcode);
+
+	/* Drop erase types which have no 4-byte address opcode */
+	for (i = 0; i < SNOR_ERASE_TYPE_MAX; i++) {
+		struct spi_nor_erase_type *type = &nor->erase_types[i];
+		u8 opcode = spi_nor_convert_3to4_erase(type->opcode);
+
+		if (opcode == type->opcode)
+			type->size = 0;
+		type->opcode = opcode;
+	}
 }
 #endif /* !CONFIG_SPI_FLASH_BAR */
 
@@ -872,24 +885,52 @@ static int read_bar(struct spi_nor *nor, const struct flash_info *info)
 }
 #endif
 
+/* Pick the largest erase type which fits at @addr without going past @len */
+static const struct spi_nor_erase_type *
+spi_nor_erase_type_at(struct spi_nor *nor, u32 addr, u32 len)
+{
+	const struct spi_nor_erase_type *best = NULL;
+	int i;
+
+	for (i = 0; i < SNOR_ERASE_TYPE_MAX; i++) {
+		const struct spi_nor_erase_type *type = &nor->erase_types[i];
+
+		if (!type->size || type->size > len ||
+		    (addr & (type->size - 1)))
+			continue;
+		if (!best || type->size > best->size)
+			best = type;
+	}
+
+	return best;
+}
+
 /*
- * Initiate the erasure of a single sector. Returns the number of bytes erased
- * on success, a negative error code on error.
+ * Erase the largest block which starts at @addr and fits in @len. Return
+ * the number of bytes erased, or -ve on error.
  */
-static int spi_nor_erase_sector(struct spi_nor *nor, u32 addr)
+static int spi_nor_erase_sector(struct spi_nor *nor, u32 addr, u32 len)
 {
+	const struct spi_nor_erase_type *type;
 	struct spi_mem_op op =
 		SPI_MEM_OP(SPI_MEM_OP_CMD(nor->erase_opcode, 0),
 			   SPI_MEM_OP_ADDR(nor->addr_width, addr, 0),
 			   SPI_MEM_OP_NO_DUMMY,
 			   SPI_MEM_OP_NO_DATA);
+	u32 size = nor->mtd.erasesize;
 	int ret;
 
-	spi_nor_setup_op(nor, &op, nor->write_proto);
-
 	if (nor->erase)
 		return nor->erase(nor, addr);
 
+	type = spi_nor_erase_type_at(nor, addr, len);
+	if (type) {
+		op.cmd.opcode = type->opcode;
+		size = type->size;
+	}
+
+	spi_nor_setup_op(nor, &op, nor->write_proto);
+
 	/*
 	 * Default implementation, if driver doesn't have a specialized HW
 	 * control
@@ -898,7 +939,7 @@ static int spi_nor_erase_sector(struct spi_nor *nor, u32 addr)
 	if (ret)
 		return ret;
 
-	return nor->mtd.erasesize;
+	return size;
 }
 
 /*
@@ -943,7 +984,7 @@ static int spi_nor_erase(struct mtd_info *mtd, struct erase_info *instr)
 		if (ret < 0)
 			goto erase_err;
 
-		ret = spi_nor_erase_sector(nor, addr);
+		ret = spi_nor_erase_sector(nor, addr, len);
 		if (ret < 0)
 			goto erase_err;
 
@@ -2182,6 +2223,7 @@ static int spi_nor_parse_bfpt(struct spi_nor *nor,
 	struct mtd_info *mtd = &nor->mtd;
 	struct sfdp_bfpt bfpt;
 	size_t len;
+	bool small_erase;
 	int i, cmd, err;
 	u32 addr;
 	u16 half;
@@ -2254,6 +2296,7 @@ static int spi_nor_parse_bfpt(struct spi_nor *nor,
 	}
 
 	/* Sector Erase settings. */
+	small_erase = false;
 	for (i = 0; i < ARRAY_SIZE(sfdp_bfpt_erases); i++) {
 		const struct sfdp_bfpt_erase *er = &sfdp_bfpt_erases[i];
 		u32 erasesize;
@@ -2268,14 +2311,18 @@ static int spi_nor_parse_bfpt(struct spi_nor *nor,
 
 		erasesize = 1U << erasesize;
 		opcode = (half >> 8) & 0xff;
+		nor->erase_types[i].size = erasesize;
+		nor->erase_types[i].opcode = opcode;
 #ifdef CONFIG_SPI_FLASH_USE_4K_SECTORS
 		if (erasesize == SZ_4K) {
 			nor->erase_opcode = opcode;
 			mtd->erasesize = erasesize;
-			break;
+			small_erase = true;
+			continue;
 		}
 #endif
-		if (!mtd->erasesize || mtd->erasesize < erasesize) {
+		if (!small_erase &&
+		    (!mtd->erasesize || mtd->erasesize < erasesize)) {
 			nor->erase_opcode = opcode;
 			mtd->erasesize = erasesize;
 		}
@@ -2723,6 +2770,7 @@ static int spi_nor_init_params(struct spi_nor *nor,
 	/* Override the parameters with data read from SFDP tables. */
 	nor->addr_width = 0;
 	nor->mtd.erasesize = 0;
+	memset(nor->erase_types, '\0', sizeof(nor->erase_types));
 	if ((info->flags & (SPI_NOR_DUAL_READ | SPI_NOR_QUAD_READ |
 	     SPI_NOR_OCTAL_DTR_READ)) &&
 	    !(info->flags & SPI_NOR_SKIP_SFDP)) {
@@ -2732,6 +2780,8 @@ static int spi_nor_init_params(struct spi_nor *nor,
 		if (spi_nor_parse_sfdp(nor, &sfdp_params)) {
 			nor->addr_width = 0;
 			nor->mtd.erasesize = 0;
+			memset(nor->erase_types, '\0',
+			       sizeof(nor->erase_types));
 		} else {
 			memcpy(params, &sfdp_params, sizeof(*params));
 		}
@@ -3052,6 +3102,14 @@ static int spi_nor_select_erase(struct spi_nor *nor,
 	if (info->flags & SECT_4K) {
 		nor->erase_opcode = SPINOR_OP_BE_4K;
 		mtd->erasesize = 4096;
+
+		/* whole sectors can still be erased at once */
+		nor->erase_types[0].size = SZ_4K;
+		nor->erase_types[0].opcode = SPINOR_OP_BE_4K;
+		if (is_power_of_2(info->sector_size)) {
+			nor->erase_types[1].size = info->sector_size;
+			nor->erase_types[1].opcode = SPINOR_OP_SE;
+		}
 	} else if (info->flags & SECT_4K_PMC) {
 		nor->erase_opcode = SPINOR_OP_BE_4K_PMC;
 		mtd->erasesize = 4096;
@@ -3064,6 +3122,23 @@ static int spi_nor_select_erase(struct spi_nor *nor,
 	return 0;
 }
 
+/*
+ * Only keep the erase types if the erase command chosen for the flash is one
+ * of them: fixups which pick another one know better.
+ */
+static void spi_nor_check_erase_types(struct spi_nor *nor)
+{
+	int i;
+
+	for (i = 0; i < SNOR_ERASE_TYPE_MAX; i++) {
+		if (nor->erase_types[i].size == nor->mtd.erasesize &&
+		    nor->erase_types[i].opcode == nor->erase_opcode)
+			return;
+	}
+
+	memset(nor->erase_types, '\0', sizeof(nor->erase_types));
+}
+
 static int spi_nor_default_setup(struct spi_nor *nor,
 				 const struct flash_info *info,
 				 const struct spi_nor_flash_parameter *params)
@@ -3864,6 +3939,8 @@ int spi_nor_scan(struct spi_nor *nor)
 		return -EINVAL;
 	}
 
+	spi_nor_check_erase_types(nor);
+
 	/* Send all the required SPI flash commands to initialize device */
 	ret = spi_nor_init(nor);
 	if (ret)
@@ -41,6 +41,7 @@
 #include <miiphy.h>
 
 #include <linux/mii.h>
+#include <asm/cache.h>
 #include <asm/io.h>
 #include <linux/dma-mapping.h>
 #include <asm/arch/clk.h>
@@ -61,7 +62,9 @@ DECLARE_GLOBAL_DATA_PTR;
 #define RX_BUFFER_MULTIPLE		64
 
 #define MACB_RX_RING_SIZE		32
-#define MACB_TX_RING_SIZE		16
+#define MACB_TX_RING_SIZE		32
+/* Each frame in the TX ring is copied to a buffer of this size */
+#define MACB_TX_BUFFER_SIZE		PKTSIZE_ALIGN
 
 #define MACB_TX_TIMEOUT		1000
 #define MACB_AUTONEG_TIMEOUT	5000000
@@ -115,10 +118,14 @@ struct macb_device {
 	const struct macb_config *config;
 
 	unsigned int		rx_tail;
+	/* Descriptors from rx_tail seen used, with their buffers invalidated */
+	unsigned int		rx_ready;
+	/* Frames queued and completed in the TX ring (free-running) */
 	unsigned int		tx_head;
 	unsigned int		tx_tail;
 	unsigned int		next_rx_tail;
-	bool			wrapped;
+	/* Most frames in the TX ring at once */
+	unsigned int		tx_max;
 
 	void			*rx_buffer;
 	void			*tx_buffer;
@@ -127,9 +134,12 @@ struct macb_device {
 	size_t			rx_buffer_size;
 
 	unsigned long		rx_buffer_dma;
+	unsigned long		tx_buffer_dma;
 	unsigned long		rx_ring_dma;
 	unsigned long		tx_ring_dma;
 
+	struct eth_stats	stats;
+
 	struct macb_dma_desc	*dummy_desc;
 	unsigned long		dummy_desc_dma;
 
@@ -344,11 +354,36 @@ static inline void macb_flush_rx_buffer(struct macb_device *macb)
 				 PKTALIGN));
 }
 
-static inline void macb_invalidate_rx_buffer(struct macb_device *macb)
+/* Invalidate the buffers of @count RX descriptors starting at @idx */
+static inline void macb_invalidate_rx_buffers(struct macb_device *macb,
+					      unsigned int idx,
+					      unsigned int count)
 {
-	invalidate_dcache_range(macb->rx_buffer_dma, macb->rx_buffer_dma +
-				ALIGN(macb->rx_buffer_size * MACB_RX_RING_SIZE,
-				      PKTALIGN));
+	unsigned long start = macb->rx_buffer_dma + macb->rx_buffer_size * idx;
+	unsigned int n = min(count, MACB_RX_RING_SIZE - idx);
+
+	invalidate_dcache_range(start, start + macb->rx_buffer_size * n);
+	if (n < count)
+		invalidate_dcache_range(macb->rx_buffer_dma, macb->rx_buffer_dma +
+					macb->rx_buffer_size * (count - n));
+}
+
+static inline struct macb_dma_desc *macb_rx_desc(struct macb_device *macb,
+						 unsigned int idx)
+{
+	if (macb->config->hw_dma_cap & HW_DMA_CAP_64B)
+		idx *= 2;
+
+	return &macb->rx_ring[idx];
+}
+
+static inline struct macb_dma_desc *macb_tx_desc(struct macb_device *macb,
+						 unsigned int idx)
+{
+	if (macb->config->hw_dma_cap & HW_DMA_CAP_64B)
+		idx *= 2;
+
+	return &macb->tx_ring[idx];
 }
 
 #if defined(CONFIG_CMD_NET)
@@ -371,59 +406,181 @@ static void macb_set_addr(struct macb_device *macb, struct macb_dma_desc *desc,
 	desc->addr = lower_32_bits(addr);
 }
 
-static int _macb_send(struct macb_device *macb, const char *name, void *packet,
-		      int length)
+/*
+ * A TX descriptor shares its cacheline with others. Writing it back could
+ * overwrite the controller's update of another frame's descriptor, so TX
+ * descriptors are kept in uncached memory if there is any. Otherwise only one
+ * frame is in the ring at a time, and these write back or discard the
+ * descriptor's cacheline while the controller is not using it.
+ */
+static void macb_flush_tx_desc(struct macb_device *macb, unsigned int idx)
+{
+#ifndef CONFIG_SYS_NONCACHED_MEMORY
+	unsigned long start = (unsigned long)macb_tx_desc(macb, idx);
+	unsigned long end = (unsigned long)macb_tx_desc(macb, idx + 1);
+
+	flush_dcache_range(start & ~(ARCH_DMA_MINALIGN - 1),
+			   ALIGN(end, ARCH_DMA_MINALIGN));
+#endif
+}
+
+static void macb_invalidate_tx_desc(struct macb_device *macb,
+				    unsigned int idx)
 {
-	unsigned long paddr, ctrl;
-	unsigned int tx_head = macb->tx_head;
+#ifndef CONFIG_SYS_NONCACHED_MEMORY
+	unsigned long start = (unsigned long)macb_tx_desc(macb, idx);
+	unsigned long end = (unsigned long)macb_tx_desc(macb, idx + 1);
+
+	invalidate_dcache_range(start & ~(ARCH_DMA_MINALIGN - 1),
+				ALIGN(end, ARCH_DMA_MINALIGN));
+#endif
+}
+
+/* Mark every TX descriptor as sent, so that the controller stops at once */
+static void macb_init_tx_ring(struct macb_device *macb)
+{
+	struct macb_dma_desc *desc;
 	int i;
 
-	paddr = dma_map_single(packet, length, DMA_TO_DEVICE);
+	for (i = 0; i < MACB_TX_RING_SIZE; i++) {
+		desc = macb_tx_desc(macb, i);
+		macb_set_addr(macb, desc, 0);
+		if (i == (MACB_TX_RING_SIZE - 1))
+			desc->ctrl = MACB_BIT(TX_USED) | MACB_BIT(TX_WRAP);
+		else
+			desc->ctrl = MACB_BIT(TX_USED);
+	}
+	macb_flush_ring_desc(macb, TX);
 
-	ctrl = length & TXBUF_FRMLEN_MASK;
-	ctrl |= MACB_BIT(TX_LAST);
-	if (tx_head == (MACB_TX_RING_SIZE - 1)) {
-		ctrl |= MACB_BIT(TX_WRAP);
-		macb->tx_head = 0;
-	} else {
-		macb->tx_head++;
+	macb->tx_head = 0;
+	macb->tx_tail = 0;
+}
+
+/* Collect the status of frames which the controller has finished sending */
+static void macb_tx_reclaim(struct macb_device *macb, const char *name)
+{
+	unsigned int idx;
+	u32 ctrl;
+
+	while (macb->tx_tail != macb->tx_head) {
+		idx = macb->tx_tail % MACB_TX_RING_SIZE;
+		macb_invalidate_tx_desc(macb, idx);
+		ctrl = macb_tx_desc(macb, idx)->ctrl;
+		if (!(ctrl & MACB_BIT(TX_USED)))
+			break;
+
+		if (ctrl & MACB_BIT(TX_UNDERRUN)) {
+			printf("%s: TX underrun\n", name);
+			macb->stats.tx_errors++;
+		}
+		if (ctrl & MACB_BIT(TX_BUF_EXHAUSTED)) {
+			printf("%s: TX buffers exhausted in mid frame\n", name);
+			macb->stats.tx_errors++;
+		}
+		macb->tx_tail++;
 	}
+}
 
+/*
+ * Stop the controller sending and drop the frames in the TX ring. Turning TX
+ * off takes the controller back to the start of the ring.
+ */
+static void macb_tx_reset(struct macb_device *macb)
+{
+	u32 ncr = macb_readl(macb, NCR);
+	int i;
+
+	macb_writel(macb, NCR, ncr | MACB_BIT(THALT));
+	for (i = 0; i <= MACB_TX_TIMEOUT; i++) {
+		if (!(macb_readl(macb, TSR) & MACB_BIT(TGO)))
+			break;
+		udelay(1);
+	}
+	macb_writel(macb, NCR, ncr & ~MACB_BIT(TE));
+
+	macb_init_tx_ring(macb);
+	macb_writel(macb, TBQP, lower_32_bits(macb->tx_ring_dma));
 	if (macb->config->hw_dma_cap & HW_DMA_CAP_64B)
-		tx_head = tx_head * 2;
+		macb_writel(macb, TBQPH, upper_32_bits(macb->tx_ring_dma));
 
-	macb->tx_ring[tx_head].ctrl = ctrl;
-	macb_set_addr(macb, &macb->tx_ring[tx_head], paddr);
+	macb_writel(macb, NCR, ncr | MACB_BIT(TE));
+}
 
-	barrier();
-	macb_flush_ring_desc(macb, TX);
-	macb_writel(macb, NCR, MACB_BIT(TE) | MACB_BIT(RE) | MACB_BIT(TSTART));
+/*
+ * Wait until fewer than @max frames are in flight. The controller stops when
+ * it finds a descriptor it has already sent, which can race with a new frame
+ * being queued behind it, so start it again if it went idle early.
+ */
+static void macb_tx_wait(struct macb_device *macb, const char *name,
+			 unsigned int max)
+{
+	int i;
 
-	/*
-	 * I guess this is necessary because the networking core may
-	 * re-use the transmit buffer as soon as we return...
-	 */
 	for (i = 0; i <= MACB_TX_TIMEOUT; i++) {
-		barrier();
-		macb_invalidate_ring_desc(macb, TX);
-		ctrl = macb->tx_ring[tx_head].ctrl;
-		if (ctrl & MACB_BIT(TX_USED))
-			break;
+		macb_tx_reclaim(macb, name);
+		if (macb->tx_head - macb->tx_tail < max)
+			return;
+		if (!(macb_readl(macb, TSR) & MACB_BIT(TGO)))
+			macb_writel(macb, NCR, MACB_BIT(TE) | MACB_BIT(RE) |
+				    MACB_BIT(TSTART));
 		udelay(1);
 	}
 
-	dma_unmap_single(paddr, length, DMA_TO_DEVICE);
+	/* The oldest frame is stuck, so start again with an empty ring */
+	printf("%s: TX timeout\n", name);
+	macb->stats.tx_errors += macb->tx_head - macb->tx_tail;
+	macb_tx_reset(macb);
+}
 
-	if (i <= MACB_TX_TIMEOUT) {
-		if (ctrl & MACB_BIT(TX_UNDERRUN))
-			printf("%s: TX underrun\n", name);
-		if (ctrl & MACB_BIT(TX_BUF_EXHAUSTED))
-			printf("%s: TX buffers exhausted in mid frame\n", name);
-	} else {
-		printf("%s: TX timeout\n", name);
+/*
+ * Frames are copied to a buffer of their own and queued without waiting for
+ * the controller to send them, so that the caller can carry on while they go
+ * out. Each frame takes one descriptor.
+ */
+static int _macb_send(struct macb_device *macb, const char *name, void *packet,
+		      int length)
+{
+	struct macb_dma_desc *desc;
+	unsigned long paddr, offset;
+	unsigned int idx;
+	void *buf;
+	u32 ctrl;
+
+	if (length > MACB_TX_BUFFER_SIZE) {
+		macb->stats.tx_errors++;
+		return -EMSGSIZE;
+	}
+
+	macb_tx_reclaim(macb, name);
+	if (macb->tx_head - macb->tx_tail >= macb->tx_max) {
+		macb->stats.tx_busy++;
+		macb_tx_wait(macb, name, macb->tx_max);
 	}
 
-	/* No one cares anyway */
+	idx = macb->tx_head % MACB_TX_RING_SIZE;
+	offset = (idx % macb->tx_max) * MACB_TX_BUFFER_SIZE;
+	buf = macb->tx_buffer + offset;
+	paddr = macb->tx_buffer_dma + offset;
+	memcpy(buf, packet, length);
+	flush_dcache_range(paddr, paddr + ALIGN(length, ARCH_DMA_MINALIGN));
+
+	ctrl = length & TXBUF_FRMLEN_MASK;
+	ctrl |= MACB_BIT(TX_LAST);
+	if (idx == MACB_TX_RING_SIZE - 1)
+		ctrl |= MACB_BIT(TX_WRAP);
+
+	desc = macb_tx_desc(macb, idx);
+	macb_set_addr(macb, desc, paddr);
+	desc->ctrl = ctrl;
+
+	barrier();
+	macb_flush_tx_desc(macb, idx);
+	macb_writel(macb, NCR, MACB_BIT(TE) | MACB_BIT(RE) | MACB_BIT(TSTART));
+	macb->tx_head++;
+
+	macb->stats.tx_packets++;
+	macb->stats.tx_bytes += length;
+
 	return 0;
 }
 
@@ -458,107 +615,122 @@ static void reclaim_rx_buffer(struct macb_device *macb,
 
 	for (i = idx & (~mask); i <= idx; i++)
 		macb->rx_ring[i << shift].addr &= ~MACB_BIT(RX_USED);
+
+	/* Hand just this cacheline back to the controller */
+	barrier();
+	flush_dcache_range((unsigned long)macb_rx_desc(macb, idx & ~mask),
+			   (unsigned long)macb_rx_desc(macb, idx + 1));
 }
 
 static void reclaim_rx_buffers(struct macb_device *macb,
 			       unsigned int new_tail)
 {
-	unsigned int i;
+	unsigned int i = macb->rx_tail;
+	unsigned int count = 0;
 
-	i = macb->rx_tail;
-
-	macb_invalidate_ring_desc(macb, RX);
-	while (i > new_tail) {
+	while (i != new_tail) {
 		reclaim_rx_buffer(macb, i);
-		i++;
-		if (i >= MACB_RX_RING_SIZE)
+		if (++i >= MACB_RX_RING_SIZE)
 			i = 0;
+		count++;
 	}
 
-	while (i < new_tail) {
-		reclaim_rx_buffer(macb, i);
-		i++;
-	}
-
-	barrier();
-	macb_flush_ring_desc(macb, RX);
 	macb->rx_tail = new_tail;
+	macb->rx_ready -= min(count, macb->rx_ready);
 }
 
-static int _macb_recv(struct macb_device *macb, uchar **packetp)
+/*
+ * Find the descriptors which the controller has filled since last time. This
+ * takes one cache operation on the ring and one on the buffers (two if they
+ * wrap), however many frames have arrived.
+ */
+static void macb_rx_sync(struct macb_device *macb)
 {
-	unsigned int next_rx_tail = macb->next_rx_tail;
-	void *buffer;
-	int length;
-	u32 status;
-	u8 flag = false;
-
-	macb->wrapped = false;
-	for (;;) {
-		macb_invalidate_ring_desc(macb, RX);
+	unsigned int mask, max, idx, n;
 
-		if (macb->config->hw_dma_cap & HW_DMA_CAP_64B)
-			next_rx_tail = next_rx_tail * 2;
+	if (macb->config->hw_dma_cap & HW_DMA_CAP_64B)
+		mask = DESC_PER_CACHELINE_64 - 1;
+	else
+		mask = DESC_PER_CACHELINE_32 - 1;
 
-		if (!(macb->rx_ring[next_rx_tail].addr & MACB_BIT(RX_USED)))
-			return -EAGAIN;
+	/*
+	 * Descriptors before rx_tail in its cacheline are used but not yet
+	 * handed back, so must not be taken for new ones
+	 */
+	max = MACB_RX_RING_SIZE - (macb->rx_tail & mask);
 
-		status = macb->rx_ring[next_rx_tail].ctrl;
-		if (status & MACB_BIT(RX_SOF)) {
-			if (macb->config->hw_dma_cap & HW_DMA_CAP_64B) {
-				next_rx_tail = next_rx_tail / 2;
-				flag = true;
-			}
+	macb_invalidate_ring_desc(macb, RX);
+	for (n = macb->rx_ready; n < max; n++) {
+		idx = (macb->rx_tail + n) % MACB_RX_RING_SIZE;
+		if (!(macb_rx_desc(macb, idx)->addr & MACB_BIT(RX_USED)))
+			break;
+	}
+	if (n > macb->rx_ready)
+		macb_invalidate_rx_buffers(macb, (macb->rx_tail +
+					   macb->rx_ready) % MACB_RX_RING_SIZE,
+					   n - macb->rx_ready);
+	macb->rx_ready = n;
+}
 
-			if (next_rx_tail != macb->rx_tail)
-				reclaim_rx_buffers(macb, next_rx_tail);
-			macb->wrapped = false;
+/*
+ * Return the next frame among the descriptors found by macb_rx_sync(). Once
+ * the caller is done with it, reclaim_rx_buffers(macb, macb->next_rx_tail)
+ * gives its buffers back to the controller.
+ */
+static int _macb_recv(struct macb_device *macb, uchar **packetp)
+{
+	unsigned int headlen, n, idx;
+	void *buffer;
+	int length;
+	u32 status;
+	bool sof;
+
+	n = 0;
+	while (n < macb->rx_ready) {
+		idx = (macb->rx_tail + n) % MACB_RX_RING_SIZE;
+		status = macb_rx_desc(macb, idx)->ctrl;
+		length = status & RXBUF_FRMLEN_MASK;
+
+		/* Drop anything which is not part of a whole frame */
+		sof = status & MACB_BIT(RX_SOF);
+		if (sof != !n) {
+			macb->stats.rx_errors++;
+			reclaim_rx_buffers(macb, n ? idx :
+					   (idx + 1) % MACB_RX_RING_SIZE);
+			n = 0;
+			continue;
+		}
+		if (!(status & MACB_BIT(RX_EOF))) {
+			n++;
+			continue;
+		}
+		if (length > macb->rx_buffer_size * (n + 1)) {
+			macb->stats.rx_errors++;
+			reclaim_rx_buffers(macb, (idx + 1) % MACB_RX_RING_SIZE);
+			n = 0;
+			continue;
 		}
 
-		if (status & MACB_BIT(RX_EOF)) {
-			buffer = macb->rx_buffer +
-				macb->rx_buffer_size * macb->rx_tail;
-			length = status & RXBUF_FRMLEN_MASK;
-
-			macb_invalidate_rx_buffer(macb);
-			if (macb->wrapped) {
-				unsigned int headlen, taillen;
-
-				headlen = macb->rx_buffer_size *
-					(MACB_RX_RING_SIZE - macb->rx_tail);
-				taillen = length - headlen;
-				memcpy((void *)net_rx_packets[0],
-				       buffer, headlen);
-				memcpy((void *)net_rx_packets[0] + headlen,
-				       macb->rx_buffer, taillen);
-				*packetp = (void *)net_rx_packets[0];
-			} else {
-				*packetp = buffer;
-			}
-
-			if (macb->config->hw_dma_cap & HW_DMA_CAP_64B) {
-				if (!flag)
-					next_rx_tail = next_rx_tail / 2;
-			}
-
-			if (++next_rx_tail >= MACB_RX_RING_SIZE)
-				next_rx_tail = 0;
-			macb->next_rx_tail = next_rx_tail;
-			return length;
+		buffer = macb->rx_buffer + macb->rx_buffer_size * macb->rx_tail;
+		headlen = macb->rx_buffer_size *
+			(MACB_RX_RING_SIZE - macb->rx_tail);
+		if (length > headlen) {
+			memcpy((void *)net_rx_packets[0], buffer, headlen);
+			memcpy((void *)net_rx_packets[0] + headlen,
+			       macb->rx_buffer, length - headlen);
+			*packetp = (void *)net_rx_packets[0];
 		} else {
-			if (macb->config->hw_dma_cap & HW_DMA_CAP_64B) {
-				if (!flag)
-					next_rx_tail = next_rx_tail / 2;
-				flag = false;
-			}
-
-			if (++next_rx_tail >= MACB_RX_RING_SIZE) {
-				macb->wrapped = true;
-				next_rx_tail = 0;
-			}
+			*packetp = buffer;
 		}
-		barrier();
+
+		macb->next_rx_tail = (idx + 1) % MACB_RX_RING_SIZE;
+		macb->stats.rx_packets++;
+		macb->stats.rx_bytes += length;
+
+		return length;
 	}
+
+	return -EAGAIN;
 }
 
 static void macb_phy_reset(struct macb_device *macb, const char *name)
@@ -1096,23 +1268,10 @@ static int _macb_init(struct macb_device *macb, const char *name)
 	macb_flush_ring_desc(macb, RX);
 	macb_flush_rx_buffer(macb);
 
-	for (i = 0; i < MACB_TX_RING_SIZE; i++) {
-		if (macb->config->hw_dma_cap & HW_DMA_CAP_64B)
-			count = i * 2;
-		else
-			count = i;
-		macb_set_addr(macb, &macb->tx_ring[count], 0);
-		if (i == (MACB_TX_RING_SIZE - 1))
-			macb->tx_ring[count].ctrl = MACB_BIT(TX_USED) |
-				MACB_BIT(TX_WRAP);
-		else
-			macb->tx_ring[count].ctrl = MACB_BIT(TX_USED);
-	}
-	macb_flush_ring_desc(macb, TX);
+	macb_init_tx_ring(macb);
 
 	macb->rx_tail = 0;
-	macb->tx_head = 0;
-	macb->tx_tail = 0;
+	macb->rx_ready = 0;
 	macb->next_rx_tail = 0;
 
 #ifdef CONFIG_MACB_ZYNQ
@@ -1221,6 +1380,10 @@ static void _macb_halt(struct macb_device *macb)
 	u32 ncr, tsr;
 	int i;
 
+	/* Let frames still queued go out */
+	if (macb->tx_head != macb->tx_tail)
+		macb_tx_wait(macb, "macb", 1);
+
 	/* Halt the controller and wait for any ongoing transmission to end. */
 	ncr = macb_readl(macb, NCR);
 	ncr |= MACB_BIT(THALT);
@@ -1341,8 +1504,19 @@ static void _macb_eth_initialize(struct macb_device *macb)
 					     &macb->rx_buffer_dma);
 	macb->rx_ring = dma_alloc_coherent(MACB_RX_DMA_DESC_SIZE,
 					   &macb->rx_ring_dma);
+#ifdef CONFIG_SYS_NONCACHED_MEMORY
+	macb->tx_ring_dma = noncached_alloc(MACB_TX_DMA_DESC_SIZE,
+					    ARCH_DMA_MINALIGN);
+	macb->tx_ring = (void *)macb->tx_ring_dma;
+	macb->tx_max = MACB_TX_RING_SIZE;
+#else
 	macb->tx_ring = dma_alloc_coherent(MACB_TX_DMA_DESC_SIZE,
 					   &macb->tx_ring_dma);
+	macb->tx_max = 1;
+#endif
+	macb->tx_buffer = dma_alloc_coherent(MACB_TX_BUFFER_SIZE *
+					     macb->tx_max,
+					     &macb->tx_buffer_dma);
 	macb->dummy_desc = dma_alloc_coherent(MACB_TX_DUMMY_DMA_DESC_SIZE,
 					   &macb->dummy_desc_dma);
 
@@ -1374,7 +1548,7 @@ static int macb_recv(struct eth_device *netdev)
 	uchar *packet;
 	int length;
 
-	macb->wrapped = false;
+	macb_rx_sync(macb);
 	for (;;) {
 		macb->next_rx_tail = macb->rx_tail;
 		length = _macb_recv(macb, &packet);
@@ -1488,8 +1662,10 @@ static int macb_recv(struct udevice *dev, int flags, uchar **packetp)
 {
 	struct macb_device *macb = dev_get_priv(dev);
 
+	/* Frames found at the start of a poll are returned one by one */
+	if (flags & ETH_RECV_CHECK_DEVICE)
+		macb_rx_sync(macb);
 	macb->next_rx_tail = macb->rx_tail;
-	macb->wrapped = false;
 
 	return _macb_recv(macb, packetp);
 }
@@ -1503,6 +1679,15 @@ static int macb_free_pkt(struct udevice *dev, uchar *packet, int length)
 	return 0;
 }
 
+static int macb_get_stats(struct udevice *dev, struct eth_stats *stats)
+{
+	struct macb_device *macb = dev_get_priv(dev);
+
+	*stats = macb->stats;
+
+	return 0;
+}
+
 static void macb_stop(struct udevice *dev)
 {
 	struct macb_device *macb = dev_get_priv(dev);
@@ -1535,6 +1720,7 @@ static const struct eth_ops macb_eth_ops = {
 	.stop	= macb_stop,
 	.free_pkt	= macb_free_pkt,
 	.write_hwaddr	= macb_write_hwaddr,
+	.get_stats	= macb_get_stats,
 };
 
 #ifdef CONFIG_CLK
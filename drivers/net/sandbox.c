@@ -344,6 +344,9 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 	if (priv->disabled)
 		return 0;
 
+	priv->stats.tx_packets++;
+	priv->stats.tx_bytes += length;
+
 	return priv->tx_handler(dev, packet, length);
 }
 
@@ -362,6 +365,8 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		debug("eth_sandbox: received packet[%d], %d waiting\n",
 		      lcl_recv_packet_length, priv->recv_packets - 1);
 		*packetp = priv->recv_packet_buffer[0];
+		priv->stats.rx_packets++;
+		priv->stats.rx_bytes += lcl_recv_packet_length;
 		return lcl_recv_packet_length;
 	}
 	return 0;
@@ -387,6 +392,15 @@ static int sb_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 	return 0;
 }
 
+static int sb_eth_get_stats(struct udevice *dev, struct eth_stats *stats)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	*stats = priv->stats;
+
+	return 0;
+}
+
 static void sb_eth_stop(struct udevice *dev)
 {
 	debug("eth_sandbox: Stop\n");
@@ -408,6 +422,7 @@ static const struct eth_ops sb_eth_ops = {
 	.free_pkt		= sb_eth_free_pkt,
 	.stop			= sb_eth_stop,
 	.write_hwaddr		= sb_eth_write_hwaddr,
+	.get_stats		= sb_eth_get_stats,
 };
 
 static int sb_eth_remove(struct udevice *dev)
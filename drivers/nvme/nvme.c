@@ -180,47 +180,29 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 	nvmeq->sq_tail = tail;
 }
 
-static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
-				struct nvme_command *cmd,
-				u32 *result, unsigned timeout)
+/**
+ * nvme_check_completion() - consume the next completion queue entry, if any
+ *
+ * @nvmeq:	The queue to check
+ * @result:	Returns the command-specific result, if not NULL
+ * @return 0 if a command completed successfully, -EIO if it completed with
+ * an error, -EAGAIN if there is no new completion yet
+ */
+static int nvme_check_completion(struct nvme_queue *nvmeq, u32 *result)
 {
 	u16 head = nvmeq->cq_head;
 	u16 phase = nvmeq->cq_phase;
 	u16 status;
-	ulong start_time;
-	ulong timeout_us = timeout * 100000;
-
-	cmd->common.command_id = nvme_get_cmd_id();
-	nvme_submit_cmd(nvmeq, cmd);
-
-	start_time = timer_get_us();
 
-	for (;;) {
-		status = nvme_read_completion_status(nvmeq, head);
-		if ((status & 0x01) == phase)
-			break;
-		if (timeout_us > 0 && (timer_get_us() - start_time)
-		    >= timeout_us)
-			return -ETIMEDOUT;
-	}
+	status = nvme_read_completion_status(nvmeq, head);
+	if ((status & 0x01) != phase)
+		return -EAGAIN;
 
 	status >>= 1;
-	if (status) {
+	if (status)
 		printf("ERROR: status = %x, phase = %d, head = %d\n",
 		       status, phase, head);
-		status = 0;
-		if (++head == nvmeq->q_depth) {
-			head = 0;
-			phase = !phase;
-		}
-		writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
-		nvmeq->cq_head = head;
-		nvmeq->cq_phase = phase;
-
-		return -EIO;
-	}
-
-	if (result)
+	else if (result)
 		*result = readl(&(nvmeq->cqes[head].result));
 
 	if (++head == nvmeq->q_depth) {
@@ -231,7 +213,30 @@ static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 	nvmeq->cq_head = head;
 	nvmeq->cq_phase = phase;
 
-	return status;
+	return status ? -EIO : 0;
+}
+
+static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
+				struct nvme_command *cmd,
+				u32 *result, unsigned timeout)
+{
+	ulong start_time;
+	ulong timeout_us = timeout * 100000;
+	int ret;
+
+	cmd->common.command_id = nvme_get_cmd_id();
+	nvme_submit_cmd(nvmeq, cmd);
+
+	start_time = timer_get_us();
+
+	for (;;) {
+		ret = nvme_check_completion(nvmeq, result);
+		if (ret != -EAGAIN)
+			return ret;
+		if (timeout_us > 0 && (timer_get_us() - start_time)
+		    >= timeout_us)
+			return -ETIMEDOUT;
+	}
 }
 
 static int nvme_submit_admin_cmd(struct nvme_dev *dev, struct nvme_command *cmd,
@@ -732,6 +737,116 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
+static void nvme_blk_rw_setup(struct nvme_ns *ns, struct nvme_command *c,
+			      bool read)
+{
+	c->rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
+	c->rw.flags = 0;
+	c->rw.nsid = cpu_to_le32(ns->ns_id);
+	c->rw.control = 0;
+	c->rw.dsmgmt = 0;
+	c->rw.reftag = 0;
+	c->rw.apptag = 0;
+	c->rw.appmask = 0;
+	c->rw.metadata = 0;
+}
+
+/**
+ * nvme_io_reap() - check whether the asynchronous command in flight is done
+ *
+ * On completion this advances the active request, completing it once all
+ * its blocks are transferred or on error. It does not issue a new command.
+ *
+ * @dev:	NVMe controller
+ * @return 0 if no command is in flight any more, -EAGAIN if it is still
+ * running
+ */
+static int nvme_io_reap(struct nvme_dev *dev)
+{
+	struct blk_request *req;
+	struct nvme_ns *ns;
+	ulong buf;
+	int ret;
+
+	if (!dev->io_lbas)
+		return 0;
+
+	ret = nvme_check_completion(dev->queues[NVME_IO_Q], NULL);
+	if (ret == -EAGAIN) {
+		if (timer_get_us() - dev->io_start < IO_TIMEOUT * 100000)
+			return -EAGAIN;
+		ret = -ETIMEDOUT;
+	}
+
+	req = list_first_entry(&dev->io_reqs, struct blk_request, list);
+	ns = dev_get_priv(req->dev);
+	if (!ret) {
+		if (req->op == BLK_REQ_READ) {
+			buf = (ulong)req->buffer + (req->xfer << ns->lba_shift);
+			invalidate_dcache_range(buf, buf + ((ulong)dev->io_lbas <<
+							    ns->lba_shift));
+		}
+		req->xfer += dev->io_lbas;
+	}
+	dev->io_lbas = 0;
+
+	if (ret || req->xfer == req->blkcnt) {
+		list_del(&req->list);
+		blk_request_done(req, ret);
+	}
+
+	return 0;
+}
+
+/**
+ * nvme_io_issue() - start the next command for the asynchronous requests
+ *
+ * The I/O queue only holds a single command, so this does nothing while a
+ * command is in flight.
+ *
+ * @dev:	NVMe controller
+ */
+static void nvme_io_issue(struct nvme_dev *dev)
+{
+	struct blk_request *req;
+	struct nvme_command c;
+	struct nvme_ns *ns;
+	uintptr_t buf;
+	u64 prp2;
+	u16 lbas;
+
+	while (!dev->io_lbas && !list_empty(&dev->io_reqs)) {
+		req = list_first_entry(&dev->io_reqs, struct blk_request,
+				       list);
+		ns = dev_get_priv(req->dev);
+		if (req->xfer == req->blkcnt) {
+			list_del(&req->list);
+			blk_request_done(req, 0);
+			continue;
+		}
+
+		lbas = min_t(u64, req->blkcnt - req->xfer,
+			     1 << (dev->max_transfer_shift - ns->lba_shift));
+		buf = (uintptr_t)req->buffer + (req->xfer << ns->lba_shift);
+		flush_dcache_range(buf, buf + ((ulong)lbas << ns->lba_shift));
+		if (nvme_setup_prps(dev, &prp2, lbas << ns->lba_shift, buf)) {
+			list_del(&req->list);
+			blk_request_done(req, -EIO);
+			continue;
+		}
+
+		nvme_blk_rw_setup(ns, &c, req->op == BLK_REQ_READ);
+		c.rw.slba = cpu_to_le64(req->start + req->xfer);
+		c.rw.length = cpu_to_le16(lbas - 1);
+		c.rw.prp1 = cpu_to_le64(buf);
+		c.rw.prp2 = cpu_to_le64(prp2);
+		c.common.command_id = nvme_get_cmd_id();
+		nvme_submit_cmd(dev->queues[NVME_IO_Q], &c);
+		dev->io_lbas = lbas;
+		dev->io_start = timer_get_us();
+	}
+}
+
 static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			 lbaint_t blkcnt, void *buffer, bool read)
 {
@@ -749,18 +864,14 @@ static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
 	u64 total_lbas = blkcnt;
 
+	/* let any asynchronous command finish before taking the queue */
+	while (nvme_io_reap(dev) == -EAGAIN)
+		;
+
 	flush_dcache_range((unsigned long)buffer,
 			   (unsigned long)buffer + total_len);
 
-	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
-	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
+	nvme_blk_rw_setup(ns, &c, read);
 
 	while (total_lbas) {
 		if (total_lbas < lbas) {
@@ -805,9 +916,31 @@ static ulong nvme_blk_write(struct udevice *udev, lbaint_t blknr,
 	return nvme_blk_rw(udev, blknr, blkcnt, (void *)buffer, false);
 }
 
+static int nvme_blk_submit(struct udevice *udev, struct blk_request *req)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	list_add_tail(&req->list, &ns->dev->io_reqs);
+	nvme_io_issue(ns->dev);
+
+	return 0;
+}
+
+static int nvme_blk_poll(struct udevice *udev)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	if (nvme_io_reap(ns->dev) != -EAGAIN)
+		nvme_io_issue(ns->dev);
+
+	return 0;
+}
+
 static const struct blk_ops nvme_blk_ops = {
 	.read	= nvme_blk_read,
 	.write	= nvme_blk_write,
+	.submit	= nvme_blk_submit,
+	.poll	= nvme_blk_poll,
 };
 
 U_BOOT_DRIVER(nvme_blk) = {
@@ -837,6 +970,7 @@ static int nvme_probe(struct udevice *udev)
 	ndev->instance = trailing_strtol(udev->name);
 
 	INIT_LIST_HEAD(&ndev->namespaces);
+	INIT_LIST_HEAD(&ndev->io_reqs);
 	ndev->bar = dm_pci_map_bar(udev, PCI_BASE_ADDRESS_0,
 			PCI_REGION_MEM);
 	if (readl(&ndev->bar->csts) == -1) {
@@ -619,6 +619,12 @@ struct nvme_dev {
 	u64 *prp_pool;
 	u32 prp_entry_num;
 	u32 nn;
+	/* Asynchronous I/O requests, the first one is being processed */
+	struct list_head io_reqs;
+	/* Number of blocks in the command in flight, 0 if idle */
+	u16 io_lbas;
+	/* Time (in us) the command in flight was issued */
+	ulong io_start;
 };
 
 /*
@@ -3,10 +3,13 @@
  * Copyright (c) 2019-2023 Hailo Technologies Ltd. All rights reserved. 
  */
 
+#include <asm/cache.h>
 #include <asm/io.h>
 #include <dm.h>
+#include <dma.h>
 #include <spi.h>
 #include <spi-mem.h>
+#include <linux/sizes.h>
 #include <linux/bitfield.h>
 #include <linux/iopoll.h>
 #include <linux/log2.h>
@@ -202,6 +205,9 @@
 #define XSPI_HAILO_WRAPPER_IRQ_MASK_VALUE (1)
 #define XSPI_HAILO_WRAPPER_IRQ_CLEAR_VALUE (1)
 
+/* Shortest SDMA read worth handing to a DMA channel */
+#define CDNS_XSPI_SDMA_DMA_MIN_LEN	SZ_4K
+
 enum cdns_xspi_stig_instr_type {
 	CDNS_XSPI_STIG_INSTR_TYPE_0,
 	CDNS_XSPI_STIG_INSTR_TYPE_1,
@@ -222,29 +228,72 @@ struct cdns_xspi_dev {
 	struct udevice *bus;
 	void __iomem *iobase;
 	void __iomem *sdmabase;
+	fdt_size_t sdmasize;
 	void __iomem *wrapperbase;
 
 	int cur_cs;
 	bool sdma_error;
+	/* Bytes moved by each access to the SDMA window: 4 or 8 */
+	uint sdma_width;
+	/* A memory-to-memory DMA channel is available for SDMA reads */
+	bool sdma_dma;
 
 	void *in_buffer;
 	const void *out_buffer;
 };
 
-static void xspi_ioread8_rep(void *addr, __u8 *buf, int len)
+/*
+ * The SDMA window behaves as a FIFO: each access moves as many bytes as the
+ * controller's DMA data width. Whole words go straight to an aligned buffer;
+ * an unaligned buffer and the tail of the transfer go through a bounce word.
+ */
+static void xspi_ioread_rep(void __iomem *addr, u8 *buf, u32 len, uint width)
 {
-	int i;
+	u64 word;
+	uint n;
+
+	if (IS_ALIGNED((ulong)buf, width)) {
+		if (width == 8) {
+			for (; len >= 8; len -= 8, buf += 8)
+				*(u64 *)buf = readq_relaxed(addr);
+		} else {
+			for (; len >= 4; len -= 4, buf += 4)
+				*(u32 *)buf = readl_relaxed(addr);
+		}
+	}
 
-	for (i = 0; i < len; i++)
-		buf[i] = readb(addr);
+	for (; len; len -= n, buf += n) {
+		n = min(len, width);
+		word = width == 8 ? readq_relaxed(addr) : readl_relaxed(addr);
+		memcpy(buf, &word, n);
+	}
 }
 
-static void xspi_iowrite8_rep(void *addr, const __u8 *buf, int len)
+static void xspi_iowrite_rep(void __iomem *addr, const u8 *buf, u32 len,
+			     uint width)
 {
-	int i;
+	u64 word;
+	uint n;
+
+	if (IS_ALIGNED((ulong)buf, width)) {
+		if (width == 8) {
+			for (; len >= 8; len -= 8, buf += 8)
+				writeq_relaxed(*(const u64 *)buf, addr);
+		} else {
+			for (; len >= 4; len -= 4, buf += 4)
+				writel_relaxed(*(const u32 *)buf, addr);
+		}
+	}
 
-	for (i = 0; i < len; i++)
-		writeb(buf[i], addr);
+	for (; len; len -= n, buf += n) {
+		n = min(len, width);
+		word = 0;
+		memcpy(&word, buf, n);
+		if (width == 8)
+			writeq_relaxed(word, addr);
+		else
+			writel_relaxed(word, addr);
+	}
 }
 
 static int hailo_xspi_set_speed(struct udevice *bus, uint hz)
@@ -262,10 +311,16 @@ static int hailo_xspi_set_mode(struct udevice *bus, uint mode)
 static int hailo_xspi_probe(struct udevice *bus)
 {
 	struct cdns_xspi_dev *cdns_xspi = dev_get_plat(bus);
+	struct udevice *dma;
 	u32 direct_access_cfg;
+	u32 features;
 
 	cdns_xspi->bus = bus;
 
+	features = readl(cdns_xspi->iobase + CDNS_XSPI_CTRL_FEATURES_REG);
+	cdns_xspi->sdma_width = (features & CDNS_XSPI_DMA_DATA_WIDTH) ? 8 : 4;
+	cdns_xspi->sdma_dma = !dma_get_device(DMA_SUPPORTS_MEM_TO_MEM, &dma);
+
 	/* disable address remap */
 	direct_access_cfg = readl(cdns_xspi->iobase + CDNS_XSPI_DIRECT_ACCESS_CFG);
 	direct_access_cfg &= ~(CDNS_XSPI_REMAP_ADDRESS_EN);
@@ -327,10 +382,22 @@ static int cdns_xspi_check_command_status(struct cdns_xspi_dev *cdns_xspi)
 
 	return ret;
 }
-static void cdns_xspi_sdma_handle(struct cdns_xspi_dev *cdns_xspi)
+/*
+ * Large reads into a cache-aligned buffer use a DMA channel when there is
+ * one. The SDMA window ignores the address, so the copy may run across it.
+ */
+static bool cdns_xspi_sdma_use_dma(struct cdns_xspi_dev *cdns_xspi, u32 len)
+{
+	return cdns_xspi->sdma_dma && len >= CDNS_XSPI_SDMA_DMA_MIN_LEN &&
+	       len <= cdns_xspi->sdmasize &&
+	       IS_ALIGNED((ulong)cdns_xspi->in_buffer | len, ARCH_DMA_MINALIGN);
+}
+
+static int cdns_xspi_sdma_handle(struct cdns_xspi_dev *cdns_xspi)
 {
 	u32 sdma_size, sdma_trd_info;
 	u8 sdma_dir;
+	int ret;
 
 	sdma_size = readl(cdns_xspi->iobase + CDNS_XSPI_SDMA_SIZE_REG);
 	sdma_trd_info = readl(cdns_xspi->iobase + CDNS_XSPI_SDMA_TRD_INFO_REG);
@@ -338,15 +405,27 @@ static void cdns_xspi_sdma_handle(struct cdns_xspi_dev *cdns_xspi)
 
 	switch (sdma_dir) {
 	case CDNS_XSPI_SDMA_DIR_READ:
-		xspi_ioread8_rep(cdns_xspi->sdmabase,
-			    cdns_xspi->in_buffer, sdma_size);
+		if (cdns_xspi_sdma_use_dma(cdns_xspi, sdma_size)) {
+			ret = dma_memcpy(cdns_xspi->in_buffer,
+					 (void *)cdns_xspi->sdmabase, sdma_size);
+			if (ret < 0) {
+				dev_err(cdns_xspi->bus,
+					"SDMA read by DMA failed: %d\n", ret);
+				return ret;
+			}
+			break;
+		}
+		xspi_ioread_rep(cdns_xspi->sdmabase, cdns_xspi->in_buffer,
+				sdma_size, cdns_xspi->sdma_width);
 		break;
 
 	case CDNS_XSPI_SDMA_DIR_WRITE:
-		xspi_iowrite8_rep(cdns_xspi->sdmabase,
-			     cdns_xspi->out_buffer, sdma_size);
+		xspi_iowrite_rep(cdns_xspi->sdmabase, cdns_xspi->out_buffer,
+				 sdma_size, cdns_xspi->sdma_width);
 		break;
 	}
+
+	return 0;
 }
 
 static int cdns_xspi_wait_for_controller_idle(struct cdns_xspi_dev *cdns_xspi)
@@ -456,7 +535,11 @@ static int cdns_xspi_send_stig_command(struct cdns_xspi_dev *cdns_xspi,
 			goto exit;
 		}
 
-		cdns_xspi_sdma_handle(cdns_xspi);
+		ret = cdns_xspi_sdma_handle(cdns_xspi);
+		if (ret < 0) {
+			ret = -EIO;
+			goto exit;
+		}
 	}
 
 	ret = cdns_xspi_wait_for_cmd_complete(cdns_xspi);
@@ -476,7 +559,7 @@ exit:
 	writel(FIELD_PREP(CDNS_XSPI_CTRL_WORK_MODE, CDNS_XSPI_WORK_MODE_DIRECT),
 	       cdns_xspi->iobase + CDNS_XSPI_CTRL_CONFIG_REG);
 
-	return 0;
+	return ret;
 }
 
 static int cdns_xspi_mem_op_execute(struct spi_slave *spi,
@@ -500,7 +583,8 @@ static int hailo_xspi_of_to_plat(struct udevice *bus)
 	struct cdns_xspi_dev *cdns_xspi = dev_get_plat(bus);
 
 	cdns_xspi->iobase = (void *)devfdt_get_addr_index(bus, 0);
-	cdns_xspi->sdmabase = (void *)devfdt_get_addr_index(bus, 1);
+	cdns_xspi->sdmabase = (void *)devfdt_get_addr_size_index(bus, 1,
+							&cdns_xspi->sdmasize);
 	cdns_xspi->wrapperbase = (void *)devfdt_get_addr_index(bus, 2);
 
 	return 0;
@@ -7,6 +7,7 @@
 #include <common.h>
 #include <blk.h>
 #include <dm.h>
+#include <malloc.h>
 #include <part.h>
 #include <virtio_types.h>
 #include <virtio.h>
@@ -17,22 +18,40 @@ struct virtio_blk_priv {
 	struct virtqueue *vq;
 };
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+/**
+ * struct virtio_blk_req - state for a request in the virtqueue
+ *
+ * The header must come first: virtqueue_get_buf() hands back the address
+ * of the first buffer of a chain, which lets us find the request again.
+ *
+ * @out_hdr:	Request header sent to the device
+ * @status:	Status byte written by the device
+ * @done:	true once the device has returned the request
+ * @req:	Block-layer request, or NULL for a synchronous transfer
+ */
+struct virtio_blk_req {
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+	bool done;
+	struct blk_request *req;
+};
+
+static int virtio_blk_queue(struct udevice *dev, struct virtio_blk_req *vreq,
+			    u64 sector, lbaint_t blkcnt, void *buffer, u32 type)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
 	unsigned int num_out = 0, num_in = 0;
 	struct virtio_sg *sgs[3];
-	u8 status;
 	int ret;
 
-	struct virtio_blk_outhdr out_hdr = {
-		.type = cpu_to_virtio32(dev, type),
-		.sector = cpu_to_virtio64(dev, sector),
-	};
-	struct virtio_sg hdr_sg = { &out_hdr, sizeof(out_hdr) };
+	struct virtio_sg hdr_sg = { &vreq->out_hdr, sizeof(vreq->out_hdr) };
 	struct virtio_sg data_sg = { buffer, blkcnt * 512 };
-	struct virtio_sg status_sg = { &status, sizeof(status) };
+	struct virtio_sg status_sg = { &vreq->status, sizeof(vreq->status) };
+
+	vreq->out_hdr.type = cpu_to_virtio32(dev, type);
+	vreq->out_hdr.ioprio = 0;
+	vreq->out_hdr.sector = cpu_to_virtio64(dev, sector);
+	vreq->done = false;
 
 	sgs[num_out++] = &hdr_sg;
 
@@ -49,10 +68,43 @@ static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
 
 	virtqueue_kick(priv->vq);
 
-	while (!virtqueue_get_buf(priv->vq, NULL))
-		;
+	return 0;
+}
+
+/* Collect all requests the device has finished with */
+static void virtio_blk_reap(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_req *vreq;
+	struct blk_request *req;
+
+	while ((vreq = virtqueue_get_buf(priv->vq, NULL))) {
+		vreq->done = true;
+		req = vreq->req;
+		if (!req)
+			continue;
+		if (vreq->status == VIRTIO_BLK_S_OK)
+			req->xfer = req->blkcnt;
+		free(vreq);
+		blk_request_done(req, req->xfer ? 0 : -EIO);
+	}
+}
+
+static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
+			       lbaint_t blkcnt, void *buffer, u32 type)
+{
+	struct virtio_blk_req vreq = { .req = NULL };
+	int ret;
+
+	ret = virtio_blk_queue(dev, &vreq, sector, blkcnt, buffer, type);
+	if (ret)
+		return ret;
+
+	/* asynchronous requests may complete ahead of ours */
+	while (!vreq.done)
+		virtio_blk_reap(dev);
 
-	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
+	return vreq.status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
 }
 
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
@@ -69,6 +121,35 @@ static ulong virtio_blk_write(struct udevice *dev, lbaint_t start,
 				 VIRTIO_BLK_T_OUT);
 }
 
+static int virtio_blk_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct virtio_blk_req *vreq;
+	int ret;
+
+	vreq = malloc(sizeof(*vreq));
+	if (!vreq)
+		return -ENOMEM;
+	vreq->req = req;
+
+	ret = virtio_blk_queue(dev, vreq, req->start, req->blkcnt, req->buffer,
+			       req->op == BLK_REQ_WRITE ? VIRTIO_BLK_T_OUT :
+			       VIRTIO_BLK_T_IN);
+	if (ret) {
+		free(vreq);
+		/* the ring is full until the device returns some buffers */
+		return ret == -ENOSPC ? -EBUSY : ret;
+	}
+
+	return 0;
+}
+
+static int virtio_blk_poll(struct udevice *dev)
+{
+	virtio_blk_reap(dev);
+
+	return 0;
+}
+
 static int virtio_blk_bind(struct udevice *dev)
 {
 	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(dev->parent);
@@ -125,6 +206,8 @@ static int virtio_blk_probe(struct udevice *dev)
 static const struct blk_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
 };
 
 U_BOOT_DRIVER(virtio_blk) = {
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * EROFS: mapping and reading file data
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <asm/unaligned.h>
+#include <linux/kernel.h>
+#include "internal.h"
+
+static int erofs_map_flat(struct erofs_inode *vi, struct erofs_map_blocks *map)
+{
+	const bool inline_tail = vi->datalayout == EROFS_INODE_FLAT_INLINE;
+	u64 blocks_end, tail;
+
+	/* Whole blocks are consecutive from raw_blkaddr */
+	if (inline_tail)
+		blocks_end = round_down(vi->size, erofs_blksiz());
+	else
+		blocks_end = round_up(vi->size, erofs_blksiz());
+
+	map->m_flags = EROFS_MAP_MAPPED;
+	if (map->m_la < blocks_end) {
+		map->m_llen = min(blocks_end, vi->size) - map->m_la;
+		map->m_pa = erofs_pos(vi->raw_blkaddr) + map->m_la;
+		map->m_plen = map->m_llen;
+		return 0;
+	}
+
+	/* The rest is stored in the inode's block, just after the inode */
+	tail = erofs_inode_tail(vi);
+	if (erofs_blkoff(tail) + vi->size - blocks_end > erofs_blksiz())
+		return -EFSCORRUPTED;
+	map->m_llen = vi->size - map->m_la;
+	map->m_pa = tail + map->m_la - blocks_end;
+	map->m_plen = map->m_llen;
+
+	return 0;
+}
+
+static int erofs_map_chunk(struct erofs_inode *vi, struct erofs_map_blocks *map)
+{
+	const u64 chunknr = map->m_la >> vi->chunkbits;
+	struct erofs_inode_chunk_index idx;
+	unsigned int unit;
+	u32 blkaddr;
+	int ret;
+
+	/* Chunks have either an index or just a block address */
+	if (vi->chunkformat & EROFS_CHUNK_FORMAT_INDEXES)
+		unit = sizeof(idx);
+	else
+		unit = sizeof(__le32);
+	ret = erofs_meta_read(&idx, round_up(erofs_inode_tail(vi), unit) +
+			      chunknr * unit, unit);
+	if (ret)
+		return ret;
+	if (unit == sizeof(idx)) {
+		if (le16_to_cpu(idx.device_id))
+			return -EOPNOTSUPP;
+		blkaddr = le32_to_cpu(idx.blkaddr);
+	} else {
+		blkaddr = get_unaligned_le32(&idx);
+	}
+
+	map->m_la = chunknr << vi->chunkbits;
+	map->m_llen = min_t(u64, 1ULL << vi->chunkbits, vi->size - map->m_la);
+	map->m_plen = map->m_llen;
+	if (blkaddr == EROFS_NULL_ADDR) {
+		map->m_flags = 0;
+	} else {
+		map->m_flags = EROFS_MAP_MAPPED;
+		map->m_pa = erofs_pos(blkaddr);
+	}
+
+	return 0;
+}
+
+/**
+ * erofs_map_blocks() - Find the extent of a file holding an offset
+ *
+ * @vi: Inode of the file
+ * @map: Holds the file offset in @map->m_la, which must be less than the file
+ *	size; returns the extent, which may start before that offset
+ * Return: 0 if OK, -ve on error
+ */
+int erofs_map_blocks(struct erofs_inode *vi, struct erofs_map_blocks *map)
+{
+	switch (vi->datalayout) {
+	case EROFS_INODE_FLAT_PLAIN:
+	case EROFS_INODE_FLAT_INLINE:
+		return erofs_map_flat(vi, map);
+	case EROFS_INODE_CHUNK_BASED:
+		return erofs_map_chunk(vi, map);
+	default:
+		return z_erofs_map_blocks(vi, map);
+	}
+}
+
+/**
+ * erofs_pread() - Read from a file
+ *
+ * Each extent is read in one go, so uncompressed data goes straight from the
+ * device into @buf.
+ *
+ * @vi: Inode of the file
+ * @buf: Buffer to read into
+ * @len: Number of bytes to read
+ * @offset: Offset in the file to read from
+ * Return: 0 if OK, -ve on error
+ */
+int erofs_pread(struct erofs_inode *vi, void *buf, u64 len, u64 offset)
+{
+	struct erofs_map_blocks map;
+	u64 skip, n;
+	int ret;
+
+	if (offset > vi->size || len > vi->size - offset)
+		return -EINVAL;
+
+	while (len) {
+		map.m_la = offset;
+		ret = erofs_map_blocks(vi, &map);
+		if (ret)
+			return ret;
+		skip = offset - map.m_la;
+		if (skip >= map.m_llen)
+			return -EFSCORRUPTED;
+		n = min(len, map.m_llen - skip);
+
+		if (!(map.m_flags & EROFS_MAP_MAPPED))
+			memset(buf, '\0', n);
+		else if (map.m_flags & EROFS_MAP_ZIPPED)
+			ret = z_erofs_read_extent(&map, buf, skip, n, len);
+		else
+			ret = erofs_dev_read(buf, map.m_pa + skip, n);
+		if (ret)
+			return ret;
+
+		buf += n;
+		offset += n;
+		len -= n;
+	}
+
+	return 0;
+}
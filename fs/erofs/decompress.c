@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * EROFS: reading compressed extents
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <linux/kernel.h>
+#include <linux/sizes.h>
+#include <u-boot/lz4.h>
+#include "internal.h"
+
+/* Space LZ4 needs after the output for the input to be decoded in place */
+#define Z_EROFS_LZ4_INPLACE_MARGIN(srcsize)	(((srcsize) >> 8) + 32)
+
+static int z_erofs_lz4_decompress(const void *src, unsigned int srcsize,
+				  void *out, unsigned int outsize,
+				  unsigned int target)
+{
+	const u8 *in = src;
+	int ret;
+
+	/* With zero padding the compressed data ends at the end of the block */
+	if (erofs_sbi.feature_incompat & EROFS_FEATURE_INCOMPAT_ZERO_PADDING) {
+		while (srcsize && !*in) {
+			in++;
+			srcsize--;
+		}
+		if (!srcsize)
+			return -EFSCORRUPTED;
+	}
+
+	ret = LZ4_decompress_safe_partial((const char *)in, out, srcsize,
+					  target, outsize);
+	if (ret < 0 || ret < target) {
+		log_debug("EROFS: LZ4 error %d\n", ret);
+		return -EFSCORRUPTED;
+	}
+
+	return 0;
+}
+
+/**
+ * z_erofs_read_extent() - Read part of a compressed extent
+ *
+ * When the whole extent is wanted it is decompressed straight into @buf. If
+ * the caller's buffer also has room for the compressed block past the end of
+ * the extent, the block is read there and decompressed in place, so no other
+ * buffer is needed.
+ *
+ * @map: The extent, from erofs_map_blocks()
+ * @buf: Buffer to read into
+ * @skip: Offset of the data wanted in the extent
+ * @len: Number of bytes wanted
+ * @room: Space in @buf, which may be more than @len
+ * Return: 0 if OK, -ve on error
+ */
+int z_erofs_read_extent(struct erofs_map_blocks *map, void *buf, u64 skip,
+			u64 len, u64 room)
+{
+	const unsigned int plen = map->m_plen;
+	const u64 llen = map->m_llen;
+	const u64 inplace = llen + Z_EROFS_LZ4_INPLACE_MARGIN(plen);
+	void *src, *out = buf;
+	int ret;
+
+	/* Far more than one block can hold */
+	if (llen > SZ_16M)
+		return -EFSCORRUPTED;
+
+	if ((erofs_sbi.feature_incompat &
+	     EROFS_FEATURE_INCOMPAT_ZERO_PADDING) &&
+	    !skip && len == llen && inplace >= plen && inplace <= room) {
+		src = buf + inplace - plen;
+		ret = erofs_dev_read(src, map->m_pa, plen);
+		if (ret)
+			return ret;
+
+		return z_erofs_lz4_decompress(src, plen, buf, llen, llen);
+	}
+
+	src = malloc_cache_aligned(plen);
+	if (!src)
+		return -ENOMEM;
+	if (skip || len < llen) {
+		out = malloc(llen);
+		if (!out) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	ret = erofs_dev_read(src, map->m_pa, plen);
+	if (!ret)
+		ret = z_erofs_lz4_decompress(src, plen, out, llen, skip + len);
+	if (!ret && out != buf)
+		memcpy(buf, out + skip, len);
+	if (out != buf)
+		free(out);
+out:
+	free(src);
+
+	return ret;
+}
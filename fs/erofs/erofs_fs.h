@@ -0,0 +1,203 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * EROFS on-disk format, as defined by the Linux kernel's fs/erofs/erofs_fs.h
+ *
+ * All fields are little-endian.
+ */
+
+#ifndef __EROFS_FS_H
+#define __EROFS_FS_H
+
+#include <linux/types.h>
+
+#define EROFS_SUPER_OFFSET	1024
+#define EROFS_SUPER_MAGIC_V1	0xE0F5E1E2
+
+/* Compressed data is right-aligned in its physical cluster */
+#define EROFS_FEATURE_INCOMPAT_ZERO_PADDING	0x00000001
+/* Shares its bit with COMPR_CFGS; checked per inode through h_advise */
+#define EROFS_FEATURE_INCOMPAT_BIG_PCLUSTER	0x00000002
+#define EROFS_FEATURE_INCOMPAT_CHUNKED_FILE	0x00000004
+#define EROFS_FEATURE_INCOMPAT_SUPP	\
+	(EROFS_FEATURE_INCOMPAT_ZERO_PADDING | \
+	 EROFS_FEATURE_INCOMPAT_BIG_PCLUSTER | \
+	 EROFS_FEATURE_INCOMPAT_CHUNKED_FILE)
+
+struct erofs_super_block {
+	__le32 magic;
+	__le32 checksum;		/* crc32c of the superblock */
+	__le32 feature_compat;
+	__u8 blkszbits;
+	__u8 reserved;
+	__le16 root_nid;
+	__le64 inos;
+	__le64 build_time;
+	__le32 build_time_nsec;
+	__le32 blocks;
+	__le32 meta_blkaddr;		/* start of the inode area */
+	__le32 xattr_blkaddr;
+	__u8 uuid[16];
+	__u8 volume_name[16];
+	__le32 feature_incompat;
+	__le16 available_compr_algs;
+	__le16 extra_devices;
+	__le16 devt_slotoff;
+	__u8 reserved2[38];
+} __packed;
+
+/* i_format: bit 0 is the inode version, bits 1-3 the data layout */
+#define EROFS_I_VERSION_BIT		0
+#define EROFS_I_VERSION_BITS		1
+#define EROFS_I_DATALAYOUT_BIT		1
+#define EROFS_I_DATALAYOUT_BITS		3
+
+#define EROFS_INODE_LAYOUT_COMPACT	0
+#define EROFS_INODE_LAYOUT_EXTENDED	1
+
+/* Data is in consecutive blocks starting at raw_blkaddr */
+#define EROFS_INODE_FLAT_PLAIN			0
+/* Compressed, with an 8-byte index for each logical cluster */
+#define EROFS_INODE_FLAT_COMPRESSION_LEGACY	1
+/* As FLAT_PLAIN, with the last partial block kept after the inode */
+#define EROFS_INODE_FLAT_INLINE			2
+/* Compressed, with packed indexes */
+#define EROFS_INODE_FLAT_COMPRESSION		3
+/* Data is in chunks, each with its own block address */
+#define EROFS_INODE_CHUNK_BASED			4
+
+/* Marks a hole in a chunk-based file */
+#define EROFS_NULL_ADDR			((u32)-1)
+
+/* chunk_info.format: bits 0-4 hold chunkbits - blkszbits */
+#define EROFS_CHUNK_FORMAT_BLKBITS_MASK	0x001f
+#define EROFS_CHUNK_FORMAT_INDEXES	0x0020
+
+struct erofs_inode_chunk_info {
+	__le16 format;
+	__le16 reserved;
+} __packed;
+
+union erofs_inode_i_u {
+	__le32 compressed_blocks;
+	__le32 raw_blkaddr;
+	__le32 rdev;
+	struct erofs_inode_chunk_info c;
+};
+
+struct erofs_inode_compact {
+	__le16 i_format;
+	__le16 i_xattr_icount;
+	__le16 i_mode;
+	__le16 i_nlink;
+	__le32 i_size;
+	__le32 i_reserved;
+	union erofs_inode_i_u i_u;
+	__le32 i_ino;
+	__le16 i_uid;
+	__le16 i_gid;
+	__le32 i_reserved2;
+} __packed;
+
+struct erofs_inode_extended {
+	__le16 i_format;
+	__le16 i_xattr_icount;
+	__le16 i_mode;
+	__le16 i_reserved;
+	__le64 i_size;
+	union erofs_inode_i_u i_u;
+	__le32 i_ino;
+	__le32 i_uid;
+	__le32 i_gid;
+	__le64 i_ctime;
+	__le32 i_ctime_nsec;
+	__le32 i_nlink;
+	__u8 i_reserved2[16];
+} __packed;
+
+/* Inodes are addressed in units of this from meta_blkaddr */
+#define EROFS_ISLOTBITS			5
+
+struct erofs_xattr_ibody_header {
+	__le32 h_reserved;
+	__u8 h_shared_count;
+	__u8 h_reserved2[7];
+	__le32 h_shared_xattrs[0];
+} __packed;
+
+static inline unsigned int erofs_xattr_ibody_size(u16 icount)
+{
+	if (!icount)
+		return 0;
+
+	return sizeof(struct erofs_xattr_ibody_header) +
+		(icount - 1) * sizeof(__u32);
+}
+
+struct erofs_inode_chunk_index {
+	__le16 advise;
+	__le16 device_id;
+	__le32 blkaddr;
+} __packed;
+
+/* Directory blocks start with an array of these, followed by the names */
+struct erofs_dirent {
+	__le64 nid;
+	__le16 nameoff;
+	__u8 file_type;
+	__u8 reserved;
+} __packed;
+
+#define EROFS_FT_UNKNOWN	0
+#define EROFS_FT_REG_FILE	1
+#define EROFS_FT_DIR		2
+#define EROFS_FT_CHRDEV		3
+#define EROFS_FT_BLKDEV		4
+#define EROFS_FT_FIFO		5
+#define EROFS_FT_SOCK		6
+#define EROFS_FT_SYMLINK	7
+
+#define Z_EROFS_COMPRESSION_LZ4	0
+
+/* h_advise */
+#define Z_EROFS_ADVISE_COMPACTED_2B		0x0001
+#define Z_EROFS_ADVISE_BIG_PCLUSTER_1		0x0002
+#define Z_EROFS_ADVISE_BIG_PCLUSTER_2		0x0004
+#define Z_EROFS_ADVISE_INLINE_PCLUSTER		0x0008
+
+/* Found after the inode and its xattrs, aligned to 8 bytes */
+struct z_erofs_map_header {
+	__le32 h_reserved1;
+	__le16 h_advise;
+	/* Bits 0-3: algorithm of HEAD lclusters */
+	__u8 h_algorithmtype;
+	/* Bits 0-2: logical cluster bits - 12 */
+	__u8 h_clusterbits;
+} __packed;
+
+/* Legacy indexes start this far past the map header */
+#define Z_EROFS_LEGACY_HEADER_PADDING	8
+
+#define Z_EROFS_CLUSTER_TYPE_PLAIN	0
+#define Z_EROFS_CLUSTER_TYPE_HEAD	1
+#define Z_EROFS_CLUSTER_TYPE_NONHEAD	2
+#define Z_EROFS_CLUSTER_TYPE_BITS	2
+
+/* di_advise: bits 0-1 hold the cluster type */
+#define Z_EROFS_DI_CLUSTER_TYPE_BIT	0
+
+struct z_erofs_lcluster_index {
+	__le16 di_advise;
+	/* Where the HEAD/PLAIN extent starts in this logical cluster */
+	__le16 di_clusterofs;
+	union {
+		/* HEAD/PLAIN: block of the compressed data */
+		__le32 blkaddr;
+		/*
+		 * NONHEAD: delta[0] is the distance back to the head logical
+		 * cluster, delta[1] the distance forward to the next one
+		 */
+		__le16 delta[2];
+	} di_u;
+} __packed;
+
+#endif /* __EROFS_FS_H */
@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * EROFS: filesystem layer (fs_...) interface
+ */
+
+#include <common.h>
+#include <erofs.h>
+#include <errno.h>
+#include <fs.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <uuid.h>
+#include <linux/kernel.h>
+#include <linux/stat.h>
+#include "internal.h"
+
+struct erofs_dir_stream {
+	struct fs_dir_stream fs_dirs;
+	struct fs_dirent dirent;
+	struct erofs_inode inode;
+	/* Current directory block, its offset and the next entry in it */
+	void *blk;
+	u64 pos;
+	unsigned int maxsize;
+	int count;
+	int idx;
+};
+
+int erofs_opendir(const char *filename, struct fs_dir_stream **dirsp)
+{
+	struct erofs_dir_stream *dirs;
+	int ret;
+
+	dirs = calloc(1, sizeof(*dirs));
+	if (!dirs)
+		return -ENOMEM;
+
+	ret = erofs_lookup(filename, &dirs->inode);
+	if (!ret && !S_ISDIR(dirs->inode.mode))
+		ret = -ENOTDIR;
+	if (!ret) {
+		dirs->blk = malloc_cache_aligned(erofs_blksiz());
+		if (!dirs->blk)
+			ret = -ENOMEM;
+	}
+	if (ret) {
+		free(dirs);
+		return ret;
+	}
+	/* Nothing read yet */
+	dirs->pos = -(u64)erofs_blksiz();
+
+	*dirsp = &dirs->fs_dirs;
+
+	return 0;
+}
+
+int erofs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
+{
+	struct erofs_dir_stream *dirs = (struct erofs_dir_stream *)fs_dirs;
+	struct fs_dirent *dent = &dirs->dirent;
+	const struct erofs_dirent *de;
+	struct erofs_inode vi;
+	unsigned int len;
+	const char *name;
+	int ret;
+
+	if (dirs->idx >= dirs->count) {
+		dirs->pos += erofs_blksiz();
+		if (dirs->pos >= dirs->inode.size)
+			return -ENOENT;
+		dirs->maxsize = min_t(u64, erofs_blksiz(),
+				      dirs->inode.size - dirs->pos);
+		ret = erofs_pread(&dirs->inode, dirs->blk, dirs->maxsize,
+				  dirs->pos);
+		if (ret)
+			return ret;
+		dirs->count = erofs_dirent_count(dirs->blk, dirs->maxsize);
+		if (dirs->count < 0)
+			return dirs->count;
+		dirs->idx = 0;
+	}
+
+	de = (struct erofs_dirent *)dirs->blk + dirs->idx;
+	name = erofs_dirent_name(dirs->blk, dirs->idx, dirs->count,
+				 dirs->maxsize, &len);
+	if (!name)
+		return -EFSCORRUPTED;
+	dirs->idx++;
+
+	memset(dent, '\0', sizeof(*dent));
+	len = min_t(unsigned int, len, sizeof(dent->name) - 1);
+	memcpy(dent->name, name, len);
+	switch (de->file_type) {
+	case EROFS_FT_DIR:
+		dent->type = FS_DT_DIR;
+		break;
+	case EROFS_FT_SYMLINK:
+		dent->type = FS_DT_LNK;
+		break;
+	case EROFS_FT_REG_FILE:
+		dent->type = FS_DT_REG;
+		vi.nid = le64_to_cpu(de->nid);
+		ret = erofs_read_inode(&vi);
+		if (ret)
+			return ret;
+		dent->size = vi.size;
+		break;
+	default:
+		dent->type = FS_DT_REG;
+		break;
+	}
+	*dentp = dent;
+
+	return 0;
+}
+
+void erofs_closedir(struct fs_dir_stream *fs_dirs)
+{
+	struct erofs_dir_stream *dirs = (struct erofs_dir_stream *)fs_dirs;
+
+	if (!dirs)
+		return;
+
+	free(dirs->blk);
+	free(dirs);
+}
+
+int erofs_exists(const char *filename)
+{
+	struct erofs_inode vi;
+
+	return !erofs_lookup(filename, &vi);
+}
+
+int erofs_size(const char *filename, loff_t *size)
+{
+	struct erofs_inode vi;
+	int ret;
+
+	ret = erofs_lookup(filename, &vi);
+	if (ret)
+		return ret;
+	*size = vi.size;
+
+	return 0;
+}
+
+int erofs_read(const char *filename, void *buf, loff_t offset, loff_t len,
+	       loff_t *actread)
+{
+	struct erofs_inode vi;
+	int ret;
+
+	*actread = 0;
+	ret = erofs_lookup(filename, &vi);
+	if (ret)
+		return ret;
+	if (S_ISDIR(vi.mode))
+		return -EISDIR;
+
+	if (offset >= vi.size)
+		return 0;
+	if (!len || len > vi.size - offset)
+		len = vi.size - offset;
+
+	ret = erofs_pread(&vi, buf, len, offset);
+	if (ret) {
+		log_err("EROFS: error %d reading '%s'\n", ret, filename);
+		return ret;
+	}
+	*actread = len;
+
+	return 0;
+}
+
+int erofs_uuid(char *uuid_str)
+{
+#ifdef CONFIG_LIB_UUID
+	uuid_bin_to_str(erofs_sbi.uuid, uuid_str, UUID_STR_FORMAT_STD);
+
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * EROFS: internal definitions shared by the driver's source files
+ */
+
+#ifndef __EROFS_INTERNAL_H
+#define __EROFS_INTERNAL_H
+
+#include <part.h>
+#include <asm/byteorder.h>
+#include "erofs_fs.h"
+
+#define EFSCORRUPTED	EUCLEAN
+
+struct erofs_sb_info {
+	struct blk_desc *dev;
+	struct disk_partition part;
+	unsigned int blkszbits;
+	u32 meta_blkaddr;
+	u64 root_nid;
+	u32 feature_incompat;
+	u8 uuid[16];
+	/* One metadata block, kept between reads of inodes and indexes */
+	void *metabuf;
+	u64 metablk;
+};
+
+extern struct erofs_sb_info erofs_sbi;
+
+#define erofs_blksiz()		(1U << erofs_sbi.blkszbits)
+#define erofs_blknr(pos)	((pos) >> erofs_sbi.blkszbits)
+#define erofs_blkoff(pos)	((pos) & (erofs_blksiz() - 1))
+#define erofs_pos(blk)		((u64)(blk) << erofs_sbi.blkszbits)
+
+static inline u64 erofs_iloc(u64 nid)
+{
+	return erofs_pos(erofs_sbi.meta_blkaddr) + (nid << EROFS_ISLOTBITS);
+}
+
+struct erofs_inode {
+	u64 nid;
+	u64 size;
+	u16 mode;
+	u8 datalayout;
+	u8 inode_isize;
+	u16 xattr_isize;
+	union {
+		u32 raw_blkaddr;
+		struct {
+			u16 chunkformat;
+			u8 chunkbits;
+		};
+		struct {
+			u16 z_advise;
+			u8 z_algorithmtype;
+			u8 z_lclusterbits;
+		};
+	};
+};
+
+static inline bool erofs_inode_is_compressed(const struct erofs_inode *vi)
+{
+	return vi->datalayout == EROFS_INODE_FLAT_COMPRESSION_LEGACY ||
+		vi->datalayout == EROFS_INODE_FLAT_COMPRESSION;
+}
+
+/* Where the data after the inode and its xattrs starts */
+static inline u64 erofs_inode_tail(const struct erofs_inode *vi)
+{
+	return erofs_iloc(vi->nid) + vi->inode_isize + vi->xattr_isize;
+}
+
+#define EROFS_MAP_MAPPED	0x0001
+/* The extent holds compressed data */
+#define EROFS_MAP_ZIPPED	0x0002
+
+/**
+ * struct erofs_map_blocks - a file extent and where its data is stored
+ *
+ * @m_la: logical (file) offset of the extent
+ * @m_llen: length of the extent in the file
+ * @m_pa: device offset of its data, for unmapped (hole) extents unused
+ * @m_plen: length of its data on the device
+ * @m_flags: EROFS_MAP_...
+ */
+struct erofs_map_blocks {
+	u64 m_la;
+	u64 m_llen;
+	u64 m_pa;
+	u64 m_plen;
+	unsigned int m_flags;
+};
+
+/* super.c */
+int erofs_dev_read(void *buf, u64 offset, size_t len);
+int erofs_meta_read(void *buf, u64 pos, size_t len);
+int erofs_read_inode(struct erofs_inode *vi);
+
+/* namei.c */
+int erofs_dirent_count(const void *blk, unsigned int maxsize);
+const char *erofs_dirent_name(const void *blk, unsigned int i,
+			      unsigned int count, unsigned int maxsize,
+			      unsigned int *lenp);
+int erofs_lookup(const char *path, struct erofs_inode *vi);
+
+/* data.c */
+int erofs_map_blocks(struct erofs_inode *vi, struct erofs_map_blocks *map);
+int erofs_pread(struct erofs_inode *vi, void *buf, u64 len, u64 offset);
+
+/* zmap.c */
+int z_erofs_map_blocks(struct erofs_inode *vi, struct erofs_map_blocks *map);
+
+/* decompress.c */
+int z_erofs_read_extent(struct erofs_map_blocks *map, void *buf, u64 skip,
+			u64 len, u64 room);
+
+#endif /* __EROFS_INTERNAL_H */
@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * EROFS: directory blocks and path lookup
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <linux/kernel.h>
+#include <linux/stat.h>
+#include "internal.h"
+
+/* Symbolic links followed while resolving one path */
+#define EROFS_MAX_LINKS		8
+/* Longest symbolic link target accepted */
+#define EROFS_MAX_LINK_LEN	4096
+
+/**
+ * erofs_dirent_count() - Check a directory block and count its entries
+ *
+ * @blk: Directory block
+ * @maxsize: Number of bytes in use in the block
+ * Return: number of entries, or -EFSCORRUPTED
+ */
+int erofs_dirent_count(const void *blk, unsigned int maxsize)
+{
+	const struct erofs_dirent *de = blk;
+	unsigned int nameoff = le16_to_cpu(de->nameoff);
+
+	if (nameoff < sizeof(*de) || nameoff >= maxsize ||
+	    nameoff % sizeof(*de))
+		return -EFSCORRUPTED;
+
+	return nameoff / sizeof(*de);
+}
+
+/**
+ * erofs_dirent_name() - Find the name of a directory entry
+ *
+ * Names are stored one after the other, after the entries, without a
+ * terminator. The last one is padded with NULs to the end of the block.
+ *
+ * @blk: Directory block
+ * @i: Entry number
+ * @count: Number of entries in the block, from erofs_dirent_count()
+ * @maxsize: Number of bytes in use in the block
+ * @lenp: Returns the length of the name
+ * Return: pointer to the name, or NULL if the block is corrupt
+ */
+const char *erofs_dirent_name(const void *blk, unsigned int i,
+			      unsigned int count, unsigned int maxsize,
+			      unsigned int *lenp)
+{
+	const struct erofs_dirent *de = blk;
+	unsigned int start, end;
+
+	start = le16_to_cpu(de[i].nameoff);
+	if (i + 1 < count) {
+		end = le16_to_cpu(de[i + 1].nameoff);
+	} else {
+		end = maxsize;
+		while (end > start && !((const char *)blk)[end - 1])
+			end--;
+	}
+	if (start > end || end > maxsize)
+		return NULL;
+	*lenp = end - start;
+
+	return blk + start;
+}
+
+static int erofs_namecmp(const char *name, unsigned int len,
+			 const char *dname, unsigned int dlen)
+{
+	int ret = memcmp(name, dname, min(len, dlen));
+
+	return ret ? ret : (int)len - (int)dlen;
+}
+
+/* Entries are sorted by name within each block, so search them by halves */
+static int erofs_dir_search(const void *blk, unsigned int maxsize,
+			    const char *name, unsigned int len, u64 *nidp)
+{
+	const struct erofs_dirent *de = blk;
+	int count, lo, hi, mid, cmp;
+	unsigned int dlen;
+	const char *dname;
+
+	count = erofs_dirent_count(blk, maxsize);
+	if (count < 0)
+		return count;
+
+	lo = 0;
+	hi = count - 1;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		dname = erofs_dirent_name(blk, mid, count, maxsize, &dlen);
+		if (!dname)
+			return -EFSCORRUPTED;
+		cmp = erofs_namecmp(name, len, dname, dlen);
+		if (!cmp) {
+			*nidp = le64_to_cpu(de[mid].nid);
+			return 0;
+		}
+		if (cmp < 0)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+
+	return -ENOENT;
+}
+
+static int erofs_dir_find(struct erofs_inode *dir, const char *name,
+			  unsigned int len, u64 *nidp)
+{
+	unsigned int maxsize;
+	void *blk;
+	u64 pos;
+	int ret;
+
+	if (!S_ISDIR(dir->mode))
+		return -ENOTDIR;
+
+	blk = malloc_cache_aligned(erofs_blksiz());
+	if (!blk)
+		return -ENOMEM;
+
+	ret = -ENOENT;
+	for (pos = 0; pos < dir->size; pos += erofs_blksiz()) {
+		maxsize = min_t(u64, erofs_blksiz(), dir->size - pos);
+		ret = erofs_pread(dir, blk, maxsize, pos);
+		if (ret)
+			break;
+		ret = erofs_dir_search(blk, maxsize, name, len, nidp);
+		if (ret != -ENOENT)
+			break;
+	}
+	free(blk);
+
+	return ret;
+}
+
+static int erofs_lookup_at(struct erofs_inode *dir, const char *path,
+			   struct erofs_inode *vi, int *links);
+
+static int erofs_follow_link(struct erofs_inode *dir, struct erofs_inode *vi,
+			     int *links)
+{
+	char *target;
+	int ret;
+
+	if (++*links > EROFS_MAX_LINKS)
+		return -ELOOP;
+	if (!vi->size || vi->size > EROFS_MAX_LINK_LEN)
+		return -EFSCORRUPTED;
+
+	target = malloc(vi->size + 1);
+	if (!target)
+		return -ENOMEM;
+	ret = erofs_pread(vi, target, vi->size, 0);
+	if (!ret) {
+		target[vi->size] = '\0';
+		ret = erofs_lookup_at(dir, target, vi, links);
+	}
+	free(target);
+
+	return ret;
+}
+
+static int erofs_lookup_at(struct erofs_inode *dir, const char *path,
+			   struct erofs_inode *vi, int *links)
+{
+	struct erofs_inode cur, parent;
+	const char *end;
+	int ret;
+
+	if (*path == '/') {
+		cur.nid = erofs_sbi.root_nid;
+		ret = erofs_read_inode(&cur);
+		if (ret)
+			return ret;
+	} else {
+		cur = *dir;
+	}
+
+	while (1) {
+		while (*path == '/')
+			path++;
+		if (!*path)
+			break;
+		end = strchrnul(path, '/');
+
+		parent = cur;
+		ret = erofs_dir_find(&parent, path, end - path, &cur.nid);
+		if (ret)
+			return ret;
+		ret = erofs_read_inode(&cur);
+		if (ret)
+			return ret;
+		if (S_ISLNK(cur.mode)) {
+			ret = erofs_follow_link(&parent, &cur, links);
+			if (ret)
+				return ret;
+		}
+		path = end;
+	}
+	*vi = cur;
+
+	return 0;
+}
+
+/**
+ * erofs_lookup() - Find the inode for a path, following symbolic links
+ *
+ * @path: Path from the root directory
+ * @vi: Returns the inode
+ * Return: 0 if OK, -ENOENT if not found, other -ve on error
+ */
+int erofs_lookup(const char *path, struct erofs_inode *vi)
+{
+	struct erofs_inode root = { .nid = erofs_sbi.root_nid };
+	int links = 0;
+	int ret;
+
+	ret = erofs_read_inode(&root);
+	if (ret)
+		return ret;
+
+	return erofs_lookup_at(&root, path, vi, &links);
+}
@@ -0,0 +1,266 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * EROFS: superblock, device access and inodes
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <erofs.h>
+#include <errno.h>
+#include <fs_internal.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <linux/kernel.h>
+#include <linux/sizes.h>
+#include <linux/stat.h>
+#include "internal.h"
+
+struct erofs_sb_info erofs_sbi;
+
+/**
+ * erofs_dev_read() - Read from the filesystem's partition
+ *
+ * Whole device blocks are read straight into @buf; only a partial block at
+ * either end goes through a bounce buffer.
+ *
+ * @buf: Buffer to read into
+ * @offset: Byte offset in the partition
+ * @len: Number of bytes to read
+ * Return: 0 if OK, -EIO on error
+ */
+int erofs_dev_read(void *buf, u64 offset, size_t len)
+{
+	const unsigned int log2blksz = erofs_sbi.dev->log2blksz;
+	size_t n;
+
+	while (len) {
+		/* fs_devread() takes an int length */
+		n = min_t(size_t, len, SZ_1G);
+		if (!fs_devread(erofs_sbi.dev, &erofs_sbi.part,
+				offset >> log2blksz,
+				offset & (erofs_sbi.dev->blksz - 1), n, buf))
+			return -EIO;
+		buf += n;
+		offset += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * erofs_meta_read() - Read metadata through the one-block metadata buffer
+ *
+ * Inodes, directory indexes and compression indexes are small and read in
+ * address order, so keeping the last block avoids most device reads.
+ *
+ * @buf: Buffer to read into
+ * @pos: Byte offset in the filesystem
+ * @len: Number of bytes to read
+ * Return: 0 if OK, -EIO on error
+ */
+int erofs_meta_read(void *buf, u64 pos, size_t len)
+{
+	unsigned int ofs, n;
+	u64 blk;
+	int ret;
+
+	while (len) {
+		blk = erofs_blknr(pos);
+		ofs = erofs_blkoff(pos);
+		if (blk != erofs_sbi.metablk) {
+			erofs_sbi.metablk = -1ULL;
+			ret = erofs_dev_read(erofs_sbi.metabuf, erofs_pos(blk),
+					     erofs_blksiz());
+			if (ret)
+				return ret;
+			erofs_sbi.metablk = blk;
+		}
+		n = min_t(size_t, len, erofs_blksiz() - ofs);
+		memcpy(buf, erofs_sbi.metabuf + ofs, n);
+		buf += n;
+		pos += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int z_erofs_read_map_header(struct erofs_inode *vi)
+{
+	struct z_erofs_map_header h;
+	int ret;
+
+	ret = erofs_meta_read(&h, round_up(erofs_inode_tail(vi), 8),
+			      sizeof(h));
+	if (ret)
+		return ret;
+
+	vi->z_advise = le16_to_cpu(h.h_advise);
+	vi->z_algorithmtype = h.h_algorithmtype & 0xf;
+	vi->z_lclusterbits = erofs_sbi.blkszbits + (h.h_clusterbits & 7);
+
+	if (vi->z_algorithmtype != Z_EROFS_COMPRESSION_LZ4) {
+		log_err("EROFS: nid %llu: unsupported compression %u\n",
+			vi->nid, vi->z_algorithmtype);
+		return -EOPNOTSUPP;
+	}
+	/* Each physical cluster must be one block */
+	if (vi->z_advise & (Z_EROFS_ADVISE_BIG_PCLUSTER_1 |
+			    Z_EROFS_ADVISE_BIG_PCLUSTER_2 |
+			    Z_EROFS_ADVISE_INLINE_PCLUSTER) ||
+	    vi->z_lclusterbits != erofs_sbi.blkszbits) {
+		log_err("EROFS: nid %llu: unsupported cluster layout\n",
+			vi->nid);
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+/**
+ * erofs_read_inode() - Read an inode from disk
+ *
+ * @vi: Inode to fill in, with @vi->nid set to the one wanted
+ * Return: 0 if OK, -ve on error
+ */
+int erofs_read_inode(struct erofs_inode *vi)
+{
+	union {
+		struct erofs_inode_compact c;
+		struct erofs_inode_extended e;
+	} di;
+	union erofs_inode_i_u *iu;
+	u16 ifmt, icount;
+	int ret;
+
+	ret = erofs_meta_read(&di.c, erofs_iloc(vi->nid), sizeof(di.c));
+	if (ret)
+		return ret;
+
+	ifmt = le16_to_cpu(di.c.i_format);
+	icount = le16_to_cpu(di.c.i_xattr_icount);
+	vi->datalayout = (ifmt >> EROFS_I_DATALAYOUT_BIT) &
+		((1 << EROFS_I_DATALAYOUT_BITS) - 1);
+	vi->mode = le16_to_cpu(di.c.i_mode);
+	vi->xattr_isize = erofs_xattr_ibody_size(icount);
+
+	switch ((ifmt >> EROFS_I_VERSION_BIT) &
+		((1 << EROFS_I_VERSION_BITS) - 1)) {
+	case EROFS_INODE_LAYOUT_COMPACT:
+		vi->inode_isize = sizeof(di.c);
+		vi->size = le32_to_cpu(di.c.i_size);
+		iu = &di.c.i_u;
+		break;
+	case EROFS_INODE_LAYOUT_EXTENDED:
+		ret = erofs_meta_read(&di.e, erofs_iloc(vi->nid),
+				      sizeof(di.e));
+		if (ret)
+			return ret;
+		vi->inode_isize = sizeof(di.e);
+		vi->size = le64_to_cpu(di.e.i_size);
+		iu = &di.e.i_u;
+		break;
+	default:
+		log_err("EROFS: nid %llu: unsupported inode format %#x\n",
+			vi->nid, ifmt);
+		return -EOPNOTSUPP;
+	}
+
+	if (!S_ISREG(vi->mode) && !S_ISDIR(vi->mode) && !S_ISLNK(vi->mode)) {
+		/* Devices, fifos and sockets have no data */
+		vi->datalayout = EROFS_INODE_FLAT_PLAIN;
+		vi->size = 0;
+		return 0;
+	}
+
+	switch (vi->datalayout) {
+	case EROFS_INODE_FLAT_PLAIN:
+	case EROFS_INODE_FLAT_INLINE:
+		vi->raw_blkaddr = le32_to_cpu(iu->raw_blkaddr);
+		return 0;
+	case EROFS_INODE_CHUNK_BASED:
+		vi->chunkformat = le16_to_cpu(iu->c.format);
+		if (vi->chunkformat & ~(EROFS_CHUNK_FORMAT_BLKBITS_MASK |
+					EROFS_CHUNK_FORMAT_INDEXES)) {
+			log_err("EROFS: nid %llu: unsupported chunk format %#x\n",
+				vi->nid, vi->chunkformat);
+			return -EOPNOTSUPP;
+		}
+		vi->chunkbits = erofs_sbi.blkszbits +
+			(vi->chunkformat & EROFS_CHUNK_FORMAT_BLKBITS_MASK);
+		if (vi->chunkbits >= 64)
+			return -EFSCORRUPTED;
+		return 0;
+	case EROFS_INODE_FLAT_COMPRESSION_LEGACY:
+	case EROFS_INODE_FLAT_COMPRESSION:
+		if (!S_ISREG(vi->mode))
+			return -EFSCORRUPTED;
+		return z_erofs_read_map_header(vi);
+	default:
+		log_err("EROFS: nid %llu: unsupported data layout %u\n",
+			vi->nid, vi->datalayout);
+		return -EOPNOTSUPP;
+	}
+}
+
+int erofs_probe(struct blk_desc *fs_dev_desc,
+		struct disk_partition *fs_partition)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct erofs_super_block, dsb, 1);
+	u32 incompat;
+	int ret;
+
+	free(erofs_sbi.metabuf);
+	erofs_sbi.metabuf = NULL;
+	erofs_sbi.dev = fs_dev_desc;
+	erofs_sbi.part = *fs_partition;
+	ret = erofs_dev_read(dsb, EROFS_SUPER_OFFSET, sizeof(*dsb));
+	if (ret)
+		goto err;
+
+	ret = -EINVAL;
+	if (le32_to_cpu(dsb->magic) != EROFS_SUPER_MAGIC_V1)
+		goto err;
+
+	erofs_sbi.blkszbits = dsb->blkszbits;
+	if (erofs_sbi.blkszbits < 9 || erofs_sbi.blkszbits > 12) {
+		log_err("EROFS: unsupported block size %u\n",
+			1U << erofs_sbi.blkszbits);
+		goto err;
+	}
+	incompat = le32_to_cpu(dsb->feature_incompat);
+	if (incompat & ~EROFS_FEATURE_INCOMPAT_SUPP) {
+		log_err("EROFS: unsupported features %#x\n",
+			incompat & ~EROFS_FEATURE_INCOMPAT_SUPP);
+		goto err;
+	}
+	if (le16_to_cpu(dsb->extra_devices)) {
+		log_err("EROFS: multiple devices are not supported\n");
+		goto err;
+	}
+
+	erofs_sbi.feature_incompat = incompat;
+	erofs_sbi.meta_blkaddr = le32_to_cpu(dsb->meta_blkaddr);
+	erofs_sbi.root_nid = le16_to_cpu(dsb->root_nid);
+	memcpy(erofs_sbi.uuid, dsb->uuid, sizeof(erofs_sbi.uuid));
+	erofs_sbi.metabuf = malloc_cache_aligned(erofs_blksiz());
+	if (!erofs_sbi.metabuf) {
+		ret = -ENOMEM;
+		goto err;
+	}
+	erofs_sbi.metablk = -1ULL;
+
+	return 0;
+
+err:
+	erofs_sbi.dev = NULL;
+	return ret;
+}
+
+void erofs_close(void)
+{
+	free(erofs_sbi.metabuf);
+	memset(&erofs_sbi, '\0', sizeof(erofs_sbi));
+}
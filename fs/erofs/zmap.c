@@ -0,0 +1,289 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * EROFS: mapping compressed files
+ *
+ * A compressed file is split into logical clusters (lclusters) of one block.
+ * Compression starts a new extent at some offset into an lcluster, its HEAD,
+ * and fills exactly one physical block with compressed data, so an extent
+ * covers a variable number of lclusters. Each lcluster has an index saying
+ * whether an extent starts in it and where; the indexes of lclusters inside
+ * an extent (NONHEAD) point back to its head.
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <asm/unaligned.h>
+#include <linux/kernel.h>
+#include "internal.h"
+
+struct z_erofs_maprecorder {
+	struct erofs_inode *inode;
+	u64 lcn;
+	u8 type;
+	unsigned int clusterofs;
+	u16 delta[2];
+	u32 pblk;
+};
+
+/* Legacy layout: an 8-byte index for every lcluster */
+static int z_erofs_load_legacy_index(struct z_erofs_maprecorder *m, u64 lcn)
+{
+	struct erofs_inode *vi = m->inode;
+	struct z_erofs_lcluster_index di;
+	u64 pos;
+	int ret;
+
+	pos = round_up(erofs_inode_tail(vi), 8) +
+		sizeof(struct z_erofs_map_header) +
+		Z_EROFS_LEGACY_HEADER_PADDING + lcn * sizeof(di);
+	ret = erofs_meta_read(&di, pos, sizeof(di));
+	if (ret)
+		return ret;
+
+	m->lcn = lcn;
+	m->type = (le16_to_cpu(di.di_advise) >> Z_EROFS_DI_CLUSTER_TYPE_BIT) &
+		((1 << Z_EROFS_CLUSTER_TYPE_BITS) - 1);
+	switch (m->type) {
+	case Z_EROFS_CLUSTER_TYPE_NONHEAD:
+		m->clusterofs = 1 << vi->z_lclusterbits;
+		m->delta[0] = le16_to_cpu(di.di_u.delta[0]);
+		m->delta[1] = le16_to_cpu(di.di_u.delta[1]);
+		return 0;
+	case Z_EROFS_CLUSTER_TYPE_PLAIN:
+	case Z_EROFS_CLUSTER_TYPE_HEAD:
+		m->clusterofs = le16_to_cpu(di.di_clusterofs);
+		m->pblk = le32_to_cpu(di.di_u.blkaddr);
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static unsigned int z_erofs_decode_compacted(unsigned int lobits,
+					     const u8 *in, unsigned int pos,
+					     u8 *type)
+{
+	const unsigned int v = get_unaligned_le32(in + pos / 8) >> (pos & 7);
+
+	*type = (v >> lobits) & ((1 << Z_EROFS_CLUSTER_TYPE_BITS) - 1);
+
+	return v & ((1 << lobits) - 1);
+}
+
+/*
+ * Compact indexes come in packs of 2 (4 bytes each) or 16 (2 bytes each)
+ * lclusters. Each holds a type and either clusterofs or delta[0], packed into
+ * a bitfield, followed by a 32-bit block address. The block of a HEAD is found
+ * by counting the HEADs before it in its pack. The last lcluster of a pack
+ * stores delta[1] rather than delta[0].
+ */
+static int z_erofs_unpack_compacted(struct z_erofs_maprecorder *m,
+				    unsigned int amortizedshift, u64 pos)
+{
+	const unsigned int lclusterbits = m->inode->z_lclusterbits;
+	unsigned int vcnt, packsize, encodebits, lo, nblk;
+	u8 pack[32], type;
+	u64 base;
+	int i, ret;
+
+	if (amortizedshift == 2)
+		vcnt = 2;
+	else if (amortizedshift == 1 && lclusterbits == 12)
+		vcnt = 16;
+	else
+		return -EOPNOTSUPP;
+
+	packsize = vcnt << amortizedshift;
+	encodebits = (packsize - sizeof(__le32)) * 8 / vcnt;
+	base = round_down(pos, packsize);
+	i = (pos - base) >> amortizedshift;
+	ret = erofs_meta_read(pack, base, packsize);
+	if (ret)
+		return ret;
+
+	lo = z_erofs_decode_compacted(lclusterbits, pack, encodebits * i,
+				      &type);
+	if (type > Z_EROFS_CLUSTER_TYPE_NONHEAD)
+		return -EOPNOTSUPP;
+	m->type = type;
+	if (type == Z_EROFS_CLUSTER_TYPE_NONHEAD) {
+		m->clusterofs = 1 << lclusterbits;
+		if (i + 1 != vcnt) {
+			m->delta[0] = lo;
+			return 0;
+		}
+		/* Work out delta[0] from the lcluster before */
+		lo = z_erofs_decode_compacted(lclusterbits, pack,
+					      encodebits * (i - 1), &type);
+		if (type != Z_EROFS_CLUSTER_TYPE_NONHEAD)
+			lo = 0;
+		m->delta[0] = lo + 1;
+		return 0;
+	}
+
+	m->clusterofs = lo;
+	m->delta[0] = 0;
+	nblk = 1;
+	while (i > 0) {
+		--i;
+		lo = z_erofs_decode_compacted(lclusterbits, pack,
+					      encodebits * i, &type);
+		if (type == Z_EROFS_CLUSTER_TYPE_NONHEAD)
+			i -= lo;
+		if (i >= 0)
+			++nblk;
+	}
+	m->pblk = get_unaligned_le32(pack + packsize - sizeof(__le32)) + nblk;
+
+	return 0;
+}
+
+/*
+ * Packs are 32-byte aligned: 4-byte indexes are used up to the first 32-byte
+ * boundary, then 2-byte ones if enabled, then 4-byte ones for the remainder
+ */
+static int z_erofs_load_compact_index(struct z_erofs_maprecorder *m, u64 lcn)
+{
+	struct erofs_inode *vi = m->inode;
+	const u64 ebase = round_up(erofs_inode_tail(vi), 8) +
+		sizeof(struct z_erofs_map_header);
+	const u64 totalidx = DIV_ROUND_UP(vi->size, 1 << vi->z_lclusterbits);
+	unsigned int compacted_4b_initial, amortizedshift;
+	u64 compacted_2b, pos;
+
+	m->lcn = lcn;
+	compacted_4b_initial = (32 - ebase % 32) / 4;
+	if (compacted_4b_initial == 32 / 4)
+		compacted_4b_initial = 0;
+	if ((vi->z_advise & Z_EROFS_ADVISE_COMPACTED_2B) &&
+	    compacted_4b_initial < totalidx)
+		compacted_2b = rounddown(totalidx - compacted_4b_initial, 16);
+	else
+		compacted_2b = 0;
+
+	pos = ebase;
+	amortizedshift = 2;
+	if (lcn >= compacted_4b_initial) {
+		pos += compacted_4b_initial * 4;
+		lcn -= compacted_4b_initial;
+		if (lcn < compacted_2b) {
+			amortizedshift = 1;
+		} else {
+			pos += compacted_2b * 2;
+			lcn -= compacted_2b;
+		}
+	}
+	pos += lcn << amortizedshift;
+
+	return z_erofs_unpack_compacted(m, amortizedshift, pos);
+}
+
+static int z_erofs_load_index(struct z_erofs_maprecorder *m, u64 lcn)
+{
+	struct erofs_inode *vi = m->inode;
+
+	if (lcn >= DIV_ROUND_UP(vi->size, 1 << vi->z_lclusterbits))
+		return -EFSCORRUPTED;
+	if (vi->datalayout == EROFS_INODE_FLAT_COMPRESSION_LEGACY)
+		return z_erofs_load_legacy_index(m, lcn);
+
+	return z_erofs_load_compact_index(m, lcn);
+}
+
+/* Walk back from a NONHEAD lcluster to the head of its extent */
+static int z_erofs_extent_lookback(struct z_erofs_maprecorder *m,
+				   unsigned int distance,
+				   struct erofs_map_blocks *map)
+{
+	int ret;
+
+	do {
+		if (!distance || m->lcn < distance)
+			return -EFSCORRUPTED;
+		ret = z_erofs_load_index(m, m->lcn - distance);
+		if (ret)
+			return ret;
+		distance = m->delta[0];
+	} while (m->type == Z_EROFS_CLUSTER_TYPE_NONHEAD);
+
+	if (m->type == Z_EROFS_CLUSTER_TYPE_PLAIN)
+		map->m_flags &= ~EROFS_MAP_ZIPPED;
+	map->m_la = (m->lcn << m->inode->z_lclusterbits) | m->clusterofs;
+
+	return 0;
+}
+
+/* Walk forward from lcn to the start of the next extent, or end of file */
+static int z_erofs_extent_end(struct erofs_inode *vi, u64 lcn, u64 *endp)
+{
+	struct z_erofs_maprecorder m = { .inode = vi };
+	const u64 totalidx = DIV_ROUND_UP(vi->size, 1 << vi->z_lclusterbits);
+	int ret;
+
+	for (lcn++; lcn < totalidx; lcn++) {
+		ret = z_erofs_load_index(&m, lcn);
+		if (ret)
+			return ret;
+		if (m.type != Z_EROFS_CLUSTER_TYPE_NONHEAD) {
+			*endp = (lcn << vi->z_lclusterbits) | m.clusterofs;
+			return 0;
+		}
+	}
+	*endp = vi->size;
+
+	return 0;
+}
+
+/**
+ * z_erofs_map_blocks() - Find the extent of a compressed file holding an offset
+ *
+ * @vi: Inode of the file
+ * @map: Holds the file offset in @map->m_la; returns the whole extent
+ * Return: 0 if OK, -ve on error
+ */
+int z_erofs_map_blocks(struct erofs_inode *vi, struct erofs_map_blocks *map)
+{
+	const unsigned int lclusterbits = vi->z_lclusterbits;
+	struct z_erofs_maprecorder m = { .inode = vi };
+	u64 lcn, endoff, end = 0;
+	int ret;
+
+	lcn = map->m_la >> lclusterbits;
+	endoff = map->m_la & ((1 << lclusterbits) - 1);
+	ret = z_erofs_load_index(&m, lcn);
+	if (ret)
+		return ret;
+
+	map->m_flags = EROFS_MAP_MAPPED | EROFS_MAP_ZIPPED;
+	switch (m.type) {
+	case Z_EROFS_CLUSTER_TYPE_PLAIN:
+	case Z_EROFS_CLUSTER_TYPE_HEAD:
+		if (endoff >= m.clusterofs) {
+			if (m.type == Z_EROFS_CLUSTER_TYPE_PLAIN)
+				map->m_flags &= ~EROFS_MAP_ZIPPED;
+			map->m_la = (lcn << lclusterbits) | m.clusterofs;
+			break;
+		}
+		/* The offset is in the extent before this one */
+		end = (lcn << lclusterbits) | m.clusterofs;
+		ret = z_erofs_extent_lookback(&m, 1, map);
+		break;
+	default:
+		ret = z_erofs_extent_lookback(&m, m.delta[0], map);
+		break;
+	}
+	if (!ret && !end)
+		ret = z_erofs_extent_end(vi, lcn, &end);
+	if (ret)
+		return ret;
+
+	if (end <= map->m_la)
+		return -EFSCORRUPTED;
+	map->m_llen = end - map->m_la;
+	map->m_pa = erofs_pos(m.pblk);
+	map->m_plen = erofs_blksiz();
+	if (!(map->m_flags & EROFS_MAP_ZIPPED) && map->m_llen > map->m_plen)
+		return -EFSCORRUPTED;
+
+	return 0;
+}
@@ -1642,6 +1642,118 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	return 1;
 }
 
+/*
+ * Checks whether the extent leaf held in @cache maps @fileblock. Extents in a
+ * leaf are sorted and the leaves do not overlap, so if @fileblock lies between
+ * the leaf's first and last extents, the leaf is the one that maps it and the
+ * tree does not need walking again.
+ */
+static struct ext4_extent_header *ext4fs_cached_leaf(struct ext_block_cache
+						     *cache, long int fileblock)
+{
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	int entries;
+
+	if (!cache || !cache->buf)
+		return NULL;
+
+	ext_block = (struct ext4_extent_header *)cache->buf;
+	entries = le16_to_cpu(ext_block->eh_entries);
+	if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC ||
+	    ext_block->eh_depth || !entries)
+		return NULL;
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+	if (fileblock < le32_to_cpu(extent[0].ee_block) ||
+	    fileblock >= le32_to_cpu(extent[entries - 1].ee_block) +
+			 le16_to_cpu(extent[entries - 1].ee_len))
+		return NULL;
+
+	return ext_block;
+}
+
+/*
+ * Maps @fileblock through the inode's extent tree and sets @count to the
+ * number of blocks, up to @max, which are mapped contiguously from there, or
+ * which are in the same hole. Returns 0 for a hole.
+ */
+static long int ext4fs_map_extent(struct ext2_inode *inode, long int fileblock,
+				  int max, int *count,
+				  struct ext_block_cache *cache)
+{
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+		get_fs()->dev_desc->log2blksz;
+	long int startblock, endblock, blknr = 0;
+	struct ext4_extent_header *ext_block;
+	struct ext_block_cache *c, cd;
+	struct ext4_extent *extent;
+	unsigned long long start;
+	int i;
+
+	*count = 1;
+	if (cache) {
+		c = cache;
+	} else {
+		c = &cd;
+		ext_cache_init(c);
+	}
+	ext_block = ext4fs_cached_leaf(cache, fileblock);
+	if (!ext_block)
+		ext_block = ext4fs_get_extent_block(ext4fs_root, c,
+						    (struct ext4_extent_header *)
+						    inode->b.blocks.dir_blocks,
+						    fileblock, log2_blksz);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		blknr = -EINVAL;
+		goto out;
+	}
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+
+	for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
+		startblock = le32_to_cpu(extent[i].ee_block);
+		endblock = startblock + le16_to_cpu(extent[i].ee_len);
+
+		if (startblock > fileblock) {
+			/* Sparse file */
+			*count = min_t(long int, startblock - fileblock, max);
+			break;
+		} else if (fileblock < endblock) {
+			start = le16_to_cpu(extent[i].ee_start_hi);
+			start = (start << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+			*count = min_t(long int, endblock - fileblock, max);
+			blknr = (fileblock - startblock) + start;
+			break;
+		}
+	}
+
+out:
+	if (!cache)
+		ext_cache_fini(c);
+
+	return blknr;
+}
+
+/*
+ * Like read_allocated_block(), but also sets @count to the number of blocks,
+ * up to @max, which follow on from @fileblock on disk, so that a whole extent
+ * can be read at once
+ */
+long int read_allocated_blocks(struct ext2_inode *inode, int fileblock,
+			       int max, int *count,
+			       struct ext_block_cache *cache)
+{
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)
+		return ext4fs_map_extent(inode, fileblock, max, count, cache);
+
+	*count = 1;
+
+	return read_allocated_block(inode, fileblock, cache);
+}
+
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache)
 {
@@ -1652,63 +1764,15 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
+	int count;
+
 	/* get the blocksize of the filesystem */
 	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
 		- get_fs()->dev_desc->log2blksz;
 
-	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		long int startblock, endblock;
-		struct ext_block_cache *c, cd;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i;
-
-		if (cache) {
-			c = cache;
-		} else {
-			c = &cd;
-			ext_cache_init(c);
-		}
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, c,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			if (!cache)
-				ext_cache_fini(c);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
-			startblock = le32_to_cpu(extent[i].ee_block);
-			endblock = startblock + le16_to_cpu(extent[i].ee_len);
-
-			if (startblock > fileblock) {
-				/* Sparse file */
-				if (!cache)
-					ext_cache_fini(c);
-				return 0;
-
-			} else if (fileblock < endblock) {
-				start = le16_to_cpu(extent[i].ee_start_hi);
-				start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-				if (!cache)
-					ext_cache_fini(c);
-				return (fileblock - startblock) + start;
-			}
-		}
-
-		if (!cache)
-			ext_cache_fini(c);
-		return 0;
-	}
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)
+		return ext4fs_map_extent(inode, fileblock, 1, &count, cache);
 
 	/* Direct blocks. */
 	if (fileblock < INDIRECT_BLOCKS)
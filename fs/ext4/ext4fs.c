@@ -29,6 +29,7 @@
 #include <malloc.h>
 #include <part.h>
 #include <uuid.h>
+#include <linux/sizes.h>
 
 int ext4fs_symlinknest;
 struct ext_filesystem ext_fs;
@@ -53,21 +54,19 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
+	lbaint_t i, first;
 	lbaint_t blockcnt;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
 	lbaint_t delayed_start = 0;
-	lbaint_t delayed_extent = 0;
-	lbaint_t delayed_skipfirst = 0;
+	int delayed_extent = 0;
+	int delayed_skipfirst = 0;
 	lbaint_t delayed_next = 0;
 	char *delayed_buf = NULL;
-	char *start_buf = buf;
-	short status;
 	struct ext_block_cache cache;
+	int count, max;
 
 	ext_cache_init(&cache);
 
@@ -81,106 +80,70 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	}
 
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
-
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
+	first = lldiv(pos, blocksize);
+
+	/*
+	 * Map as many blocks at a time as the extent allows, so that a file
+	 * in one large extent is read with a single device read straight into
+	 * the buffer, rather than being looked up block by block
+	 */
+	for (i = first; i < blockcnt; i += count) {
 		long int blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
-		int skipfirst = 0;
-		blknr = read_allocated_block(&node->inode, i, &cache);
-		if (blknr < 0) {
-			ext_cache_fini(&cache);
-			return -1;
+		loff_t start, end;
+		int skipfirst, runlen;
+
+		/* Keep each device read within what ext4fs_devread() takes */
+		max = min_t(lbaint_t, blockcnt - i, SZ_1G / blocksize);
+		blknr = read_allocated_blocks(&node->inode, i, max, &count,
+					      &cache);
+		if (blknr < 0)
+			goto fail;
+
+		start = max_t(loff_t, (loff_t)i * blocksize, pos);
+		end = min_t(loff_t, (loff_t)(i + count) * blocksize, pos + len);
+		skipfirst = start - (loff_t)i * blocksize;
+		runlen = end - start;
+
+		if (!blknr) {
+			/* spill, then zero the hole */
+			if (delayed_extent &&
+			    !ext4fs_devread(delayed_start, delayed_skipfirst,
+					    delayed_extent, delayed_buf))
+				goto fail;
+			delayed_extent = 0;
+			memset(buf + (start - pos), 0, runlen);
+			continue;
 		}
 
 		blknr = blknr << log2_fs_blocksize;
-
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
-
-		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
-		if (blknr) {
-			int status;
-
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-					if (status == 0) {
-						ext_cache_fini(&cache);
-						return -1;
-					}
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
-				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
-				delayed_skipfirst = skipfirst;
-				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
-			}
+		if (delayed_extent && delayed_next == blknr &&
+		    delayed_extent <= SZ_1G - runlen) {
+			delayed_extent += runlen;
 		} else {
-			int n;
-			int n_left;
-			if (previous_block_number != -1) {
-				/* spill */
-				status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-				if (status == 0) {
-					ext_cache_fini(&cache);
-					return -1;
-				}
-				previous_block_number = -1;
-			}
-			/* Zero no more than `len' bytes. */
-			n = blocksize - skipfirst;
-			n_left = len - ( buf - start_buf );
-			if (n > n_left)
-				n = n_left;
-			memset(buf, 0, n);
-		}
-		buf += blocksize - skipfirst;
-	}
-	if (previous_block_number != -1) {
-		/* spill */
-		status = ext4fs_devread(delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
-		if (status == 0) {
-			ext_cache_fini(&cache);
-			return -1;
+			/* spill */
+			if (delayed_extent &&
+			    !ext4fs_devread(delayed_start, delayed_skipfirst,
+					    delayed_extent, delayed_buf))
+				goto fail;
+			delayed_start = blknr;
+			delayed_extent = runlen;
+			delayed_skipfirst = skipfirst;
+			delayed_buf = buf + (start - pos);
 		}
-		previous_block_number = -1;
+		delayed_next = blknr + ((lbaint_t)count << log2_fs_blocksize);
 	}
+	if (delayed_extent &&
+	    !ext4fs_devread(delayed_start, delayed_skipfirst, delayed_extent,
+			    delayed_buf))
+		goto fail;
 
 	*actread  = len;
 	ext_cache_fini(&cache);
 	return 0;
+
+fail:
+	ext_cache_fini(&cache);
+	return -1;
 }
 
 int ext4fs_ls(const char *dirname)
@@ -20,8 +20,10 @@
 #include <malloc.h>
 #include <memalign.h>
 #include <asm/cache.h>
+#include <linux/build_bug.h>
 #include <linux/compiler.h>
 #include <linux/ctype.h>
+#include <linux/math64.h>
 
 /*
  * Convert a string to lowercase.  Converts at most 'len' characters,
@@ -304,6 +306,68 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/* A run of consecutive clusters in a cluster chain */
+struct fat_run {
+	__u32 start;
+	__u32 count;
+};
+
+/**
+ * get_cluster_runs() - resolve a cluster chain into runs of clusters
+ *
+ * Following the chain up front, rather than between data reads, means the
+ * FAT is read sequentially and the data in the fewest possible transfers.
+ *
+ * @mydata:	filesystem data
+ * @clust:	first cluster of the chain
+ * @max:	number of clusters to resolve, at most
+ * @runsp:	returns the runs, which the caller must free
+ * Return:	number of runs, or -1 on error
+ */
+static int get_cluster_runs(fsdata *mydata, __u32 clust, __u32 max,
+			    struct fat_run **runsp)
+{
+	struct fat_run *runs = NULL, *new;
+	int nruns = 0, size = 0;
+	__u32 count;
+
+	for (count = 0; count < max; count++) {
+		if (count) {
+			clust = get_fatent(mydata, clust);
+			if (IS_LAST_CLUST(clust, mydata->fatsize))
+				break;
+		}
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			printf("Invalid FAT entry\n");
+			free(runs);
+			return -1;
+		}
+
+		if (nruns && runs[nruns - 1].start + runs[nruns - 1].count ==
+		    clust) {
+			runs[nruns - 1].count++;
+			continue;
+		}
+		if (nruns == size) {
+			size = size ? size * 2 : 16;
+			new = realloc(runs, size * sizeof(*runs));
+			if (!new) {
+				debug("Error: allocating runs\n");
+				free(runs);
+				return -1;
+			}
+			runs = new;
+		}
+		runs[nruns].start = clust;
+		runs[nruns].count = 1;
+		nruns++;
+	}
+	*runsp = runs;
+
+	return nruns;
+}
+
 /**
  * get_contents() - read from file
  *
@@ -324,9 +388,10 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
-	loff_t actsize;
+	loff_t start, end, actsize;
+	struct fat_run *runs;
+	int i, nruns, ret = 0;
+	__u32 clust, skip;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -341,101 +406,76 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
-
-	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize += bytesperclust;
-	}
-
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
+	nruns = get_cluster_runs(mydata, START(dentptr),
+				 div_u64(filesize + bytesperclust - 1,
+					 bytesperclust), &runs);
+	if (nruns < 0)
+		return -1;
 
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		__u8 *tmp_buffer;
+	end = 0;
+	for (i = 0; i < nruns && end < filesize; i++) {
+		/* file offsets covered by this run */
+		start = end;
+		end += (loff_t)runs[i].count * bytesperclust;
+		if (end <= pos)
+			continue;
+		clust = runs[i].start;
 
-		actsize = min(filesize, (loff_t)bytesperclust);
-		tmp_buffer = malloc_cache_aligned(actsize);
-		if (!tmp_buffer) {
-			debug("Error: allocating buffer\n");
-			return -1;
+		/* go to cluster at pos */
+		if (start < pos) {
+			skip = div_u64(pos - start, bytesperclust);
+			clust += skip;
+			start += (loff_t)skip * bytesperclust;
 		}
 
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
-			printf("Error reading cluster\n");
-			free(tmp_buffer);
-			return -1;
-		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, tmp_buffer + pos, actsize);
-		free(tmp_buffer);
-		*gotsize += actsize;
-		if (!filesize)
-			return 0;
-		buffer += actsize;
+		/* the cluster holding pos goes through a bounce buffer */
+		if (start < pos) {
+			__u8 *tmp_buffer;
 
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-	}
+			actsize = min(filesize - start, (loff_t)bytesperclust);
+			tmp_buffer = malloc_cache_aligned(actsize);
+			if (!tmp_buffer) {
+				debug("Error: allocating buffer\n");
+				ret = -1;
+				break;
+			}
 
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				printf("Invalid FAT entry\n");
-				return -1;
+			if (get_cluster(mydata, clust, tmp_buffer, actsize)) {
+				printf("Error reading cluster\n");
+				free(tmp_buffer);
+				ret = -1;
+				break;
 			}
-			endclust = newclust;
-			actsize += bytesperclust;
+			actsize -= pos - start;
+			memcpy(buffer, tmp_buffer + pos - start, actsize);
+			free(tmp_buffer);
+			*gotsize += actsize;
+			buffer += actsize;
+			clust++;
+			start += bytesperclust;
 		}
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		/* the rest of the run is read straight into the buffer */
+		actsize = min(end, filesize) - start;
+		if (actsize <= 0)
+			continue;
+		if (get_cluster(mydata, clust, buffer, actsize)) {
 			printf("Error reading cluster\n");
-			return -1;
+			ret = -1;
+			break;
 		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
-		filesize -= actsize;
 		buffer += actsize;
+	}
+	free(runs);
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	/* the chain ended before the file did */
+	if (!ret && *gotsize < filesize - pos) {
+		printf("Invalid FAT entry\n");
+		ret = -1;
+	}
+
+	return ret;
 }
 
 /*
@@ -623,6 +663,8 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster = 0;
 	}
 
+	/* FAT12 entries must not be split between two reads */
+	BUILD_BUG_ON(FATBUFBLOCKS % 3);
 	mydata->fatbufnum = -1;
 	mydata->fat_dirty = 0;
 	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
@@ -208,17 +208,19 @@ static int disk_write(__u32 block, __u32 nr_blocks, void *buf)
 }
 
 /*
- * Write fat buffer into block device
+ * Write the modified sectors of the fat buffer into block device
  */
 static int flush_dirty_fat_buffer(fsdata *mydata)
 {
-	int getsize = FATBUFBLOCKS;
+	int getsize = mydata->dirty_end - mydata->dirty_start;
 	__u32 fatlength = mydata->fatlength;
-	__u8 *bufptr = mydata->fatbuf;
-	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u8 *bufptr = mydata->fatbuf + mydata->dirty_start * mydata->sect_size;
+	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS +
+			   mydata->dirty_start;
 
-	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum,
-	      (int)mydata->fat_dirty);
+	debug("debug: evicting %d, dirty: %d, sectors %d-%d\n",
+	      mydata->fatbufnum, (int)mydata->fat_dirty, mydata->dirty_start,
+	      mydata->dirty_end);
 
 	if ((!mydata->fat_dirty) || (mydata->fatbufnum == -1))
 		return 0;
@@ -435,7 +437,7 @@ fill_dir_slot(fat_itr *itr, const char *l_name, const char *shortname)
  */
 static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 {
-	__u32 bufnum, offset, off16;
+	__u32 bufnum, offset, off16, first, last;
 	__u16 val1, val2;
 
 	switch (mydata->fatsize) {
@@ -479,7 +481,30 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		mydata->fatbufnum = bufnum;
 	}
 
-	/* Mark as dirty */
+	/* Mark the sectors holding the entry as dirty */
+	switch (mydata->fatsize) {
+	case 32:
+		first = offset * 4;
+		last = first + 3;
+		break;
+	case 16:
+		first = offset * 2;
+		last = first + 1;
+		break;
+	default:
+		first = (offset * 3) / 2;
+		last = first + 1;
+		break;
+	}
+	first /= mydata->sect_size;
+	last = last / mydata->sect_size + 1;
+	if (!mydata->fat_dirty) {
+		mydata->dirty_start = first;
+		mydata->dirty_end = last;
+	} else {
+		mydata->dirty_start = min_t(__u16, mydata->dirty_start, first);
+		mydata->dirty_end = max_t(__u16, mydata->dirty_end, last);
+	}
 	mydata->fat_dirty = 1;
 
 	/* Set the actual entry */
@@ -533,6 +558,10 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		return -1;
 	}
 
+	/* A freed cluster may now be the first free one */
+	if (!entry_value && entry < mydata->next_free)
+		mydata->next_free = entry;
+
 	return 0;
 }
 
@@ -799,7 +828,7 @@ get_set_cluster(fsdata *mydata, __u32 clustnum, loff_t pos, __u8 *buffer,
  */
 static int find_empty_cluster(fsdata *mydata)
 {
-	__u32 fat_val, entry = 3;
+	__u32 fat_val, entry = max(mydata->next_free, 3U);
 
 	while (1) {
 		fat_val = get_fatent(mydata, entry);
@@ -807,6 +836,7 @@ static int find_empty_cluster(fsdata *mydata)
 			break;
 		entry++;
 	}
+	mydata->next_free = entry;
 
 	return entry;
 }
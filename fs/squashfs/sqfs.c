@@ -93,64 +93,151 @@ static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
 }
 
 /*
- * Retrieves fragment block entry and returns true if the fragment block is
- * compressed
+ * Finds the block at offset @start of the image in @cache, or returns NULL if
+ * it has not been read since the filesystem was probed
  */
-static int sqfs_frag_lookup(u32 inode_fragment_index,
-			    struct squashfs_fragment_block_entry *e)
+static void *sqfs_cache_lookup(struct squashfs_cache_entry *cache, int count,
+			       u64 start, u32 *size)
 {
-	u64 start, n_blks, src_len, table_offset, start_block;
-	unsigned char *metadata_buffer, *metadata, *table;
-	struct squashfs_fragment_block_entry *entries;
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	unsigned long dest_len;
-	int block, offset, ret;
-	u16 header;
+	int i;
 
-	metadata_buffer = NULL;
-	entries = NULL;
-	table = NULL;
+	for (i = 0; i < count; i++) {
+		if (cache[i].data && cache[i].start == start) {
+			cache[i].used = ++ctxt.cache_stamp;
+			if (size)
+				*size = cache[i].size;
+			return cache[i].data;
+		}
+	}
 
-	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
-		return -EINVAL;
+	return NULL;
+}
+
+/*
+ * Adds a decompressed block to @cache, which takes ownership of @data. The
+ * least recently used block is dropped if there is no free entry.
+ */
+static void sqfs_cache_insert(struct squashfs_cache_entry *cache, int count,
+			      u64 start, void *data, u32 size)
+{
+	struct squashfs_cache_entry *victim = cache;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!cache[i].data) {
+			victim = &cache[i];
+			break;
+		}
+		if (cache[i].used < victim->used)
+			victim = &cache[i];
+	}
+
+	free(victim->data);
+	victim->start = start;
+	victim->size = size;
+	victim->used = ++ctxt.cache_stamp;
+	victim->data = data;
+}
+
+static void sqfs_cache_free(struct squashfs_cache_entry *cache, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		free(cache[i].data);
+	memset(cache, '\0', count * sizeof(*cache));
+}
+
+static void sqfs_put_tables(struct squashfs_tables *tables)
+{
+	if (!tables || --tables->refcount)
+		return;
+
+	free(tables->inode_table);
+	free(tables->dir_table);
+	free(tables->pos_list);
+	free(tables);
+}
+
+/* Drops all metadata read from the current filesystem */
+static void sqfs_free_metadata(void)
+{
+	sqfs_put_tables(ctxt.tables);
+	free(ctxt.frag_index);
+	ctxt.tables = NULL;
+	ctxt.frag_index = NULL;
+	sqfs_cache_free(ctxt.metadata_cache, SQFS_METADATA_CACHE_SIZE);
+	sqfs_cache_free(ctxt.frag_cache, SQFS_FRAGMENT_CACHE_SIZE);
+}
 
+/*
+ * Reads the fragment index table, which gives the start offset of each
+ * metadata block holding fragment block entries
+ */
+static int sqfs_read_frag_index(void)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u64 start, n_blks, table_offset, table_end;
+	unsigned char *table;
+	int i, count;
+
+	if (ctxt.frag_index)
+		return 0;
+
+	count = DIV_ROUND_UP(get_unaligned_le32(&sblk->fragments),
+			     SQFS_MAX_ENTRIES);
+	table_end = get_unaligned_le64(&sblk->fragment_table_start) +
+		count * sizeof(u64);
 	start = get_unaligned_le64(&sblk->fragment_table_start) /
 		ctxt.cur_dev->blksz;
 	n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
-				  sblk->export_table_start,
-				  &table_offset);
+				  cpu_to_le64(table_end), &table_offset);
 
-	/* Allocate a proper sized buffer to store the fragment index table */
 	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!table) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	if (!table)
+		return -ENOMEM;
 
 	if (sqfs_disk_read(start, n_blks, table) < 0) {
-		ret = -EINVAL;
-		goto out;
+		free(table);
+		return -EINVAL;
 	}
 
-	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
-	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+	ctxt.frag_index = malloc(count * sizeof(u64));
+	if (!ctxt.frag_index) {
+		free(table);
+		return -ENOMEM;
+	}
 
-	/*
-	 * Get the start offset of the metadata block that contains the right
-	 * fragment block entry
-	 */
-	start_block = get_unaligned_le64(table + table_offset + block *
-					 sizeof(u64));
+	for (i = 0; i < count; i++)
+		ctxt.frag_index[i] = get_unaligned_le64(table + table_offset +
+							i * sizeof(u64));
+	free(table);
+
+	return 0;
+}
+
+/*
+ * Reads and decompresses the metadata block of fragment block entries at
+ * offset @start_block of the image
+ */
+static int sqfs_read_frag_entries(u64 start_block,
+				  struct squashfs_fragment_block_entry **entriesp)
+{
+	struct squashfs_fragment_block_entry *entries = NULL;
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	unsigned char *metadata_buffer, *metadata;
+	u64 start, n_blks, src_len, table_offset;
+	unsigned long dest_len;
+	u16 header;
+	int ret;
 
 	start = start_block / ctxt.cur_dev->blksz;
 	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
 				  sblk->fragment_table_start, &table_offset);
 
 	metadata_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!metadata_buffer) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	if (!metadata_buffer)
+		return -ENOMEM;
 
 	if (sqfs_disk_read(start, n_blks, metadata_buffer) < 0) {
 		ret = -EINVAL;
@@ -185,13 +272,121 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
 	}
 
-	*e = entries[offset];
-	ret = SQFS_COMPRESSED_BLOCK(e->size);
+	*entriesp = entries;
+	entries = NULL;
+	ret = 0;
 
 out:
 	free(entries);
 	free(metadata_buffer);
-	free(table);
+
+	return ret;
+}
+
+/*
+ * Retrieves fragment block entry and returns true if the fragment block is
+ * compressed
+ */
+static int sqfs_frag_lookup(u32 inode_fragment_index,
+			    struct squashfs_fragment_block_entry *e)
+{
+	struct squashfs_fragment_block_entry *entries;
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	int block, offset, ret;
+	u64 start_block;
+
+	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
+		return -EINVAL;
+
+	ret = sqfs_read_frag_index();
+	if (ret)
+		return ret;
+
+	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
+	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+
+	/*
+	 * Get the start offset of the metadata block that contains the right
+	 * fragment block entry
+	 */
+	start_block = ctxt.frag_index[block];
+
+	entries = sqfs_cache_lookup(ctxt.metadata_cache,
+				    SQFS_METADATA_CACHE_SIZE, start_block, NULL);
+	if (!entries) {
+		ret = sqfs_read_frag_entries(start_block, &entries);
+		if (ret)
+			return ret;
+		sqfs_cache_insert(ctxt.metadata_cache, SQFS_METADATA_CACHE_SIZE,
+				  start_block, entries, SQFS_METADATA_BLOCK_SIZE);
+	}
+
+	*e = entries[offset];
+
+	return SQFS_COMPRESSED_BLOCK(e->size);
+}
+
+/*
+ * Gets the contents of the fragment block described by @e, reading it only if
+ * it is not in the fragment cache. Small files often share a fragment block,
+ * so this saves decompressing it again for each of them. The block belongs to
+ * the cache and must not be freed.
+ */
+static int sqfs_get_fragment(struct squashfs_fragment_block_entry *e,
+			     bool comp, char **blockp, u32 *sizep)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u64 start, n_blks, table_size, table_offset;
+	char *fragment, *block;
+	unsigned long dest_len;
+	int ret;
+
+	block = sqfs_cache_lookup(ctxt.frag_cache, SQFS_FRAGMENT_CACHE_SIZE,
+				  e->start, sizep);
+	if (block) {
+		*blockp = block;
+		return 0;
+	}
+
+	start = e->start / ctxt.cur_dev->blksz;
+	table_size = SQFS_BLOCK_SIZE(e->size);
+	table_offset = e->start - (start * ctxt.cur_dev->blksz);
+	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
+
+	fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	if (!fragment)
+		return -ENOMEM;
+
+	ret = sqfs_disk_read(start, n_blks, fragment);
+	if (ret < 0)
+		goto out;
+
+	dest_len = comp ? get_unaligned_le32(&sblk->block_size) : table_size;
+	block = malloc(dest_len);
+	if (!block) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (comp) {
+		ret = sqfs_decompress(&ctxt, block, &dest_len,
+				      fragment + table_offset, table_size);
+		if (ret) {
+			free(block);
+			goto out;
+		}
+	} else {
+		memcpy(block, fragment + table_offset, table_size);
+	}
+
+	sqfs_cache_insert(ctxt.frag_cache, SQFS_FRAGMENT_CACHE_SIZE, e->start,
+			  block, dest_len);
+	*blockp = block;
+	*sizep = dest_len;
+	ret = 0;
+
+out:
+	free(fragment);
 
 	return ret;
 }
@@ -807,12 +1002,11 @@ static int sqfs_read_directory_table(unsigned char **dir_table, u32 **pos_list)
 		goto out;
 
 	*dir_table = malloc(metablks_count * SQFS_METADATA_BLOCK_SIZE);
-	if (!*dir_table)
-		goto out;
-
 	*pos_list = malloc(metablks_count * sizeof(u32));
-	if (!*pos_list)
+	if (!*dir_table || !*pos_list) {
+		metablks_count = -1;
 		goto out;
+	}
 
 	ret = sqfs_get_metablk_pos(*pos_list, dtb, table_offset,
 				   metablks_count);
@@ -868,13 +1062,43 @@ out:
 	return metablks_count;
 }
 
+/*
+ * Decompresses the inode and directory tables the first time they are needed
+ * after sqfs_probe(), so that later lookups do not read them again
+ */
+static int sqfs_read_tables(void)
+{
+	struct squashfs_tables *tables;
+
+	if (ctxt.tables)
+		return 0;
+
+	tables = calloc(1, sizeof(*tables));
+	if (!tables)
+		return -ENOMEM;
+	tables->refcount = 1;
+
+	if (sqfs_read_inode_table(&tables->inode_table)) {
+		sqfs_put_tables(tables);
+		return -EINVAL;
+	}
+
+	tables->metablks_count = sqfs_read_directory_table(&tables->dir_table,
+							   &tables->pos_list);
+	if (tables->metablks_count < 1) {
+		sqfs_put_tables(tables);
+		return -EINVAL;
+	}
+	ctxt.tables = tables;
+
+	return 0;
+}
+
 int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 {
-	unsigned char *inode_table = NULL, *dir_table = NULL;
-	int j, token_count = 0, ret = 0, metablks_count;
+	int j, token_count = 0, ret = 0;
 	struct squashfs_dir_stream *dirs;
 	char **token_list = NULL, *path = NULL;
-	u32 *pos_list = NULL;
 
 	dirs = calloc(1, sizeof(*dirs));
 	if (!dirs)
@@ -887,17 +1111,13 @@ int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	dirs->inode_table = NULL;
 	dirs->dir_table = NULL;
 
-	ret = sqfs_read_inode_table(&inode_table);
-	if (ret) {
-		ret = -EINVAL;
+	ret = sqfs_read_tables();
+	if (ret)
 		goto out;
-	}
 
-	metablks_count = sqfs_read_directory_table(&dir_table, &pos_list);
-	if (metablks_count < 1) {
-		ret = -EINVAL;
-		goto out;
-	}
+	/* The stream outlives the fs_close() that follows fs_opendir() */
+	dirs->tables = ctxt.tables;
+	dirs->tables->refcount++;
 
 	/* Tokenize filename */
 	token_count = sqfs_count_tokens(filename);
@@ -926,10 +1146,11 @@ int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	 * ldir's (extended directory) size is greater than dir, so it works as
 	 * a general solution for the malloc size, since 'i' is a union.
 	 */
-	dirs->inode_table = inode_table;
-	dirs->dir_table = dir_table;
-	ret = sqfs_search_dir(dirs, token_list, token_count, pos_list,
-			      metablks_count);
+	dirs->inode_table = dirs->tables->inode_table;
+	dirs->dir_table = dirs->tables->dir_table;
+	ret = sqfs_search_dir(dirs, token_list, token_count,
+			      dirs->tables->pos_list,
+			      dirs->tables->metablks_count);
 	if (ret)
 		goto out;
 
@@ -953,10 +1174,10 @@ out:
 	for (j = 0; j < token_count; j++)
 		free(token_list[j]);
 	free(token_list);
-	free(pos_list);
 	free(path);
 	if (ret) {
-		free(inode_table);
+		sqfs_put_tables(dirs->tables);
+		free(dirs->dir_header);
 		free(dirs);
 	}
 
@@ -1081,6 +1302,9 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 	struct squashfs_super_block *sblk;
 	int ret;
 
+	/* Nothing read from a previous filesystem can be used for this one */
+	sqfs_free_metadata();
+
 	ctxt.cur_dev = fs_dev_desc;
 	ctxt.cur_part_info = *fs_partition;
 
@@ -1309,7 +1533,7 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	      loff_t *actread)
 {
 	char *dir = NULL, *fragment_block, *datablock = NULL, *data_buffer = NULL;
-	char *fragment = NULL, *file = NULL, *resolved, *data;
+	char *file = NULL, *resolved, *data;
 	u64 start, n_blks, table_size, data_offset, table_offset, sparse_size;
 	int ret, j, i_number, datablk_count = 0;
 	struct squashfs_super_block *sblk = ctxt.sblk;
@@ -1324,6 +1548,7 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	unsigned long dest_len;
 	struct fs_dirent *dent;
 	unsigned char *ipos;
+	u32 frag_size;
 
 	*actread = 0;
 
@@ -1514,53 +1739,21 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 		goto out;
 	}
 
-	start = frag_entry.start / ctxt.cur_dev->blksz;
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
-
-	fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-
-	if (!fragment) {
-		ret = -ENOMEM;
+	ret = sqfs_get_fragment(&frag_entry, finfo.comp, &fragment_block,
+				&frag_size);
+	if (ret)
 		goto out;
-	}
 
-	ret = sqfs_disk_read(start, n_blks, fragment);
-	if (ret < 0)
+	if (finfo.offset + finfo.size - *actread > frag_size) {
+		ret = -EINVAL;
 		goto out;
-
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
-			goto out;
-		}
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-
-		free(fragment_block);
-
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
 	}
 
+	memcpy(buf + *actread, &fragment_block[finfo.offset],
+	       finfo.size - *actread);
+	*actread = finfo.size;
+
 out:
-	free(fragment);
 	if (datablk_count) {
 		free(data_buffer);
 		free(datablock);
@@ -1702,6 +1895,7 @@ free_strings:
 
 void sqfs_close(void)
 {
+	sqfs_free_metadata();
 	sqfs_decompressor_cleanup(&ctxt);
 	free(ctxt.sblk);
 	ctxt.sblk = NULL;
@@ -1716,8 +1910,7 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 		return;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
-	free(sqfs_dirs->dir_table);
+	sqfs_put_tables(sqfs_dirs->tables);
 	free(sqfs_dirs->dir_header);
 	free(sqfs_dirs);
 }
@@ -29,6 +29,10 @@
 #define SQFS_EMPTY_FILE_SIZE 3
 #define SQFS_STOP_READDIR 1
 #define SQFS_EMPTY_DIR -1
+/* Number of decompressed fragment table metadata blocks kept while mounted */
+#define SQFS_METADATA_CACHE_SIZE 8
+/* Number of decompressed fragment blocks kept while mounted */
+#define SQFS_FRAGMENT_CACHE_SIZE 4
 /*
  * A directory entry object has a fixed length of 8 bytes, corresponding to its
  * first four members, plus the size of the entry name, which is equal to
@@ -73,6 +77,27 @@ struct squashfs_super_block {
 	__le64 export_table_start;
 };
 
+/*
+ * Inode and directory tables, decompressed the first time they are needed
+ * after sqfs_probe(). They are shared by the filesystem context and any open
+ * directory streams, and freed when the last of these lets go of them.
+ */
+struct squashfs_tables {
+	int refcount;
+	unsigned char *inode_table;
+	unsigned char *dir_table;
+	u32 *pos_list;
+	int metablks_count;
+};
+
+/* A decompressed block, looked up by its offset in the image */
+struct squashfs_cache_entry {
+	u64 start;
+	u32 size;
+	ulong used;
+	void *data;
+};
+
 struct squashfs_ctxt {
 	struct disk_partition cur_part_info;
 	struct blk_desc *cur_dev;
@@ -80,6 +105,16 @@ struct squashfs_ctxt {
 #if IS_ENABLED(CONFIG_ZSTD)
 	void *zstd_workspace;
 #endif
+	/*
+	 * Metadata read since sqfs_probe(), which is dropped by sqfs_close().
+	 * The inode and directory tables are kept whole, since lookups index
+	 * into them directly.
+	 */
+	struct squashfs_tables *tables;
+	u64 *frag_index;
+	struct squashfs_cache_entry metadata_cache[SQFS_METADATA_CACHE_SIZE];
+	struct squashfs_cache_entry frag_cache[SQFS_FRAGMENT_CACHE_SIZE];
+	ulong cache_stamp;
 };
 
 struct squashfs_directory_index {
@@ -274,8 +309,10 @@ struct squashfs_dir_stream {
 	struct squashfs_ldir_inode i_ldir;
 	/*
 	 * References to the tables' beginnings. They are assigned in
-	 * sqfs_opendir() and freed in sqfs_closedir().
+	 * sqfs_opendir(), which takes a reference to 'tables' that is dropped
+	 * in sqfs_closedir().
 	 */
+	struct squashfs_tables *tables;
 	unsigned char *inode_table;
 	unsigned char *dir_table;
 };
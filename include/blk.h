@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -119,6 +120,11 @@ struct blk_desc {
 #define PAD_TO_BLOCKSIZE(size, blk_desc) \
 	(PAD_SIZE(size, blk_desc->blksz))
 
+/* Device read function used by the block cache to fetch missing blocks */
+typedef unsigned long (*blkcache_read_fn)(struct blk_desc *desc,
+					  lbaint_t start, lbaint_t blkcnt,
+					  void *buffer);
+
 #if CONFIG_IS_ENABLED(BLOCK_CACHE)
 
 /**
@@ -158,6 +164,25 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_read_through() - read blocks, going to the device on a miss
+ *
+ * On a miss, small requests are widened to whole cache entries and, when
+ * the device is being read sequentially, extended by the configured
+ * read-ahead so that following reads can be served from the cache.
+ *
+ * @param desc - block device descriptor
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to read
+ * @param buffer - buffer to receive the data
+ * @param read - function reading blocks from the device
+ *
+ * @return - number of blocks read
+ */
+unsigned long blkcache_read_through(struct blk_desc *desc, lbaint_t start,
+				    lbaint_t blkcnt, void *buffer,
+				    blkcache_read_fn read);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
@@ -167,6 +192,15 @@ void blkcache_fill(int iftype, int dev,
  */
 void blkcache_invalidate(int iftype, int dev);
 
+/**
+ * blkcache_remove() - discard the cache and all other state for a device
+ * because it is going away.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ */
+void blkcache_remove(int iftype, int dev);
+
 /**
  * blkcache_configure() - configure block cache
  *
@@ -175,6 +209,14 @@ void blkcache_invalidate(int iftype, int dev);
  */
 void blkcache_configure(unsigned blocks, unsigned entries);
 
+/**
+ * blkcache_configure_size() - configure block cache capacity and read-ahead
+ *
+ * @param size - maximum number of bytes held in the cache
+ * @param readahead - maximum blocks read ahead on sequential access
+ */
+void blkcache_configure_size(unsigned long size, unsigned readahead);
+
 /*
  * statistics of the block cache
  */
@@ -184,6 +226,12 @@ struct block_cache_stats {
 	unsigned entries; /* current entry count */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	unsigned long size; /* bytes currently cached */
+	unsigned long max_size;
+	unsigned max_readahead; /* in blocks */
+	unsigned long long bytes_served; /* bytes returned from the cache */
+	unsigned ra_issued; /* blocks fetched by read-ahead */
+	unsigned ra_used; /* read-ahead blocks later hit */
 };
 
 /**
@@ -206,13 +254,71 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline unsigned long blkcache_read_through(struct blk_desc *desc,
+						  lbaint_t start,
+						  lbaint_t blkcnt,
+						  void *buffer,
+						  blkcache_read_fn read)
+{
+	return read(desc, start, blkcnt, buffer);
+}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
+static inline void blkcache_remove(int iftype, int dev) {}
+
 #endif
 
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
+/**
+ * enum blk_req_op - Operation carried out by a struct blk_request
+ *
+ * @BLK_REQ_READ: Read blocks from the device into the buffer
+ * @BLK_REQ_WRITE: Write blocks from the buffer to the device
+ */
+enum blk_req_op {
+	BLK_REQ_READ,
+	BLK_REQ_WRITE,
+};
+
+/**
+ * struct blk_request - an asynchronous block I/O request
+ *
+ * The caller fills in the first group of fields and hands the request to
+ * blk_submit(). The request (and its buffer) must stay valid until it has
+ * completed, i.e. until @done is true.
+ *
+ * @op:		Operation to perform
+ * @start:	Start block number (0=first)
+ * @blkcnt:	Number of blocks to transfer
+ * @buffer:	Data buffer, at least @blkcnt blocks in size
+ * @end_io:	Called once the request has completed, or NULL. This may be
+ *		called from within blk_submit() or blk_poll()
+ * @priv:	Private data for the caller, not used by the block layer
+ *
+ * @dev:	Block device the request was submitted to
+ * @list:	Used by the uclass or driver to queue pending requests
+ * @xfer:	Number of blocks transferred so far
+ * @status:	0 if the request completed successfully, else -ve error
+ * @done:	true once the request has completed
+ */
+struct blk_request {
+	enum blk_req_op op;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	void (*end_io)(struct blk_request *req);
+	void *priv;
+
+	struct udevice *dev;
+	struct list_head list;
+	lbaint_t xfer;
+	int status;
+	bool done;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -271,6 +377,33 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - start an asynchronous request
+	 *
+	 * The driver takes ownership of the request until it completes it by
+	 * calling blk_request_done(), either from submit() itself or from a
+	 * later call to poll(). Drivers which do not provide this method are
+	 * handled synchronously by blk_submit().
+	 *
+	 * @dev:	Device to submit the request to
+	 * @req:	Request to start (@req->dev is already set up)
+	 * @return 0 if OK, -EBUSY if the driver cannot accept another request
+	 * until an earlier one completes, other -ve on error
+	 */
+	int (*submit)(struct udevice *dev, struct blk_request *req);
+
+	/**
+	 * poll() - make progress on requests started with submit()
+	 *
+	 * This must not block waiting for the hardware. It should reap any
+	 * completed transfers, call blk_request_done() for each finished
+	 * request and start the next transfer if the device is idle.
+	 *
+	 * @dev:	Device to poll
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -288,6 +421,85 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_submit() - submit an asynchronous block request
+ *
+ * Starts the transfer described by @req. If the driver supports
+ * asynchronous I/O this returns as soon as the request is queued, and the
+ * caller must call blk_poll() or blk_wait() until @req->done is set. Reads
+ * which can be satisfied from the block cache, and all requests to drivers
+ * without a submit() method, complete before this function returns.
+ *
+ * The block cache is invalidated when a write is submitted. While a write is
+ * outstanding, blk_dread(), blk_dwrite() and blk_derase() first wait for it
+ * if it overlaps the blocks they access, and blk_dread() bypasses the cache.
+ *
+ * @desc:	Block device to use
+ * @req:	Request to submit
+ * @return 0 if the request was accepted, -ve on error (in which case
+ * @req->end_io is not called)
+ */
+int blk_submit(struct blk_desc *desc, struct blk_request *req);
+
+/**
+ * blk_poll() - make progress on outstanding requests for a device
+ *
+ * @desc:	Block device to poll
+ * @return number of requests still outstanding, or -ve on error
+ */
+int blk_poll(struct blk_desc *desc);
+
+/**
+ * blk_wait() - wait for a request to complete
+ *
+ * Polls the device until @req has completed. Other requests for the same
+ * device may complete (and have their callbacks run) in the meantime.
+ *
+ * @desc:	Block device the request was submitted to
+ * @req:	Request to wait for
+ * @return 0 if the request completed successfully, -ve on error
+ */
+int blk_wait(struct blk_desc *desc, struct blk_request *req);
+
+/**
+ * blk_request_done() - mark a request as completed
+ *
+ * This is called by drivers (and the uclass) when a request has finished.
+ * It records the status, updates the block cache and runs the caller's
+ * completion callback.
+ *
+ * @req:	Request which has completed
+ * @status:	0 if all blocks were transferred, else -ve error
+ */
+void blk_request_done(struct blk_request *req, int status);
+
+/**
+ * blk_queue_submit() - queue a request for blk_queue_poll()
+ *
+ * Drivers whose hardware only supports synchronous transfers can use this
+ * and blk_queue_poll() as their submit() and poll() methods. Requests are
+ * then carried out in chunks by the uclass, one chunk per call to
+ * blk_poll(), using the driver's read() and write() methods. This lets the
+ * caller interleave other work with a large transfer.
+ *
+ * This is not real asynchronous I/O: each chunk is a synchronous transfer
+ * made from within blk_poll(), so nothing moves between polls and the CPU
+ * waits for the device just as it would with blk_dread() or blk_dwrite().
+ *
+ * @dev:	Block device
+ * @req:	Request to queue
+ * @return 0 (always succeeds)
+ */
+int blk_queue_submit(struct udevice *dev, struct blk_request *req);
+
+/**
+ * blk_queue_poll() - transfer the next chunk of queued requests
+ *
+ * @dev:	Block device
+ * @return 0 if OK, -ve on error
+ */
+int blk_queue_poll(struct udevice *dev);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -453,22 +665,13 @@ struct blk_desc *blk_get_by_device(struct udevice *dev);
 static inline ulong blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			      lbaint_t blkcnt, void *buffer)
 {
-	ulong blks_read;
-	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
-		return blkcnt;
-
 	/*
 	 * We could check if block_read is NULL and return -ENOSYS. But this
 	 * bloats the code slightly (cause some board to fail to build), and
 	 * it would be an error to try an operation that does not exist.
 	 */
-	blks_read = block_dev->block_read(block_dev, start, blkcnt, buffer);
-	if (blks_read == blkcnt)
-		blkcache_fill(block_dev->if_type, block_dev->devnum,
-			      start, blkcnt, block_dev->blksz, buffer);
-
-	return blks_read;
+	return blkcache_read_through(block_dev, start, blkcnt, buffer,
+				     block_dev->block_read);
 }
 
 static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
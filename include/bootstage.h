@@ -213,6 +213,21 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ALLOC,
 };
 
+/* Kinds of scope, see bootstage_scope_start() */
+enum bootstage_scope_type {
+	BOOTSTAGE_SCOPE_USER,		/* Code marked by hand */
+	BOOTSTAGE_SCOPE_PROBE,		/* device_probe() */
+	BOOTSTAGE_SCOPE_READ,		/* blk_dread() */
+
+	BOOTSTAGE_SCOPE_TYPE_COUNT,
+};
+
+/* Formats for bootstage_scope_export() */
+enum bootstage_trace_fmt {
+	BOOTSTAGE_TRACE_FOLDED,		/* Folded stacks, for flame graphs */
+	BOOTSTAGE_TRACE_CHROME,		/* Chrome trace-event JSON */
+};
+
 /*
  * Return the time since boot in microseconds, This is needed for bootstage
  * and should be defined in CPU- or board-specific code. If undefined then
@@ -433,6 +448,84 @@ static inline int bootstage_init(bool first)
 
 #endif /* ENABLE_BOOTSTAGE */
 
+#if defined(ENABLE_BOOTSTAGE) && CONFIG_IS_ENABLED(BOOTSTAGE_SCOPES)
+/**
+ * bootstage_scope_start() - Start timing a scope
+ *
+ * Scopes nest: a scope started while another is open is recorded as its
+ * child. Each call must be matched by a call to bootstage_scope_end(), in
+ * reverse order of starting. Consecutive reads from the same device are
+ * merged into a single scope which counts them.
+ *
+ * Scopes are only recorded once the full malloc() is available.
+ *
+ * @type:	Kind of scope
+ * @name:	Name of scope, e.g. the device name. This is copied, and
+ *		truncated if long.
+ * Return: scope number to pass to bootstage_scope_end(), or -ve if the
+ *	scope is not being recorded
+ */
+int bootstage_scope_start(enum bootstage_scope_type type, const char *name);
+
+/**
+ * bootstage_scope_end() - Finish timing a scope
+ *
+ * @scope:	Value returned by bootstage_scope_start()
+ */
+void bootstage_scope_end(int scope);
+
+/**
+ * bootstage_scope_report() - Print the recorded scopes as a tree
+ *
+ * Each scope is shown with its start time, the time spent in it and the
+ * time spent in it but not in its child scopes. For merged reads, the start
+ * time is that of the first read and the time spent is the total for all of
+ * them, so it may be less than the time from the first read to the last.
+ *
+ * @min_us:	Omit scopes which took less than this many microseconds
+ */
+void bootstage_scope_report(uint min_us);
+
+/**
+ * bootstage_scope_export() - Write out the recorded scopes as a trace
+ *
+ * For BOOTSTAGE_TRACE_FOLDED, each line holds the stack of scope names,
+ * separated by ';', then the time spent in that scope but not in its
+ * children. This can be fed to flamegraph.pl. BOOTSTAGE_TRACE_CHROME gives
+ * a JSON trace with the scopes and bootstage marks, for chrome://tracing
+ * and similar viewers. Merged reads appear as a single event which starts
+ * with the first read and lasts for the total time of all of them, with the
+ * number of reads in its "count" argument.
+ *
+ * @fmt:	Format to use
+ * @buf:	Buffer for the output, which is nul-terminated if it fits
+ * @size:	Size of buffer
+ * Return: length of the output, not including the terminator. If this is
+ *	@size or more, the output did not fit.
+ */
+int bootstage_scope_export(enum bootstage_trace_fmt fmt, char *buf, int size);
+#else
+static inline int bootstage_scope_start(enum bootstage_scope_type type,
+					const char *name)
+{
+	return 0;
+}
+
+static inline void bootstage_scope_end(int scope)
+{
+}
+
+static inline void bootstage_scope_report(uint min_us)
+{
+}
+
+static inline int bootstage_scope_export(enum bootstage_trace_fmt fmt,
+					 char *buf, int size)
+{
+	return 0;
+}
+#endif
+
 /* Helper macro for adding a bootstage to a line of code */
 #define BOOTSTAGE_MARKER()	\
 		bootstage_mark_code(__FILE__, __func__, __LINE__)
@@ -0,0 +1,171 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * eMMC Command Queue Host Controller Interface (CQHCI)
+ */
+
+#ifndef __CQHCI_H
+#define __CQHCI_H
+
+#include <blk.h>
+#include <linux/bitops.h>
+#include <linux/sizes.h>
+#include <linux/types.h>
+
+struct mmc;
+
+/* Registers, from the start of the CQHCI area */
+#define CQHCI_VER		0x00
+#define CQHCI_CAP		0x04
+#define CQHCI_CFG		0x08
+#define  CQHCI_CFG_ENABLE		BIT(0)
+#define  CQHCI_CFG_TASK_DESC_SZ	BIT(8)
+#define  CQHCI_CFG_DCMD		BIT(12)
+#define CQHCI_CTL		0x0c
+#define  CQHCI_CTL_HALT		BIT(0)
+#define  CQHCI_CTL_CLEAR_ALL_TASKS	BIT(8)
+#define CQHCI_IS		0x10
+#define CQHCI_ISTE		0x14
+#define CQHCI_ISGE		0x18
+#define  CQHCI_IS_HAC			BIT(0)
+#define  CQHCI_IS_TCC			BIT(1)
+#define  CQHCI_IS_RED			BIT(2)
+#define  CQHCI_IS_TCL			BIT(3)
+#define  CQHCI_IS_GCE			BIT(4)
+#define  CQHCI_IS_ICCE		BIT(5)
+#define  CQHCI_IS_MASK		(CQHCI_IS_TCC | CQHCI_IS_RED | \
+				 CQHCI_IS_GCE | CQHCI_IS_ICCE)
+#define  CQHCI_IS_ERROR		(CQHCI_IS_RED | CQHCI_IS_GCE | \
+				 CQHCI_IS_ICCE)
+#define CQHCI_IC		0x1c
+#define CQHCI_TDLBA		0x20
+#define CQHCI_TDLBAU		0x24
+#define CQHCI_TDBR		0x28
+#define CQHCI_TCN		0x2c
+#define CQHCI_DQS		0x30
+#define CQHCI_DPT		0x34
+#define CQHCI_TCLR		0x38
+#define CQHCI_SSC1		0x40
+#define CQHCI_SSC2		0x44
+#define CQHCI_TERRI		0x54
+#define  CQHCI_TERRI_CMD_TASK(x)	(((x) >> 8) & 0x1f)
+#define  CQHCI_TERRI_CMD_VALID	BIT(15)
+#define  CQHCI_TERRI_DAT_TASK(x)	(((x) >> 24) & 0x1f)
+#define  CQHCI_TERRI_DAT_VALID	BIT(31)
+
+/* Fields of task, transfer and link descriptors */
+#define CQHCI_VALID(x)		((u64)(x) << 0)
+#define CQHCI_END(x)		((u64)(x) << 1)
+#define CQHCI_INT(x)		((u64)(x) << 2)
+#define CQHCI_ACT(x)		((u64)(x) << 3)
+#define  CQHCI_ACT_TRAN		0x4
+#define  CQHCI_ACT_TASK		0x5
+#define  CQHCI_ACT_LINK		0x6
+#define CQHCI_DATA_DIR(x)	((u64)(x) << 12)
+#define CQHCI_BLK_COUNT(x)	((u64)(x) << 16)
+#define CQHCI_BLK_ADDR(x)	((u64)(x) << 32)
+#define CQHCI_DAT_LENGTH(x)	((u64)(x) << 16)
+
+#define CQHCI_NUM_SLOTS		32
+/* Largest transfer descriptor we use, and the most of them in a task */
+#define CQHCI_SEG_SIZE		SZ_32K
+#define CQHCI_MAX_SEGS		32
+
+/**
+ * struct cqhci_host - State of a command queue engine
+ *
+ * @mmio: Start of the CQHCI registers
+ * @mmc: MMC device the engine serves, while it is enabled
+ * @dma64: true to use 64-bit DMA addresses
+ * @desc: Task descriptor list, with a task and a link descriptor per slot
+ * @trans: Transfer descriptor lists, one per slot
+ * @slot_len: Length of a slot in @desc
+ * @trans_len: Length of a transfer descriptor
+ * @busy: Mask of slots with a task in progress
+ * @buf: DMA address of the data of each task
+ * @len: Number of bytes of data of each task
+ * @write: Mask of slots with a task which writes to the card
+ */
+struct cqhci_host {
+	void *mmio;
+	struct mmc *mmc;
+	bool dma64;
+	void *desc;
+	void *trans;
+	int slot_len;
+	int trans_len;
+	u32 busy;
+	dma_addr_t buf[CQHCI_NUM_SLOTS];
+	size_t len[CQHCI_NUM_SLOTS];
+	u32 write;
+};
+
+/**
+ * cqhci_init() - Set up a command queue engine
+ *
+ * Allocates the descriptor lists. The engine is left disabled.
+ *
+ * @cq:		Command queue engine
+ * @mmio:	Start of its registers
+ * @dma64:	true to use 64-bit DMA addresses
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+int cqhci_init(struct cqhci_host *cq, void *mmio, bool dma64);
+
+/**
+ * cqhci_free() - Free the descriptor lists of a command queue engine
+ *
+ * The engine must be disabled.
+ *
+ * @cq:		Command queue engine
+ */
+void cqhci_free(struct cqhci_host *cq);
+
+/**
+ * cqhci_enable() - Start the command queue engine
+ *
+ * The host must be set up for DMA transfers of 512-byte blocks. The card must
+ * be in command queue mode before any task is queued.
+ *
+ * @cq:		Command queue engine
+ * @mmc:	MMC device it serves
+ * @return number of task slots
+ */
+int cqhci_enable(struct cqhci_host *cq, struct mmc *mmc);
+
+/**
+ * cqhci_disable() - Stop the command queue engine
+ *
+ * @cq:		Command queue engine
+ * @return 0 if OK, -ETIMEDOUT if it did not halt
+ */
+int cqhci_disable(struct cqhci_host *cq);
+
+/**
+ * cqhci_request() - Queue a read or write task
+ *
+ * @cq:		Command queue engine
+ * @tag:	Slot to use, which must be free
+ * @write:	true to write to the card, false to read from it
+ * @start:	First block
+ * @blkcnt:	Number of blocks, at most CQHCI_MAX_SEGS * CQHCI_SEG_SIZE / 512
+ * @buf:	Data buffer
+ * @return 0 if OK, -EINVAL if the task is too large
+ */
+int cqhci_request(struct cqhci_host *cq, int tag, bool write, lbaint_t start,
+		  lbaint_t blkcnt, void *buf);
+
+/**
+ * cqhci_poll() - Find out which tasks are finished
+ *
+ * On an error the engine is halted and all its tasks are dropped; they are
+ * then returned as finished and failed.
+ *
+ * @cq:		Command queue engine
+ * @donep:	Returns the mask of tasks which finished since the last call
+ * @failedp:	Returns the mask of finished tasks which failed
+ * @return 0 if OK, -ETIMEDOUT if the engine could not be stopped after an
+ *	error
+ */
+int cqhci_poll(struct cqhci_host *cq, u32 *donep, u32 *failedp);
+
+#endif /* __CQHCI_H */
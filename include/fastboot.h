@@ -44,6 +44,9 @@ enum {
 #if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_BOOTBUS)
 	FASTBOOT_COMMAND_OEM_BOOTBUS,
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	FASTBOOT_COMMAND_OEM_STREAM,
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 	FASTBOOT_COMMAND_ACMD,
 	FASTBOOT_COMMAND_UCMD,
@@ -164,6 +167,15 @@ u32 fastboot_data_remaining(void);
 void fastboot_data_download(const void *fastboot_data,
 			    unsigned int fastboot_data_len, char *response);
 
+/**
+ * fastboot_data_flush() - Write out streamed data once enough has arrived
+ *
+ * Transports call this after each part of a download, once they are ready
+ * for the next one, so that it arrives while the data is being written.
+ * Does nothing unless the download is streamed ("oem stream").
+ */
+void fastboot_data_flush(void);
+
 /**
  * fastboot_data_complete() - Mark current transfer complete
  *
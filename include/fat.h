@@ -25,7 +25,11 @@ struct disk_partition;
 #define DIRENTSPERCLUST	((mydata->clust_size * mydata->sect_size) / \
 			 sizeof(dir_entry))
 
+#if defined(CONFIG_SPL_BUILD) || !defined(CONFIG_FS_FAT_FATBUF_BLOCKS)
 #define FATBUFBLOCKS	6
+#else
+#define FATBUFBLOCKS	CONFIG_FS_FAT_FATBUF_BLOCKS
+#endif
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
@@ -173,6 +177,8 @@ typedef struct {
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
 	__u8	fat_dirty;      /* Set if fatbuf has been modified */
+	__u16	dirty_start;	/* First modified sector in fatbuf */
+	__u16	dirty_end;	/* Sector after the last modified one */
 	__u32	rootdir_sect;	/* Start sector of root directory */
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
@@ -182,6 +188,7 @@ typedef struct {
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
 	int	fats;		/* Number of FATs */
+	__u32	next_free;	/* No free cluster below this, 0 if unknown */
 } fsdata;
 
 struct fat_itr;
@@ -32,6 +32,33 @@ int fastboot_mmc_get_part_info(const char *part_name,
  */
 void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 			      u32 download_bytes, char *response);
+
+/**
+ * fastboot_mmc_stream_start() - Get ready to write an image as it arrives
+ *
+ * @cmd: Named partition to write image to
+ * @max_size: Returns the size of the partition, in bytes
+ * @response: Pointer to fastboot response buffer
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_start(const char *cmd, u64 *max_size, char *response);
+
+/**
+ * fastboot_mmc_stream_write() - Write the next part of a streamed image
+ *
+ * Raw images are written in whole blocks and sparse images as far as their
+ * headers are complete; the bytes left over must be passed again, followed
+ * by more of the image.
+ *
+ * @data: Next bytes of the image
+ * @len: Number of bytes
+ * @last: true if this is the end of the image
+ * @response: Pointer to fastboot response buffer, set on error or at the end
+ * Return: number of bytes used, or -ve on error
+ */
+int fastboot_mmc_stream_write(const void *data, u32 len, bool last,
+			      char *response);
+
 /**
  * fastboot_mmc_flash_erase() - Erase eMMC for fastboot
  *
@@ -53,6 +53,9 @@ int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
  *	gzwrite_progress called during decompress/write loop
  *	gzwrite_progress_finish called at end of loop to
  *		indicate success (retcode=0) or failure
+ *	gzwrite_progress_stats called after a successful write with the
+ *		time taken and how much of it was spent waiting for the
+ *		device to finish writing
  */
 void gzwrite_progress_init(ulong expected_size);
 
@@ -61,13 +64,22 @@ void gzwrite_progress(int iteration, ulong bytes_written, ulong total_bytes);
 void gzwrite_progress_finish(int retcode, ulong totalwritten, ulong totalsize,
 			     u32 expected_crc, u32 calculated_crc);
 
+void gzwrite_progress_stats(ulong bytes_written, ulong elapsed_ms,
+			    ulong wait_ms);
+
 /**
  * gzwrite() - decompress and write gzipped image from memory to block device
  *
+ * Decompression overlaps with writing: while one buffer of @szwritebuf bytes
+ * is being filled, the ones before it are written to the device.
+ *
  * @src:	compressed image address
  * @len:	compressed image length in bytes
  * @dev:	block device descriptor
- * @szwritebuf:	bytes per write (pad to erase size)
+ * @szwritebuf:	bytes per write (pad to erase size). Writes are kept within
+ *		@szwritebuf-aligned regions of the device, so the first one
+ *		is shorter if @startoffs is not aligned. Smaller writes are
+ *		used if the buffers cannot be allocated
  * @startoffs:	offset in bytes of first write
  * @szexpected:	expected uncompressed length, may be zero to use gzip trailer
  *		for files under 4GiB
@@ -38,5 +38,76 @@ static inline int is_sparse_image(void *buf)
 	return 0;
 }
 
+/**
+ * struct sparse_stream - State of a sparse image written piece by piece
+ *
+ * @info: Where the image goes
+ * @part_name: Name of the partition, for messages
+ * @header: Sparse image header
+ * @chunk_header: Header of the current chunk
+ * @state: What the next bytes of the image hold
+ * @chunk: Number of chunks done
+ * @blk: Next block to write
+ * @blkcnt: Blocks of the current chunk still to write
+ * @skip: Bytes of the current chunk still to skip
+ * @bytes_written: Bytes written so far
+ * @total_blocks: Blocks of the output image done so far
+ */
+struct sparse_stream {
+	struct sparse_storage	*info;
+	const char		*part_name;
+	sparse_header_t		header;
+	chunk_header_t		chunk_header;
+	enum {
+		SPARSE_STREAM_HEADER,
+		SPARSE_STREAM_CHUNK,
+		SPARSE_STREAM_RAW,
+		SPARSE_STREAM_FILL,
+		SPARSE_STREAM_SKIP,
+		SPARSE_STREAM_DONE,
+	} state;
+	uint32_t		chunk;
+	lbaint_t		blk;
+	lbaint_t		blkcnt;
+	uint64_t		skip;
+	uint64_t		bytes_written;
+	uint32_t		total_blocks;
+};
+
+/**
+ * sparse_stream_init() - Get ready to write a sparse image piece by piece
+ *
+ * @ss: Stream state
+ * @info: Where the image goes
+ * @part_name: Name of the partition, for messages
+ */
+void sparse_stream_init(struct sparse_stream *ss, struct sparse_storage *info,
+			const char *part_name);
+
+/**
+ * sparse_stream_write() - Write the next piece of a sparse image
+ *
+ * Headers are only used once they are complete and raw data only in whole
+ * blocks of @info, so less than @len bytes may be used; the caller passes
+ * the rest again, followed by more of the image.
+ *
+ * @ss: Stream state
+ * @buf: Next bytes of the image
+ * @len: Number of bytes
+ * @response: Pointer to fastboot response buffer, for @info->mssg
+ * Return: number of bytes used, or -1 on error
+ */
+int sparse_stream_write(struct sparse_stream *ss, const void *buf, size_t len,
+			char *response);
+
+/**
+ * sparse_stream_finish() - Check that the whole sparse image was written
+ *
+ * @ss: Stream state
+ * @response: Pointer to fastboot response buffer, for @info->mssg
+ * Return: 0 if OK, -1 on error
+ */
+int sparse_stream_finish(struct sparse_stream *ss, char *response);
+
 int write_sparse_image(struct sparse_storage *info, const char *part_name,
 		       void *data, char *response);
@@ -308,6 +308,8 @@ typedef struct bootm_headers {
 	void		*fit_hdr_os;	/* os FIT image header */
 	const char	*fit_uname_os;	/* os subimage node unit name */
 	int		fit_noffset_os;	/* os subimage node offset */
+	int		fit_stream_os;	/* os hashes checked when loading it */
+	int		fit_stream_req;	/* next load may defer os hash checks */
 
 	void		*fit_hdr_rd;	/* init ramdisk FIT image header */
 	const char	*fit_uname_rd;	/* init ramdisk subimage node unit name */
@@ -1014,6 +1016,7 @@ int fit_image_get_data_and_size(const void *fit, int noffset,
 int fit_image_hash_get_algo(const void *fit, int noffset, char **algo);
 int fit_image_hash_get_value(const void *fit, int noffset, uint8_t **value,
 				int *value_len);
+int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore);
 
 int fit_set_timestamp(void *fit, int noffset, time_t timestamp);
 
@@ -1050,6 +1053,42 @@ int fit_add_verification_data(const char *keydir, const char *keyfile,
 int fit_image_verify_with_data(const void *fit, int image_noffset,
 			       const void *data, size_t size);
 int fit_image_verify(const void *fit, int noffset);
+
+/**
+ * fit_image_can_stream() - check if an image can be verified while loading
+ *
+ * This is possible if the image is uncompressed or gzip-compressed and is
+ * protected only by hashes. Images which must be signed or are encrypted
+ * need the full data before they can be checked.
+ *
+ * @fit:	FIT to check
+ * @noffset:	Offset of the image node
+ * @comp:	Compression used by the image (IH_COMP_...)
+ * @return true if fit_image_stream_load() can be used for this image
+ */
+bool fit_image_can_stream(const void *fit, int noffset, int comp);
+
+/**
+ * fit_image_stream_load() - verify and load an image in a single pass
+ *
+ * The image data is hashed in chunks, with each chunk copied or
+ * decompressed to the destination straight after it is hashed, so that
+ * the data is only read from memory once.
+ *
+ * @fit:	FIT containing the image
+ * @noffset:	Offset of the image node
+ * @comp:	Compression used by the image (IH_COMP_NONE or IH_COMP_GZIP)
+ * @src:	Image data
+ * @srclen:	Size of image data in bytes
+ * @dst:	Destination buffer, may be @src for an uncompressed image
+ * @dstlen:	Size of destination buffer in bytes
+ * @lenp:	Returns the number of bytes written to @dst, if not NULL
+ * @return 0 if OK, -EACCES if a hash does not match, -ENOSPC if the
+ * destination buffer is too small, other -ve value on other error
+ */
+int fit_image_stream_load(const void *fit, int noffset, int comp,
+			  const void *src, ulong srclen, void *dst,
+			  ulong dstlen, ulong *lenp);
 int fit_config_verify(const void *fit, int conf_noffset);
 int fit_all_image_verify(const void *fit);
 int fit_config_decrypt(const void *fit, int conf_noffset);
@@ -284,6 +284,20 @@ enum spi_nor_option_flags {
 
 struct spi_nor;
 
+/* Erase Types a flash can describe in its SFDP tables */
+#define SNOR_ERASE_TYPE_MAX	4
+
+/**
+ * struct spi_nor_erase_type - an erase command which works anywhere on the
+ *			       flash
+ * @size:	number of bytes erased, a power of two; 0 if unused
+ * @opcode:	erase opcode
+ */
+struct spi_nor_erase_type {
+	u32	size;
+	u8	opcode;
+};
+
 /**
  * struct spi_nor_hwcaps - Structure for describing the hardware capabilies
  * supported by the SPI controller (bus master).
@@ -493,6 +507,9 @@ struct spi_flash {
  * @cmd_buf:		used by the write_reg
  * @cmd_ext_type:	the command opcode extension for DTR mode.
  * @fixups:		flash-specific fixup hooks.
+ * @erase_types:	erase commands spi_nor_erase() may choose from, so that it
+ *			can erase large aligned regions at once. Empty if only
+ *			@erase_opcode is to be used
  * @prepare:		[OPTIONAL] do some preparations for the
  *			read/write/erase/lock/unlock operations
  * @unprepare:		[OPTIONAL] do some post work after the
@@ -540,6 +557,7 @@ struct spi_nor {
 	u8			cmd_buf[SPI_NOR_MAX_CMD_SIZE];
 	enum spi_nor_cmd_ext	cmd_ext_type;
 	struct spi_nor_fixups	*fixups;
+	struct spi_nor_erase_type erase_types[SNOR_ERASE_TYPE_MAX];
 
 	int (*setup)(struct spi_nor *nor, const struct flash_info *info,
 		     const struct spi_nor_flash_parameter *params);
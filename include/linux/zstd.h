@@ -1155,4 +1155,54 @@ struct abuf;
  */
 int zstd_decompress(struct abuf *in, struct abuf *out);
 
+/**
+ * struct zstd_stream - state for streaming Zstandard decompression
+ *
+ * @dctx:	Decompression context
+ * @workspace:	Memory used by @dctx
+ * @stage:	Gathers an input unit which is split across calls
+ * @stage_len:	Number of bytes in @stage
+ */
+struct zstd_stream {
+	ZSTD_DCtx *dctx;
+	void *workspace;
+	char *stage;
+	size_t stage_len;
+};
+
+/**
+ * zstd_stream_init() - Set up streaming decompression of a Zstandard frame
+ *
+ * The output must be written to a single buffer which stays in place until
+ * the end. The decompressor then refers back to that buffer and needs only a
+ * small, fixed amount of memory.
+ *
+ * @zs:		Stream to set up
+ * @return 0 if OK, -ENOMEM if out of memory, other -ve on error
+ */
+int zstd_stream_init(struct zstd_stream *zs);
+
+/**
+ * zstd_stream_decompress() - Decompress the next part of a Zstandard frame
+ *
+ * This consumes as much of @in as possible, updating @in->pos and @out->pos.
+ * @out must describe the same buffer on every call, though its size may
+ * grow.
+ *
+ * @zs:		Stream to use
+ * @in:		Compressed data
+ * @out:	Place to put the decompressed data
+ * @return 1 at the end of the frame, 0 if more input is needed, -ENOSPC if
+ * the output buffer is too small, other -ve on error
+ */
+int zstd_stream_decompress(struct zstd_stream *zs, ZSTD_inBuffer *in,
+			   ZSTD_outBuffer *out);
+
+/**
+ * zstd_stream_end() - Free the memory used by a stream
+ *
+ * @zs:		Stream to finish with
+ */
+void zstd_stream_end(struct zstd_stream *zs);
+
 #endif  /* ZSTD_H */
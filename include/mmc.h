@@ -112,6 +112,7 @@ struct bd_info;
 #define MMC_CMD_ERASE_GROUP_START	35
 #define MMC_CMD_ERASE_GROUP_END		36
 #define MMC_CMD_ERASE			38
+#define MMC_CMD_CMDQ_TASK_MGMT		48
 #define MMC_CMD_APP_CMD			55
 #define MMC_CMD_SPI_READ_OCR		58
 #define MMC_CMD_SPI_CRC_ON_OFF		59
@@ -213,6 +214,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 /*
  * EXT_CSD fields
  */
+#define EXT_CSD_CMDQ_MODE_EN		15	/* R/W */
 #define EXT_CSD_ENH_START_ADDR		136	/* R/W */
 #define EXT_CSD_ENH_SIZE_MULT		140	/* R/W */
 #define EXT_CSD_GP_SIZE_MULT		143	/* R/W */
@@ -242,6 +244,8 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
 #define EXT_CSD_GENERIC_CMD6_TIME       248     /* RO */
+#define EXT_CSD_CMDQ_DEPTH		307	/* RO */
+#define EXT_CSD_CMDQ_SUPPORT		308	/* RO */
 #define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
 
 /*
@@ -297,6 +301,12 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_EXTRACT_BOOT_PART(x)		(((x) >> 3) & 0x7)
 #define EXT_CSD_EXTRACT_PARTITION_ACCESS(x)	((x) & 0x7)
 
+#define EXT_CSD_CMDQ_DEPTH_MASK		0x1f
+#define EXT_CSD_CMDQ_SUPPORTED		BIT(0)
+
+/* CMD48 argument: throw away every task queued in the card */
+#define MMC_CMDQ_DISCARD_QUEUE		1
+
 #define EXT_CSD_BOOT_BUS_WIDTH_MODE(x)	(x << 3)
 #define EXT_CSD_BOOT_BUS_WIDTH_RESET(x)	(x << 2)
 #define EXT_CSD_BOOT_BUS_WIDTH_WIDTH(x)	(x)
@@ -355,6 +365,9 @@ enum mmc_voltage {
 /* Maximum block size for MMC */
 #define MMC_MAX_BLOCK_LEN	512
 
+/* Most blocks in one command queue task: 1MiB, which hosts must accept */
+#define MMC_CQE_MAX_BLKCNT	2048
+
 /* The number of MMC physical partitions.  These consist of:
  * boot partitions (2), general purpose partitions (4) in MMC v4.4.
  */
@@ -487,6 +500,25 @@ struct dm_mmc_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*execute_tuning)(struct udevice *dev, uint opcode);
+
+	/**
+	 * get_tuning() - Read back the result of the last tuning
+	 *
+	 * @dev:	Device to check
+	 * @val:	Returns the tuning result, in a host-specific form
+	 *		(e.g. a sampling tap delay)
+	 * @return 0 if OK, -ve if the host is not tuned or on error
+	 */
+	int (*get_tuning)(struct udevice *dev, u32 *val);
+
+	/**
+	 * set_tuning() - Apply a tuning result instead of tuning again
+	 *
+	 * @dev:	Device to set up
+	 * @val:	Tuning result, as returned by get_tuning()
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*set_tuning)(struct udevice *dev, u32 val);
 #endif
 
 	/**
@@ -535,6 +567,60 @@ struct dm_mmc_ops {
 	 * @return 0 if success, -ve on error
 	 */
 	int (*hs400_prepare_ddr)(struct udevice *dev);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	/**
+	 * cqe_enable() - Switch the host to command queueing
+	 *
+	 * The card is already in command queue mode. Until cqe_disable() is
+	 * called, only cqe_request() and cqe_poll() are used.
+	 *
+	 * @dev:	Device to switch
+	 * @return number of task slots, -ENOSYS if the host has no command
+	 *	queue engine, other -ve on error
+	 */
+	int (*cqe_enable)(struct udevice *dev);
+
+	/**
+	 * cqe_disable() - Leave command queueing
+	 *
+	 * Any tasks still queued in the host are dropped. The host must then
+	 * be able to send other commands, to take the card out of command
+	 * queue mode.
+	 *
+	 * @dev:	Device to switch
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_disable)(struct udevice *dev);
+
+	/**
+	 * cqe_request() - Queue a read or write task
+	 *
+	 * @dev:	Device to use
+	 * @tag:	Task slot to use, which must be free
+	 * @write:	true to write to the card, false to read from it
+	 * @start:	First block to transfer
+	 * @blkcnt:	Number of blocks, at most MMC_CQE_MAX_BLKCNT
+	 * @buf:	Data buffer
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_request)(struct udevice *dev, int tag, bool write,
+			   lbaint_t start, lbaint_t blkcnt, void *buf);
+
+	/**
+	 * cqe_poll() - Check for tasks which have completed
+	 *
+	 * This must not wait for the hardware.
+	 *
+	 * @dev:	Device to check
+	 * @donep:	Returns the mask of tasks which completed since the last
+	 *		call
+	 * @failedp:	Returns the mask of completed tasks which failed
+	 * @return 0 if OK, -ve if the queue stopped working (all tasks are
+	 *	then dropped)
+	 */
+	int (*cqe_poll)(struct udevice *dev, u32 *donep, u32 *failedp);
+#endif
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -544,6 +630,8 @@ int mmc_set_ios(struct mmc *mmc);
 int mmc_getcd(struct mmc *mmc);
 int mmc_getwp(struct mmc *mmc);
 int mmc_execute_tuning(struct mmc *mmc, uint opcode);
+int mmc_get_tuning(struct mmc *mmc, u32 *val);
+int mmc_set_tuning(struct mmc *mmc, u32 val);
 int mmc_wait_dat0(struct mmc *mmc, int state, int timeout_us);
 int mmc_set_enhanced_strobe(struct mmc *mmc);
 int mmc_host_power_cycle(struct mmc *mmc);
@@ -551,6 +639,11 @@ int mmc_deferred_probe(struct mmc *mmc);
 int mmc_reinit(struct mmc *mmc);
 int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt);
 int mmc_hs400_prepare_ddr(struct mmc *mmc);
+int mmc_cqe_enable(struct mmc *mmc);
+int mmc_cqe_disable(struct mmc *mmc);
+int mmc_cqe_request(struct mmc *mmc, int tag, bool write, lbaint_t start,
+		    lbaint_t blkcnt, void *buf);
+int mmc_cqe_poll(struct mmc *mmc, u32 *donep, u32 *failedp);
 #else
 struct mmc_ops {
 	int (*send_cmd)(struct mmc *mmc,
@@ -726,10 +819,46 @@ struct mmc {
 				  */
 	u32 quirks;
 	u8 hs400_tuning;
+#if CONFIG_IS_ENABLED(MMC_BUS_CACHE)
+	bool use_cached_tuning;	/* apply cached_tuning rather than tune */
+	u32 cached_tuning;
+#endif
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	u8 cmdq_depth;		/* tasks the card can queue, 0 if none */
+	struct mmc_cmdq *cmdq;	/* command queue state, see mmc_cmdq.c */
+#endif
 
 	enum bus_mode user_speed_mode; /* input speed mode from user */
 };
 
+#define MMC_BUS_CACHE_ENTRIES	4
+
+/**
+ * struct mmc_bus_cache - Bus settings handed on to later phases
+ *
+ * This is kept in the bloblist (BLOBLISTT_MMC_BUS) with MMC_BUS_CACHE, so
+ * that U-Boot proper can reuse what SPL found rather than trying each mode
+ * and tuning again.
+ *
+ * @cid: CID of the card, an empty entry has all zeroes
+ * @clock: Bus clock of the mode when it was selected, in Hz
+ * @tuning: Tuning result, as returned by mmc_get_tuning()
+ * @width: Bus width (MMC_MODE_...BIT)
+ * @mode: Bus mode (enum bus_mode)
+ * @has_tuning: true if @tuning is valid
+ */
+struct mmc_bus_cache {
+	struct mmc_bus_cache_entry {
+		u32 cid[4];
+		u32 clock;
+		u32 tuning;
+		u32 width;
+		u8 mode;
+		u8 has_tuning;
+		u8 spare[2];
+	} ent[MMC_BUS_CACHE_ENTRIES];
+};
+
 #if CONFIG_IS_ENABLED(DM_MMC)
 #define mmc_to_dev(_mmc)	_mmc->dev
 #else
@@ -107,6 +107,27 @@ enum eth_state_t {
 	ETH_STATE_ACTIVE
 };
 
+/**
+ * struct eth_stats - Traffic counters kept by an Ethernet driver
+ *
+ * @rx_packets: Frames received
+ * @rx_bytes: Bytes received
+ * @rx_errors: Received frames dropped because they were bad or incomplete
+ * @tx_packets: Frames sent
+ * @tx_bytes: Bytes sent
+ * @tx_errors: Frames which failed to send
+ * @tx_busy: Times a frame had to wait for the hardware to have room for it
+ */
+struct eth_stats {
+	u64 rx_packets;
+	u64 rx_bytes;
+	u64 rx_errors;
+	u64 tx_packets;
+	u64 tx_bytes;
+	u64 tx_errors;
+	u64 tx_busy;
+};
+
 #ifdef CONFIG_DM_ETH
 /**
  * struct eth_pdata - Platform data for Ethernet MAC controllers
@@ -159,6 +180,8 @@ enum eth_recv_flags {
  *		    to the network stack. This function should fill in the
  *		    eth_pdata::enetaddr field - optional
  * set_promisc: Enable or Disable promiscuous mode
+ * get_stats: Read the traffic counters kept since the device was probed -
+ *	      optional
  */
 struct eth_ops {
 	int (*start)(struct udevice *dev);
@@ -170,6 +193,7 @@ struct eth_ops {
 	int (*write_hwaddr)(struct udevice *dev);
 	int (*read_rom_hwaddr)(struct udevice *dev);
 	int (*set_promisc)(struct udevice *dev, bool enable);
+	int (*get_stats)(struct udevice *dev, struct eth_stats *stats);
 };
 
 #define eth_get_ops(dev) ((struct eth_ops *)(dev)->driver->ops)
@@ -184,6 +208,14 @@ unsigned char *eth_get_ethaddr(void); /* get the current device MAC */
 
 /* Used only when NetConsole is enabled */
 int eth_is_active(struct udevice *dev); /* Test device for active state */
+/**
+ * eth_get_stats() - Read the traffic counters of a device
+ *
+ * @dev: Ethernet device, which must be probed
+ * @stats: Returns the counters
+ * Return: 0 if OK, -ENOSYS if the driver does not keep any
+ */
+int eth_get_stats(struct udevice *dev, struct eth_stats *stats);
 int eth_init_state_only(void); /* Set active state */
 void eth_halt_state_only(void); /* Set passive state */
 #endif
@@ -371,6 +403,7 @@ struct vlan_ethernet_hdr {
 #define PROT_NCSI	0x88f8		/* NC-SI control packets        */
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -562,7 +595,7 @@ extern int		net_restart_wrap;	/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL, UDP
+	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL, UDP, WGET
 };
 
 extern char	net_boot_file_name[1024];/* Boot File name */
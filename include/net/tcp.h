@@ -0,0 +1,160 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Minimal TCP client, enough to fetch a file over a single connection
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+/*
+ *	Internet Protocol (IP) + TCP header, without TCP options.
+ */
+struct ip_tcp_hdr {
+	u8		ip_hl_v;	/* header length and version	*/
+	u8		ip_tos;		/* type of service		*/
+	u16		ip_len;		/* total length			*/
+	u16		ip_id;		/* identification		*/
+	u16		ip_off;		/* fragment offset field	*/
+	u8		ip_ttl;		/* time to live			*/
+	u8		ip_p;		/* protocol			*/
+	u16		ip_sum;		/* checksum			*/
+	struct in_addr	ip_src;		/* Source IP address		*/
+	struct in_addr	ip_dst;		/* Destination IP address	*/
+	u16		tcp_src;	/* TCP source port		*/
+	u16		tcp_dst;	/* TCP destination port		*/
+	u32		tcp_seq;	/* Sequence number		*/
+	u32		tcp_ack;	/* Acknowledgment number	*/
+	u8		tcp_hlen;	/* Header length in words << 4	*/
+	u8		tcp_flags;	/* TCP_... flags		*/
+	u16		tcp_win;	/* Receive window		*/
+	u16		tcp_xsum;	/* Checksum			*/
+	u16		tcp_urg;	/* Urgent pointer		*/
+} __attribute__((packed));
+
+#define IP_TCP_HDR_SIZE		(sizeof(struct ip_tcp_hdr))
+#define TCP_HDR_SIZE		(IP_TCP_HDR_SIZE - IP_HDR_SIZE)
+
+/* Flags in tcp_flags */
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PUSH	0x08
+#define TCP_ACK		0x10
+
+/* Largest segment we receive: an Ethernet MTU less the IP and TCP headers */
+#define TCP_MSS		(1500 - IP_TCP_HDR_SIZE)
+
+/**
+ * enum tcp_event - Change in the state of the connection
+ *
+ * @TCP_EV_CONNECTED: The connection is open and data may be sent
+ * @TCP_EV_CLOSED: The peer closed the connection after all its data was
+ *	passed on
+ * @TCP_EV_RESET: The peer refused or reset the connection
+ * @TCP_EV_TIMEOUT: The peer stopped responding
+ */
+enum tcp_event {
+	TCP_EV_CONNECTED,
+	TCP_EV_CLOSED,
+	TCP_EV_RESET,
+	TCP_EV_TIMEOUT,
+};
+
+/**
+ * tcp_rxhand_f - Handler for data received on the connection
+ *
+ * Data is passed on in order, exactly once.
+ *
+ * @data: Received data
+ * @len: Number of bytes
+ * Return: 0 if OK, -ve to reset the connection
+ */
+typedef int tcp_rxhand_f(const uchar *data, unsigned int len);
+
+/**
+ * tcp_evhand_f - Handler for changes in the state of the connection
+ *
+ * After any event other than TCP_EV_CONNECTED the connection is closed.
+ *
+ * @event: What happened
+ */
+typedef void tcp_evhand_f(enum tcp_event event);
+
+/**
+ * tcp_connect() - Open a connection
+ *
+ * Sends the SYN and returns; the handlers are called from the network loop
+ * as the connection progresses. Only one connection is supported, so this
+ * drops any earlier one.
+ *
+ * @dest: IP address of the server
+ * @dport: Port on the server
+ * @rx: Handler for received data
+ * @ev: Handler for connection events
+ */
+void tcp_connect(struct in_addr dest, int dport, tcp_rxhand_f *rx,
+		 tcp_evhand_f *ev);
+
+/**
+ * tcp_send() - Send data on the open connection
+ *
+ * The data is copied and sent again until the peer acknowledges it. It
+ * must fit in one segment and nothing else may be outstanding.
+ *
+ * @data: Data to send
+ * @len: Number of bytes
+ * Return: 0 if OK, -EBUSY if earlier data is unacknowledged, -EINVAL if it
+ *	is too long, -ENOTCONN if the connection is not open
+ */
+int tcp_send(const void *data, unsigned int len);
+
+/**
+ * tcp_close() - Close the connection
+ *
+ * Sends a FIN and forgets the connection, without waiting for the peer.
+ */
+void tcp_close(void);
+
+/**
+ * tcp_abort() - Reset the connection
+ *
+ * Sends a RST and forgets the connection.
+ */
+void tcp_abort(void);
+
+/**
+ * tcp_clear() - Forget the connection without sending anything
+ *
+ * Called when the network loop starts or ends, so that segments for an old
+ * connection do not reach its handlers.
+ */
+void tcp_clear(void);
+
+/**
+ * tcp_set_tcp_header() - Set up the IP and TCP headers of a segment
+ *
+ * The payload, if any, must already follow the headers: at
+ * IP_TCP_HDR_SIZE, as only the SYN carries options.
+ *
+ * @pkt: Start of the IP header
+ * @dest: Destination IP address
+ * @dport: Destination port
+ * @sport: Source port
+ * @payload_len: Number of bytes of payload
+ * @flags: TCP_... flags
+ * @seq: Sequence number
+ * @ack: Acknowledgment number
+ * Return: Size of the IP and TCP headers
+ */
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 flags, u32 seq, u32 ack);
+
+/**
+ * tcp_receive() - Handle a received TCP segment
+ *
+ * @ip: IP header of the segment
+ * @len: Length of the IP packet
+ */
+void tcp_receive(struct ip_tcp_hdr *ip, int len);
+
+#endif /* __TCP_H__ */
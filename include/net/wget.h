@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * HTTP download over the minimal TCP client
+ */
+
+#ifndef __WGET_H__
+#define __WGET_H__
+
+/* wget.c */
+void wget_start(void);	/* Begin HTTP download */
+
+#endif /* __WGET_H__ */
@@ -480,4 +480,24 @@ long os_get_time_offset(void);
  */
 void os_set_time_offset(long offset);
 
+/**
+ * os_thread_create() - start a host thread
+ *
+ * The thread shares U-Boot's memory but must not call into anything which
+ * is not safe to use from two threads at once, such as the console or
+ * malloc().
+ *
+ * @func:	function to run in the thread
+ * @arg:	argument for @func
+ * Return:	handle for the thread, or NULL on error
+ */
+void *os_thread_create(void (*func)(void *arg), void *arg);
+
+/**
+ * os_thread_join() - wait for a host thread to finish
+ *
+ * @thread:	handle returned by os_thread_create(), which is freed
+ */
+void os_thread_join(void *thread);
+
 #endif
@@ -124,6 +124,7 @@
 #define  SDHCI_INT_CARD_INSERT	BIT(6)
 #define  SDHCI_INT_CARD_REMOVE	BIT(7)
 #define  SDHCI_INT_CARD_INT	BIT(8)
+#define  SDHCI_INT_CQE		BIT(14)
 #define  SDHCI_INT_ERROR	BIT(15)
 #define  SDHCI_INT_TIMEOUT	BIT(16)
 #define  SDHCI_INT_CRC		BIT(17)
@@ -273,6 +274,9 @@ struct sdhci_ops {
 	int	(*set_ios_post)(struct sdhci_host *host);
 	void	(*set_clock)(struct sdhci_host *host, u32 div);
 	int (*platform_execute_tuning)(struct mmc *host, u8 opcode);
+	/* Read back / apply a tuning result, see struct dm_mmc_ops */
+	int (*platform_get_tuning)(struct mmc *host, u32 *val);
+	int (*platform_set_tuning)(struct mmc *host, u32 val);
 	int (*set_delay)(struct sdhci_host *host);
 	int	(*deferred_probe)(struct sdhci_host *host);
 	void (*set_clock_dividier)(struct sdhci_host *host, u32 clock, u32 *div);
@@ -309,6 +313,8 @@ struct sdhci_adma_desc {
 #endif
 } __packed;
 
+struct cqhci_host;
+
 struct sdhci_host {
 	const char *name;
 	void *ioaddr;
@@ -342,6 +348,10 @@ struct sdhci_host {
 	struct sdhci_adma_desc *adma_desc_table;
 #endif
 	uint adma_desc_table_extra_desc;
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	struct cqhci_host *cqhci;	/* Command queue engine, if any */
+	u32 cqe_int_enable;	/* SDHCI_INT_ENABLE to restore after the CQE */
+#endif
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
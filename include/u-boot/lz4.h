@@ -21,4 +21,23 @@
  */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/**
+ * LZ4_decompress_safe_partial() - Decompress part of a raw LZ4 block
+ *
+ * Decoding stops once at least @target bytes have been produced, so @src may
+ * be followed by unrelated data. The output may overlap the end of the input,
+ * as long as the input ends at least (@srcn / 256) + 32 bytes after the end of
+ * the output.
+ *
+ * @src: Start of the compressed block, with no frame header
+ * @dst: Destination for uncompressed data
+ * @srcn: Length of source data, or an upper bound on it
+ * @target: Number of bytes wanted
+ * @dstn: Size of the destination buffer, at least @target
+ * @return number of bytes written to @dst, which may be more than @target, or
+ *	a negative value if the compressed data is malformed
+ */
+int LZ4_decompress_safe_partial(const char *src, char *dst, int srcn,
+				int target, int dstn);
+
 #endif
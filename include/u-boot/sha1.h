@@ -81,6 +81,21 @@ void sha1_csum(const unsigned char *input, unsigned int ilen,
 void sha1_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/**
+ * \brief	   SHA-1 compression of whole 64-byte blocks
+ *
+ * Architectures may override this with a faster version, which can
+ * fall back to sha1_process_generic() if the CPU lacks support.
+ *
+ * \param ctx	   SHA-1 context
+ * \param data	   buffer holding the data
+ * \param blocks   number of 64-byte blocks in the buffer
+ */
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks);
+void sha1_process_generic(sha1_context *ctx, const unsigned char *data,
+			  unsigned int blocks);
+
 /**
  * \brief	   Output = HMAC-SHA-1( input buffer, hmac key )
  *
@@ -19,6 +19,21 @@ void sha256_starts(sha256_context * ctx);
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length);
 void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 
+/**
+ * sha256_process() - run the SHA-256 compression function over data
+ *
+ * Architectures may override this with a faster version, which can fall back
+ * to sha256_process_generic() if the CPU lacks support.
+ *
+ * @ctx:	SHA-256 context to update
+ * @data:	Data to process
+ * @blocks:	Number of 64-byte blocks in @data
+ */
+void sha256_process(sha256_context *ctx, const uint8_t *data,
+		    unsigned int blocks);
+void sha256_process_generic(sha256_context *ctx, const uint8_t *data,
+			    unsigned int blocks);
+
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
@@ -22,6 +22,22 @@ void sha512_starts(sha512_context * ctx);
 void sha512_update(sha512_context *ctx, const uint8_t *input, uint32_t length);
 void sha512_finish(sha512_context * ctx, uint8_t digest[SHA512_SUM_LEN]);
 
+/**
+ * sha512_process() - run the SHA-512 compression function over data
+ *
+ * This is used for both SHA-384 and SHA-512. Architectures may override it
+ * with a faster version, which can fall back to sha512_process_generic() if
+ * the CPU lacks support.
+ *
+ * @ctx:	SHA-512 context to update
+ * @data:	Data to process
+ * @blocks:	Number of 128-byte blocks in @data
+ */
+void sha512_process(sha512_context *ctx, const uint8_t *data,
+		    unsigned int blocks);
+void sha512_process_generic(sha512_context *ctx, const uint8_t *data,
+			    unsigned int blocks);
+
 void sha512_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
@@ -0,0 +1,236 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Running boot-time work on secondary CPUs
+ *
+ * The boot CPU queues self-contained pieces of work (hashing, clearing or
+ * testing memory) which are picked up by the other CPUs. Work functions run
+ * without a console, driver model or malloc(), so they must only touch the
+ * memory they are given.
+ */
+
+#ifndef __WORKER_H
+#define __WORKER_H
+
+#include <linux/string.h>
+#include <linux/types.h>
+
+struct worker_job;
+
+/**
+ * typedef worker_func_t - function which does some work
+ *
+ * @arg:	Argument passed to worker_submit()
+ * Return: value to pass back to worker_wait()
+ */
+typedef int (*worker_func_t)(void *arg);
+
+/**
+ * typedef worker_range_func_t - function which works on part of a range
+ *
+ * @arg:	Argument passed to worker_run_range()
+ * @start:	Start of the part to work on
+ * @end:	End of the part (exclusive)
+ * Return: number of problems found (e.g. memory errors), or -ve on error
+ */
+typedef long (*worker_range_func_t)(void *arg, ulong start, ulong end);
+
+/**
+ * struct worker_job - a piece of work for a secondary CPU
+ *
+ * This is owned by the caller, typically on its stack, and must stay in place
+ * until worker_wait() returns.
+ *
+ * @func:	Function to call
+ * @arg:	Argument for @func
+ * @ret:	Value returned by @func
+ * @done:	Set to 1 once @func has returned
+ */
+struct worker_job {
+	worker_func_t func;
+	void *arg;
+	int ret;
+	int done;
+};
+
+/**
+ * enum worker_state - state of a secondary CPU
+ *
+ * @WORKER_OFF:		Not started, or stopped again
+ * @WORKER_RUNNING:	Waiting for, or running, jobs
+ * @WORKER_PARKED:	Finished with jobs and about to stop
+ */
+enum worker_state {
+	WORKER_OFF,
+	WORKER_RUNNING,
+	WORKER_PARKED,
+};
+
+/**
+ * struct worker_cpu - a secondary CPU in the worker pool
+ *
+ * @index:	Index of this CPU in the pool
+ * @id:		Architecture-specific CPU ID (e.g. MPIDR on ARM)
+ * @state:	Current state (enum worker_state)
+ * @priv:	Private data for the architecture code
+ */
+struct worker_cpu {
+	int index;
+	ulong id;
+	int state;
+	void *priv;
+};
+
+#if CONFIG_IS_ENABLED(WORKER)
+/**
+ * worker_count() - Get the number of secondary CPUs taking jobs
+ *
+ * This starts the secondary CPUs the first time it is called.
+ *
+ * Return: number of running secondary CPUs, 0 if none
+ */
+int worker_count(void);
+
+/**
+ * worker_submit() - Queue a job to run on a secondary CPU
+ *
+ * If there are no secondary CPUs, or the queue is full, the job is run
+ * straight away on the calling CPU.
+ *
+ * @job:	Job to queue
+ * @func:	Function to call
+ * @arg:	Argument for @func
+ */
+void worker_submit(struct worker_job *job, worker_func_t func, void *arg);
+
+/**
+ * worker_wait() - Wait for a job to finish
+ *
+ * While waiting, the calling CPU runs any jobs still in the queue.
+ *
+ * @job:	Job to wait for
+ * Return: value returned by the job function
+ */
+int worker_wait(struct worker_job *job);
+
+/**
+ * worker_run_range() - Split work on a range of addresses between all CPUs
+ *
+ * The range is split into one piece per CPU, including the calling one, and
+ * @func is called on each piece. Small ranges are handled by the calling CPU
+ * alone.
+ *
+ * @start:	Start of range
+ * @end:	End of range (exclusive)
+ * @align:	Alignment of the split points, must be a power of two (e.g. the
+ *		cache-line size, so that CPUs do not share lines)
+ * @func:	Function to call for each piece
+ * @arg:	Argument for @func
+ * Return: total of the values returned by @func, or the first -ve value
+ */
+long worker_run_range(ulong start, ulong end, ulong align,
+		      worker_range_func_t func, void *arg);
+
+/**
+ * worker_memset() - Fill a large region of memory using all CPUs
+ *
+ * @s:		Region to fill
+ * @c:		Byte value to fill with
+ * @count:	Number of bytes to fill
+ * Return: @s
+ */
+void *worker_memset(void *s, int c, size_t count);
+
+/**
+ * worker_park() - Stop all secondary CPUs
+ *
+ * This must be called before handing control to an OS, which expects the
+ * secondary CPUs to be off. The pool is started again if more work is
+ * submitted later.
+ *
+ * Return: 0 if OK, -ETIMEDOUT if a CPU did not stop
+ */
+int worker_park(void);
+
+/**
+ * worker_main() - Take and run jobs until told to park
+ *
+ * This is called by the architecture code on each secondary CPU once it is
+ * running with the same memory map as the boot CPU. It returns when the
+ * pool is parked; the CPU must then switch itself off.
+ *
+ * @wc:		CPU this is running on
+ */
+void worker_main(struct worker_cpu *wc);
+
+/**
+ * arch_worker_cpus() - Get the IDs of the secondary CPUs
+ *
+ * @ids:	Returns the ID of each secondary CPU
+ * @max:	Maximum number of IDs to return
+ * Return: number of IDs returned
+ */
+int arch_worker_cpus(ulong *ids, int max);
+
+/**
+ * arch_worker_start() - Start a secondary CPU
+ *
+ * The CPU must call worker_main() and switch off when it returns.
+ *
+ * @wc:		CPU to start, with @wc->id set
+ * Return: 0 if OK, -ve on error
+ */
+int arch_worker_start(struct worker_cpu *wc);
+
+/**
+ * arch_worker_stop() - Wait for a secondary CPU to switch off
+ *
+ * This is called after worker_main() has returned (or is about to) on @wc.
+ *
+ * @wc:		CPU to wait for
+ * Return: 0 if OK, -ETIMEDOUT if it did not switch off
+ */
+int arch_worker_stop(struct worker_cpu *wc);
+
+/**
+ * arch_worker_idle() - Pause briefly while polling for something to happen
+ *
+ * This is used by CPUs waiting for a job or for a job to finish. It must
+ * return after a short time even if nothing has changed.
+ */
+void arch_worker_idle(void);
+#else
+static inline int worker_count(void)
+{
+	return 0;
+}
+
+static inline void worker_submit(struct worker_job *job, worker_func_t func,
+				 void *arg)
+{
+	job->ret = func(arg);
+	job->done = 1;
+}
+
+static inline int worker_wait(struct worker_job *job)
+{
+	return job->ret;
+}
+
+static inline long worker_run_range(ulong start, ulong end, ulong align,
+				    worker_range_func_t func, void *arg)
+{
+	return start < end ? func(arg, start, end) : 0;
+}
+
+static inline void *worker_memset(void *s, int c, size_t count)
+{
+	return memset(s, c, count);
+}
+
+static inline int worker_park(void)
+{
+	return 0;
+}
+#endif
+
+#endif /* __WORKER_H */
@@ -12,10 +12,104 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <u-boot/crc.h>
+#include <asm/global_data.h>
+#ifdef CONFIG_ARM64_CRC32
+#include <asm/system.h>
+#endif
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Bit-reflected Castagnoli polynomial, as implemented by the crc32c insns */
+#define CRC32C_POLY		0x82f63b78
+
+#if CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+/*
+ * Tables for slicing-by-8, built from the last table passed to crc32c_cal().
+ * The entry for 0x80 in a byte-wise table is the polynomial itself, so this
+ * is used to tell whether the tables need to be rebuilt. They are in BSS, so
+ * they are only used after relocation.
+ */
+static uint32_t crc32c_table8_poly;
+static uint32_t crc32c_table8[8][256];
+
+static void crc32c_make_table8(const uint32_t *crc32c_table)
+{
+	uint32_t c;
+	int n, k;
+
+	memcpy(crc32c_table8[0], crc32c_table, sizeof(crc32c_table8[0]));
+	for (n = 0; n < 256; n++) {
+		c = crc32c_table[n];
+		for (k = 1; k < 8; k++) {
+			c = crc32c_table[c & 0xff] ^ (c >> 8);
+			crc32c_table8[k][n] = c;
+		}
+	}
+	crc32c_table8_poly = crc32c_table[0x80];
+}
+
+static uint32_t crc32c_slice8(uint32_t crc, const u8 *p, int length,
+			      const uint32_t *crc32c_table)
+{
+	uint32_t lo, hi;
+
+	if (crc32c_table8_poly != crc32c_table[0x80])
+		crc32c_make_table8(crc32c_table);
+
+	for (; length && ((ulong)p & 7); length--)
+		crc = crc32c_table8[0][(u8)(crc ^ *p++)] ^ (crc >> 8);
+
+	for (; length >= 8; length -= 8, p += 8) {
+		lo = crc ^ le32_to_cpu(*(const uint32_t *)p);
+		hi = le32_to_cpu(*(const uint32_t *)(p + 4));
+		crc = crc32c_table8[7][lo & 0xff] ^
+		      crc32c_table8[6][(lo >> 8) & 0xff] ^
+		      crc32c_table8[5][(lo >> 16) & 0xff] ^
+		      crc32c_table8[4][lo >> 24] ^
+		      crc32c_table8[3][hi & 0xff] ^
+		      crc32c_table8[2][(hi >> 8) & 0xff] ^
+		      crc32c_table8[1][(hi >> 16) & 0xff] ^
+		      crc32c_table8[0][hi >> 24];
+	}
+
+	for (; length; length--)
+		crc = crc32c_table8[0][(u8)(crc ^ *p++)] ^ (crc >> 8);
+
+	return crc;
+}
+#endif
+
+#ifdef CONFIG_ARM64_CRC32
+static uint32_t crc32c_arm64(uint32_t crc, const u8 *p, int length)
+{
+	for (; length && ((ulong)p & 7); length--)
+		crc = __builtin_aarch64_crc32cb(crc, *p++);
+
+	for (; length >= 8; length -= 8, p += 8)
+		crc = __builtin_aarch64_crc32cx(crc,
+					le64_to_cpu(*(const uint64_t *)p));
+
+	for (; length; length--)
+		crc = __builtin_aarch64_crc32cb(crc, *p++);
+
+	return crc;
+}
+#endif
 
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table)
 {
+#ifdef CONFIG_ARM64_CRC32
+	if (crc32c_table[0x80] == CRC32C_POLY &&
+	    (get_id_aa64isar0() & ID_AA64ISAR0_EL1_CRC32))
+		return crc32c_arm64(crc, (const u8 *)data, length);
+#endif
+#if CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+	if (gd->flags & GD_FLG_RELOC)
+		return crc32c_slice8(crc, (const u8 *)data, length,
+				     crc32c_table);
+#endif
 	while (length--)
 		crc = crc32c_table[(u8)(crc ^ *data++)] ^ (crc >> 8);
 
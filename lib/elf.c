@@ -10,6 +10,7 @@
 #include <env.h>
 #include <net.h>
 #include <vxworks.h>
+#include <worker.h>
 #ifdef CONFIG_X86
 #include <vbe.h>
 #include <asm/e820.h>
@@ -42,8 +43,8 @@ unsigned long load_elf64_image_phdr(unsigned long addr)
 		if (phdr->p_filesz)
 			memcpy(dst, src, phdr->p_filesz);
 		if (phdr->p_filesz != phdr->p_memsz)
-			memset(dst + phdr->p_filesz, 0x00,
-			       phdr->p_memsz - phdr->p_filesz);
+			worker_memset(dst + phdr->p_filesz, 0x00,
+				      phdr->p_memsz - phdr->p_filesz);
 		flush_cache(rounddown((unsigned long)dst, ARCH_DMA_MINALIGN),
 			    roundup(phdr->p_memsz, ARCH_DMA_MINALIGN));
 		++phdr;
@@ -100,8 +101,8 @@ unsigned long load_elf64_image_shdr(unsigned long addr)
 		}
 
 		if (shdr->sh_type == SHT_NOBITS) {
-			memset((void *)(uintptr_t)shdr->sh_addr, 0,
-			       shdr->sh_size);
+			worker_memset((void *)(uintptr_t)shdr->sh_addr, 0,
+				      shdr->sh_size);
 		} else {
 			image = (unsigned char *)addr + (ulong)shdr->sh_offset;
 			memcpy((void *)(uintptr_t)shdr->sh_addr,
@@ -157,8 +158,8 @@ unsigned long load_elf_image_phdr(unsigned long addr)
 		if (phdr->p_filesz)
 			memcpy(dst, src, phdr->p_filesz);
 		if (phdr->p_filesz != phdr->p_memsz)
-			memset(dst + phdr->p_filesz, 0x00,
-			       phdr->p_memsz - phdr->p_filesz);
+			worker_memset(dst + phdr->p_filesz, 0x00,
+				      phdr->p_memsz - phdr->p_filesz);
 		flush_cache(rounddown((unsigned long)dst, ARCH_DMA_MINALIGN),
 			    roundup(phdr->p_memsz, ARCH_DMA_MINALIGN));
 		++phdr;
@@ -205,8 +206,8 @@ unsigned long load_elf_image_shdr(unsigned long addr)
 		}
 
 		if (shdr->sh_type == SHT_NOBITS) {
-			memset((void *)(uintptr_t)shdr->sh_addr, 0,
-			       shdr->sh_size);
+			worker_memset((void *)(uintptr_t)shdr->sh_addr, 0,
+				      shdr->sh_size);
 		} else {
 			image = (unsigned char *)addr + shdr->sh_offset;
 			memcpy((void *)(uintptr_t)shdr->sh_addr,
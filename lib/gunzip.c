@@ -13,8 +13,10 @@
 #include <image.h>
 #include <malloc.h>
 #include <memalign.h>
+#include <time.h>
 #include <u-boot/crc.h>
 #include <watchdog.h>
+#include <linux/sizes.h>
 #include <u-boot/zlib.h>
 
 #define HEADER0			'\x1f'
@@ -116,6 +118,94 @@ void gzwrite_progress_finish(int returnval,
 	}
 }
 
+__weak
+void gzwrite_progress_stats(ulong bytes_written, ulong elapsed_ms,
+			    ulong wait_ms)
+{
+	if (!elapsed_ms)
+		return;
+
+	putc('\t');
+	print_size(lldiv((u64)bytes_written * 1000, elapsed_ms), "/s");
+	printf(", waited for the device %lu%% of %lu ms\n",
+	       wait_ms * 100 / elapsed_ms, elapsed_ms);
+}
+
+/*
+ * Number of buffers gzwrite() inflates into: one is filled while the others
+ * are written to the device
+ */
+#define GZWRITE_NUM_BUFS	3
+/* Bytes inflated between calls to blk_poll() */
+#define GZWRITE_STEP		SZ_64K
+
+struct gzwrite_buf {
+	unsigned char *data;
+#if CONFIG_IS_ENABLED(BLK)
+	struct blk_request req;
+#endif
+	bool busy;
+};
+
+/* Let the device make progress on writes which are in flight */
+static void gzwrite_poll(struct blk_desc *dev)
+{
+#if CONFIG_IS_ENABLED(BLK)
+	blk_poll(dev);
+#endif
+}
+
+/* Start writing the first @blkcnt blocks of @buf at block @start */
+static int gzwrite_submit(struct blk_desc *dev, struct gzwrite_buf *buf,
+			  lbaint_t start, lbaint_t blkcnt)
+{
+#if CONFIG_IS_ENABLED(BLK)
+	int ret;
+
+	buf->req.op = BLK_REQ_WRITE;
+	buf->req.start = start;
+	buf->req.blkcnt = blkcnt;
+	buf->req.buffer = buf->data;
+	buf->req.end_io = NULL;
+	ret = blk_submit(dev, &buf->req);
+	if (!ret)
+		buf->busy = true;
+#else
+	int ret = 0;
+
+	if (blk_dwrite(dev, start, blkcnt, buf->data) != blkcnt)
+		ret = -EIO;
+#endif
+	if (ret)
+		printf("%s: write at block " LBAF " failed: %d\n", __func__,
+		       start, ret);
+
+	return ret;
+}
+
+/* Wait until @buf may be filled again, adding the time taken to @wait_ms */
+static int gzwrite_wait(struct blk_desc *dev, struct gzwrite_buf *buf,
+			ulong *wait_ms)
+{
+	int ret = 0;
+#if CONFIG_IS_ENABLED(BLK)
+	ulong start;
+
+	if (!buf->busy)
+		return 0;
+
+	start = get_timer(0);
+	ret = blk_wait(dev, &buf->req);
+	*wait_ms += get_timer(start);
+	buf->busy = false;
+	if (ret)
+		printf("%s: write at block " LBAF " failed: %d\n", __func__,
+		       buf->req.start, ret);
+#endif
+
+	return ret;
+}
+
 int gzwrite(unsigned char *src, int len,
 	    struct blk_desc *dev,
 	    unsigned long szwritebuf,
@@ -125,10 +215,14 @@ int gzwrite(unsigned char *src, int len,
 	int i, flags;
 	z_stream s;
 	int r = 0;
-	unsigned char *writebuf;
+	struct gzwrite_buf bufs[GZWRITE_NUM_BUFS] = {};
+	struct gzwrite_buf *buf;
+	int nbufs, cur = 0;
+	ulong fill = 0, bufsize;
 	unsigned crc = 0;
 	ulong totalfilled = 0;
-	lbaint_t blksperbuf, outblock;
+	ulong start_time, wait_ms = 0;
+	lbaint_t outblock;
 	u32 expected_crc;
 	u32 payload_size;
 	int iteration = 0;
@@ -147,7 +241,6 @@ int gzwrite(unsigned char *src, int len,
 		return -1;
 	}
 
-	blksperbuf = szwritebuf / dev->blksz;
 	outblock = lldiv(startoffs, dev->blksz);
 
 	/* skip header */
@@ -192,6 +285,26 @@ int gzwrite(unsigned char *src, int len,
 		return -1;
 	}
 
+	/*
+	 * Make do with fewer buffers if memory is short, then with smaller
+	 * ones. Halving keeps the writes within the same aligned regions.
+	 */
+	for (;;) {
+		for (nbufs = 0; nbufs < GZWRITE_NUM_BUFS; nbufs++) {
+			bufs[nbufs].data = malloc_cache_aligned(szwritebuf);
+			if (!bufs[nbufs].data)
+				break;
+		}
+		if (nbufs)
+			break;
+		if ((szwritebuf / 2) % dev->blksz) {
+			printf("%s: cannot allocate %lu bytes\n", __func__,
+			       szwritebuf);
+			return -1;
+		}
+		szwritebuf /= 2;
+	}
+
 	gzwrite_progress_init(szexpected);
 
 	s.zalloc = gzalloc;
@@ -200,59 +313,79 @@ int gzwrite(unsigned char *src, int len,
 	r = inflateInit2(&s, -MAX_WBITS);
 	if (r != Z_OK) {
 		printf("Error: inflateInit2() returned %d\n", r);
-		return -1;
+		r = -1;
+		goto out_free;
 	}
 
 	s.next_in = src + i;
 	s.avail_in = payload_size+8;
-	writebuf = (unsigned char *)malloc_cache_aligned(szwritebuf);
-
-	/* decompress until deflate stream ends or end of file */
+	start_time = get_timer(0);
+
+	/*
+	 * Keep each write within one szwritebuf-sized (e.g. erase group)
+	 * region of the device, by making the first one short if needed
+	 */
+	bufsize = szwritebuf - startoffs % szwritebuf;
+
+	/*
+	 * Decompress until the deflate stream ends. Each full buffer is
+	 * handed to the device and inflating carries on into the next one,
+	 * waiting only when that is still being written.
+	 */
 	do {
+		lbaint_t writeblocks;
+		ulong numfilled;
+
 		if (s.avail_in == 0) {
 			printf("%s: weird termination with result %d\n",
 			       __func__, r);
 			break;
 		}
 
-		/* run inflate() on input until output buffer not full */
-		do {
-			unsigned long blocks_written;
-			int numfilled;
-			lbaint_t writeblocks;
-
-			s.avail_out = szwritebuf;
-			s.next_out = writebuf;
-			r = inflate(&s, Z_SYNC_FLUSH);
-			if ((r != Z_OK) &&
-			    (r != Z_STREAM_END)) {
-				printf("Error: inflate() returned %d\n", r);
-				goto out;
-			}
-			numfilled = szwritebuf - s.avail_out;
-			crc = crc32(crc, writebuf, numfilled);
-			totalfilled += numfilled;
-			if (numfilled < szwritebuf) {
-				writeblocks = (numfilled+dev->blksz-1)
-						/ dev->blksz;
-				memset(writebuf+numfilled, 0,
-				       dev->blksz-(numfilled%dev->blksz));
-			} else {
-				writeblocks = blksperbuf;
-			}
+		buf = &bufs[cur];
+		s.next_out = buf->data + fill;
+		s.avail_out = min_t(ulong, bufsize - fill, GZWRITE_STEP);
+		r = inflate(&s, Z_SYNC_FLUSH);
+		if ((r != Z_OK) &&
+		    (r != Z_STREAM_END)) {
+			printf("Error: inflate() returned %d\n", r);
+			r = -1;
+			goto out;
+		}
+		numfilled = s.next_out - (buf->data + fill);
+		crc = crc32(crc, buf->data + fill, numfilled);
+		fill += numfilled;
+		totalfilled += numfilled;
+		gzwrite_poll(dev);
+
+		if (fill == bufsize || r == Z_STREAM_END) {
+			writeblocks = DIV_ROUND_UP(fill, dev->blksz);
+			memset(buf->data + fill, 0,
+			       writeblocks * dev->blksz - fill);
 
 			gzwrite_progress(iteration++,
 					 totalfilled,
 					 szexpected);
-			blocks_written = blk_dwrite(dev, outblock,
-						    writeblocks, writebuf);
-			outblock += blocks_written;
-			if (ctrlc()) {
-				puts("abort\n");
+			if (gzwrite_submit(dev, buf, outblock, writeblocks)) {
+				r = -1;
 				goto out;
 			}
-			WATCHDOG_RESET();
-		} while (s.avail_out == 0);
+			outblock += writeblocks;
+			fill = 0;
+			bufsize = szwritebuf;
+
+			cur = (cur + 1) % nbufs;
+			if (gzwrite_wait(dev, &bufs[cur], &wait_ms)) {
+				r = -1;
+				goto out;
+			}
+		}
+		if (ctrlc()) {
+			puts("abort\n");
+			r = -1;
+			goto out;
+		}
+		WATCHDOG_RESET();
 		/* done when inflate() says it's done */
 	} while (r != Z_STREAM_END);
 
@@ -263,10 +396,20 @@ int gzwrite(unsigned char *src, int len,
 		r = 0;
 
 out:
+	/* The buffers must not be freed while the device may still use them */
+	for (i = 0; i < nbufs; i++) {
+		if (gzwrite_wait(dev, &bufs[i], &wait_ms))
+			r = -1;
+	}
 	gzwrite_progress_finish(r, totalfilled, szexpected,
 				expected_crc, crc);
-	free(writebuf);
+	if (!r)
+		gzwrite_progress_stats(totalfilled, get_timer(start_time),
+				       wait_ms);
 	inflateEnd(&s);
+out_free:
+	for (i = 0; i < nbufs; i++)
+		free(bufs[i].data);
 
 	return r;
 }
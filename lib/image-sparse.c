@@ -49,217 +49,295 @@
 
 static void default_log(const char *ignored, char *response) {}
 
-int write_sparse_image(struct sparse_storage *info,
-		       const char *part_name, void *data, char *response)
+static int sparse_write_fill(struct sparse_stream *ss, uint32_t fill_val,
+			     lbaint_t blkcnt, char *response)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
-	lbaint_t blks;
-	uint64_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int offset;
-	uint64_t chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
+	struct sparse_storage *info = ss->info;
 	int fill_buf_num_blks;
+	uint32_t *fill_buf;
+	lbaint_t blks;
 	int i;
 	int j;
 
 	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
+	fill_buf = (uint32_t *)
+		   memalign(ARCH_DMA_MINALIGN,
+			    ROUNDUP(info->blksz * fill_buf_num_blks,
+				    ARCH_DMA_MINALIGN));
+	if (!fill_buf) {
+		info->mssg("Malloc failed for: CHUNK_TYPE_FILL", response);
+		return -1;
+	}
 
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *)data;
+	for (i = 0; i < (info->blksz * fill_buf_num_blks / sizeof(fill_val));
+	     i++)
+		fill_buf[i] = fill_val;
 
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t)) {
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
+	for (i = 0; i < blkcnt;) {
+		j = blkcnt - i;
+		if (j > fill_buf_num_blks)
+			j = fill_buf_num_blks;
+		blks = info->write(info, ss->blk, j, fill_buf);
+		/* blks might be > j (eg. NAND bad-blocks) */
+		if (blks < j) {
+			printf("%s: %s " LBAFU " [%d]\n", __func__,
+			       "Write failed, block #", ss->blk, j);
+			info->mssg("flash write failure", response);
+			free(fill_buf);
+			return -1;
+		}
+		ss->blk += blks;
+		i += j;
 	}
+	free(fill_buf);
 
-	if (!info->mssg)
-		info->mssg = default_log;
+	return 0;
+}
 
-	debug("=== Sparse Image Header ===\n");
-	debug("magic: 0x%x\n", sparse_header->magic);
-	debug("major_version: 0x%x\n", sparse_header->major_version);
-	debug("minor_version: 0x%x\n", sparse_header->minor_version);
-	debug("file_hdr_sz: %d\n", sparse_header->file_hdr_sz);
-	debug("chunk_hdr_sz: %d\n", sparse_header->chunk_hdr_sz);
-	debug("blk_sz: %d\n", sparse_header->blk_sz);
-	debug("total_blks: %d\n", sparse_header->total_blks);
-	debug("total_chunks: %d\n", sparse_header->total_chunks);
-
-	/*
-	 * Verify that the sparse block size is a multiple of our
-	 * storage backend block size
-	 */
-	div_u64_rem(sparse_header->blk_sz, info->blksz, &offset);
-	if (offset) {
-		printf("%s: Sparse image block size issue [%u]\n",
-		       __func__, sparse_header->blk_sz);
-		info->mssg("sparse image block size issue", response);
-		return -1;
+/* Check a chunk header and set up to take the data which follows it */
+static int sparse_start_chunk(struct sparse_stream *ss, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	sparse_header_t *sparse_header = &ss->header;
+	chunk_header_t *chunk_header = &ss->chunk_header;
+	uint64_t chunk_data_sz;
+	lbaint_t blkcnt;
+
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
 	}
 
-	puts("Flashing Sparse Image\n");
+	chunk_data_sz = ((u64)sparse_header->blk_sz) * chunk_header->chunk_sz;
+	blkcnt = DIV_ROUND_UP_ULL(chunk_data_sz, info->blksz);
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
+			info->mssg("Bogus chunk size for chunk type Raw",
+				   response);
+			return -1;
+		}
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
+			info->mssg("Bogus chunk size for chunk type FILL",
+				   response);
+			return -1;
+		}
+		break;
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk = 0; chunk < sparse_header->total_chunks; chunk++) {
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *)data;
-		data += sizeof(chunk_header_t);
+	case CHUNK_TYPE_DONT_CARE:
+		ss->blk += info->reserve(info, ss->blk, blkcnt);
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->chunk++;
+		return 0;
 
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz != sparse_header->chunk_hdr_sz) {
+			info->mssg("Bogus chunk size for chunk type Dont Care",
+				   response);
+			return -1;
 		}
+		ss->skip = chunk_data_sz;
+		ss->state = SPARSE_STREAM_SKIP;
+		return 0;
+
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		info->mssg("Unknown chunk type", response);
+		return -1;
+	}
+
+	if (ss->blk + blkcnt > info->start + info->size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		info->mssg("Request would exceed partition size!", response);
+		return -1;
+	}
+	ss->blkcnt = blkcnt;
+	ss->state = chunk_header->chunk_type == CHUNK_TYPE_RAW ?
+		    SPARSE_STREAM_RAW : SPARSE_STREAM_FILL;
+
+	return 0;
+}
+
+void sparse_stream_init(struct sparse_stream *ss, struct sparse_storage *info,
+			const char *part_name)
+{
+	memset(ss, '\0', sizeof(*ss));
+	ss->info = info;
+	ss->part_name = part_name;
+	ss->blk = info->start;
+	ss->state = SPARSE_STREAM_HEADER;
+
+	if (!info->mssg)
+		info->mssg = default_log;
+}
+
+int sparse_stream_write(struct sparse_stream *ss, const void *buf, size_t len,
+			char *response)
+{
+	struct sparse_storage *info = ss->info;
+	sparse_header_t *sparse_header = &ss->header;
+	const char *data = buf;
+	size_t used = 0;
+	size_t avail;
+	lbaint_t blks;
+	lbaint_t n;
+	uint64_t skip;
+	uint32_t offset;
+
+	while (ss->state != SPARSE_STREAM_DONE) {
+		avail = len - used;
+		switch (ss->state) {
+		case SPARSE_STREAM_HEADER:
+			/* Read and skip over sparse image header */
+			if (avail < sizeof(sparse_header_t))
+				return used;
+			memcpy(sparse_header, data + used,
+			       sizeof(sparse_header_t));
+			if (avail < sparse_header->file_hdr_sz)
+				return used;
+			used += sparse_header->file_hdr_sz;
+
+			debug("=== Sparse Image Header ===\n");
+			debug("magic: 0x%x\n", sparse_header->magic);
+			debug("major_version: 0x%x\n",
+			      sparse_header->major_version);
+			debug("minor_version: 0x%x\n",
+			      sparse_header->minor_version);
+			debug("file_hdr_sz: %d\n", sparse_header->file_hdr_sz);
+			debug("chunk_hdr_sz: %d\n", sparse_header->chunk_hdr_sz);
+			debug("blk_sz: %d\n", sparse_header->blk_sz);
+			debug("total_blks: %d\n", sparse_header->total_blks);
+			debug("total_chunks: %d\n", sparse_header->total_chunks);
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t)) {
 			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
+			 * Verify that the sparse block size is a multiple of
+			 * our storage backend block size
 			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
-		}
-
-		chunk_data_sz = ((u64)sparse_header->blk_sz) * chunk_header->chunk_sz;
-		blkcnt = DIV_ROUND_UP_ULL(chunk_data_sz, info->blksz);
-		switch (chunk_header->chunk_type) {
-		case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
-				info->mssg("Bogus chunk size for chunk type Raw",
+			div_u64_rem(sparse_header->blk_sz, info->blksz, &offset);
+			if (offset) {
+				printf("%s: Sparse image block size issue [%u]\n",
+				       __func__, sparse_header->blk_sz);
+				info->mssg("sparse image block size issue",
 					   response);
 				return -1;
 			}
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
-					   response);
-				return -1;
+			puts("Flashing Sparse Image\n");
+			ss->state = SPARSE_STREAM_CHUNK;
+			break;
+
+		case SPARSE_STREAM_CHUNK:
+			if (ss->chunk == sparse_header->total_chunks) {
+				ss->state = SPARSE_STREAM_DONE;
+				break;
 			}
+			/* Read and skip over chunk header */
+			if (avail < max_t(size_t, sizeof(chunk_header_t),
+					  sparse_header->chunk_hdr_sz))
+				return used;
+			memcpy(&ss->chunk_header, data + used,
+			       sizeof(chunk_header_t));
+			used += max_t(size_t, sizeof(chunk_header_t),
+				      sparse_header->chunk_hdr_sz);
+			if (sparse_start_chunk(ss, response))
+				return -1;
+			break;
 
-			blks = info->write(info, blk, blkcnt, data);
-			/* blks might be > blkcnt (eg. NAND bad-blocks) */
-			if (blks < blkcnt) {
+		case SPARSE_STREAM_RAW:
+			/* Write as many whole blocks as we have */
+			n = min_t(lbaint_t, avail / info->blksz, ss->blkcnt);
+			if (!n && ss->blkcnt)
+				return used;
+			/* An empty chunk is finished at once */
+			blks = n ? info->write(info, ss->blk, n, data + used) : 0;
+			/* blks might be > n (eg. NAND bad-blocks) */
+			if (blks < n) {
 				printf("%s: %s" LBAFU " [" LBAFU "]\n",
 				       __func__, "Write failed, block #",
-				       blk, blks);
+				       ss->blk, blks);
 				info->mssg("flash write failure", response);
 				return -1;
 			}
-			blk += blks;
-			bytes_written += ((u64)blkcnt) * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
-
-		case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
-				info->mssg("Bogus chunk size for chunk type FILL", response);
-				return -1;
-			}
-
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
-						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
-					   response);
-				return -1;
+			ss->blk += blks;
+			ss->blkcnt -= n;
+			ss->bytes_written += ((u64)n) * info->blksz;
+			used += n * info->blksz;
+			if (!ss->blkcnt) {
+				ss->total_blocks += ss->chunk_header.chunk_sz;
+				ss->chunk++;
+				ss->state = SPARSE_STREAM_CHUNK;
 			}
+			break;
 
-			fill_val = *(uint32_t *)data;
-			data = (char *)data + sizeof(uint32_t);
-
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
-
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
-					   response);
+		case SPARSE_STREAM_FILL:
+			if (avail < sizeof(uint32_t))
+				return used;
+			if (sparse_write_fill(ss, *(uint32_t *)(data + used),
+					      ss->blkcnt, response))
 				return -1;
-			}
-
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					info->mssg("flash write failure",
-						   response);
-					free(fill_buf);
-					return -1;
-				}
-				blk += blks;
-				i += j;
-			}
-			bytes_written += ((u64)blkcnt) * info->blksz;
-			total_blocks += DIV_ROUND_UP_ULL(chunk_data_sz,
-							 sparse_header->blk_sz);
-			free(fill_buf);
+			used += sizeof(uint32_t);
+			ss->bytes_written += ((u64)ss->blkcnt) * info->blksz;
+			ss->total_blocks += ss->chunk_header.chunk_sz;
+			ss->chunk++;
+			ss->state = SPARSE_STREAM_CHUNK;
 			break;
 
-		case CHUNK_TYPE_DONT_CARE:
-			blk += info->reserve(info, blk, blkcnt);
-			total_blocks += chunk_header->chunk_sz;
+		case SPARSE_STREAM_SKIP:
+			skip = min_t(u64, avail, ss->skip);
+			ss->skip -= skip;
+			used += skip;
+			if (ss->skip)
+				return used;
+			ss->total_blocks += ss->chunk_header.chunk_sz;
+			ss->chunk++;
+			ss->state = SPARSE_STREAM_CHUNK;
 			break;
 
-		case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz) {
-				info->mssg("Bogus chunk size for chunk type Dont Care",
-					   response);
-				return -1;
-			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
+		case SPARSE_STREAM_DONE:
 			break;
-
-		default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			info->mssg("Unknown chunk type", response);
-			return -1;
 		}
 	}
 
+	return used;
+}
+
+int sparse_stream_finish(struct sparse_stream *ss, char *response)
+{
+	if (ss->state != SPARSE_STREAM_DONE) {
+		ss->info->mssg("sparse image is incomplete", response);
+		return -1;
+	}
+
 	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %llu bytes to '%s'\n", bytes_written, part_name);
+	      ss->total_blocks, ss->header.total_blks);
+	printf("........ wrote %llu bytes to '%s'\n", ss->bytes_written,
+	       ss->part_name);
 
-	if (total_blocks != sparse_header->total_blks) {
-		info->mssg("sparse image write failure", response);
+	if (ss->total_blocks != ss->header.total_blks) {
+		ss->info->mssg("sparse image write failure", response);
 		return -1;
 	}
 
 	return 0;
 }
+
+int write_sparse_image(struct sparse_storage *info,
+		       const char *part_name, void *data, char *response)
+{
+	struct sparse_stream ss;
+
+	/* The whole image is in memory, so it is all used in one go */
+	sparse_stream_init(&ss, info, part_name);
+	if (sparse_stream_write(&ss, data, SIZE_MAX, response) < 0)
+		return -1;
+
+	return sparse_stream_finish(&ss, response);
+}
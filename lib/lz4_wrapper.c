@@ -128,3 +128,11 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 	*dstn = out - dst;
 	return ret;
 }
+
+int LZ4_decompress_safe_partial(const char *src, char *dst, int srcn,
+				int target, int dstn)
+{
+	return LZ4_decompress_generic(src, dst, srcn, dstn, endOnInputSize,
+				      partial, target, noDict, (BYTE *)dst,
+				      NULL, 0);
+}
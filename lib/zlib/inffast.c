@@ -31,6 +31,25 @@
 #  define PUP(a) *++(a)
 #endif
 
+/* Bytes of input which must remain after the last one inflate_fast() reads */
+#define INSLOP (INFLATE_FAST_MIN_IN - 1)
+
+#if INFLATE_FAST_WIDE
+/*
+   U-Boot: top up the bit accumulator to at least 56 bits with a single
+   eight-byte load. Any bits above 'bits' in 'hold' come from the byte at
+   'in + OFF', which is loaded again here, so or-ing them in is harmless.
+   56 bits is enough for a whole length/distance pair, so no further input
+   checks are needed until the next code.
+ */
+#  define REFILL() \
+    do { \
+        hold |= (unsigned long)get_unaligned_le64(in + OFF) << bits; \
+        in += (63 - bits) >> 3; \
+        bits |= 56; \
+    } while (0)
+#endif
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -47,6 +66,8 @@
         start >= strm->avail_out
         state->bits < 8
 
+   U-Boot: when INFLATE_FAST_WIDE, strm->avail_in >= 8 is needed instead.
+
    On return, state->mode is one of:
 
         LEN -- ran out of enough output space or enough available input
@@ -98,14 +119,14 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* copy state to local variables */
     state = (struct inflate_state FAR *)strm->state;
     in = strm->next_in - OFF;
-    last = in + (strm->avail_in - 5);
-    if (in > last && strm->avail_in > 5) {
+    last = in + (strm->avail_in - INSLOP);
+    if (in > last && strm->avail_in > INSLOP) {
         /*
          * overflow detected, limit strm->avail_in to the
          * max. possible size and recalculate last
          */
 	strm->avail_in = 0xffffffff - (uintptr_t)in;
-        last = in + (strm->avail_in - 5);
+        last = in + (strm->avail_in - INSLOP);
     }
     out = strm->next_out - OFF;
     beg = out - (start - strm->avail_out);
@@ -127,12 +148,16 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
+#if INFLATE_FAST_WIDE
+        REFILL();
+#else
         if (bits < 15) {
             hold += (unsigned long)(PUP(in)) << bits;
             bits += 8;
             hold += (unsigned long)(PUP(in)) << bits;
             bits += 8;
         }
+#endif
         this = lcode[hold & lmask];
       dolen:
         op = (unsigned)(this.bits);
@@ -144,26 +169,42 @@ void inflate_fast(z_streamp strm, unsigned start)
                     "inflate:         literal '%c'\n" :
                     "inflate:         literal 0x%02x\n", this.val));
             PUP(out) = (unsigned char)(this.val);
+#if INFLATE_FAST_WIDE
+            /* U-Boot: a second literal always fits in the bits left */
+            this = lcode[hold & lmask];
+            if (this.op == 0) {
+                hold >>= this.bits;
+                bits -= this.bits;
+                Tracevv((stderr, this.val >= 0x20 && this.val < 0x7f ?
+                        "inflate:         literal '%c'\n" :
+                        "inflate:         literal 0x%02x\n", this.val));
+                PUP(out) = (unsigned char)(this.val);
+            }
+#endif
         }
         else if (op & 16) {                     /* length base */
             len = (unsigned)(this.val);
             op &= 15;                           /* number of extra bits */
             if (op) {
+#if !INFLATE_FAST_WIDE
                 if (bits < op) {
                     hold += (unsigned long)(PUP(in)) << bits;
                     bits += 8;
                 }
+#endif
                 len += (unsigned)hold & ((1U << op) - 1);
                 hold >>= op;
                 bits -= op;
             }
             Tracevv((stderr, "inflate:         length %u\n", len));
+#if !INFLATE_FAST_WIDE
             if (bits < 15) {
                 hold += (unsigned long)(PUP(in)) << bits;
                 bits += 8;
                 hold += (unsigned long)(PUP(in)) << bits;
                 bits += 8;
             }
+#endif
             this = dcode[hold & dmask];
           dodist:
             op = (unsigned)(this.bits);
@@ -173,6 +214,7 @@ void inflate_fast(z_streamp strm, unsigned start)
             if (op & 16) {                      /* distance base */
                 dist = (unsigned)(this.val);
                 op &= 15;                       /* number of extra bits */
+#if !INFLATE_FAST_WIDE
                 if (bits < op) {
                     hold += (unsigned long)(PUP(in)) << bits;
                     bits += 8;
@@ -181,6 +223,7 @@ void inflate_fast(z_streamp strm, unsigned start)
                         bits += 8;
                     }
                 }
+#endif
                 dist += (unsigned)hold & ((1U << op) - 1);
 #ifdef INFLATE_STRICT
                 if (dist > dmax) {
@@ -257,6 +300,27 @@ void inflate_fast(z_streamp strm, unsigned start)
 		    unsigned long loops;
 
                     from = out - dist;          /* copy direct from output */
+#if INFLATE_FAST_WIDE
+		    /*
+		     * U-Boot: copy eight bytes at a time when the source is
+		     * at least that far back, so that the loads never see
+		     * bytes which this copy has not stored yet
+		     */
+		    if (dist >= 8) {
+			while (len >= 8) {
+			    put_unaligned_le64(get_unaligned_le64(from + OFF),
+					       out + OFF);
+			    out += 8;
+			    from += 8;
+			    len -= 8;
+			}
+			while (len) {
+			    PUP(out) = PUP(from);
+			    len--;
+			}
+			continue;
+		    }
+#endif
                     /* minimum length is three */
 		    /* Align out addr */
 		    if (!((long)(out - 1 + OFF) & 1)) {
@@ -331,7 +395,8 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* update state and return */
     strm->next_in = in + OFF;
     strm->next_out = out + OFF;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
+    strm->avail_in = (unsigned)(in < last ? INSLOP + (last - in) :
+                                INSLOP - (in - last));
     strm->avail_out = (unsigned)(out < end ?
                                  257 + (end - out) : 257 - (out - end));
     state->hold = hold;
@@ -8,4 +8,19 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/*
+   U-Boot: with a 64-bit bit accumulator inflate_fast() refills it eight
+   bytes at a time, which needs a little more input to be available than the
+   original two-bytes-at-a-time refill. The accumulator is an unsigned long,
+   so check its size directly: BITS_PER_LONG is not always accurate, e.g. for
+   sandbox.
+ */
+#if __SIZEOF_LONG__ >= 8
+#  define INFLATE_FAST_WIDE 1
+#  define INFLATE_FAST_MIN_IN 8
+#else
+#  define INFLATE_FAST_WIDE 0
+#  define INFLATE_FAST_MIN_IN 6
+#endif
+
 void inflate_fast OF((z_streamp strm, unsigned start));
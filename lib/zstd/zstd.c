@@ -11,54 +11,133 @@
 #include <malloc.h>
 #include <linux/zstd.h>
 
+/* Convert a zstd error into an error number */
+static int zstd_err(size_t res)
+{
+	switch (ZSTD_getErrorCode(res)) {
+	case ZSTD_error_dstSize_tooSmall:
+		return -ENOSPC;
+	case ZSTD_error_memory_allocation:
+		return -ENOMEM;
+	default:
+		return -EINVAL;
+	}
+}
+
 int zstd_decompress(struct abuf *in, struct abuf *out)
 {
-	ZSTD_DStream *dstream;
-	ZSTD_inBuffer in_buf;
-	ZSTD_outBuffer out_buf;
+	ZSTD_DCtx *dctx;
 	void *workspace;
 	size_t wsize;
+	size_t res;
 	int ret;
 
-	wsize = ZSTD_DStreamWorkspaceBound(abuf_size(in));
+	/*
+	 * The whole output is in one buffer, so the decompressor can refer
+	 * back to it and does not need a window of its own
+	 */
+	wsize = ZSTD_DCtxWorkspaceBound();
 	workspace = malloc(wsize);
 	if (!workspace) {
 		debug("%s: cannot allocate workspace of size %zu\n", __func__,
-			wsize);
+		      wsize);
 		return -ENOMEM;
 	}
 
-	dstream = ZSTD_initDStream(abuf_size(in), workspace, wsize);
-	if (!dstream) {
-		log_err("%s: ZSTD_initDStream failed\n", __func__);
+	dctx = ZSTD_initDCtx(workspace, wsize);
+	if (!dctx) {
+		log_err("%s: ZSTD_initDCtx failed\n", __func__);
 		ret = -EPERM;
 		goto do_free;
 	}
 
-	in_buf.src = abuf_data(in);
-	in_buf.pos = 0;
-	in_buf.size = abuf_size(in);
+	res = ZSTD_decompressDCtx(dctx, abuf_data(out), abuf_size(out),
+				  abuf_data(in), abuf_size(in));
+	if (ZSTD_isError(res)) {
+		log_err("ZSTD_decompressDCtx error %d\n",
+			ZSTD_getErrorCode(res));
+		ret = zstd_err(res);
+		goto do_free;
+	}
 
-	out_buf.dst = abuf_data(out);
-	out_buf.pos = 0;
-	out_buf.size = abuf_size(out);
+	ret = res;
+do_free:
+	free(workspace);
+	return ret;
+}
 
-	while (1) {
-		size_t res;
+int zstd_stream_init(struct zstd_stream *zs)
+{
+	size_t wsize;
 
-		res = ZSTD_decompressStream(dstream, &out_buf, &in_buf);
-		if (ZSTD_isError(res)) {
-			ret = ZSTD_getErrorCode(res);
-			log_err("ZSTD_decompressStream error %d\n", ret);
-			goto do_free;
+	memset(zs, '\0', sizeof(*zs));
+	wsize = ZSTD_DCtxWorkspaceBound();
+	zs->workspace = malloc(wsize);
+	if (!zs->workspace) {
+		debug("%s: cannot allocate workspace of size %zu\n", __func__,
+		      wsize);
+		return -ENOMEM;
+	}
+
+	zs->dctx = ZSTD_initDCtx(zs->workspace, wsize);
+	if (!zs->dctx || ZSTD_isError(ZSTD_decompressBegin(zs->dctx))) {
+		log_err("%s: cannot set up zstd context\n", __func__);
+		zstd_stream_end(zs);
+		return -EPERM;
+	}
+
+	return 0;
+}
+
+/*
+ * Feed whole input units to ZSTD_decompressContinue(), which writes straight
+ * into the output buffer. Units split across calls are gathered in a staging
+ * buffer first.
+ */
+int zstd_stream_decompress(struct zstd_stream *zs, ZSTD_inBuffer *in,
+			   ZSTD_outBuffer *out)
+{
+	const void *src;
+	size_t need, copy, res;
+
+	while ((need = ZSTD_nextSrcSizeToDecompress(zs->dctx))) {
+		if (zs->stage_len || in->size - in->pos < need) {
+			if (!zs->stage) {
+				zs->stage = malloc(ZSTD_BLOCKSIZE_ABSOLUTEMAX);
+				if (!zs->stage)
+					return -ENOMEM;
+			}
+			if (need > ZSTD_BLOCKSIZE_ABSOLUTEMAX)
+				return -EINVAL;
+			copy = min(need - zs->stage_len, in->size - in->pos);
+			memcpy(zs->stage + zs->stage_len, in->src + in->pos,
+			       copy);
+			zs->stage_len += copy;
+			in->pos += copy;
+			if (zs->stage_len < need)
+				return 0;
+			src = zs->stage;
+			zs->stage_len = 0;
+		} else {
+			src = in->src + in->pos;
+			in->pos += need;
 		}
 
-		if (in_buf.pos >= abuf_size(in) || !res)
-			break;
+		res = ZSTD_decompressContinue(zs->dctx, out->dst + out->pos,
+					      out->size - out->pos, src, need);
+		if (ZSTD_isError(res))
+			return zstd_err(res);
+		out->pos += res;
 	}
 
-	ret = out_buf.pos;
-do_free:
-	free(workspace);
-	return ret;
+	return 1;
+}
+
+void zstd_stream_end(struct zstd_stream *zs)
+{
+	free(zs->stage);
+	free(zs->workspace);
+	zs->stage = NULL;
+	zs->workspace = NULL;
+	zs->dctx = NULL;
 }
@@ -354,6 +354,14 @@ int eth_is_active(struct udevice *dev)
 	return priv->state == ETH_STATE_ACTIVE;
 }
 
+int eth_get_stats(struct udevice *dev, struct eth_stats *stats)
+{
+	if (!eth_get_ops(dev)->get_stats)
+		return -ENOSYS;
+
+	return eth_get_ops(dev)->get_stats(dev, stats);
+}
+
 int eth_send(void *packet, int length)
 {
 	struct udevice *current;
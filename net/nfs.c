@@ -28,18 +28,25 @@
 
 #include <common.h>
 #include <command.h>
+#include <env.h>
 #include <flash.h>
 #include <image.h>
 #include <log.h>
 #include <net.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <linux/kernel.h>
 #include "nfs.h"
 #include "bootp.h"
 #include <time.h>
 
 #define HASHES_PER_LINE 65	/* Number of "loading" hashes per line	*/
+#define NFS_HASH_BYTES	(NFS_READ_SIZE / 2 * 10) /* Bytes per hash	*/
 #define NFS_RETRY_COUNT 30
+/* Most READ requests we keep in flight */
+#define NFS_MAX_READS	16
+/* Replies to later READs after which we take an earlier one as lost */
+#define NFS_READ_REORDER 3
 #ifndef CONFIG_NFS_TIMEOUT
 # define NFS_TIMEOUT 2000UL
 #else
@@ -51,10 +58,27 @@
 
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
+static int nfs_offset = -1;	/* next offset to read */
+static int nfs_read_size;
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+/*
+ * READ requests in flight. Each has its own XID, so replies can be matched
+ * up in any order and only the missing ones are sent again.
+ */
+struct nfs_read {
+	unsigned long xid;
+	int offset;
+	int len;
+	int overtaken;	/* replies to later requests since this was sent */
+	bool busy;
+};
+static struct nfs_read nfs_reads[NFS_MAX_READS];
+static int nfs_read_window;
+static int nfs_eof;		/* size of the file once seen, else -1 */
+static ulong nfs_loaded;	/* bytes stored, for the hashes */
+static int nfs_hashes;
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -73,6 +97,7 @@ static int nfs_state;
 #define STATE_LOOKUP_REQ		5
 #define STATE_READ_REQ			6
 #define STATE_READLINK_REQ		7
+#define STATE_FSINFO_REQ		8
 
 static char *nfs_filename;
 static char *nfs_path;
@@ -391,6 +416,89 @@ static void nfs_read_req(int offset, int readlen)
 	rpc_req(PROG_NFS, NFS_READ, data, len);
 }
 
+/* Send a READ, or send it again, under a new XID */
+static void nfs_read_send(struct nfs_read *rd)
+{
+	nfs_read_req(rd->offset, rd->len);
+	rd->xid = rpc_id;
+	rd->overtaken = 0;
+	rd->busy = true;
+}
+
+/* Keep the window full, up to the end of the file once we have seen it */
+static void nfs_read_fill(void)
+{
+	struct nfs_read *rd;
+
+	for (rd = nfs_reads; rd < nfs_reads + nfs_read_window; rd++) {
+		if (rd->busy)
+			continue;
+		if (nfs_eof >= 0 && nfs_offset >= nfs_eof)
+			break;
+		rd->offset = nfs_offset;
+		rd->len = nfs_read_size;
+		nfs_offset += nfs_read_size;
+		nfs_read_send(rd);
+	}
+}
+
+static void nfs_read_start(void)
+{
+	memset(nfs_reads, '\0', sizeof(nfs_reads));
+	nfs_offset = 0;
+	nfs_eof = -1;
+	nfs_loaded = 0;
+	nfs_hashes = 0;
+	nfs_read_fill();
+}
+
+/* Send again the READs that are still missing */
+static void nfs_read_resend(void)
+{
+	struct nfs_read *rd;
+
+	for (rd = nfs_reads; rd < nfs_reads + nfs_read_window; rd++) {
+		if (rd->busy && (nfs_eof < 0 || rd->offset < nfs_eof))
+			nfs_read_send(rd);
+	}
+}
+
+/* The file is in once nothing before its end is outstanding */
+static bool nfs_read_done(void)
+{
+	struct nfs_read *rd;
+
+	if (nfs_eof < 0)
+		return false;
+	for (rd = nfs_reads; rd < nfs_reads + nfs_read_window; rd++) {
+		if (rd->busy && rd->offset < nfs_eof)
+			return false;
+	}
+
+	return true;
+}
+
+/**************************************************************************
+NFS3_FSINFO - Get the preferred read size of an NFSv3 server
+**************************************************************************/
+static void nfs3_fsinfo_req(void)
+{
+	uint32_t data[1024];
+	uint32_t *p;
+	int len;
+
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	*p++ = htonl(filefh3_length);
+	memcpy(p, filefh, filefh3_length);
+	p += (filefh3_length / 4);
+
+	len = (uint32_t *)p - (uint32_t *)&(data[0]);
+
+	rpc_req(PROG_NFS, NFS3PROC_FSINFO, data, len);
+}
+
 /**************************************************************************
 RPC request dispatcher
 **************************************************************************/
@@ -421,11 +529,14 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_resend();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
 		break;
+	case STATE_FSINFO_REQ:
+		nfs3_fsinfo_req();
+		break;
 	}
 }
 
@@ -664,21 +775,79 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
-static int nfs_read_reply(uchar *pkt, unsigned len)
+static int nfs3_fsinfo_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
-	int rlen;
-	uchar *data_ptr;
+	int nfsv3_data_offset;
+	uint rtmax, rtpref, size;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	memcpy(&rpc_pkt.u.data[0], pkt, len);
 
 	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
 		return -NFS_RPC_ERR;
 	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
 		return -NFS_RPC_DROP;
 
+	if (rpc_pkt.u.reply.rstatus  ||
+	    rpc_pkt.u.reply.verifier ||
+	    rpc_pkt.u.reply.astatus  ||
+	    rpc_pkt.u.reply.data[0])
+		return -1;
+
+	nfsv3_data_offset = nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
+	if ((uchar *)&(rpc_pkt.u.reply.data[3 + nfsv3_data_offset]) -
+	    (uchar *)(&rpc_pkt) > len)
+		return -1;
+	rtmax = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+	rtpref = ntohl(rpc_pkt.u.reply.data[2 + nfsv3_data_offset]);
+
+	/* Use the preferred size, as far as we can reassemble the replies */
+	size = rtpref && rtpref <= rtmax ? rtpref : rtmax;
+	size = min_t(uint, size, NFS_READ_SIZE_MAX);
+	if (size > NFS_READ_SIZE)
+		size = rounddown(size, NFS_READ_SIZE);
+	if (size)
+		nfs_read_size = size;
+	debug("rtmax %u, rtpref %u: reading %d bytes at a time\n", rtmax,
+	      rtpref, nfs_read_size);
+
+	return 0;
+}
+
+static void nfs_show_progress(int rlen)
+{
+	nfs_loaded += rlen;
+	while (nfs_hashes < DIV_ROUND_UP(nfs_loaded, NFS_HASH_BYTES)) {
+		if (nfs_hashes && !(nfs_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+		putc('#');
+		nfs_hashes++;
+	}
+}
+
+static int nfs_read_reply(uchar *pkt, unsigned len)
+{
+	struct rpc_t rpc_pkt;
+	struct nfs_read *rd, *other;
+	int rlen, hdr_len;
+	bool eof = false;
+	uchar *data_ptr;
+
+	debug("%s\n", __func__);
+
+	/* Only the header is copied, the data is stored from the packet */
+	memcpy(&rpc_pkt.u.data[0], pkt, min_t(uint, len,
+					       sizeof(rpc_pkt.u.reply)));
+
+	for (rd = nfs_reads; rd < nfs_reads + nfs_read_window; rd++) {
+		if (rd->busy && rd->xid == ntohl(rpc_pkt.u.reply.id))
+			break;
+	}
+	if (rd == nfs_reads + nfs_read_window)
+		return -NFS_RPC_DROP;
+
 	if (rpc_pkt.u.reply.rstatus  ||
 	    rpc_pkt.u.reply.verifier ||
 	    rpc_pkt.u.reply.astatus  ||
@@ -690,12 +859,6 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
 		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
@@ -705,19 +868,39 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
-		/* Skip unused values :
-			EOF:		32 bits value,
-			data_size:	32 bits value,
-		*/
+		eof = rpc_pkt.u.reply.data[2 + nfsv3_data_offset];
+		/* Skip data_size, a 32 bits value */
 		data_ptr = (uchar *)
 			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
 	}
 
-	if (((uchar *)&(rpc_pkt.u.reply.data[0]) - (uchar *)(&rpc_pkt) + rlen) > len)
-			return -9999;
+	hdr_len = data_ptr - (uchar *)&rpc_pkt;
+	if (rlen < 0 || rlen > rd->len || hdr_len + rlen > len)
+		return -9999;
 
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	if (store_block(pkt + hdr_len, rd->offset, rlen))
+		return -9999;
+	nfs_show_progress(rlen);
+
+	/* A request that later ones keep overtaking was probably lost */
+	for (other = nfs_reads; other < nfs_reads + nfs_read_window; other++) {
+		if (other->busy && other->xid < rd->xid &&
+		    ++other->overtaken >= NFS_READ_REORDER)
+			nfs_read_send(other);
+	}
+
+	if (eof || !rlen) {
+		if (nfs_eof < 0 || rd->offset + rlen < nfs_eof)
+			nfs_eof = rd->offset + rlen;
+		rd->busy = false;
+	} else if (rlen < rd->len) {
+		/* A short read: ask for the rest */
+		rd->offset += rlen;
+		rd->len -= rlen;
+		nfs_read_send(rd);
+	} else {
+		rd->busy = false;
+	}
 
 	return rlen;
 }
@@ -747,7 +930,10 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 	debug("%s\n", __func__);
 
-	if (len > sizeof(struct rpc_t))
+	/* Only READ replies may be larger than the usual buffer */
+	if (len > (nfs_state == STATE_READ_REQ ?
+		   NFS_READ_SIZE_MAX + NFS_READ_OVERHEAD :
+		   sizeof(struct rpc_t)))
 		return;
 
 	if (dest != nfs_our_port)
@@ -812,14 +998,24 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			/* And retry with another supported version */
 			nfs_state = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
 			nfs_send();
-		} else {
+		} else if (supported_nfs_versions & NFSV2_FLAG) {
 			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
+			nfs_read_start();
+		} else {
+			/* Ask how much an NFSv3 server would read at once */
+			nfs_state = STATE_FSINFO_REQ;
 			nfs_send();
 		}
 		break;
 
+	case STATE_FSINFO_REQ:
+		if (nfs3_fsinfo_reply(pkt, len) == -NFS_RPC_DROP)
+			break;
+		/* Without an answer we keep to the default size */
+		nfs_state = STATE_READ_REQ;
+		nfs_read_start();
+		break;
+
 	case STATE_READLINK_REQ:
 		reply = nfs_readlink_reply(pkt, len);
 		if (reply == -NFS_RPC_DROP) {
@@ -843,15 +1039,14 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (rlen == -NFS_RPC_DROP)
 			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			nfs_send();
+		if (rlen >= 0 && !nfs_read_done()) {
+			nfs_read_fill();
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
+			if (rlen >= 0)
 				nfs_download_state = NETLOOP_SUCCESS;
 			if (rlen < 0)
 				debug("NFS READ error (%d)\n", rlen);
@@ -922,6 +1117,10 @@ void nfs_start(void)
 
 	nfs_timeout_count = 0;
 	nfs_state = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
+	nfs_read_size = NFS_READ_SIZE;
+	nfs_read_window = clamp_t(int, env_get_ulong("nfswindowsize", 10,
+						     CONFIG_NFS_READ_WINDOW),
+				  1, NFS_MAX_READS);
 
 	/*nfs_our_port = 4096 + (get_ticks() % 3072);*/
 	/*FIX ME !!!*/
@@ -25,6 +25,7 @@
 #define NFS_READ        6
 
 #define NFS3PROC_LOOKUP 3
+#define NFS3PROC_FSINFO 19
 
 #define NFS_FHSIZE      32
 #define NFS3_FHSIZE     64
@@ -44,6 +45,21 @@
 #define NFS_READ_SIZE	1024	/* biggest power of two that fits Ether frame */
 #define NFS_MAX_ATTRS	26
 
+/* What a READ reply holds besides the data */
+#define NFS_READ_OVERHEAD	((6 + NFS_MAX_ATTRS) * sizeof(uint32_t))
+
+/*
+ * Largest read we ask for when the server prefers bigger ones (NFSv3
+ * FSINFO), given that the reply has to be reassembled into one datagram
+ */
+#ifdef CONFIG_IP_DEFRAG
+#define NFS_READ_SIZE_MAX	rounddown(CONFIG_NET_MAXDEFRAG - \
+					  IP_UDP_HDR_SIZE - NFS_READ_OVERHEAD, \
+					  NFS_READ_SIZE)
+#else
+#define NFS_READ_SIZE_MAX	NFS_READ_SIZE
+#endif
+
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
 enum rpc_accept_stat {
 	NFS_RPC_SUCCESS = 0,	/* RPC executed successfully */
@@ -0,0 +1,433 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Minimal TCP client
+ *
+ * There is one connection at a time, which we open. Received data is passed
+ * on in order as it arrives, so the receive window never fills and can be
+ * as large as the link warrants; a segment that arrives past a gap is
+ * dropped and answered with a duplicate ACK, which makes the peer
+ * retransmit from the gap. We only send a request, so sending is
+ * stop-and-wait with a backed-off retransmission timer.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <net.h>
+#include <time.h>
+#include <asm/unaligned.h>
+#include <linux/kernel.h>
+#include <net/tcp.h>
+
+/* Initial retransmission timeout in millisecs; doubles on each retry */
+#define TCP_RTO		1000UL
+#define TCP_RTO_MAX	8000UL
+/* # of timeouts in a row before giving up */
+#define TCP_RETRIES	8
+/* Millisecs we may hold back the ACK for a single segment */
+#define TCP_ACK_DELAY	20UL
+/* Peer MSS when it does not send one */
+#define TCP_DEFAULT_MSS	536
+
+/* Option kinds */
+#define TCPOPT_END	0
+#define TCPOPT_NOP	1
+#define TCPOPT_MSS	2
+#define TCPOPT_WSCALE	3
+/* Length of the options we send in the SYN */
+#define TCP_SYN_OPT_LEN	8
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+};
+
+static enum tcp_state tcp_state;
+static struct in_addr tcp_remote_ip;
+static uchar tcp_remote_ether[ARP_HLEN];
+static int tcp_remote_port;
+static int tcp_local_port;
+static tcp_rxhand_f *tcp_rx_handler;
+static tcp_evhand_f *tcp_ev_handler;
+
+/* Oldest unacknowledged and next sequence number we send */
+static u32 tcp_snd_una;
+static u32 tcp_snd_nxt;
+static unsigned int tcp_snd_mss;
+/* Data from tcp_snd_una to tcp_snd_nxt, kept for retransmission */
+static uchar tcp_tx_buf[TCP_MSS];
+static unsigned int tcp_tx_len;
+
+/* Next sequence number we expect */
+static u32 tcp_rcv_nxt;
+/* Shift of the window we advertise, if the peer agreed to scaling */
+static int tcp_rcv_wscale;
+/* # of in-order segments received since our last ACK */
+static int tcp_unacked;
+
+static ulong tcp_rto;
+static int tcp_retries;
+
+static void tcp_timeout_handler(void);
+
+/* Smallest shift that lets the 16-bit window field hold our window */
+static int tcp_wscale(void)
+{
+	int shift = 0;
+
+	while ((CONFIG_TCP_WINDOW_SIZE >> shift) > 0xffff && shift < 14)
+		shift++;
+
+	return shift;
+}
+
+static u16 tcp_checksum(struct ip_tcp_hdr *ip, int tcp_len)
+{
+	struct {
+		struct in_addr src;
+		struct in_addr dst;
+		u8 zero;
+		u8 proto;
+		u16 len;
+	} __attribute__((packed)) pseudo;
+	uint sum;
+
+	net_copy_ip(&pseudo.src, &ip->ip_src);
+	net_copy_ip(&pseudo.dst, &ip->ip_dst);
+	pseudo.zero = 0;
+	pseudo.proto = IPPROTO_TCP;
+	pseudo.len = htons(tcp_len);
+
+	sum = compute_ip_checksum(&pseudo, sizeof(pseudo));
+
+	return add_ip_checksums(sizeof(pseudo), sum,
+				compute_ip_checksum((uchar *)ip + IP_HDR_SIZE,
+						    tcp_len));
+}
+
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 flags, u32 seq, u32 ack)
+{
+	struct ip_tcp_hdr *ip = (struct ip_tcp_hdr *)pkt;
+	uchar *opt = pkt + IP_TCP_HDR_SIZE;
+	int hdr_len = TCP_HDR_SIZE;
+	uint win;
+
+	if (flags & TCP_SYN) {
+		/* Offer our MSS and window scaling; the SYN window is unscaled */
+		opt[0] = TCPOPT_MSS;
+		opt[1] = 4;
+		put_unaligned_be16(TCP_MSS, opt + 2);
+		opt[4] = TCPOPT_NOP;
+		opt[5] = TCPOPT_WSCALE;
+		opt[6] = 3;
+		opt[7] = tcp_wscale();
+		hdr_len += TCP_SYN_OPT_LEN;
+		win = CONFIG_TCP_WINDOW_SIZE;
+	} else {
+		win = CONFIG_TCP_WINDOW_SIZE >> tcp_rcv_wscale;
+	}
+
+	net_set_ip_header(pkt, dest, net_ip, IP_HDR_SIZE + hdr_len + payload_len,
+			  IPPROTO_TCP);
+
+	ip->tcp_src = htons(sport);
+	ip->tcp_dst = htons(dport);
+	ip->tcp_seq = htonl(seq);
+	ip->tcp_ack = htonl(flags & TCP_ACK ? ack : 0);
+	ip->tcp_hlen = (hdr_len / 4) << 4;
+	ip->tcp_flags = flags;
+	ip->tcp_win = htons(min_t(uint, win, 0xffff));
+	ip->tcp_xsum = 0;
+	ip->tcp_urg = 0;
+	ip->tcp_xsum = tcp_checksum(ip, hdr_len + payload_len);
+
+	return IP_HDR_SIZE + hdr_len;
+}
+
+static void tcp_send_segment(u8 flags, u32 seq, const uchar *data,
+			     unsigned int len)
+{
+	uchar *pkt = net_tx_packet + net_eth_hdr_size() + IP_TCP_HDR_SIZE;
+
+	if (len)
+		memcpy(pkt, data, len);
+	/* Every segment after the SYN acknowledges what we have */
+	if (flags & TCP_ACK)
+		tcp_unacked = 0;
+
+	net_send_ip_packet(tcp_remote_ether, tcp_remote_ip, tcp_remote_port,
+			   tcp_local_port, len, IPPROTO_TCP, flags, seq,
+			   tcp_rcv_nxt);
+}
+
+static void tcp_send_ack(void)
+{
+	tcp_send_segment(TCP_ACK, tcp_snd_nxt, NULL, 0);
+}
+
+/* Send the SYN or our unacknowledged data, else just an ACK */
+static void tcp_transmit(void)
+{
+	if (tcp_state == TCP_SYN_SENT)
+		tcp_send_segment(TCP_SYN, tcp_snd_una, NULL, 0);
+	else if (tcp_tx_len)
+		tcp_send_segment(TCP_ACK | TCP_PUSH, tcp_snd_una, tcp_tx_buf,
+				 tcp_tx_len);
+	else
+		tcp_send_ack();
+}
+
+static void tcp_restart_timer(void)
+{
+	tcp_rto = TCP_RTO;
+	tcp_retries = 0;
+	net_set_timeout_handler(tcp_unacked ? TCP_ACK_DELAY : tcp_rto,
+				tcp_timeout_handler);
+}
+
+void tcp_clear(void)
+{
+	tcp_state = TCP_CLOSED;
+	tcp_rx_handler = NULL;
+	tcp_ev_handler = NULL;
+}
+
+/* Forget the connection and tell the handler why */
+static void tcp_finish(enum tcp_event event)
+{
+	tcp_evhand_f *ev = tcp_ev_handler;
+
+	net_set_timeout_handler(0, NULL);
+	tcp_clear();
+	if (ev)
+		ev(event);
+}
+
+static void tcp_timeout_handler(void)
+{
+	if (tcp_unacked) {
+		/* Nothing followed the segment we held the ACK back for */
+		tcp_send_ack();
+		net_set_timeout_handler(tcp_rto, tcp_timeout_handler);
+		return;
+	}
+
+	if (++tcp_retries > TCP_RETRIES) {
+		tcp_finish(TCP_EV_TIMEOUT);
+		return;
+	}
+
+	/* Resend what is outstanding, or repeat our ACK to prompt the peer */
+	debug("TCP: timeout, retry %d\n", tcp_retries);
+	tcp_rto = min(tcp_rto * 2, TCP_RTO_MAX);
+	tcp_transmit();
+	net_set_timeout_handler(tcp_rto, tcp_timeout_handler);
+}
+
+void tcp_connect(struct in_addr dest, int dport, tcp_rxhand_f *rx,
+		 tcp_evhand_f *ev)
+{
+	tcp_remote_ip = dest;
+	tcp_remote_port = dport;
+	memset(tcp_remote_ether, '\0', ARP_HLEN);
+	/* Pick a port and initial sequence number an old connection won't use */
+	tcp_local_port = 1024 + (get_timer(0) % 3072);
+	tcp_snd_una = (u32)get_ticks();
+	/* The SYN takes up one sequence number */
+	tcp_snd_nxt = tcp_snd_una + 1;
+	tcp_snd_mss = TCP_DEFAULT_MSS;
+	tcp_tx_len = 0;
+	tcp_rcv_nxt = 0;
+	tcp_rcv_wscale = 0;
+	tcp_unacked = 0;
+	tcp_rx_handler = rx;
+	tcp_ev_handler = ev;
+	tcp_state = TCP_SYN_SENT;
+
+	tcp_restart_timer();
+	tcp_transmit();
+}
+
+int tcp_send(const void *data, unsigned int len)
+{
+	if (tcp_state != TCP_ESTABLISHED)
+		return -ENOTCONN;
+	if (tcp_tx_len)
+		return -EBUSY;
+	/* A request is far smaller than any window, so that is not checked */
+	if (len > tcp_snd_mss)
+		return -EINVAL;
+
+	memcpy(tcp_tx_buf, data, len);
+	tcp_tx_len = len;
+	tcp_snd_nxt = tcp_snd_una + len;
+	tcp_transmit();
+
+	return 0;
+}
+
+void tcp_close(void)
+{
+	if (tcp_state == TCP_ESTABLISHED)
+		tcp_send_segment(TCP_FIN | TCP_ACK, tcp_snd_nxt, NULL, 0);
+	net_set_timeout_handler(0, NULL);
+	tcp_clear();
+}
+
+void tcp_abort(void)
+{
+	if (tcp_state == TCP_ESTABLISHED)
+		tcp_send_segment(TCP_RST | TCP_ACK, tcp_snd_nxt, NULL, 0);
+	net_set_timeout_handler(0, NULL);
+	tcp_clear();
+}
+
+/* Pick up the peer's MSS and whether it agreed to window scaling */
+static void tcp_parse_options(struct ip_tcp_hdr *ip, int hdr_len)
+{
+	const uchar *opt = (uchar *)ip + IP_TCP_HDR_SIZE;
+	const uchar *end = (uchar *)ip + IP_HDR_SIZE + hdr_len;
+	bool wscale = false;
+
+	while (opt < end && *opt != TCPOPT_END) {
+		if (*opt == TCPOPT_NOP) {
+			opt++;
+			continue;
+		}
+		if (end - opt < 2 || opt[1] < 2 || opt[1] > end - opt)
+			break;
+		if (opt[0] == TCPOPT_MSS && opt[1] == 4)
+			tcp_snd_mss = min_t(uint, get_unaligned_be16(opt + 2),
+					    TCP_MSS);
+		else if (opt[0] == TCPOPT_WSCALE && opt[1] == 3)
+			wscale = true;
+		opt += opt[1];
+	}
+
+	/* Our window is only scaled if both sides offer scaling */
+	tcp_rcv_wscale = wscale ? tcp_wscale() : 0;
+}
+
+static void tcp_receive_syn_ack(struct ip_tcp_hdr *ip, int hdr_len, u32 seq,
+				u32 ack)
+{
+	if (!(ip->tcp_flags & TCP_ACK) || ack != tcp_snd_nxt)
+		return;
+	if (ip->tcp_flags & TCP_RST) {
+		tcp_finish(TCP_EV_RESET);
+		return;
+	}
+	if (!(ip->tcp_flags & TCP_SYN))
+		return;
+
+	tcp_parse_options(ip, hdr_len);
+	tcp_snd_una = ack;
+	tcp_rcv_nxt = seq + 1;
+	tcp_state = TCP_ESTABLISHED;
+	tcp_restart_timer();
+
+	tcp_ev_handler(TCP_EV_CONNECTED);
+
+	/* Acknowledge the SYN, unless data sent by the handler already did */
+	if (tcp_state == TCP_ESTABLISHED && !tcp_tx_len)
+		tcp_send_ack();
+}
+
+void tcp_receive(struct ip_tcp_hdr *ip, int len)
+{
+	int hdr_len = (ip->tcp_hlen >> 4) * 4;
+	int tcp_len = len - IP_HDR_SIZE;
+	u8 flags = ip->tcp_flags;
+	const uchar *data;
+	unsigned int dlen;
+	u32 seq, ack, dup;
+
+	if (tcp_state == TCP_CLOSED)
+		return;
+	if (len < IP_TCP_HDR_SIZE || hdr_len < TCP_HDR_SIZE ||
+	    hdr_len > tcp_len)
+		return;
+	if (net_read_ip(&ip->ip_src).s_addr != tcp_remote_ip.s_addr ||
+	    ntohs(ip->tcp_src) != tcp_remote_port ||
+	    ntohs(ip->tcp_dst) != tcp_local_port)
+		return;
+	if (tcp_checksum(ip, tcp_len)) {
+		debug("TCP: bad checksum\n");
+		return;
+	}
+
+	seq = ntohl(ip->tcp_seq);
+	ack = ntohl(ip->tcp_ack);
+	data = (uchar *)ip + IP_HDR_SIZE + hdr_len;
+	dlen = tcp_len - hdr_len;
+
+	if (tcp_state == TCP_SYN_SENT) {
+		tcp_receive_syn_ack(ip, hdr_len, seq, ack);
+		return;
+	}
+
+	if (flags & TCP_RST) {
+		/* Only believe a reset that lands in our window */
+		if (seq - tcp_rcv_nxt < CONFIG_TCP_WINDOW_SIZE)
+			tcp_finish(TCP_EV_RESET);
+		return;
+	}
+	if (flags & TCP_SYN) {
+		/* The SYN-ACK again, so our ACK of it was lost */
+		tcp_send_ack();
+		return;
+	}
+	if (!(flags & TCP_ACK))
+		return;
+
+	/* Drop what the peer acknowledges from the retransmission buffer */
+	if (ack - tcp_snd_una - 1 < tcp_snd_nxt - tcp_snd_una) {
+		uint acked = ack - tcp_snd_una;
+
+		tcp_tx_len -= acked;
+		memmove(tcp_tx_buf, tcp_tx_buf + acked, tcp_tx_len);
+		tcp_snd_una = ack;
+	}
+
+	/*
+	 * Trim what we have already had, as from a retransmission. Anything
+	 * that is all old, or starts past a gap, is just acknowledged again.
+	 */
+	if (seq != tcp_rcv_nxt) {
+		dup = tcp_rcv_nxt - seq;
+		if (dup > dlen || (dup == dlen && !(flags & TCP_FIN))) {
+			if (dlen || (flags & TCP_FIN))
+				tcp_send_ack();
+			tcp_restart_timer();
+			return;
+		}
+		data += dup;
+		dlen -= dup;
+	}
+
+	if (dlen) {
+		/* Account for the data first: the handler may close */
+		tcp_rcv_nxt += dlen;
+		tcp_unacked++;
+		if (tcp_rx_handler(data, dlen)) {
+			tcp_abort();
+			return;
+		}
+		if (tcp_state != TCP_ESTABLISHED)
+			return;
+	}
+
+	if (flags & TCP_FIN) {
+		/* Acknowledge it and close our side in one go */
+		tcp_rcv_nxt++;
+		tcp_send_segment(TCP_FIN | TCP_ACK, tcp_snd_nxt, NULL, 0);
+		tcp_finish(TCP_EV_CLOSED);
+		return;
+	}
+
+	/* ACK every other segment, and the last one of a burst */
+	if (tcp_unacked >= 2 || (dlen && (flags & TCP_PUSH)))
+		tcp_send_ack();
+	tcp_restart_timer();
+}
@@ -35,6 +35,10 @@ DECLARE_GLOBAL_DATA_PTR;
 #endif
 /* Number of "loading" hashes per line (for checking the image size) */
 #define HASHES_PER_LINE	65
+/* Shortest timeout we adapt down to, in millisecs */
+#define TFTP_RTO_MIN	100UL
+/* Number of blocks past a lost one that we hold on to */
+#define TFTP_HELD_BLOCKS	64
 
 /*
  *	TFTP operations.
@@ -104,6 +108,21 @@ static ushort	tftp_windowsize;
 static ushort	tftp_next_ack;
 /* Last nack block we send */
 static ushort	tftp_last_nack;
+/*
+ * Blocks which arrived ahead of a lost one and are already stored: bit n is
+ * set if block tftp_cur_block + 2 + n has been received
+ */
+static u64	tftp_held_blocks;
+/* Number of the (short) last block if it has already arrived, else -1 */
+static int	tftp_final_block;
+/* Current timeout, adapted to the round-trip time seen */
+static ulong	tftp_rto;
+/* Smoothed round-trip time x 8 and its mean deviation x 4, as in TCP */
+static ulong	tftp_srtt;
+static ulong	tftp_rttvar;
+/* Time we sent the last ack, if it is usable for measuring the RTT */
+static ulong	tftp_ack_time;
+static bool	tftp_ack_timed;
 #ifdef CONFIG_CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -218,11 +237,44 @@ static void new_transfer(void)
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_held_blocks = 0;
+	tftp_final_block = -1;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
 }
 
+/* Go back to the configured timeout, with no round-trip time measured */
+static void reset_rto(void)
+{
+	tftp_rto = timeout_ms;
+	tftp_srtt = 0;
+	tftp_rttvar = 0;
+	tftp_ack_timed = false;
+}
+
+/*
+ * Update the timeout from a round-trip time measurement, following RFC 6298
+ * but never going above the configured timeout
+ */
+static void update_rto(ulong rtt)
+{
+	long err;
+
+	if (!tftp_srtt) {
+		tftp_srtt = rtt << 3;
+		tftp_rttvar = rtt << 1;
+	} else {
+		err = rtt - (tftp_srtt >> 3);
+		tftp_srtt += err;
+		if (err < 0)
+			err = -err;
+		tftp_rttvar += err - (tftp_rttvar >> 2);
+	}
+	tftp_rto = clamp((tftp_srtt >> 3) + tftp_rttvar, TFTP_RTO_MIN,
+			 timeout_ms);
+}
+
 #ifdef CONFIG_CMD_TFTPPUT
 /**
  * Load the next block from memory to be sent over tftp.
@@ -311,6 +363,66 @@ static void update_block_number(void)
 	show_block_marker();
 }
 
+/**
+ * Store a block which arrived ahead of the one we are waiting for
+ *
+ * With a window of several blocks, losing one would otherwise mean
+ * discarding the rest of the window and fetching it all again. Instead the
+ * blocks after the gap go straight to their place in memory, so that once
+ * the gap is filled we can acknowledge all of them at once.
+ *
+ * @param block	Block number received
+ * @param src	Block data
+ * @param len	Number of bytes in block
+ * @return 0 if the block was held or ignored, -1 on error
+ */
+static int hold_block(ushort block, uchar *src, unsigned int len)
+{
+	/* Distance past the block we are waiting for */
+	ushort ahead = block - (ushort)(tftp_cur_block + 1);
+	u64 bit;
+
+	if (tftp_state != STATE_DATA || tftp_put_active || !ahead ||
+	    ahead > TFTP_HELD_BLOCKS)
+		return 0;
+	if (tftp_final_block >= 0 &&
+	    (ushort)(tftp_final_block - tftp_cur_block) < ahead + 1)
+		return 0;
+	bit = 1ULL << (ahead - 1);
+	if (tftp_held_blocks & bit)
+		return 0;
+
+	/* The block number may wrap before we get to it */
+	if (store_block(tftp_cur_block + 1 + ahead, src, len))
+		return -1;
+	tftp_held_blocks |= bit;
+	if (len < tftp_block_size)
+		tftp_final_block = block;
+
+	return 0;
+}
+
+/**
+ * Move on past blocks held by hold_block(), once the block before them has
+ * been stored
+ *
+ * @return true if this reached the last block of the file
+ */
+static bool advance_held_blocks(void)
+{
+	while (tftp_held_blocks & 1) {
+		tftp_held_blocks >>= 1;
+		tftp_cur_block = (tftp_cur_block + 1) % TFTP_SEQUENCE_SIZE;
+		update_block_number();
+		tftp_prev_block = tftp_cur_block;
+		if (tftp_cur_block == tftp_final_block)
+			return true;
+	}
+	tftp_held_blocks >>= 1;
+
+	return false;
+}
+
 /* The TFTP get or put is complete */
 static void tftp_complete(void)
 {
@@ -401,6 +513,8 @@ static void tftp_send(void)
 		s[0] = htons(TFTP_ACK);
 		s[1] = htons(tftp_cur_block);
 		pkt = (uchar *)(s + 2);
+		tftp_ack_time = get_timer(0);
+		tftp_ack_timed = true;
 #ifdef CONFIG_CMD_TFTPPUT
 		if (tftp_put_active) {
 			int toload = tftp_block_size;
@@ -610,6 +724,11 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			debug("Received unexpected block: %d, expected: %d\n",
 			      ntohs(*(__be16 *)pkt),
 			      (ushort)(tftp_cur_block + 1));
+			if (hold_block(ntohs(*(__be16 *)pkt), pkt + 2, len)) {
+				eth_halt();
+				net_set_state(NETLOOP_FAIL);
+				break;
+			}
 			/*
 			 * If one packet is dropped most likely
 			 * all other buffers in the window
@@ -657,8 +776,12 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 		update_block_number();
 		tftp_prev_block = tftp_cur_block;
+		if (tftp_ack_timed) {
+			update_rto(get_timer(tftp_ack_time));
+			tftp_ack_timed = false;
+		}
 		timeout_count_max = tftp_timeout_count_max;
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		net_set_timeout_handler(tftp_rto, tftp_timeout_handler);
 
 		if (store_block(tftp_cur_block, pkt + 2, len)) {
 			eth_halt();
@@ -667,11 +790,32 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		}
 
 		if (len < tftp_block_size) {
+			/* Ignore any stray blocks after this one */
+			tftp_final_block = tftp_cur_block;
 			tftp_send();
 			tftp_complete();
 			break;
 		}
 
+		/*
+		 * If this filled a gap, acknowledge everything after it which
+		 * we already have, so the remote carries on from there
+		 */
+		if (tftp_held_blocks & 1) {
+			bool done = advance_held_blocks();
+
+			tftp_send();
+			if (done) {
+				tftp_complete();
+				break;
+			}
+			tftp_last_nack = tftp_cur_block;
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
+			break;
+		}
+		tftp_held_blocks >>= 1;
+
 		/*
 		 *	Acknowledge the block just received, which will prompt
 		 *	the remote for the next one.
@@ -710,14 +854,21 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 static void tftp_timeout_handler(void)
 {
-	if (++timeout_count > timeout_count_max) {
+	/*
+	 * Back off from an adapted timeout before counting retries, and do not
+	 * measure the round trip of an ack which may have been sent twice
+	 */
+	if (tftp_rto < timeout_ms) {
+		tftp_rto = min(tftp_rto * 2, timeout_ms);
+	} else if (++timeout_count > timeout_count_max) {
 		restart("Retry count exceeded");
-	} else {
-		puts("T ");
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
-		if (tftp_state != STATE_RECV_WRQ)
-			tftp_send();
+		return;
 	}
+	puts("T ");
+	net_set_timeout_handler(tftp_rto, tftp_timeout_handler);
+	if (tftp_state != STATE_RECV_WRQ)
+		tftp_send();
+	tftp_ack_timed = false;
 }
 
 /* Initialize tftp_load_addr and tftp_load_size from image_load_addr and lmb */
@@ -852,8 +1003,9 @@ void tftp_start(enum proto_t protocol)
 
 	time_start = get_timer(0);
 	timeout_count_max = tftp_timeout_count_max;
+	reset_rto();
 
-	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+	net_set_timeout_handler(tftp_rto, tftp_timeout_handler);
 	net_set_udp_handler(tftp_handler);
 #ifdef CONFIG_CMD_TFTPPUT
 	net_set_icmp_handler(icmp_handler);
@@ -906,7 +1058,8 @@ void tftp_start_server(void)
 	timeout_count_max = tftp_timeout_count_max;
 	timeout_count = 0;
 	timeout_ms = TIMEOUT;
-	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+	reset_rto();
+	net_set_timeout_handler(tftp_rto, tftp_timeout_handler);
 
 	/* Revert tftp_block_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
@@ -0,0 +1,289 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * HTTP download over the minimal TCP client
+ *
+ * Sends one HTTP/1.1 GET and streams the body of the response to
+ * image_load_addr as it arrives.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <env.h>
+#include <image.h>
+#include <lmb.h>
+#include <log.h>
+#include <mapmem.h>
+#include <net.h>
+#include <asm/global_data.h>
+#include <linux/sizes.h>
+#include <net/tcp.h>
+#include <net/wget.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Well known HTTP port # */
+#define HTTP_PORT	80
+/* Number of "loading" hashes per line */
+#define HASHES_PER_LINE	65
+/* Bytes loaded for each hash */
+#define WGET_HASH_BYTES	SZ_64K
+/* Longest response header we handle */
+#define WGET_HDR_SIZE	2048
+
+static char wget_filename[256];
+static struct in_addr wget_server_ip;
+static ulong wget_load_addr;
+static ulong wget_load_size;
+static ulong time_start;
+static ulong wget_hashes;
+
+/* Response header, until the blank line that ends it */
+static char wget_hdr[WGET_HDR_SIZE + 1];
+static unsigned int wget_hdr_len;
+static bool wget_in_body;
+/* Content-Length, if the server sent one */
+static bool wget_len_known;
+static ulong wget_content_len;
+
+static void wget_fail(const char *msg)
+{
+	printf("\nwget error: %s\n", msg);
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void wget_complete(void)
+{
+	time_start = get_timer(time_start);
+	if (time_start > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(net_boot_file_size / time_start * 1000, "/s");
+	}
+	puts("\ndone\n");
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+static void wget_send_request(void)
+{
+	char req[TCP_MSS];
+	int len;
+
+	len = snprintf(req, sizeof(req),
+		       "GET %s%s HTTP/1.1\r\nHost: %pI4\r\n"
+		       "User-Agent: U-Boot\r\nConnection: close\r\n\r\n",
+		       *wget_filename == '/' ? "" : "/", wget_filename,
+		       &wget_server_ip);
+	if (len >= sizeof(req)) {
+		tcp_abort();
+		wget_fail("path too long");
+	} else if (tcp_send(req, len)) {
+		tcp_abort();
+		wget_fail("cannot send the request");
+	}
+}
+
+/* Check the status line and pick out the headers we care about */
+static int wget_parse_header(void)
+{
+	char *line, *next;
+	ulong code;
+
+	if (strncmp(wget_hdr, "HTTP/1.", 7) || strlen(wget_hdr) < 12) {
+		wget_fail("not an HTTP response");
+		return -EPROTO;
+	}
+
+	for (line = wget_hdr; *line; line = next) {
+		next = strstr(line, "\r\n");
+		*next = '\0';
+		next += 2;
+
+		if (line == wget_hdr) {
+			code = simple_strtoul(line + 9, NULL, 10);
+			if (code != 200) {
+				printf("\nwget error: server sent '%s'\n",
+				       line);
+				net_set_state(NETLOOP_FAIL);
+				return -ENOENT;
+			}
+		} else if (!strncasecmp(line, "Content-Length:", 15)) {
+			for (line += 15; *line == ' ' || *line == '\t'; line++)
+				;
+			wget_content_len = simple_strtoul(line, NULL, 10);
+			wget_len_known = true;
+		} else if (!strncasecmp(line, "Transfer-Encoding:", 18) &&
+			   strstr(line + 18, "chunked")) {
+			wget_fail("chunked transfer encoding not supported");
+			return -EPROTO;
+		}
+	}
+
+	return 0;
+}
+
+/* Collect the header; return the number of bytes of @data it used */
+static int wget_header(const uchar *data, unsigned int len)
+{
+	unsigned int old_len = wget_hdr_len;
+	unsigned int n = min(len, WGET_HDR_SIZE - old_len);
+	char *end;
+	int ret;
+
+	memcpy(wget_hdr + old_len, data, n);
+	wget_hdr_len += n;
+	wget_hdr[wget_hdr_len] = '\0';
+
+	/* The blank line may straddle two segments */
+	end = strstr(wget_hdr + (old_len > 3 ? old_len - 3 : 0), "\r\n\r\n");
+	if (!end) {
+		if (wget_hdr_len == WGET_HDR_SIZE) {
+			wget_fail("response header too long");
+			return -E2BIG;
+		}
+		return len;
+	}
+
+	/* Keep the last CRLF, so that every line ends in one */
+	end[2] = '\0';
+	wget_in_body = true;
+	ret = wget_parse_header();
+	if (ret)
+		return ret;
+
+	return end + 4 - (wget_hdr + old_len);
+}
+
+static int wget_store(const uchar *data, unsigned int len)
+{
+	ulong offset = net_boot_file_size;
+	void *ptr;
+
+	/* Ignore anything past the advertised length */
+	if (wget_len_known)
+		len = min_t(ulong, len, wget_content_len - offset);
+
+	if (IS_ENABLED(CONFIG_LMB) && wget_load_size &&
+	    len > wget_load_size - offset) {
+		wget_fail("trying to overwrite reserved memory...");
+		return -ENOSPC;
+	}
+
+	ptr = map_sysmem(wget_load_addr + offset, len);
+	memcpy(ptr, data, len);
+	unmap_sysmem(ptr);
+	net_boot_file_size += len;
+
+	while (wget_hashes < net_boot_file_size / WGET_HASH_BYTES) {
+		putc('#');
+		if (!(++wget_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+	}
+
+	/* We have it all, so don't wait for the server to close */
+	if (wget_len_known && net_boot_file_size == wget_content_len) {
+		tcp_close();
+		wget_complete();
+	}
+
+	return 0;
+}
+
+static int wget_rx(const uchar *data, unsigned int len)
+{
+	int n;
+
+	if (!wget_in_body) {
+		n = wget_header(data, len);
+		if (n < 0)
+			return n;
+		data += n;
+		len -= n;
+	}
+	if (!wget_in_body || !len)
+		return 0;
+
+	return wget_store(data, len);
+}
+
+static void wget_event(enum tcp_event event)
+{
+	switch (event) {
+	case TCP_EV_CONNECTED:
+		wget_send_request();
+		break;
+	case TCP_EV_CLOSED:
+		if (!wget_in_body)
+			wget_fail("connection closed before the response");
+		else if (wget_len_known &&
+			 net_boot_file_size != wget_content_len)
+			wget_fail("connection closed before the end of the file");
+		else
+			wget_complete();
+		break;
+	case TCP_EV_RESET:
+		wget_fail("connection refused or reset");
+		break;
+	case TCP_EV_TIMEOUT:
+		puts("\nRetry count exceeded; starting again\n");
+		net_start_again();
+		break;
+	}
+}
+
+/* Initialize wget_load_addr and wget_load_size from image_load_addr and lmb */
+static int wget_init_load_addr(void)
+{
+#ifdef CONFIG_LMB
+	struct lmb lmb;
+	phys_size_t max_size;
+
+	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
+
+	max_size = lmb_get_free_size(&lmb, image_load_addr);
+	if (!max_size)
+		return -1;
+
+	wget_load_size = max_size;
+#endif
+	wget_load_addr = image_load_addr;
+	return 0;
+}
+
+void wget_start(void)
+{
+	int port = HTTP_PORT;
+	char *s;
+
+	wget_server_ip = net_server_ip;
+	if (!net_parse_bootfile(&wget_server_ip, wget_filename,
+				sizeof(wget_filename))) {
+		puts("*** ERROR: no file name given\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+
+	s = env_get("httpdstp");
+	if (s)
+		port = dectoul(s, NULL);
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4; our IP address is %pI4\n",
+	       &wget_server_ip, &net_ip);
+	printf("Filename '%s'.\n", wget_filename);
+
+	if (wget_init_load_addr()) {
+		wget_fail("trying to overwrite reserved memory...");
+		return;
+	}
+	printf("Load address: 0x%lx\n", wget_load_addr);
+	puts("Loading: *\b");
+
+	wget_hdr_len = 0;
+	wget_in_body = false;
+	wget_len_known = false;
+	wget_content_len = 0;
+	wget_hashes = 0;
+	net_boot_file_size = 0;
+	time_start = get_timer(0);
+
+	tcp_connect(wget_server_ip, port, wget_rx, wget_event);
+}
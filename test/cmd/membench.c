@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Test for the membench command
+ */
+
+#include <common.h>
+#include <console.h>
+#include <mapmem.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+/* Declare a new mem test */
+#define MEM_TEST(_name, _flags)	UNIT_TEST(_name, _flags, mem_test)
+
+/* Test that 'membench' covers each size and leaves memcpy() working */
+static int mem_test_membench(struct unit_test_state *uts)
+{
+	u8 *buf;
+	int i;
+
+	ut_assertok(console_record_reset_enable());
+	ut_assertok(run_command("membench 0 10000", 0));
+	ut_assert_nextline("    size    memcpy   memmove    memset (GB/s)");
+	ut_assert_nextlinen("      40  ");
+	ut_assert_nextlinen("     400  ");
+	ut_assert_nextlinen("    4000  ");
+	ut_assert_nextlinen("    7fc0  ");
+	ut_assert_console_end();
+
+	/* The last memset() of the largest size fills the second half */
+	buf = map_sysmem(0, 0x10000);
+	for (i = 0x8000; i < 0x8000 + 0x7fc0; i++)
+		ut_asserteq(buf[0x8000], buf[i]);
+	unmap_sysmem(buf);
+
+	ut_asserteq(1, run_command("membench 0 80", 0));
+	ut_assert_nextline("Length must be at least 0x100");
+	ut_assert_console_end();
+
+	return 0;
+}
+MEM_TEST(mem_test_membench, UT_TESTF_CONSOLE_REC);
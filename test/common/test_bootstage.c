@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for bootstage scopes
+ */
+
+#include <common.h>
+#include <bootstage.h>
+#include <malloc.h>
+#include <vsprintf.h>
+#include <linux/delay.h>
+#include <test/common.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Number of reads made, each of which should be merged into the first */
+#define SCOPE_TEST_READS	3
+#define SCOPE_TEST_READ_US	1000
+
+/**
+ * find_event() - Find a scope in a Chrome trace
+ *
+ * @trace:	Trace to search
+ * @name:	Name of scope
+ * @cat:	Kind of scope, e.g. "read"
+ * @startp:	Returns the start time of the scope
+ * @timep:	Returns the time spent in the scope
+ * @countp:	Returns the number of times the scope was entered
+ * Return: 0 if found, -ENOENT if not
+ */
+static int find_event(const char *trace, const char *name, const char *cat,
+		      uint *startp, uint *timep, uint *countp)
+{
+	char fmt[120];
+	const char *p;
+
+	snprintf(fmt, sizeof(fmt), "{\"name\":\"%s\",\"cat\":\"%s\"", name,
+		 cat);
+	p = strstr(trace, fmt);
+	if (!p)
+		return -ENOENT;
+	p += strlen(fmt);
+	if (sscanf(p, ",\"ph\":\"X\",\"ts\":%u,\"dur\":%u,\"pid\":1,\"tid\":1,\"args\":{\"count\":%u}",
+		   startp, timep, countp) != 3)
+		return -ENOENT;
+
+	return 0;
+}
+
+/* Test that scopes nest, that reads are merged and how they are reported */
+static int test_bootstage_scopes(struct unit_test_state *uts)
+{
+	uint outer_start, outer_time, outer_count;
+	uint probe_start, probe_time, probe_count;
+	uint read_start, read_time, read_count;
+	int outer, probe, read, first, i;
+	char *buf;
+	int len;
+
+	outer = bootstage_scope_start(BOOTSTAGE_SCOPE_USER, "ut_outer");
+	if (outer == -ENOSPC) {
+		bootstage_scope_end(outer);
+		printf("Skipping: scope table is full\n");
+		return 0;
+	}
+	ut_assert(outer >= 0);
+	probe = bootstage_scope_start(BOOTSTAGE_SCOPE_PROBE, "ut_dev");
+	ut_assert(probe > outer);
+
+	first = -1;
+	for (i = 0; i < SCOPE_TEST_READS; i++) {
+		read = bootstage_scope_start(BOOTSTAGE_SCOPE_READ, "ut_blk");
+		ut_assert(read > probe);
+		if (first < 0)
+			first = read;
+		ut_asserteq(first, read);
+		udelay(SCOPE_TEST_READ_US);
+		bootstage_scope_end(read);
+	}
+	bootstage_scope_end(probe);
+	bootstage_scope_end(outer);
+
+	len = bootstage_scope_export(BOOTSTAGE_TRACE_CHROME, NULL, 0);
+	buf = malloc(len + 1);
+	ut_assertnonnull(buf);
+	ut_asserteq(len, bootstage_scope_export(BOOTSTAGE_TRACE_CHROME, buf,
+						len + 1));
+
+	ut_assertok(find_event(buf, "ut_outer", "scope", &outer_start,
+			       &outer_time, &outer_count));
+	ut_assertok(find_event(buf, "ut_dev", "probe", &probe_start,
+			       &probe_time, &probe_count));
+	ut_assertok(find_event(buf, "ut_blk", "read", &read_start, &read_time,
+			       &read_count));
+
+	/* The merged read starts with the first read and holds the total */
+	ut_asserteq(1, outer_count);
+	ut_asserteq(1, probe_count);
+	ut_asserteq(SCOPE_TEST_READS, read_count);
+	ut_assert(read_time >= SCOPE_TEST_READS * SCOPE_TEST_READ_US);
+	ut_assert(outer_start <= probe_start && probe_start <= read_start);
+	ut_assert(read_start + read_time <= probe_start + probe_time);
+	ut_assert(probe_start + probe_time <= outer_start + outer_time);
+	free(buf);
+
+	/* Each scope is shown below its parent */
+	len = bootstage_scope_export(BOOTSTAGE_TRACE_FOLDED, NULL, 0);
+	buf = malloc(len + 1);
+	ut_assertnonnull(buf);
+	bootstage_scope_export(BOOTSTAGE_TRACE_FOLDED, buf, len + 1);
+	ut_assertnonnull(strstr(buf, "\nut_outer "));
+	ut_assertnonnull(strstr(buf, "\nut_outer;probe:ut_dev "));
+	ut_assertnonnull(strstr(buf, "\nut_outer;probe:ut_dev;read:ut_blk "));
+	free(buf);
+
+	return 0;
+}
+COMMON_TEST(test_bootstage_scopes, 0);
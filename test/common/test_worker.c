@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the secondary-CPU worker pool
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <worker.h>
+#include <linux/sizes.h>
+#include <test/common.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* More jobs than fit in the queue at once */
+#define WORKER_TEST_JOBS	50
+
+struct worker_test_sum {
+	const u32 *buf;
+	int count;
+	u32 sum;
+};
+
+static int worker_test_sum(void *arg)
+{
+	struct worker_test_sum *ts = arg;
+	int i;
+
+	ts->sum = 0;
+	for (i = 0; i < ts->count; i++)
+		ts->sum += ts->buf[i];
+
+	return ts->count;
+}
+
+static long worker_test_range(void *arg, ulong start, ulong end)
+{
+	u8 *buf = arg;
+	ulong i;
+
+	for (i = start; i < end; i++)
+		buf[i]++;
+
+	return end - start;
+}
+
+static int test_worker(struct unit_test_state *uts)
+{
+	struct worker_test_sum ts[WORKER_TEST_JOBS];
+	struct worker_job job[WORKER_TEST_JOBS];
+	const int words = SZ_4K;
+	const ulong size = SZ_1M + 3;
+	u32 *buf;
+	u8 *mem;
+	int i;
+
+	ut_asserteq(CONFIG_WORKER_NR_CPUS - 1, worker_count());
+
+	buf = malloc(words * sizeof(*buf));
+	ut_assertnonnull(buf);
+	for (i = 0; i < words; i++)
+		buf[i] = i;
+	for (i = 0; i < WORKER_TEST_JOBS; i++) {
+		ts[i].buf = buf + i;
+		ts[i].count = words - i;
+		worker_submit(&job[i], worker_test_sum, &ts[i]);
+	}
+	for (i = 0; i < WORKER_TEST_JOBS; i++) {
+		ut_asserteq(words - i, worker_wait(&job[i]));
+		ut_asserteq((words - 1) * words / 2 - (i - 1) * i / 2,
+			    ts[i].sum);
+	}
+	free(buf);
+
+	/* Each byte must be handled exactly once, however the range is split */
+	mem = malloc(size);
+	ut_assertnonnull(mem);
+	memset(mem, '\0', size);
+	ut_asserteq(size - 1, worker_run_range(1, size, 64, worker_test_range,
+					       mem));
+	ut_asserteq(0, mem[0]);
+	for (i = 1; i < size; i++)
+		ut_asserteq(1, mem[i]);
+	ut_asserteq(0, worker_run_range(5, 5, 64, worker_test_range, mem));
+
+	ut_asserteq_ptr(mem + 1, worker_memset(mem + 1, 0xa5, size - 2));
+	ut_asserteq(0, mem[0]);
+	ut_asserteq(1, mem[size - 1]);
+	for (i = 1; i < size - 1; i++)
+		ut_asserteq(0xa5, mem[i]);
+	free(mem);
+
+	/* The pool starts again after being parked */
+	ut_assertok(worker_park());
+	ut_asserteq(CONFIG_WORKER_NR_CPUS - 1, worker_count());
+	ut_assertok(worker_park());
+
+	return 0;
+}
+COMMON_TEST(test_worker, 0);
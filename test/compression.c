@@ -4,13 +4,16 @@
  */
 
 #include <common.h>
+#include <abuf.h>
 #include <bootm.h>
 #include <command.h>
 #include <gzip.h>
+#include <hash.h>
 #include <image.h>
 #include <log.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <time.h>
 #include <asm/io.h>
 
 #include <u-boot/lz4.h>
@@ -22,6 +25,8 @@
 #include <lzma/LzmaTools.h>
 
 #include <linux/lzo.h>
+#include <linux/sizes.h>
+#include <linux/zstd.h>
 #include <test/compression.h>
 #include <test/suites.h>
 #include <test/ut.h>
@@ -121,6 +126,44 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+/* zstd -19 /tmp/plain.txt -o /tmp/plain.zst */
+static const char zstd_compressed[] =
+	"\x28\xb5\x2f\xfd\x64\x5e\x00\xad\x05\x00\x42\x4e\x26\x17\x90\x3b"
+	"\x07\x04\x5a\x13\x8b\xa7\x65\x34\x12\x21\x6d\xb0\x39\xbb\xae\xe8"
+	"\xba\xc9\xcd\x5e\x02\x49\xd0\x2b\xa9\xfa\x96\x92\xe7\x1f\x19\x19"
+	"\x7c\x8f\xf1\x9d\x54\x37\xfc\xd6\x0a\xf3\x0c\x93\x56\xc7\x52\x4f"
+	"\x0a\x62\x3e\xd1\xa5\x83\x17\x31\xab\x5d\x8f\x57\xf3\xcc\x3b\x58"
+	"\xf8\x91\x8c\xf1\x2a\x5c\x89\xdd\xf2\x9b\x15\xb7\x92\x5b\xbe\xba"
+	"\xab\xd5\xd1\x34\xdf\xf0\x02\x0e\x61\xcd\x7b\xd6\x01\xfc\xc2\xa7"
+	"\xd4\xd1\x3d\x26\x9c\x10\x49\xb8\x5b\xcd\xba\x7c\xf7\xac\x4b\xad"
+	"\xb7\x31\x1c\xbc\xf9\xcb\x62\x8e\x2e\x9b\x0f\xd3\x87\x57\x45\x12"
+	"\x16\xfa\x3a\x79\xde\x65\xf8\xcc\x48\xd5\x43\xa6\xbd\xc3\x91\x29"
+	"\x65\x29\xa7\x5b\x9a\x08\x08\x00\x60\x13\x00\x63\xa3\x8e\x28\x94"
+	"\x79\x41\x2a\x78\xc2\x91\x70\x9f\xaa\x6a\x21\x7a\xa1\xaa\x0c\xe4"
+	"\xf4\x6e\xfa";
+static const unsigned long zstd_compressed_size = 195;
+
+/*
+ * plain repeated to fill just under 256KiB, as used by the FIT tests:
+ * zstd -19 /tmp/repeated.txt -o /tmp/repeated.zst
+ */
+static const char zstd_repeated[] =
+	"\x28\xb5\x2f\xfd\xa4\xa8\xfe\x03\x00\xd4\x05\x00\x52\x4e\x26\x17"
+	"\x80\x6d\x0e\x00\x10\x12\x93\xa0\xe5\x3f\xd1\x9e\x20\xf2\xc4\x30"
+	"\xe6\x6f\x74\x95\x0d\xd7\x03\xc0\xa0\x5f\x50\xf5\x0c\x50\x9c\x8f"
+	"\xa0\xb4\x9e\x73\x8d\xff\xa0\xfa\x61\xb7\xd6\x87\x6f\x1a\xb4\x42"
+	"\x52\x41\x80\x20\x21\x24\xb8\x69\x59\x6d\x42\x5e\xc5\x2f\x2f\xe1"
+	"\xe1\x08\xae\xc6\xab\x2f\x15\x5f\xad\x5b\xfa\xcc\x4b\x4b\xa0\xa5"
+	"\xaf\xed\x6a\x85\x38\xcc\x3f\xbc\x41\x4b\x96\xe3\xa0\xb5\xf0\xbe"
+	"\xcf\x29\xf5\xdf\x21\x17\x56\x0a\x60\x78\x4b\x66\x4d\xbf\x39\x6b"
+	"\xaa\xf5\x3a\x87\x85\x33\x9f\xc9\x65\xa9\x21\xf3\x1f\xfa\xef\xca"
+	"\x00\x86\x8d\xbe\x56\x9c\x37\x0f\x7f\x1d\xa8\xfa\xd7\x30\x87\x58"
+	"\x5a\x6a\x49\x65\x34\x43\x17\x01\x09\x00\x9f\xfe\x61\x9b\x1d\x6c"
+	"\x22\x60\x6c\x94\x45\x51\xaf\x66\x84\xa2\xc0\x08\x23\xe1\x3a\x42"
+	"\x65\x41\xf4\x42\x55\x19\x55\x00\x00\x00\x01\x00\xa5\xfe\x57\xff"
+	"\xb9\x06\x02\xe8\x77\xf1\xea";
+static const unsigned long zstd_repeated_size = 215;
+
 
 #define TEST_BUFFER_SIZE	512
 
@@ -296,6 +339,54 @@ static int uncompress_using_lz4(struct unit_test_state *uts,
 	return (ret != 0);
 }
 
+static int compress_using_zstd(struct unit_test_state *uts,
+			       void *in, unsigned long in_size,
+			       void *out, unsigned long out_max,
+			       unsigned long *out_size)
+{
+	const char *data = zstd_compressed;
+	unsigned long size = zstd_compressed_size;
+	ulong pos;
+
+	/* There is no zstd compression in u-boot, so fake it. */
+	if (in_size != strlen(plain)) {
+		for (pos = 0; pos < in_size; pos += strlen(plain))
+			ut_asserteq_mem(plain, in + pos, strlen(plain));
+		ut_asserteq(in_size, pos);
+		data = zstd_repeated;
+		size = zstd_repeated_size;
+	}
+	ut_asserteq_mem(plain, in, strlen(plain));
+
+	if (size > out_max)
+		return -1;
+
+	memcpy(out, data, size);
+	if (out_size)
+		*out_size = size;
+
+	return 0;
+}
+
+static int uncompress_using_zstd(struct unit_test_state *uts,
+				 void *in, unsigned long in_size,
+				 void *out, unsigned long out_max,
+				 unsigned long *out_size)
+{
+	struct abuf ain, aout;
+	int ret;
+
+	abuf_init_set(&ain, in, in_size);
+	abuf_init_set(&aout, out, out_max);
+	ret = zstd_decompress(&ain, &aout);
+	if (ret < 0)
+		return 1;
+	if (out_size)
+		*out_size = ret;
+
+	return 0;
+}
+
 #define errcheck(statement) if (!(statement)) { \
 	fprintf(stderr, "\tFailed: %s\n", #statement); \
 	ret = 1; \
@@ -440,6 +531,59 @@ static int compression_test_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_lz4, 0);
 
+static int compression_test_zstd(struct unit_test_state *uts)
+{
+	return run_test(uts, "zstd", compress_using_zstd,
+			uncompress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_zstd, 0);
+
+/* Decompress a zstd frame in small pieces, straight into one buffer */
+static int compression_test_zstd_stream(struct unit_test_state *uts)
+{
+	const ulong in_step = 7, unc_max = SZ_256K;
+	ZSTD_outBuffer zout;
+	ZSTD_inBuffer zin;
+	struct zstd_stream zs;
+	char *out;
+	ulong pos;
+	int ret;
+
+	out = malloc(unc_max);
+	ut_assertnonnull(out);
+	ut_assertok(zstd_stream_init(&zs));
+	zin.src = zstd_repeated;
+	zin.size = 0;
+	zin.pos = 0;
+	zout.dst = out;
+	zout.size = unc_max;
+	zout.pos = 0;
+	do {
+		zin.size = min(zin.size + in_step, zstd_repeated_size);
+		ret = zstd_stream_decompress(&zs, &zin, &zout);
+		ut_assert(ret >= 0);
+	} while (!ret);
+	ut_asserteq(zstd_repeated_size, zin.pos);
+	zstd_stream_end(&zs);
+
+	ut_asserteq(unc_max - unc_max % strlen(plain), zout.pos);
+	for (pos = 0; pos < zout.pos; pos += strlen(plain))
+		ut_asserteq_mem(plain, out + pos, strlen(plain));
+
+	/* Running out of space must be reported */
+	ut_assertok(zstd_stream_init(&zs));
+	zin.size = zstd_repeated_size;
+	zin.pos = 0;
+	zout.size = SZ_64K;
+	zout.pos = 0;
+	ut_asserteq(-ENOSPC, zstd_stream_decompress(&zs, &zin, &zout));
+	zstd_stream_end(&zs);
+	free(out);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_zstd_stream, 0);
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
@@ -530,12 +674,214 @@ static int compression_test_bootm_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_lz4, 0);
 
+static int compression_test_bootm_zstd(struct unit_test_state *uts)
+{
+	return run_bootm_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_bootm_zstd, 0);
+
 static int compression_test_bootm_none(struct unit_test_state *uts)
 {
 	return run_bootm_test(uts, IH_COMP_NONE, compress_using_none);
 }
 COMPRESSION_TEST(compression_test_bootm_none, 0);
 
+#if CONFIG_IS_ENABLED(FIT_STREAM)
+/**
+ * run_fit_stream_test() - Run tests on single-pass FIT image loading
+ *
+ * This builds a FIT holding a single image with a sha256 hash, then loads
+ * it, checking that the data is correct and that corruption is detected
+ *
+ * @comp_type:	Compression type to test
+ * @compress:	Our function to compress data
+ * @return 0 if OK, non-zero on failure
+ */
+static int run_fit_stream_test(struct unit_test_state *uts, int comp_type,
+			       mutate_func compress)
+{
+	const ulong fit_size = SZ_512K, unc_max = SZ_256K;
+	ulong unc_size, compress_size, len;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int images, node, hash_node;
+	char *unc, *out, *fit;
+	const void *data;
+	int value_len;
+	int data_len;
+	ulong pos;
+
+	/* Use enough data to need several chunks */
+	unc = malloc(unc_max);
+	out = malloc(unc_max);
+	fit = malloc(fit_size);
+	ut_assertnonnull(unc);
+	ut_assertnonnull(out);
+	ut_assertnonnull(fit);
+	unc_size = unc_max - strlen(plain);
+	for (pos = 0; pos < unc_size; pos += strlen(plain))
+		memcpy(unc + pos, plain, strlen(plain));
+	unc_size = pos;
+
+	ut_assertok(fdt_create_empty_tree(fit, fit_size));
+	images = fdt_add_subnode(fit, 0, "images");
+	ut_assert(images >= 0);
+	node = fdt_add_subnode(fit, images, "image-1");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_string(fit, node, FIT_COMP_PROP,
+				       genimg_get_comp_short_name(comp_type)));
+	ut_assertok(fdt_setprop_placeholder(fit, node, FIT_DATA_PROP,
+					    unc_max, (void **)&data));
+	compress_size = unc_max;
+	ut_assertok(compress(uts, unc, unc_size, (void *)data, unc_max,
+			     &compress_size));
+	ut_assertok(fdt_setprop_placeholder(fit, node, FIT_DATA_PROP,
+					    compress_size, (void **)&data));
+	hash_node = fdt_add_subnode(fit, node, "hash-1");
+	ut_assert(hash_node >= 0);
+	ut_assertok(fdt_setprop_string(fit, hash_node, FIT_ALGO_PROP,
+				       "sha256"));
+	data = fdt_getprop(fit, node, FIT_DATA_PROP, &data_len);
+	ut_assertnonnull(data);
+	value_len = sizeof(value);
+	ut_assertok(hash_block("sha256", data, data_len, value, &value_len));
+	ut_assertok(fdt_setprop(fit, hash_node, FIT_VALUE_PROP, value,
+				value_len));
+
+	/* The hash node may have moved the data */
+	node = fdt_path_offset(fit, "/images/image-1");
+	ut_assert(node >= 0);
+	data = fdt_getprop(fit, node, FIT_DATA_PROP, &data_len);
+	ut_assert(fit_image_can_stream(fit, node, comp_type));
+
+	memset(out, '\0', unc_max);
+	ut_assertok(fit_image_stream_load(fit, node, comp_type, data,
+					  data_len, out, unc_max, &len));
+	ut_asserteq(unc_size, len);
+	ut_asserteq_mem(unc, out, unc_size);
+
+	/* The destination buffer must be large enough */
+	ut_asserteq(-ENOSPC, fit_image_stream_load(fit, node, comp_type, data,
+						   data_len, out, unc_size - 1,
+						   &len));
+
+	/* Corrupt the stored hash value */
+	hash_node = fdt_subnode_offset(fit, node, "hash-1");
+	value[0] ^= 0xff;
+	ut_assertok(fdt_setprop_inplace(fit, hash_node, FIT_VALUE_PROP, value,
+					value_len));
+	ut_asserteq(-EACCES, fit_image_stream_load(fit, node, comp_type,
+						   data, data_len, out,
+						   unc_max, &len));
+
+	/* Images with a signature must be checked in full before loading */
+	ut_assert(fdt_add_subnode(fit, node, "signature-1") >= 0);
+	node = fdt_path_offset(fit, "/images/image-1");
+	ut_assert(!fit_image_can_stream(fit, node, comp_type));
+
+	free(fit);
+	free(out);
+	free(unc);
+
+	return 0;
+}
+
+static int compression_test_fit_stream_gzip(struct unit_test_state *uts)
+{
+	return run_fit_stream_test(uts, IH_COMP_GZIP, compress_using_gzip);
+}
+COMPRESSION_TEST(compression_test_fit_stream_gzip, 0);
+
+static int compression_test_fit_stream_zstd(struct unit_test_state *uts)
+{
+	return run_fit_stream_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_fit_stream_zstd, 0);
+
+static int compression_test_fit_stream_none(struct unit_test_state *uts)
+{
+	return run_fit_stream_test(uts, IH_COMP_NONE, compress_using_none);
+}
+COMPRESSION_TEST(compression_test_fit_stream_none, 0);
+#endif
+
+/* Amount of data used by the decompression benchmark */
+#define BENCH_SIZE		SZ_4M
+#define BENCH_RUNS		4
+
+/*
+ * Fill a buffer with something resembling a kernel image: runs of text-like
+ * symbols with repeats at a range of distances, separated by stretches of
+ * poorly compressible bytes
+ */
+static void bench_fill(u8 *buf, ulong size)
+{
+	u32 seed = 0x12345678;
+	ulong pos = 0, len, dist, i;
+
+	while (pos < size) {
+		seed = seed * 1103515245 + 12345;
+		len = min(size - pos, 3 + (ulong)(seed >> 24) % 64);
+		switch ((seed >> 16) & 3) {
+		case 0:
+			for (i = 0; i < len; i++) {
+				seed = seed * 1103515245 + 12345;
+				buf[pos + i] = seed >> 24;
+			}
+			break;
+		case 1:
+			for (i = 0; i < len; i++)
+				buf[pos + i] = 'a' + (seed >> (i % 16)) % 26;
+			break;
+		default:
+			dist = 1 + (seed >> 8) % min(pos + 1, (ulong)SZ_32K);
+			for (i = 0; i < len; i++)
+				buf[pos + i] = pos + i >= dist ?
+					buf[pos + i - dist] : ' ';
+			break;
+		}
+		pos += len;
+	}
+}
+
+/* Report the throughput of gunzip() in MB/s of uncompressed data */
+static int compression_test_gunzip_bench(struct unit_test_state *uts)
+{
+	ulong comp_size, len, start, us, best = ULONG_MAX;
+	u8 *orig, *comp, *out;
+	int i;
+
+	orig = malloc(BENCH_SIZE);
+	comp = malloc(BENCH_SIZE);
+	out = malloc(BENCH_SIZE);
+	ut_assertnonnull(orig);
+	ut_assertnonnull(comp);
+	ut_assertnonnull(out);
+
+	bench_fill(orig, BENCH_SIZE);
+	comp_size = BENCH_SIZE;
+	ut_assertok(gzip(comp, &comp_size, orig, BENCH_SIZE));
+
+	for (i = 0; i < BENCH_RUNS; i++) {
+		memset(out, '\0', BENCH_SIZE);
+		len = comp_size;
+		start = timer_get_us();
+		ut_assertok(gunzip(out, BENCH_SIZE, comp, &len));
+		us = timer_get_us() - start;
+		ut_asserteq(BENCH_SIZE, len);
+		ut_asserteq_mem(orig, out, BENCH_SIZE);
+		best = min(best, max(us, 1UL));
+	}
+	printf("gunzip: %lu -> %lu bytes, %lu us, %lu MB/s\n", comp_size,
+	       (ulong)BENCH_SIZE, best, (ulong)BENCH_SIZE / best);
+
+	free(out);
+	free(comp);
+	free(orig);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_gunzip_bench, 0);
+
 int do_ut_compression(struct cmd_tbl *cmdtp, int flag, int argc,
 		      char *const argv[])
 {
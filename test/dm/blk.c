@@ -5,10 +5,12 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
 #include <part.h>
 #include <usb.h>
 #include <asm/global_data.h>
 #include <asm/state.h>
+#include <linux/sizes.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -79,6 +81,32 @@ static int dm_test_blk_usb(struct unit_test_state *uts)
 	/* Check we have one block device for each mass storage device */
 	ut_asserteq(6, count_blk_devices());
 
+	/*
+	 * USB storage has no submit() method, so requests are carried out
+	 * at once; a miss must only be looked up in the cache once. There
+	 * is no backing file, so the read itself fails.
+	 */
+	if (CONFIG_IS_ENABLED(BLOCK_CACHE)) {
+		struct block_cache_stats stats;
+		struct blk_request req;
+		u8 *buf;
+
+		buf = malloc(dev_desc->blksz);
+		ut_assertnonnull(buf);
+		blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+		blkcache_stats(&stats);
+		memset(&req, '\0', sizeof(req));
+		req.op = BLK_REQ_READ;
+		req.blkcnt = 1;
+		req.buffer = buf;
+		ut_assertok(blk_submit(dev_desc, &req));
+		ut_asserteq(true, req.done);
+		blkcache_stats(&stats);
+		ut_asserteq(0, stats.hits);
+		ut_asserteq(1, stats.misses);
+		free(buf);
+	}
+
 	/* Now go around again, making sure the old devices were unbound */
 	ut_assertok(usb_stop());
 	ut_assertok(usb_init());
@@ -217,3 +245,181 @@ static int dm_test_blk_iter(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_iter, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test that the block cache serves repeated and sequential reads */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats, old;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	u8 *buf, *pattern;
+	int i;
+
+	ut_assertok(blk_get_device(IF_TYPE_MMC, 0, &dev));
+	desc = dev_get_uclass_plat(dev);
+
+	/* Write a pattern with the block number at the start of each block */
+	pattern = calloc(48, desc->blksz);
+	buf = malloc(4 * desc->blksz);
+	ut_assertnonnull(pattern);
+	ut_assertnonnull(buf);
+	for (i = 0; i < 48; i++)
+		pattern[i * desc->blksz] = 96 + i;
+	ut_asserteq(48, blk_dwrite(desc, 96, 48, pattern));
+
+	blkcache_stats(&old);
+	blkcache_configure(8, 32);
+	blkcache_configure_size(SZ_1M, 16);
+	blkcache_invalidate(desc->if_type, desc->devnum);
+
+	/* A miss fetches the whole entry, so the rest of it is then a hit */
+	ut_asserteq(1, blk_dread(desc, 99, 1, buf));
+	ut_asserteq(99, buf[0]);
+	ut_asserteq(2, blk_dread(desc, 97, 2, buf));
+	ut_asserteq(97, buf[0]);
+	ut_asserteq(98, buf[desc->blksz]);
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(1, stats.entries);
+	ut_asserteq(2 * desc->blksz, stats.bytes_served);
+
+	/* Writing drops the cached data */
+	pattern[0] = 0xa5;
+	ut_asserteq(1, blk_dwrite(desc, 96, 1, pattern));
+	ut_asserteq(1, blk_dread(desc, 96, 1, buf));
+	ut_asserteq(0xa5, buf[0]);
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.hits);
+	ut_asserteq(1, stats.misses);
+
+	/*
+	 * Sequential reads of half an entry: once the run is established, a
+	 * miss also reads ahead two more entries, which the last reads hit.
+	 */
+	for (i = 0; i < 8; i++) {
+		ut_asserteq(4, blk_dread(desc, 104 + i * 4, 4, buf));
+		ut_asserteq(104 + i * 4, buf[0]);
+		ut_asserteq(107 + i * 4, buf[3 * desc->blksz]);
+	}
+	blkcache_stats(&stats);
+	ut_asserteq(6, stats.hits);
+	ut_asserteq(2, stats.misses);
+	ut_asserteq(16, stats.ra_issued);
+	ut_asserteq(16, stats.ra_used);
+
+	/* With a small cache, read-ahead is cut down to one entry */
+	blkcache_configure_size(64 * desc->blksz, 16);
+	blkcache_invalidate(desc->if_type, desc->devnum);
+	for (i = 0; i < 8; i++) {
+		ut_asserteq(4, blk_dread(desc, 104 + i * 4, 4, buf));
+		ut_asserteq(104 + i * 4, buf[0]);
+	}
+	blkcache_stats(&stats);
+	ut_asserteq(5, stats.hits);
+	ut_asserteq(3, stats.misses);
+	ut_asserteq(16, stats.ra_issued);
+	ut_asserteq(8, stats.ra_used);
+
+	blkcache_configure(old.max_blocks_per_entry, old.max_entries);
+	blkcache_configure_size(old.max_size, old.max_readahead);
+	free(buf);
+	free(pattern);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+static int blk_test_seq;
+
+static void blk_test_end_io(struct blk_request *req)
+{
+	int *order = req->priv;
+
+	*order = ++blk_test_seq;
+}
+
+/* Test that asynchronous requests are queued and completed in order */
+static int dm_test_blk_async(struct unit_test_state *uts)
+{
+	struct blk_request req[3];
+	struct blk_desc *desc;
+	struct udevice *dev;
+	int order[2] = {0};
+	u8 *buf, *pattern;
+	int i;
+
+	blk_test_seq = 0;
+	ut_assertok(blk_get_device(IF_TYPE_MMC, 0, &dev));
+	desc = dev_get_uclass_plat(dev);
+
+	pattern = calloc(300, desc->blksz);
+	buf = calloc(300, desc->blksz);
+	ut_assertnonnull(pattern);
+	ut_assertnonnull(buf);
+	for (i = 0; i < 300; i++)
+		pattern[i * desc->blksz] = i;
+	ut_asserteq(300, blk_dwrite(desc, 512, 300, pattern));
+	blkcache_invalidate(desc->if_type, desc->devnum);
+
+	memset(req, '\0', sizeof(req));
+	req[0].op = BLK_REQ_READ;
+	req[0].start = 512;
+	req[0].blkcnt = 300;
+	req[0].buffer = buf;
+	req[0].end_io = blk_test_end_io;
+	req[0].priv = &order[0];
+	req[1] = req[0];
+	req[1].start = 1024;
+	req[1].blkcnt = 8;
+	req[1].buffer = pattern;
+	req[1].priv = &order[1];
+	ut_assertok(blk_submit(desc, &req[0]));
+	ut_assertok(blk_submit(desc, &req[1]));
+	ut_asserteq(false, req[0].done);
+	ut_asserteq(2, blk_poll(desc));
+
+	/* The mmc driver moves 64KB per poll, so the first read takes three */
+	ut_asserteq(128, req[0].xfer);
+	ut_asserteq(2, blk_poll(desc));
+	ut_asserteq(1, blk_poll(desc));
+	ut_asserteq(true, req[0].done);
+	ut_assertok(req[0].status);
+	ut_asserteq(1, order[0]);
+	ut_asserteq(0, order[1]);
+	ut_asserteq(0, blk_poll(desc));
+	ut_asserteq(2, order[1]);
+	for (i = 0; i < 300; i++)
+		ut_asserteq((u8)i, buf[i * desc->blksz]);
+
+	/* Write back a modified block and wait for it */
+	buf[0] = 0x5a;
+	req[2].op = BLK_REQ_WRITE;
+	req[2].start = 512;
+	req[2].blkcnt = 1;
+	req[2].buffer = buf;
+	req[2].end_io = NULL;
+	ut_assertok(blk_submit(desc, &req[2]));
+	ut_assertok(blk_wait(desc, &req[2]));
+	ut_asserteq(1, req[2].xfer);
+	ut_asserteq(1, blk_dread(desc, 512, 1, pattern));
+	ut_asserteq(0x5a, pattern[0]);
+
+	/* A synchronous read waits for an outstanding write to its blocks */
+	buf[0] = 0xa5;
+	ut_assertok(blk_submit(desc, &req[2]));
+	ut_asserteq(false, req[2].done);
+	ut_asserteq(1, blk_dread(desc, 512, 1, pattern));
+	ut_asserteq(true, req[2].done);
+	ut_asserteq(0xa5, pattern[0]);
+
+	/* Waiting for a request which was never submitted fails */
+	req[2].done = false;
+	ut_asserteq(-ENOENT, blk_wait(desc, &req[2]));
+
+	free(buf);
+	free(pattern);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
@@ -10,13 +10,17 @@
 #include <dm.h>
 #include <env.h>
 #include <fdtdec.h>
+#include <image.h>
 #include <log.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
 #include <asm/eth.h>
+#include <asm/unaligned.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
+#include <net/tcp.h>
 #include <test/test.h>
 #include <test/ut.h>
 
@@ -66,6 +70,31 @@ static int dm_test_eth_alias(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_eth_alias, UT_TESTF_SCAN_FDT);
 
+static int dm_test_eth_stats(struct unit_test_state *uts)
+{
+	struct eth_stats before, after;
+	struct udevice *dev;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+	ut_assertok(eth_get_stats(dev, &before));
+
+	/* An ARP request and reply, then a ping and its reply */
+	net_ping_ip = string_to_ip("1.1.2.2");
+	env_set("ethact", "eth@10002000");
+	ut_assertok(net_loop(PING));
+
+	ut_assertok(eth_get_stats(dev, &after));
+	ut_asserteq(2, after.tx_packets - before.tx_packets);
+	ut_asserteq(2, after.rx_packets - before.rx_packets);
+	ut_assert(after.rx_bytes - before.rx_bytes >=
+		  2 * (ETHER_HDR_SIZE + ARP_HDR_SIZE));
+	ut_asserteq(0, after.rx_errors);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_stats, UT_TESTF_SCAN_FDT);
+
 static int dm_test_eth_prime(struct unit_test_state *uts)
 {
 	net_ping_ip = string_to_ip("1.1.2.2");
@@ -431,3 +460,605 @@ static int dm_test_eth_async_ping_reply(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_eth_async_ping_reply, UT_TESTF_SCAN_FDT);
+
+/* A TFTP server which loses one block and sends the last two out of order */
+#define SB_TFTP_SERVER_PORT	5000
+#define SB_TFTP_BLKSIZE		512
+#define SB_TFTP_WINDOWSIZE	2
+#define SB_TFTP_FILE_SIZE	(11 * SB_TFTP_BLKSIZE + 100)
+#define SB_TFTP_LOAD_ADDR	0x100000
+
+struct sb_tftp_server {
+	int client_port;
+	/* Block to lose the first time it is sent, or 0 */
+	int drop_block;
+	/* Send the last two blocks in the wrong order, once */
+	bool swap_last;
+	/* Last block acknowledged, to spot a repeated ACK */
+	int last_ack;
+	/* Mask of the blocks which have been acknowledged */
+	u32 acked;
+};
+
+static u8 sb_tftp_file_byte(int pos)
+{
+	return pos * 7 + (pos >> 9);
+}
+
+static int sb_tftp_reply(struct udevice *dev, const void *data, int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_tftp_server *srv = priv->priv;
+	struct ethernet_hdr *eth;
+	struct ip_udp_hdr *ip;
+
+	/* Anything which does not fit in the receive queue is lost */
+	if (priv->recv_packets >= PKTBUFSRX)
+		return 0;
+
+	eth = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth->et_dest, net_ethaddr, ARP_HLEN);
+	memcpy(eth->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth->et_protlen = htons(PROT_IP);
+	ip = (void *)eth + ETHER_HDR_SIZE;
+	net_set_ip_header((uchar *)ip, net_ip, priv->fake_host_ipaddr,
+			  IP_UDP_HDR_SIZE + len, IPPROTO_UDP);
+	ip->udp_src = htons(SB_TFTP_SERVER_PORT);
+	ip->udp_dst = htons(srv->client_port);
+	ip->udp_len = htons(UDP_HDR_SIZE + len);
+	ip->udp_xsum = 0;
+	memcpy(ip + 1, data, len);
+
+	priv->recv_packet_length[priv->recv_packets] =
+		ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+	++priv->recv_packets;
+
+	return 0;
+}
+
+static int sb_tftp_send_block(struct udevice *dev, int block)
+{
+	u8 buf[4 + SB_TFTP_BLKSIZE];
+	int pos = (block - 1) * SB_TFTP_BLKSIZE;
+	int len = min(SB_TFTP_FILE_SIZE - pos, SB_TFTP_BLKSIZE);
+	int i;
+
+	put_unaligned_be16(3, buf);	/* DATA */
+	put_unaligned_be16(block, buf + 2);
+	for (i = 0; i < len; i++)
+		buf[4 + i] = sb_tftp_file_byte(pos + i);
+
+	return sb_tftp_reply(dev, buf, 4 + len);
+}
+
+static int sb_tftp_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	static const char oack[] = "\0\6blksize\0" __stringify(SB_TFTP_BLKSIZE)
+		"\0windowsize\0" __stringify(SB_TFTP_WINDOWSIZE);
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_tftp_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	u8 *tftp = (u8 *)(ip + 1);
+	const int last = SB_TFTP_FILE_SIZE / SB_TFTP_BLKSIZE + 1;
+	int block, end;
+
+	sandbox_eth_arp_req_to_reply(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	switch (get_unaligned_be16(tftp)) {
+	case 1:		/* RRQ */
+		srv->client_port = ntohs(ip->udp_src);
+		return sb_tftp_reply(dev, oack, sizeof(oack));
+	case 4:		/* ACK: send the next window */
+		block = get_unaligned_be16(tftp + 2);
+		srv->acked |= BIT(block);
+		/* A repeated ACK reports a gap: only send the missing block */
+		if (block == srv->last_ack && block < last)
+			return sb_tftp_send_block(dev, block + 1);
+		if (block == srv->last_ack)
+			return 0;
+		srv->last_ack = block++;
+		end = min(block + SB_TFTP_WINDOWSIZE, last + 1);
+		if (srv->swap_last && block == last - 1 && end == last + 1) {
+			srv->swap_last = false;
+			sb_tftp_send_block(dev, last);
+			return sb_tftp_send_block(dev, last - 1);
+		}
+		for (; block < end; block++) {
+			if (block == srv->drop_block)
+				srv->drop_block = 0;
+			else
+				sb_tftp_send_block(dev, block);
+		}
+		return 0;
+	}
+
+	return 0;
+}
+
+static int dm_test_eth_tftp_window(struct unit_test_state *uts)
+{
+	const int drop = 3, last = SB_TFTP_FILE_SIZE / SB_TFTP_BLKSIZE + 1;
+	struct sb_tftp_server srv = {
+		.drop_block = drop,
+		.swap_last = true,
+		.last_ack = -1,
+	};
+	u8 *buf;
+	int i;
+
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	sandbox_eth_set_priv(0, &srv);
+
+	env_set("ethact", "eth@10002000");
+	net_server_ip = string_to_ip("1.1.2.2");
+	env_set_ulong("tftpwindowsize", SB_TFTP_WINDOWSIZE);
+	strcpy(net_boot_file_name, "test.bin");
+	image_load_addr = SB_TFTP_LOAD_ADDR;
+
+	buf = map_sysmem(SB_TFTP_LOAD_ADDR, SB_TFTP_FILE_SIZE);
+	memset(buf, '\0', SB_TFTP_FILE_SIZE);
+	ut_asserteq(SB_TFTP_FILE_SIZE, net_loop(TFTPGET));
+
+	/* The held blocks must have gone to the right place */
+	for (i = 0; i < SB_TFTP_FILE_SIZE; i++)
+		ut_asserteq(sb_tftp_file_byte(i), buf[i]);
+	ut_asserteq(0, srv.drop_block);
+	ut_assert(!srv.swap_last);
+
+	/*
+	 * Only the missing block was sent again. The blocks held past it were
+	 * acknowledged at once, rather than after a timeout asked for them
+	 */
+	ut_asserteq(0, srv.acked & (BIT(drop) | BIT(last - 1)));
+	ut_assert(srv.acked & BIT(drop + 1));
+	ut_assert(srv.acked & BIT(last));
+	unmap_sysmem(buf);
+
+	env_set("tftpwindowsize", NULL);
+	net_server_ip.s_addr = 0;
+	net_boot_file_name[0] = '\0';
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_tftp_window, UT_TESTF_SCAN_FDT);
+
+#if defined(CONFIG_CMD_NFS)
+/*
+ * An NFSv3 server which prefers small reads, answers two of them out of order
+ * and loses one reply
+ */
+#define SB_NFS_PORT		2049
+#define SB_NFS_READ_SIZE	512
+#define SB_NFS_WINDOWSIZE	3
+#define SB_NFS_FILE_SIZE	(10 * SB_NFS_READ_SIZE + 100)
+#define SB_NFS_LOAD_ADDR	0x100000
+
+struct sb_nfs_server {
+	/* Largest read asked for */
+	int max_count;
+	/* Read to hold back until the next one is answered, or -1 */
+	int swap_offset;
+	/* Read whose reply is lost the first time, or -1 */
+	int drop_offset;
+	/* Times the lost read was asked for */
+	int drop_reads;
+	/* Held back reply */
+	u32 held[6 + 5 + SB_NFS_READ_SIZE / 4];
+	int held_words;
+};
+
+static u8 sb_nfs_file_byte(int pos)
+{
+	return pos * 3 + (pos >> 8);
+}
+
+static int sb_nfs_reply(struct udevice *dev, struct ip_udp_hdr *req,
+			const u32 *words, int nwords)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth;
+	struct ip_udp_hdr *ip;
+	int len = nwords * sizeof(u32);
+
+	/* Anything which does not fit in the receive queue is lost */
+	if (priv->recv_packets >= PKTBUFSRX)
+		return 0;
+
+	eth = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth->et_dest, net_ethaddr, ARP_HLEN);
+	memcpy(eth->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth->et_protlen = htons(PROT_IP);
+	ip = (void *)eth + ETHER_HDR_SIZE;
+	net_set_ip_header((uchar *)ip, net_ip, priv->fake_host_ipaddr,
+			  IP_UDP_HDR_SIZE + len, IPPROTO_UDP);
+	ip->udp_src = req->udp_dst;
+	ip->udp_dst = req->udp_src;
+	ip->udp_len = htons(UDP_HDR_SIZE + len);
+	ip->udp_xsum = 0;
+	memcpy(ip + 1, words, len);
+
+	priv->recv_packet_length[priv->recv_packets] =
+		ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+	++priv->recv_packets;
+
+	return 0;
+}
+
+/* Fill in a READ3 reply after the RPC header, returning its length */
+static int sb_nfs_read(struct sb_nfs_server *srv, u32 *data, int offset,
+		       int count)
+{
+	u8 *buf = (u8 *)&data[5];
+	int len = max(0, min(SB_NFS_FILE_SIZE - offset, count));
+	int i;
+
+	srv->max_count = max(srv->max_count, count);
+	data[0] = 0;			/* NFS3_OK */
+	data[1] = 0;			/* no attributes */
+	data[2] = htonl(len);
+	data[3] = htonl(offset + len >= SB_NFS_FILE_SIZE);
+	data[4] = htonl(len);
+	for (i = 0; i < len; i++)
+		buf[i] = sb_nfs_file_byte(offset + i);
+	for (; i & 3; i++)
+		buf[i] = 0;
+
+	return 5 + i / 4;
+}
+
+static int sb_nfs_handler(struct udevice *dev, void *packet,
+			  unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_nfs_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	u32 *call = (u32 *)(ip + 1);
+	u32 *args = &call[6 + 9];	/* after the credentials */
+	u32 reply[6 + 5 + SB_NFS_READ_SIZE / 4] = {};
+	u32 *data = &reply[6];
+	int nwords = 6, offset, fh;
+
+	sandbox_eth_arp_req_to_reply(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	reply[0] = call[0];		/* XID */
+	reply[1] = htonl(1);		/* REPLY */
+
+	switch (ntohl(call[3])) {
+	case 100000:			/* portmap GETPORT */
+		data[0] = htonl(SB_NFS_PORT);
+		nwords++;
+		break;
+	case 100005:			/* mount */
+		if (ntohl(call[5]) == 1) {	/* MNT */
+			memset(data, 0x5a, 4 + 32);
+			data[0] = 0;
+			nwords += 1 + 32 / 4;
+		}
+		break;
+	case 100003:			/* NFS */
+		if (ntohl(call[4]) != 3) {
+			reply[5] = htonl(2);	/* PROG_MISMATCH */
+			data[0] = htonl(3);
+			data[1] = htonl(3);
+			nwords += 2;
+			break;
+		}
+		switch (ntohl(call[5])) {
+		case 3:			/* LOOKUP */
+			memset(data, 0xa5, 8 + 32);
+			data[0] = 0;
+			data[1] = htonl(32);
+			data[10] = 0;		/* no object attributes */
+			data[11] = 0;		/* no directory attributes */
+			nwords += 12;
+			break;
+		case 19:		/* FSINFO */
+			data[1] = 0;		/* no attributes */
+			data[2] = htonl(8192);	/* rtmax */
+			data[3] = htonl(SB_NFS_READ_SIZE); /* rtpref */
+			nwords += 4;
+			break;
+		case 6:			/* READ */
+			fh = ntohl(args[0]) / 4;
+			offset = ntohl(args[2 + fh]);
+			nwords += sb_nfs_read(srv, data, offset,
+					      ntohl(args[3 + fh]));
+			if (offset == srv->drop_offset) {
+				srv->drop_reads++;
+				if (srv->drop_reads == 1)
+					return 0;
+			}
+			if (offset == srv->swap_offset) {
+				srv->swap_offset = -1;
+				memcpy(srv->held, reply, nwords * sizeof(u32));
+				srv->held_words = nwords;
+				return 0;
+			}
+			sb_nfs_reply(dev, ip, reply, nwords);
+			if (srv->held_words) {
+				sb_nfs_reply(dev, ip, srv->held,
+					     srv->held_words);
+				srv->held_words = 0;
+			}
+			return 0;
+		}
+		break;
+	}
+
+	return sb_nfs_reply(dev, ip, reply, nwords);
+}
+
+static int dm_test_eth_nfs(struct unit_test_state *uts)
+{
+	struct sb_nfs_server srv = {
+		.swap_offset = 1 * SB_NFS_READ_SIZE,
+		.drop_offset = 5 * SB_NFS_READ_SIZE,
+	};
+	u8 *buf;
+	int i;
+
+	sandbox_eth_set_tx_handler(0, sb_nfs_handler);
+	sandbox_eth_set_priv(0, &srv);
+
+	env_set("ethact", "eth@10002000");
+	net_server_ip = string_to_ip("1.1.2.2");
+	env_set_ulong("nfswindowsize", SB_NFS_WINDOWSIZE);
+	strcpy(net_boot_file_name, "/export/test.bin");
+	image_load_addr = SB_NFS_LOAD_ADDR;
+
+	buf = map_sysmem(SB_NFS_LOAD_ADDR, SB_NFS_FILE_SIZE);
+	memset(buf, '\0', SB_NFS_FILE_SIZE);
+	ut_asserteq(SB_NFS_FILE_SIZE, net_loop(NFS));
+
+	for (i = 0; i < SB_NFS_FILE_SIZE; i++)
+		ut_asserteq(sb_nfs_file_byte(i), buf[i]);
+	unmap_sysmem(buf);
+
+	/* The preferred size was used and the lost read was asked for again */
+	ut_asserteq(SB_NFS_READ_SIZE, srv.max_count);
+	ut_asserteq(-1, srv.swap_offset);
+	ut_asserteq(2, srv.drop_reads);
+
+	env_set("nfswindowsize", NULL);
+	net_server_ip.s_addr = 0;
+	net_boot_file_name[0] = '\0';
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_nfs, UT_TESTF_SCAN_FDT);
+#endif
+
+#if defined(CONFIG_CMD_WGET)
+/*
+ * An HTTP server which loses one segment, then goes back to it when it sees
+ * a duplicate ACK. Its sequence numbers wrap during the transfer.
+ */
+#define SB_HTTP_MSS		1000
+#define SB_HTTP_ISS		0xffffd000
+#define SB_HTTP_FILE_SIZE	(20 * SB_HTTP_MSS + 123)
+#define SB_HTTP_LOAD_ADDR	0x100000
+#define SB_HTTP_IN_FLIGHT	(4 * SB_HTTP_MSS)
+
+struct sb_http_server {
+	int client_port;
+	u32 client_seq;
+	/* Offsets in the response of the oldest unacknowledged byte and next */
+	u32 snd_una;
+	u32 snd_nxt;
+	bool recovering;
+	/* Offset of the segment to lose the first time it is sent, or -1 */
+	int drop_off;
+	/* Window and MSS the client advertised */
+	uint client_win;
+	uint client_mss;
+	bool client_wscale;
+	bool got_fin;
+	char hdr[100];
+	int hdr_len;
+};
+
+static u8 sb_http_byte(struct sb_http_server *srv, int pos)
+{
+	if (pos < srv->hdr_len)
+		return srv->hdr[pos];
+	pos -= srv->hdr_len;
+
+	return pos * 13 + (pos >> 10);
+}
+
+static int sb_http_reply(struct udevice *dev, u8 flags, u32 off,
+			 const u8 *opt, int opt_len, int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_http_server *srv = priv->priv;
+	struct ethernet_hdr *eth;
+	struct ip_tcp_hdr *ip;
+	u8 *data;
+	int tcp_len = TCP_HDR_SIZE + opt_len + len;
+	uint sum;
+	int i;
+
+	/* Anything which does not fit in the receive queue is lost */
+	if (priv->recv_packets >= PKTBUFSRX)
+		return 0;
+
+	eth = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth->et_dest, net_ethaddr, ARP_HLEN);
+	memcpy(eth->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth->et_protlen = htons(PROT_IP);
+	ip = (void *)eth + ETHER_HDR_SIZE;
+	net_set_ip_header((uchar *)ip, net_ip, priv->fake_host_ipaddr,
+			  IP_HDR_SIZE + tcp_len, IPPROTO_TCP);
+	ip->tcp_src = htons(80);
+	ip->tcp_dst = htons(srv->client_port);
+	ip->tcp_seq = htonl(SB_HTTP_ISS + (flags & TCP_SYN ? 0 : 1) + off);
+	ip->tcp_ack = htonl(srv->client_seq);
+	ip->tcp_hlen = ((TCP_HDR_SIZE + opt_len) / 4) << 4;
+	ip->tcp_flags = flags;
+	ip->tcp_win = htons(0xffff);
+	ip->tcp_xsum = 0;
+	ip->tcp_urg = 0;
+	data = (u8 *)(ip + 1);
+	memcpy(data, opt, opt_len);
+	for (i = 0; i < len; i++)
+		data[opt_len + i] = sb_http_byte(srv, off + i);
+
+	/* Pseudo header, then the segment, in big-endian 16-bit words */
+	sum = IPPROTO_TCP + tcp_len;
+	for (i = 0; i < 8; i++)
+		sum += ((u8 *)&ip->ip_src)[i] << (i & 1 ? 0 : 8);
+	for (i = 0; i < tcp_len; i++)
+		sum += ((u8 *)ip)[IP_HDR_SIZE + i] << (i & 1 ? 0 : 8);
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	ip->tcp_xsum = htons(~sum & 0xffff);
+
+	priv->recv_packet_length[priv->recv_packets] =
+		ETHER_HDR_SIZE + IP_HDR_SIZE + tcp_len;
+	++priv->recv_packets;
+
+	return 0;
+}
+
+/* Send what the window allows, marking the end of the burst */
+static void sb_http_send(struct udevice *dev)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_http_server *srv = priv->priv;
+	u32 total = srv->hdr_len + SB_HTTP_FILE_SIZE;
+	int len;
+
+	while (srv->snd_nxt < total &&
+	       srv->snd_nxt < srv->snd_una + SB_HTTP_IN_FLIGHT &&
+	       priv->recv_packets < PKTBUFSRX) {
+		len = min(total - srv->snd_nxt, (u32)SB_HTTP_MSS);
+		if (srv->snd_nxt == srv->drop_off)
+			srv->drop_off = -1;
+		else
+			sb_http_reply(dev, TCP_ACK |
+				      (priv->recv_packets == PKTBUFSRX - 1 ?
+				       TCP_PUSH : 0), srv->snd_nxt, NULL, 0,
+				      len);
+		srv->snd_nxt += len;
+	}
+}
+
+static int sb_http_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	static const u8 syn_opt[] = { 2, 4, SB_HTTP_MSS >> 8,
+				      SB_HTTP_MSS & 0xff, 1, 3, 3, 0 };
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_http_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *ip = packet + ETHER_HDR_SIZE;
+	int hdr_len = (ip->tcp_hlen >> 4) * 4;
+	int dlen = ntohs(ip->ip_len) - IP_HDR_SIZE - hdr_len;
+	u8 *opt = (u8 *)(ip + 1);
+	u32 ack;
+
+	sandbox_eth_arp_req_to_reply(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_TCP ||
+	    ntohs(ip->tcp_dst) != 80)
+		return 0;
+
+	if (ip->tcp_flags & TCP_SYN) {
+		srv->client_port = ntohs(ip->tcp_src);
+		srv->client_seq = ntohl(ip->tcp_seq) + 1;
+		/* We send options in the same order */
+		if (hdr_len == TCP_HDR_SIZE + sizeof(syn_opt) &&
+		    opt[0] == 2 && opt[5] == 3) {
+			srv->client_mss = get_unaligned_be16(opt + 2);
+			srv->client_wscale = true;
+		}
+		return sb_http_reply(dev, TCP_SYN | TCP_ACK, 0, syn_opt,
+				     sizeof(syn_opt), 0);
+	}
+
+	srv->client_win = ntohs(ip->tcp_win);
+	if (ip->tcp_flags & TCP_FIN) {
+		srv->got_fin = true;
+		return 0;
+	}
+	if (dlen) {
+		/* The request: answer once it is all here */
+		if (strncmp((char *)ip + IP_HDR_SIZE + hdr_len,
+			    "GET /test.bin HTTP/1.1\r\n", 24))
+			return 0;
+		srv->client_seq += dlen;
+		srv->snd_una = 0;
+		srv->snd_nxt = 0;
+		sb_http_send(dev);
+		return 0;
+	}
+
+	ack = ntohl(ip->tcp_ack) - SB_HTTP_ISS - 1;
+	if (ack == srv->snd_una && srv->snd_nxt != srv->snd_una) {
+		/* A duplicate ACK: go back to the gap, once */
+		if (!srv->recovering) {
+			srv->recovering = true;
+			srv->snd_nxt = srv->snd_una;
+		}
+	} else if ((int)(ack - srv->snd_una) > 0) {
+		srv->snd_una = ack;
+		if ((int)(srv->snd_nxt - ack) < 0)
+			srv->snd_nxt = ack;
+		srv->recovering = false;
+	}
+	sb_http_send(dev);
+
+	return 0;
+}
+
+static int dm_test_eth_wget(struct unit_test_state *uts)
+{
+	struct sb_http_server srv = {
+		.drop_off = 3 * SB_HTTP_MSS,
+	};
+	u8 *buf;
+	int i;
+
+	srv.hdr_len = sprintf(srv.hdr,
+			      "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n",
+			      SB_HTTP_FILE_SIZE);
+	sandbox_eth_set_tx_handler(0, sb_http_handler);
+	sandbox_eth_set_priv(0, &srv);
+
+	env_set("ethact", "eth@10002000");
+	net_server_ip = string_to_ip("1.1.2.2");
+	strcpy(net_boot_file_name, "test.bin");
+	image_load_addr = SB_HTTP_LOAD_ADDR;
+
+	buf = map_sysmem(SB_HTTP_LOAD_ADDR, SB_HTTP_FILE_SIZE);
+	memset(buf, '\0', SB_HTTP_FILE_SIZE);
+	ut_asserteq(SB_HTTP_FILE_SIZE, net_loop(WGET));
+
+	for (i = 0; i < SB_HTTP_FILE_SIZE; i++)
+		ut_asserteq(sb_http_byte(&srv, srv.hdr_len + i), buf[i]);
+	unmap_sysmem(buf);
+
+	/* The lost segment was sent again and the client closed */
+	ut_asserteq(-1, srv.drop_off);
+	ut_assert(srv.got_fin);
+	/* Our MSS, and a 64KiB window scaled by one */
+	ut_asserteq(TCP_MSS, srv.client_mss);
+	ut_assert(srv.client_wscale);
+	ut_asserteq(CONFIG_TCP_WINDOW_SIZE >> 1, srv.client_win);
+
+	net_server_ip.s_addr = 0;
+	net_boot_file_name[0] = '\0';
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_wget, UT_TESTF_SCAN_FDT);
+#endif
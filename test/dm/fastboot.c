@@ -7,9 +7,12 @@
 #include <dm.h>
 #include <fastboot.h>
 #include <fb_mmc.h>
+#include <image-sparse.h>
+#include <malloc.h>
 #include <mmc.h>
 #include <part.h>
 #include <part_efi.h>
+#include <asm/unaligned.h>
 #include <dm/test.h>
 #include <test/ut.h>
 #include <linux/stringify.h>
@@ -93,3 +96,196 @@ static int dm_test_fastboot_mmc_part(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_fastboot_mmc_part, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+#define FB_STREAM_BUF_SIZE	8192
+#define FB_STREAM_RAW_SIZE	50000
+#define FB_STREAM_BLKSZ		512
+
+static u8 fb_stream_byte(int pos)
+{
+	return pos * 5 + (pos >> 9);
+}
+
+/* Download an image in uneven pieces, as a transport would */
+static int fb_stream_download(struct unit_test_state *uts, const u8 *image,
+			      int size, int piece)
+{
+	char response[FASTBOOT_RESPONSE_LEN] = {0};
+	char cmd[FASTBOOT_COMMAND_LEN];
+	int pos, len;
+
+	snprintf(cmd, sizeof(cmd), "download:%08x", size);
+	fastboot_handle_command(cmd, response);
+	ut_assertok(strncmp(response, "DATA", 4));
+
+	for (pos = 0; pos < size; pos += len) {
+		len = min(piece, size - pos);
+		fastboot_data_download(image + pos, len, response);
+		ut_asserteq_str("", response);
+		fastboot_data_flush();
+	}
+	fastboot_data_complete(response);
+	ut_asserteq_str("OKAY", response);
+
+	return 0;
+}
+
+static int dm_test_fastboot_mmc_stream(struct unit_test_state *uts)
+{
+	char response[FASTBOOT_RESPONSE_LEN] = {0};
+	char str_disk_guid[UUID_STR_LEN + 1];
+	struct blk_desc *mmc_dev_desc;
+	struct disk_partition parts[2] = {
+		{
+			.start = 48,
+			.size = 256,
+			.name = "test1",
+		},
+		{
+			.start = 304,
+			.size = 16,
+			.name = "test2",
+		},
+	};
+	u8 *buf, *image, *readback, *p;
+	chunk_header_t *chunk;
+	sparse_header_t *hdr;
+	char cmd[32];
+	int i, size;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &mmc_dev_desc));
+	if (CONFIG_IS_ENABLED(RANDOM_UUID)) {
+		gen_rand_uuid_str(parts[0].uuid, UUID_STR_FORMAT_STD);
+		gen_rand_uuid_str(parts[1].uuid, UUID_STR_FORMAT_STD);
+		gen_rand_uuid_str(str_disk_guid, UUID_STR_FORMAT_STD);
+	}
+	ut_assertok(gpt_restore(mmc_dev_desc, str_disk_guid, parts,
+				ARRAY_SIZE(parts)));
+
+	/* Images larger than the download buffer */
+	buf = malloc(FB_STREAM_BUF_SIZE);
+	image = malloc(FB_STREAM_RAW_SIZE + 4096);
+	readback = malloc(parts[0].size * FB_STREAM_BLKSZ);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(image);
+	ut_assertnonnull(readback);
+	fastboot_init(buf, FB_STREAM_BUF_SIZE);
+
+	/* Too large for the buffer unless streamed */
+	snprintf(cmd, sizeof(cmd), "download:%08x", FB_STREAM_RAW_SIZE);
+	fastboot_handle_command(cmd, response);
+	ut_assertok(strncmp(response, "FAIL", 4));
+
+	fastboot_handle_command(strcpy(cmd, "oem stream:nonexistent"),
+				response);
+	ut_assertok(strncmp(response, "FAIL", 4));
+	fastboot_handle_command(strcpy(cmd, "oem stream:test1"), response);
+	ut_asserteq_str("OKAY", response);
+
+	/* A raw image whose end is not block-aligned */
+	for (i = 0; i < FB_STREAM_RAW_SIZE; i++)
+		image[i] = fb_stream_byte(i);
+	ut_assertok(fb_stream_download(uts, image, FB_STREAM_RAW_SIZE, 1000));
+	fastboot_handle_command(strcpy(cmd, "flash:test1"), response);
+	ut_asserteq_str("OKAY", response);
+
+	size = DIV_ROUND_UP(FB_STREAM_RAW_SIZE, FB_STREAM_BLKSZ);
+	ut_asserteq(size, blk_dread(mmc_dev_desc, parts[0].start, size,
+				    readback));
+	ut_asserteq_mem(image, readback, FB_STREAM_RAW_SIZE);
+	for (i = FB_STREAM_RAW_SIZE; i < size * FB_STREAM_BLKSZ; i++)
+		ut_asserteq(0, readback[i]);
+
+	/*
+	 * A sparse image: 40 raw blocks, 20 filled, 10 skipped, an empty raw
+	 * chunk and 30 raw, sent in pieces which split its headers
+	 */
+	memset(image, '\0', FB_STREAM_RAW_SIZE + 4096);
+	hdr = (sparse_header_t *)image;
+	hdr->magic = SPARSE_HEADER_MAGIC;
+	hdr->major_version = 1;
+	hdr->file_hdr_sz = sizeof(*hdr);
+	hdr->chunk_hdr_sz = sizeof(*chunk);
+	hdr->blk_sz = FB_STREAM_BLKSZ;
+	hdr->total_blks = 100;
+	hdr->total_chunks = 5;
+	p = image + sizeof(*hdr);
+
+	chunk = (chunk_header_t *)p;
+	chunk->chunk_type = CHUNK_TYPE_RAW;
+	chunk->chunk_sz = 40;
+	chunk->total_sz = sizeof(*chunk) + 40 * FB_STREAM_BLKSZ;
+	p += sizeof(*chunk);
+	for (i = 0; i < 40 * FB_STREAM_BLKSZ; i++)
+		*p++ = fb_stream_byte(i);
+
+	chunk = (chunk_header_t *)p;
+	chunk->chunk_type = CHUNK_TYPE_FILL;
+	chunk->chunk_sz = 20;
+	chunk->total_sz = sizeof(*chunk) + sizeof(u32);
+	p += sizeof(*chunk);
+	put_unaligned_le32(0x5aa5c33c, p);
+	p += sizeof(u32);
+
+	chunk = (chunk_header_t *)p;
+	chunk->chunk_type = CHUNK_TYPE_DONT_CARE;
+	chunk->chunk_sz = 10;
+	chunk->total_sz = sizeof(*chunk);
+	p += sizeof(*chunk);
+
+	chunk = (chunk_header_t *)p;
+	chunk->chunk_type = CHUNK_TYPE_RAW;
+	chunk->chunk_sz = 0;
+	chunk->total_sz = sizeof(*chunk);
+	p += sizeof(*chunk);
+
+	chunk = (chunk_header_t *)p;
+	chunk->chunk_type = CHUNK_TYPE_RAW;
+	chunk->chunk_sz = 30;
+	chunk->total_sz = sizeof(*chunk) + 30 * FB_STREAM_BLKSZ;
+	p += sizeof(*chunk);
+	for (i = 0; i < 30 * FB_STREAM_BLKSZ; i++)
+		*p++ = ~fb_stream_byte(i);
+
+	/* The skipped blocks keep what the raw image left there */
+	ut_assertok(fb_stream_download(uts, image, p - image, 777));
+	fastboot_handle_command(strcpy(cmd, "flash:test1"), response);
+	ut_asserteq_str("OKAY", response);
+
+	ut_asserteq(100, blk_dread(mmc_dev_desc, parts[0].start, 100,
+				   readback));
+	for (i = 0; i < 40 * FB_STREAM_BLKSZ; i++)
+		ut_asserteq(fb_stream_byte(i), readback[i]);
+	for (; i < 60 * FB_STREAM_BLKSZ; i += 4)
+		ut_asserteq(0x5aa5c33c, get_unaligned_le32(readback + i));
+	for (; i < 70 * FB_STREAM_BLKSZ; i++)
+		ut_asserteq(fb_stream_byte(i), readback[i]);
+	for (; i < 100 * FB_STREAM_BLKSZ; i++)
+		ut_asserteq((u8)~fb_stream_byte(i - 70 * FB_STREAM_BLKSZ),
+			    readback[i]);
+
+	/* The result only goes with the streamed partition */
+	ut_assertok(fb_stream_download(uts, image, 1000, 1000));
+	fastboot_handle_command(strcpy(cmd, "flash:test2"), response);
+	ut_asserteq_str("FAILimage was streamed to another partition",
+			response);
+
+	/* Too large for the partition */
+	fastboot_handle_command(strcpy(cmd, "oem stream:test2"), response);
+	ut_asserteq_str("OKAY", response);
+	snprintf(cmd, sizeof(cmd), "download:%08x", 16 * FB_STREAM_BLKSZ + 1);
+	fastboot_handle_command(cmd, response);
+	ut_assertok(strncmp(response, "FAIL", 4));
+
+	fastboot_handle_command(strcpy(cmd, "oem stream:"), response);
+	ut_asserteq_str("OKAY", response);
+
+	free(readback);
+	free(image);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_mmc_stream, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
@@ -4,9 +4,16 @@
  */
 
 #include <common.h>
+#include <bloblist.h>
 #include <dm.h>
+#include <gzip.h>
+#include <malloc.h>
+#include <mapmem.h>
 #include <mmc.h>
 #include <part.h>
+#include <time.h>
+#include <asm/global_data.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -52,3 +59,223 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if defined(CONFIG_CMD_UNZIP) && defined(CONFIG_GZIP_COMPRESSED)
+/* Decompress an image to the card, through several write buffers */
+static int dm_test_mmc_gzwrite(struct unit_test_state *uts)
+{
+	const ulong size = 150000, start = 0x1200, wbuf = 0x8000;
+	const ulong blocks = DIV_ROUND_UP(size, 512);
+	struct blk_desc *dev_desc;
+	unsigned long gz_size;
+	char *data, *gz, *read;
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	data = malloc(size);
+	gz = malloc(size);
+	read = malloc((blocks + 1) * 512);
+	ut_assertnonnull(data);
+	ut_assertnonnull(gz);
+	ut_assertnonnull(read);
+
+	for (i = 0; i < size; i++)
+		data[i] = (i * 7) ^ (i >> 9);
+	gz_size = size;
+	ut_assertok(gzip(gz, &gz_size, data, size));
+
+	/* Dirty the last block, to check that the tail is padded */
+	memset(read, 0xff, 512);
+	ut_asserteq(1, blk_dwrite(dev_desc, start / 512 + blocks - 1, 1, read));
+
+	ut_assertok(gzwrite(gz, gz_size, dev_desc, wbuf, start, 0));
+	ut_asserteq(blocks, blk_dread(dev_desc, start / 512, blocks, read));
+	ut_asserteq_mem(data, read, size);
+	for (i = size; i < blocks * 512; i++)
+		ut_asserteq(0, read[i]);
+
+	/* A corrupted image must be reported */
+	gz[gz_size - 8] ^= 1;
+	ut_asserteq(-1, gzwrite(gz, gz_size, dev_desc, wbuf, start, 0));
+
+	free(read);
+	free(gz);
+	free(data);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_gzwrite, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
+
+#if CONFIG_IS_ENABLED(MMC_BUS_CACHE)
+DECLARE_GLOBAL_DATA_PTR;
+
+#define TEST_BLOBLIST_SIZE	0x100
+
+/* Find the bus settings recorded for @mmc */
+static struct mmc_bus_cache_entry *find_bus_cache(struct mmc *mmc)
+{
+	struct mmc_bus_cache *cache;
+	int i;
+
+	cache = bloblist_find(BLOBLISTT_MMC_BUS, sizeof(*cache));
+	if (!cache)
+		return NULL;
+	for (i = 0; i < MMC_BUS_CACHE_ENTRIES; i++) {
+		if (!memcmp(cache->ent[i].cid, mmc->cid, sizeof(mmc->cid)))
+			return &cache->ent[i];
+	}
+
+	return NULL;
+}
+
+/* Check that an eMMC's bus settings are recorded and then reused */
+static int check_bus_cache(struct unit_test_state *uts, struct mmc *mmc)
+{
+	struct mmc_bus_cache_entry *ent;
+
+	/* The first init selects the mode and records it */
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_assert(!IS_SD(mmc));
+	ut_asserteq(8, mmc->bus_width);
+	ent = find_bus_cache(mmc);
+	ut_assertnonnull(ent);
+	ut_asserteq(MMC_HS_52, ent->mode);
+	ut_asserteq(MMC_MODE_8BIT, ent->width);
+	ut_asserteq(mmc->tran_speed, ent->clock);
+
+	/* The next one applies the record, even though 8 bits would work */
+	ent->width = MMC_MODE_1BIT;
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(MMC_HS_52, mmc->selected_mode);
+	ut_asserteq(1, mmc->bus_width);
+
+	/* A record for another clock is stale, so the mode is selected again */
+	ent->clock /= 2;
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(8, mmc->bus_width);
+	ut_asserteq(MMC_MODE_8BIT, ent->width);
+	ut_asserteq(mmc->tran_speed, ent->clock);
+
+	return 0;
+}
+
+static int dm_test_mmc_bus_cache(struct unit_test_state *uts)
+{
+	void *old_bloblist = gd->bloblist;
+	struct udevice *dev;
+	void *buf;
+	int ret;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	sandbox_mmc_set_emmc(dev, true);
+
+	/* Use an empty bloblist, so that earlier tests make no difference */
+	buf = memalign(BLOBLIST_ALIGN, TEST_BLOBLIST_SIZE);
+	ut_assertnonnull(buf);
+	ut_assertok(bloblist_new(map_to_sysmem(buf), TEST_BLOBLIST_SIZE, 0));
+	ret = check_bus_cache(uts, mmc_get_mmc_dev(dev));
+	gd->bloblist = old_bloblist;
+	free(buf);
+	ut_assertok(ret);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_bus_cache, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/* Check that requests to an eMMC are queued on it, where possible */
+static int dm_test_mmc_cmdq(struct unit_test_state *uts)
+{
+	struct blk_request req[3];
+	struct blk_desc *desc;
+	struct udevice *dev;
+	struct mmc *mmc;
+	u8 *buf, *pattern;
+	int i;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	sandbox_mmc_set_emmc(dev, true);
+	mmc = mmc_get_mmc_dev(dev);
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(8, mmc->cmdq_depth);
+	desc = mmc_get_blk_desc(mmc);
+
+	buf = calloc(48, desc->blksz);
+	pattern = calloc(16, desc->blksz);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(pattern);
+	for (i = 0; i < 32; i++)
+		buf[i * desc->blksz] = i;
+	ut_asserteq(32, blk_dwrite(desc, 100, 32, buf));
+	blkcache_invalidate(desc->if_type, desc->devnum);
+	memset(buf, '\0', 48 * desc->blksz);
+	for (i = 0; i < 16; i++)
+		pattern[i * desc->blksz] = 0xa0 + i;
+
+	/* Two reads and a write, all queued on the card at once */
+	memset(req, '\0', sizeof(req));
+	req[0].op = BLK_REQ_READ;
+	req[0].start = 100;
+	req[0].blkcnt = 16;
+	req[0].buffer = buf;
+	req[1] = req[0];
+	req[1].start = 116;
+	req[1].buffer = buf + 16 * desc->blksz;
+	req[2].op = BLK_REQ_WRITE;
+	req[2].start = 300;
+	req[2].blkcnt = 16;
+	req[2].buffer = pattern;
+	for (i = 0; i < 3; i++)
+		ut_assertok(blk_submit(desc, &req[i]));
+	for (i = 0; i < 3; i++) {
+		ut_assertok(blk_wait(desc, &req[i]));
+		ut_asserteq(16, req[i].xfer);
+	}
+	ut_asserteq(3, sandbox_mmc_get_cqe_tasks(dev));
+	for (i = 0; i < 32; i++)
+		ut_asserteq((u8)i, buf[i * desc->blksz]);
+
+	/* The card has left command queue mode, so plain reads work again */
+	ut_asserteq(16, blk_dread(desc, 300, 16, buf + 32 * desc->blksz));
+	for (i = 0; i < 16; i++)
+		ut_asserteq(0xa0 + i, buf[(32 + i) * desc->blksz]);
+
+	/* Requests for other hardware partitions are not queued */
+	desc->hwpart = 1;
+	req[0].start = 300;
+	ut_assertok(blk_submit(desc, &req[0]));
+	ut_assertok(blk_wait(desc, &req[0]));
+	desc->hwpart = 0;
+	ut_asserteq(16, req[0].xfer);
+	ut_asserteq(3, sandbox_mmc_get_cqe_tasks(dev));
+	ut_asserteq(0xa0, buf[0]);
+
+	/* Tasks which the card never finishes fail once they time out */
+	sandbox_mmc_set_cqe_stall(dev, true);
+	req[0].start = 100;
+	req[0].xfer = 0;
+	ut_assertok(blk_submit(desc, &req[0]));
+	ut_asserteq(1, blk_poll(desc));
+	ut_assert(!req[0].done);
+	timer_test_add_offset(11000);
+	ut_asserteq(-EIO, blk_wait(desc, &req[0]));
+	ut_asserteq(0, req[0].xfer);
+	sandbox_mmc_set_cqe_stall(dev, false);
+
+	/* The card has left command queue mode again */
+	ut_asserteq(16, blk_dread(desc, 300, 16, buf));
+	ut_asserteq(0xa0, buf[0]);
+
+	free(pattern);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cmdq, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
@@ -5,6 +5,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <console.h>
 #include <dm.h>
 #include <fdtdec.h>
 #include <mapmem.h>
@@ -102,3 +103,56 @@ static int dm_test_spi_flash_func(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_spi_flash_func, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test that sf update only erases and writes the sectors which change */
+static int dm_test_spi_flash_update(struct unit_test_state *uts)
+{
+	int full_size = 0x200000;
+	int size = 0x28000;
+	u8 *src, *dst;
+	int i;
+
+	/* Sector 0 has data, sector 1 is blank and sector 2 has other data */
+	src = map_sysmem(0x20000, full_size);
+	for (i = 0; i < 0x30000; i++)
+		src[i] = i < 0x10000 ? i : i < 0x20000 ? 0xff : i * 3;
+	ut_assertok(os_write_file("spi.bin", src, full_size));
+
+	/* Keep sector 0, fill sector 1 and change half of sector 2 */
+	for (i = 0x10000; i < size; i++)
+		src[i] = i * 7;
+
+	ut_assertok(run_command("sf probe", 0));
+	console_record_reset_enable();
+	ut_assertok(run_command("sf update 20000 0 28000", 0));
+	ut_assert_nextline("device 0 offset 0x0, size 0x28000");
+	ut_assert_skipline();	/* the progress line is cleared by a '\r' */
+	ut_assert_nextlinen("%d bytes written, %d bytes skipped", 0x18000,
+			    0x10000);
+	ut_assert_console_end();
+
+	/* The rest of sector 2 must survive its erase */
+	dst = map_sysmem(0x20000 + full_size, 0x30000);
+	ut_assertok(run_command("sf read 220000 0 30000", 0));
+	ut_asserteq_mem(src, dst, size);
+	for (i = size; i < 0x30000; i++)
+		ut_asserteq((u8)(i * 3), dst[i]);
+
+	/* Nothing to do the second time */
+	console_record_reset_enable();
+	ut_assertok(run_command("sf update 20000 0 28000", 0));
+	ut_assert_nextline("device 0 offset 0x0, size 0x28000");
+	ut_assert_skipline();
+	ut_assert_nextlinen("0 bytes written, %d bytes skipped", size);
+	ut_assert_console_end();
+
+	/*
+	 * Since we are about to destroy all devices, we must tell sandbox
+	 * to forget the emulation device
+	 */
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_update, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT |
+	UT_TESTF_CONSOLE_REC);
@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests and throughput benchmark for the hash algorithms
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <malloc.h>
+#include <time.h>
+#include <linux/sizes.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <u-boot/sha512.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Amount of data hashed for each algorithm by the benchmark */
+#define HASH_BENCH_SIZE		SZ_1M
+
+/**
+ * struct hash_test - a hash algorithm to test
+ *
+ * @name:	Name of the algorithm, as used by hash_lookup_algo()
+ * @abc:	Digest of the string "abc"
+ * @block_size:	Size of the blocks passed to the compression function
+ * @check:	Check that the compression function in use matches the portable
+ *		one, NULL if the algorithm has none
+ * @bench:	Hash whole blocks using the portable compression function and
+ *		return the resulting state (up to 64 bytes), NULL if the
+ *		algorithm has none
+ */
+struct hash_test {
+	const char *name;
+	const char *abc;
+	int block_size;
+	int (*check)(struct unit_test_state *uts, const u8 *buf, int blocks);
+	void (*bench)(const u8 *buf, int blocks, void *state);
+};
+
+#if CONFIG_IS_ENABLED(SHA1)
+static int sha1_check(struct unit_test_state *uts, const u8 *buf, int blocks)
+{
+	sha1_context ctx, ref;
+
+	sha1_starts(&ctx);
+	sha1_starts(&ref);
+	sha1_process(&ctx, buf, blocks);
+	sha1_process_generic(&ref, buf, blocks);
+	ut_asserteq_mem(ref.state, ctx.state, sizeof(ctx.state));
+
+	return 0;
+}
+
+static void sha1_bench(const u8 *buf, int blocks, void *state)
+{
+	sha1_context ctx;
+
+	sha1_starts(&ctx);
+	sha1_process_generic(&ctx, buf, blocks);
+	memcpy(state, ctx.state, sizeof(ctx.state));
+}
+#endif
+
+#if CONFIG_IS_ENABLED(SHA256)
+static int sha256_check(struct unit_test_state *uts, const u8 *buf,
+			int blocks)
+{
+	sha256_context ctx, ref;
+
+	sha256_starts(&ctx);
+	sha256_starts(&ref);
+	sha256_process(&ctx, buf, blocks);
+	sha256_process_generic(&ref, buf, blocks);
+	ut_asserteq_mem(ref.state, ctx.state, sizeof(ctx.state));
+
+	return 0;
+}
+
+static void sha256_bench(const u8 *buf, int blocks, void *state)
+{
+	sha256_context ctx;
+
+	sha256_starts(&ctx);
+	sha256_process_generic(&ctx, buf, blocks);
+	memcpy(state, ctx.state, sizeof(ctx.state));
+}
+#endif
+
+#if CONFIG_IS_ENABLED(SHA512)
+static int sha512_check(struct unit_test_state *uts, const u8 *buf,
+			int blocks)
+{
+	sha512_context ctx, ref;
+
+	sha512_starts(&ctx);
+	sha512_starts(&ref);
+	sha512_process(&ctx, buf, blocks);
+	sha512_process_generic(&ref, buf, blocks);
+	ut_asserteq_mem(ref.state, ctx.state, sizeof(ctx.state));
+
+	return 0;
+}
+
+static void sha512_bench(const u8 *buf, int blocks, void *state)
+{
+	sha512_context ctx;
+
+	sha512_starts(&ctx);
+	sha512_process_generic(&ctx, buf, blocks);
+	memcpy(state, ctx.state, sizeof(ctx.state));
+}
+#endif
+
+static const struct hash_test hash_tests[] = {
+#if CONFIG_IS_ENABLED(SHA1)
+	{ "sha1", "a9993e364706816aba3e25717850c26c9cd0d89d",
+	  64, sha1_check, sha1_bench },
+#endif
+#if CONFIG_IS_ENABLED(SHA256)
+	{ "sha256",
+	  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+	  64, sha256_check, sha256_bench },
+#endif
+#if CONFIG_IS_ENABLED(SHA384)
+	{ "sha384",
+	  "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded1631a8b605a43ff5bed"
+	  "8086072ba1e7cc2358baeca134c825a7",
+	  128, NULL, NULL },
+#endif
+#if CONFIG_IS_ENABLED(SHA512)
+	{ "sha512",
+	  "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+	  "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f",
+	  128, sha512_check, sha512_bench },
+#endif
+#if CONFIG_IS_ENABLED(MD5)
+	{ "md5", "900150983cd24fb0d6963f7d28e17f72", 64, NULL, NULL },
+#endif
+#if CONFIG_IS_ENABLED(CRC32)
+	{ "crc32", "352441c2", 1, NULL, NULL },
+#endif
+};
+
+static void hash_test_fill(u8 *buf, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = i * 7 + (i >> 8);
+}
+
+/* Check the digest of "abc" and that progressive hashing gives the same */
+static int lib_test_hash_algo(struct unit_test_state *uts,
+			      const struct hash_test *test, const u8 *buf,
+			      int size)
+{
+	u8 digest[HASH_MAX_DIGEST_SIZE], value[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	char str[HASH_MAX_DIGEST_SIZE * 2 + 1];
+	int pos, chunk, i;
+	void *ctx;
+
+	ut_assertok(hash_lookup_algo(test->name, &algo));
+	algo->hash_func_ws((const u8 *)"abc", 3, digest, algo->chunk_size);
+	for (i = 0; i < algo->digest_size; i++)
+		sprintf(str + i * 2, "%02x", digest[i]);
+	ut_asserteq_str(test->abc, str);
+
+	if (!algo->hash_init)
+		return 0;
+
+	/* Use pieces which split blocks in different places */
+	algo->hash_func_ws(buf, size, digest, algo->chunk_size);
+	ut_assertok(algo->hash_init(algo, &ctx));
+	for (pos = 0, chunk = 1; pos < size; pos += chunk) {
+		chunk = min(chunk * 3 + 1, size - pos);
+		ut_assertok(algo->hash_update(algo, ctx, buf + pos, chunk,
+					      pos + chunk == size));
+	}
+	ut_assertok(algo->hash_finish(algo, ctx, value, sizeof(value)));
+	ut_asserteq_mem(digest, value, algo->digest_size);
+
+	if (test->check)
+		ut_assertok(test->check(uts, buf, size / test->block_size));
+
+	return 0;
+}
+
+static int lib_test_hash(struct unit_test_state *uts)
+{
+	const int size = 5 * SZ_1K + 3;
+	u8 *buf;
+	int i;
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	hash_test_fill(buf, size);
+	for (i = 0; i < ARRAY_SIZE(hash_tests); i++)
+		ut_assertok(lib_test_hash_algo(uts, &hash_tests[i], buf,
+					       size));
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_hash, 0);
+
+/* Work out throughput in KiB/s, given a time in microseconds */
+static ulong hash_bench_rate(ulong size, ulong us)
+{
+	return (ulong)((u64)size * 1000000 / 1024 / max(us, 1UL));
+}
+
+/*
+ * Compare the throughput of each algorithm, as used by hash_block() and
+ * friends, with that of the portable C code
+ */
+static int lib_test_hash_bench(struct unit_test_state *uts)
+{
+	u8 digest[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	ulong start, us;
+	u64 state[8];
+	u8 *buf;
+	int i;
+
+	buf = malloc(HASH_BENCH_SIZE);
+	ut_assertnonnull(buf);
+	hash_test_fill(buf, HASH_BENCH_SIZE);
+
+	printf("%-8s %12s %12s\n", "algo", "KiB/s", "generic");
+	for (i = 0; i < ARRAY_SIZE(hash_tests); i++) {
+		const struct hash_test *test = &hash_tests[i];
+
+		ut_assertok(hash_lookup_algo(test->name, &algo));
+		start = timer_get_us();
+		algo->hash_func_ws(buf, HASH_BENCH_SIZE, digest,
+				   algo->chunk_size);
+		us = timer_get_us() - start;
+		printf("%-8s %12lu", test->name,
+		       hash_bench_rate(HASH_BENCH_SIZE, us));
+
+		if (test->bench) {
+			start = timer_get_us();
+			test->bench(buf, HASH_BENCH_SIZE / test->block_size,
+				    state);
+			us = timer_get_us() - start;
+			printf(" %12lu", hash_bench_rate(HASH_BENCH_SIZE, us));
+		}
+		printf("\n");
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_hash_bench, 0);
@@ -0,0 +1,145 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Tests for the EROFS filesystem: builds images with mkfs.erofs, uncompressed
+# and LZ4-compressed, and reads them back with erofsls and erofsload.
+
+import hashlib
+import os
+import random
+import shutil
+import subprocess
+import pytest
+
+EROFS_SRC_DIR = 'erofs_src_dir'
+# (image name, mkfs.erofs options)
+EROFS_IMAGES = [
+    ('erofs_plain.img', []),
+    ('erofs_lz4.img', ['-zlz4']),
+    ('erofs_lz4_legacy.img', ['-zlz4', '-Elegacy-compress']),
+]
+
+def generate_src_dir(build_dir):
+    """ Makes the directory the images are built from.
+
+    Args:
+        build_dir: the build directory.
+    Returns:
+        A dict of the files' paths in the image and their contents.
+    """
+    root = os.path.join(build_dir, EROFS_SRC_DIR)
+    shutil.rmtree(root, ignore_errors=True)
+    os.makedirs(os.path.join(root, 'subdir'))
+
+    rng = random.Random(0)
+    text = b''.join(b'%d: the quick brown fox jumps over the lazy dog\n' %
+                    rng.randint(0, 100) for _ in range(20000))
+    files = {
+        'small': b'hello, world\n',
+        'random': bytes(rng.getrandbits(8) for _ in range(100000)),
+        'text': text,
+        'mixed': text[:50000] + bytes(rng.getrandbits(8) for _ in range(20000)),
+        'subdir/nested': b'nested file\n' * 1000,
+    }
+    for name, data in files.items():
+        with open(os.path.join(root, name), 'wb') as f:
+            f.write(data)
+    os.symlink('subdir/nested', os.path.join(root, 'link'))
+
+    return files
+
+def erofs_load_check(u_boot_console, name, data, offset=0, length=0):
+    """ Loads (part of) a file and checks its contents.
+
+    Args:
+        u_boot_console: provides the means to interact with U-Boot's console.
+        name: path of the file in the image.
+        data: expected contents of the whole file.
+        offset: where to start loading in the file.
+        length: number of bytes to load, or 0 to load to the end of the file.
+    """
+    expect = data[offset:offset + length] if length else data[offset:]
+    cmd = 'erofsload host 0 $kernel_addr_r {}'.format(name)
+    if length or offset:
+        cmd += ' {:x} {:x}'.format(length, offset)
+    out = u_boot_console.run_command(cmd)
+    assert '{} bytes read'.format(len(expect)) in out
+
+    out = u_boot_console.run_command('md5sum $kernel_addr_r {:x}'.format(
+        len(expect)))
+    assert hashlib.md5(expect).hexdigest() in out
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('cmd_erofs')
+@pytest.mark.buildconfigspec('fs_erofs')
+@pytest.mark.requiredtool('mkfs.erofs')
+def test_erofs(u_boot_console):
+    """ Lists and loads files from each image. """
+    build_dir = u_boot_console.config.build_dir
+    files = generate_src_dir(build_dir)
+    src = os.path.join(build_dir, EROFS_SRC_DIR)
+
+    try:
+        for image, opts in EROFS_IMAGES:
+            path = os.path.join(build_dir, image)
+            subprocess.run(['mkfs.erofs'] + opts + [path, src], check=True)
+            u_boot_console.run_command('host bind 0 {}'.format(path))
+
+            out = u_boot_console.run_command('erofsls host 0')
+            assert 'subdir/' in out
+            assert '<SYM>   link' in out
+            assert '{}   random'.format(len(files['random'])) in out
+            out = u_boot_console.run_command('erofsls host 0 subdir')
+            assert 'nested' in out
+
+            for name, data in files.items():
+                erofs_load_check(u_boot_console, name, data)
+            erofs_load_check(u_boot_console, 'link', files['subdir/nested'])
+            erofs_load_check(u_boot_console, 'text', files['text'], 5000,
+                             10000)
+            erofs_load_check(u_boot_console, 'mixed', files['mixed'],
+                             40000)
+
+            out = u_boot_console.run_command(
+                'erofsload host 0 $kernel_addr_r non-existent')
+            assert 'Failed to load' in out
+            os.remove(path)
+    finally:
+        shutil.rmtree(src, ignore_errors=True)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('fs_erofs')
+@pytest.mark.requiredtool('mkfs.erofs')
+def test_erofs_generic(u_boot_console):
+    """ Reads a compressed image with the generic filesystem commands. """
+    build_dir = u_boot_console.config.build_dir
+    files = generate_src_dir(build_dir)
+    src = os.path.join(build_dir, EROFS_SRC_DIR)
+    path = os.path.join(build_dir, 'erofs_generic.img')
+
+    try:
+        subprocess.run(['mkfs.erofs', '-zlz4', path, src], check=True)
+        u_boot_console.run_command('host bind 0 {}'.format(path))
+
+        out = u_boot_console.run_command('ls host 0')
+        assert 'subdir/' in out
+        assert '{}   text'.format(len(files['text'])) in out
+
+        u_boot_console.run_command('size host 0 mixed')
+        out = u_boot_console.run_command('printenv filesize')
+        assert 'filesize={:x}'.format(len(files['mixed'])) in out
+
+        for name, data in files.items():
+            out = u_boot_console.run_command(
+                'load host 0 $kernel_addr_r {}'.format(name))
+            assert '{} bytes read'.format(len(data)) in out
+            out = u_boot_console.run_command(
+                'md5sum $kernel_addr_r $filesize')
+            assert hashlib.md5(data).hexdigest() in out
+
+        out = u_boot_console.run_command('load host 0 $kernel_addr_r missing')
+        assert 'Failed to load' in out
+        os.remove(path)
+    finally:
+        shutil.rmtree(src, ignore_errors=True)